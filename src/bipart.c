@@ -0,0 +1,629 @@
+/* 
+
+Copyright (c) 2009 Thomas Junier and Evgeny Zdobnov, University of Geneva
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+* Neither the name of the University of Geneva nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "bipart.h"
+#include "tree.h"
+#include "tree_stats.h"
+#include "rnode.h"
+#include "list.h"
+#include "hash.h"
+#include "common.h"
+
+#define WORD_BITS 64
+
+/* The SplitMix64 finalizer, as in topology_hash.c */
+
+static uint64_t mix64(uint64_t x)
+{
+	x ^= x >> 30;
+	x *= 0xbf58476d1ce4e5b9ULL;
+	x ^= x >> 27;
+	x *= 0x94d049bb133111ebULL;
+	x ^= x >> 31;
+	return x;
+}
+
+uint64_t bipart_fingerprint(const uint64_t *bits, int nb_words)
+{
+	uint64_t h = 0x9e3779b97f4a7c15ULL;
+	int i;
+	for (i = 0; i < nb_words; i++)
+		h = mix64(h ^ bits[i]);
+	return h;
+}
+
+static int compare_labels(const void *a, const void *b)
+{
+	return strcmp(* (char **) a, * (char **) b);
+}
+
+/* Numbers 'labels' (which are copied), in lexical order */
+
+static enum bipart_status number_labels(char **labels, int nb_labels,
+		struct bipart_leaves **leaves_ptr)
+{
+	struct bipart_leaves *leaves = malloc(sizeof(struct bipart_leaves));
+	if (NULL == leaves) return BIPART_MEM_ERROR;
+	leaves->nb_leaves = nb_labels;
+	leaves->nb_words = (nb_labels + WORD_BITS - 1) / WORD_BITS;
+	leaves->labels = malloc(nb_labels * sizeof(char *));
+	leaves->values = malloc(nb_labels * sizeof(int));
+	leaves->numbers = create_hash(nb_labels);
+	if (NULL == leaves->labels || NULL == leaves->values ||
+		NULL == leaves->numbers)
+		return BIPART_MEM_ERROR;
+
+	int i;
+	for (i = 0; i < nb_labels; i++) {
+		leaves->labels[i] = strdup(labels[i]);
+		if (NULL == leaves->labels[i]) return BIPART_MEM_ERROR;
+	}
+	qsort(leaves->labels, nb_labels, sizeof(char *), compare_labels);
+	for (i = 0; i < nb_labels; i++) {
+		char *label = leaves->labels[i];
+		if (i > 0 && 0 == strcmp(leaves->labels[i-1], label))
+			return BIPART_DUP_LABEL;
+		leaves->values[i] = i;
+		if (! hash_set(leaves->numbers, label, leaves->values + i))
+			return BIPART_MEM_ERROR;
+	}
+
+	*leaves_ptr = leaves;
+	return BIPART_OK;
+}
+
+enum bipart_status create_bipart_leaves(struct rooted_tree *tree,
+		struct bipart_leaves **leaves_ptr)
+{
+	struct llist *labels = get_leaf_labels(tree);
+	if (NULL == labels) return BIPART_MEM_ERROR;
+	if (labels->count != leaf_count(tree)) return BIPART_EMPTY_LABEL;
+
+	char **array = (char **) llist_to_array(labels);
+	if (NULL == array) return BIPART_MEM_ERROR;
+	enum bipart_status status = number_labels(array, labels->count,
+			leaves_ptr);
+	free(array);
+	destroy_llist(labels);
+
+	return status;
+}
+
+void destroy_bipart_leaves(struct bipart_leaves *leaves)
+{
+	int i;
+	destroy_hash(leaves->numbers);
+	for (i = 0; i < leaves->nb_leaves; i++)
+		free(leaves->labels[i]);
+	free(leaves->labels);
+	free(leaves->values);
+	free(leaves);
+}
+
+/* A split's fingerprint, and where its bits are in the work space */
+
+struct fp_ref {
+	uint64_t fp;
+	int row;
+};
+
+static int compare_fp_refs(const void *a, const void *b)
+{
+	uint64_t fa = ((struct fp_ref *) a)->fp;
+	uint64_t fb = ((struct fp_ref *) b)->fp;
+	if (fa < fb) return -1;
+	if (fa > fb) return 1;
+	return 0;
+}
+
+static int popcount(const uint64_t *bits, int nb_words)
+{
+	int count = 0, i;
+	for (i = 0; i < nb_words; i++) {
+		uint64_t w = bits[i];
+		while (0 != w) { w &= w - 1; count++; }
+	}
+	return count;
+}
+
+enum bipart_status get_node_clusters(struct rooted_tree *tree,
+		struct bipart_leaves *leaves, uint64_t **bits_ptr)
+{
+	struct tree_stats *stats = get_tree_stats(tree);
+	if (NULL == stats) return BIPART_MEM_ERROR;
+	int nb_words = leaves->nb_words;
+	int nb_leaves = leaves->nb_leaves;
+
+	if (stats->nb_leaves[stats->nb_nodes - 1] != nb_leaves)
+		return BIPART_WRONG_LEAF_COUNT;
+
+	uint64_t *rows = calloc((size_t) stats->nb_nodes * nb_words,
+			sizeof(uint64_t));
+	if (NULL == rows) return BIPART_MEM_ERROR;
+
+	/* Rows are in post-order, so each node's row is complete when it is
+	 * reached, and can then be added to its parent's. */
+	int i, w;
+	for (i = 0; i < stats->nb_nodes; i++) {
+		struct rnode *node = stats->nodes[i];
+		uint64_t *row = rows + (size_t) i * nb_words;
+		if (is_leaf(node)) {
+			int *num = hash_get(leaves->numbers, node->label);
+			if (NULL == num) {
+				free(rows);
+				return BIPART_UNKNOWN_LABEL;
+			}
+			row[*num / WORD_BITS] |= 1ULL << (*num % WORD_BITS);
+		}
+		if (! is_root(node)) {
+			uint64_t *parent_row = rows +
+				(size_t) node->parent->index * nb_words;
+			for (w = 0; w < nb_words; w++)
+				parent_row[w] |= row[w];
+		}
+	}
+	/* A leaf count per row would not catch duplicate labels */
+	if (popcount(rows + (size_t) (stats->nb_nodes - 1) * nb_words,
+				nb_words) != nb_leaves) {
+		free(rows);
+		return BIPART_WRONG_LEAF_COUNT;
+	}
+
+	*bits_ptr = rows;
+	return BIPART_OK;
+}
+
+/* Collects the splits (or, if 'rooted' is true, the clusters) of the inner
+ * nodes. */
+
+static enum bipart_status make_bipart_set(struct rooted_tree *tree,
+		struct bipart_leaves *leaves, bool rooted,
+		struct bipart_set **set_ptr)
+{
+	uint64_t *work;
+	enum bipart_status status = get_node_clusters(tree, leaves, &work);
+	if (BIPART_OK != status) return status;
+
+	struct tree_stats *stats = tree->stats;
+	int nb_words = leaves->nb_words;
+	int nb_leaves = leaves->nb_leaves;
+	int last_bits = nb_leaves % WORD_BITS;
+	uint64_t last_mask = 0 == last_bits ? ~0ULL : (1ULL << last_bits) - 1;
+	struct fp_ref *refs = malloc(stats->nb_nodes * sizeof(struct fp_ref));
+	if (NULL == refs) return BIPART_MEM_ERROR;
+
+	int i, w, nb_refs = 0;
+	for (i = 0; i < stats->nb_nodes; i++) {
+		struct rnode *node = stats->nodes[i];
+		uint64_t *row = work + (size_t) i * nb_words;
+		if (is_leaf(node)) continue;
+		if (! rooted) {
+			if (is_root(node)) continue;
+			/* normalize: we want the side without leaf 0 */
+			if (row[0] & 1ULL) {
+				for (w = 0; w < nb_words; w++)
+					row[w] = ~row[w];
+				row[nb_words - 1] &= last_mask;
+			}
+			int size = popcount(row, nb_words);
+			if (size < 2 || size > nb_leaves - 2) continue;
+		}
+		refs[nb_refs].fp = bipart_fingerprint(row, nb_words);
+		refs[nb_refs].row = i;
+		nb_refs++;
+	}
+
+	qsort(refs, nb_refs, sizeof(struct fp_ref), compare_fp_refs);
+
+	struct bipart_set *set = malloc(sizeof(struct bipart_set));
+	if (NULL == set) return BIPART_MEM_ERROR;
+	set->nb_words = nb_words;
+	set->fingerprints = malloc(nb_refs * sizeof(uint64_t));
+	set->bits = malloc((size_t) nb_refs * nb_words * sizeof(uint64_t));
+	if ((NULL == set->fingerprints || NULL == set->bits) && nb_refs > 0)
+		return BIPART_MEM_ERROR;
+	/* The two edges below a root of degree 2 are the same split, and a
+	 * node with a single child has the same cluster as the child */
+	int n = 0;
+	for (i = 0; i < nb_refs; i++) {
+		if (n > 0 && set->fingerprints[n-1] == refs[i].fp) continue;
+		set->fingerprints[n] = refs[i].fp;
+		memcpy(set->bits + (size_t) n * nb_words,
+			work + (size_t) refs[i].row * nb_words,
+			nb_words * sizeof(uint64_t));
+		n++;
+	}
+	set->nb_biparts = n;
+
+	free(work);
+	free(refs);
+	*set_ptr = set;
+	return BIPART_OK;
+}
+
+enum bipart_status get_bipart_set(struct rooted_tree *tree,
+		struct bipart_leaves *leaves, struct bipart_set **set_ptr)
+{
+	return make_bipart_set(tree, leaves, false, set_ptr);
+}
+
+enum bipart_status get_cluster_set(struct rooted_tree *tree,
+		struct bipart_leaves *leaves, struct bipart_set **set_ptr)
+{
+	return make_bipart_set(tree, leaves, true, set_ptr);
+}
+
+void drop_bipart_bits(struct bipart_set *set)
+{
+	free(set->bits);
+	set->bits = NULL;
+}
+
+void destroy_bipart_set(struct bipart_set *set)
+{
+	free(set->bits);
+	free(set->fingerprints);
+	free(set);
+}
+
+int common_bipart_count(struct bipart_set *set1, struct bipart_set *set2)
+{
+	const uint64_t *fp1 = set1->fingerprints;
+	const uint64_t *fp2 = set2->fingerprints;
+	int i = 0, j = 0, common = 0;
+	while (i < set1->nb_biparts && j < set2->nb_biparts) {
+		if (fp1[i] < fp2[j])
+			i++;
+		else if (fp1[i] > fp2[j])
+			j++;
+		else {
+			common++; i++; j++;
+		}
+	}
+	return common;
+}
+
+int rf_distance(struct bipart_set *set1, struct bipart_set *set2)
+{
+	return set1->nb_biparts + set2->nb_biparts -
+		2 * common_bipart_count(set1, set2);
+}
+
+char *bits_to_s(const uint64_t *bits, int nb_leaves)
+{
+	char *result = malloc((nb_leaves + 1) * sizeof(char));
+	if (NULL == result) return NULL;
+	int n;
+	for (n = 0; n < nb_leaves; n++)
+		result[n] = (bits[n / WORD_BITS] >> (n % WORD_BITS)) & 1ULL ?
+			'*' : '.';
+	result[n] = '\0';
+	return result;
+}
+
+char *bipart_to_s(struct bipart_set *set, int i, int nb_leaves)
+{
+	return bits_to_s(set->bits + (size_t) i * set->nb_words, nb_leaves);
+}
+
+struct bipart_counts *create_bipart_counts(int nb_words)
+{
+	struct bipart_counts *counts = malloc(sizeof(struct bipart_counts));
+	if (NULL == counts) return NULL;
+	counts->nb_words = nb_words;
+	counts->nb_trees = 0;
+	counts->nb_biparts = 0;
+	counts->capacity = 64;
+	counts->nb_slots = 128;
+	counts->fingerprints = malloc(counts->capacity * sizeof(uint64_t));
+	counts->counts = malloc(counts->capacity * sizeof(int));
+	counts->bits = malloc((size_t) counts->capacity * nb_words *
+			sizeof(uint64_t));
+	counts->slots = malloc(counts->nb_slots * sizeof(int));
+	if (NULL == counts->fingerprints || NULL == counts->counts ||
+		NULL == counts->bits || NULL == counts->slots)
+		return NULL;
+	memset(counts->slots, -1, counts->nb_slots * sizeof(int));
+	return counts;
+}
+
+/* Linear probing. The fingerprints are already well mixed, so their low bits
+ * can be used directly. */
+
+static int *find_slot(struct bipart_counts *counts, uint64_t fp)
+{
+	int mask = counts->nb_slots - 1;
+	int s = (int) (fp & mask);
+	while (-1 != counts->slots[s] &&
+			counts->fingerprints[counts->slots[s]] != fp)
+		s = (s + 1) & mask;
+	return counts->slots + s;
+}
+
+static int grow_bipart_counts(struct bipart_counts *counts)
+{
+	int nb_words = counts->nb_words;
+	counts->capacity *= 2;
+	counts->fingerprints = realloc(counts->fingerprints,
+			counts->capacity * sizeof(uint64_t));
+	counts->counts = realloc(counts->counts,
+			counts->capacity * sizeof(int));
+	counts->bits = realloc(counts->bits, (size_t) counts->capacity *
+			nb_words * sizeof(uint64_t));
+	if (NULL == counts->fingerprints || NULL == counts->counts ||
+		NULL == counts->bits)
+		return FAILURE;
+
+	/* keep the load factor below 1/2 */
+	free(counts->slots);
+	counts->nb_slots = 2 * counts->capacity;
+	counts->slots = malloc(counts->nb_slots * sizeof(int));
+	if (NULL == counts->slots) return FAILURE;
+	memset(counts->slots, -1, counts->nb_slots * sizeof(int));
+	int i;
+	for (i = 0; i < counts->nb_biparts; i++)
+		*find_slot(counts, counts->fingerprints[i]) = i;
+
+	return SUCCESS;
+}
+
+int add_bipart_counts(struct bipart_counts *counts, struct bipart_set *set)
+{
+	int nb_words = counts->nb_words;
+	int i;
+	for (i = 0; i < set->nb_biparts; i++) {
+		uint64_t fp = set->fingerprints[i];
+		int *slot = find_slot(counts, fp);
+		if (-1 != *slot) {
+			counts->counts[*slot]++;
+			continue;
+		}
+		if (counts->nb_biparts == counts->capacity) {
+			if (! grow_bipart_counts(counts)) return FAILURE;
+			slot = find_slot(counts, fp);
+		}
+		int n = counts->nb_biparts++;
+		*slot = n;
+		counts->fingerprints[n] = fp;
+		counts->counts[n] = 1;
+		memcpy(counts->bits + (size_t) n * nb_words,
+			set->bits + (size_t) i * nb_words,
+			nb_words * sizeof(uint64_t));
+	}
+	counts->nb_trees++;
+	return SUCCESS;
+}
+
+int get_bipart_count(struct bipart_counts *counts, uint64_t fingerprint)
+{
+	int n = *find_slot(counts, fingerprint);
+	return -1 == n ? 0 : counts->counts[n];
+}
+
+void destroy_bipart_counts(struct bipart_counts *counts)
+{
+	free(counts->fingerprints);
+	free(counts->counts);
+	free(counts->bits);
+	free(counts->slots);
+	free(counts);
+}
+
+/* Index file layout: the header, then nb_leaves NUL-terminated labels
+ * (padded with NULs to a multiple of 8 bytes, 'labels_size' in all), then
+ * nb_biparts fingerprints, then nb_biparts counts. */
+
+static const char INDEX_MAGIC[8] = "NWSPLIT1";
+
+struct index_header {
+	char magic[8];
+	uint32_t nb_leaves;
+	uint32_t nb_trees;
+	uint32_t nb_biparts;
+	uint32_t labels_size;
+};
+
+static struct bipart_counts *sort_counts;
+
+static int compare_count_fps(const void *a, const void *b)
+{
+	uint64_t fa = sort_counts->fingerprints[* (int *) a];
+	uint64_t fb = sort_counts->fingerprints[* (int *) b];
+	if (fa < fb) return -1;
+	if (fa > fb) return 1;
+	return 0;
+}
+
+/* Writes the fingerprints in increasing order, then their counts. 'order' and
+ * 'sorted_counts' are work arrays of counts->nb_biparts elements. */
+
+static enum bipart_status write_biparts(struct bipart_counts *counts,
+		int *order, uint32_t *sorted_counts, FILE *file)
+{
+	int i;
+	for (i = 0; i < counts->nb_biparts; i++)
+		order[i] = i;
+	sort_counts = counts;
+	qsort(order, counts->nb_biparts, sizeof(int), compare_count_fps);
+	for (i = 0; i < counts->nb_biparts; i++) {
+		uint64_t fp = counts->fingerprints[order[i]];
+		if (1 != fwrite(&fp, sizeof(fp), 1, file))
+			return BIPART_IO_ERROR;
+		sorted_counts[i] = counts->counts[order[i]];
+	}
+	if (counts->nb_biparts > 0 && 1 != fwrite(sorted_counts,
+			counts->nb_biparts * sizeof(uint32_t), 1, file))
+		return BIPART_IO_ERROR;
+	return BIPART_OK;
+}
+
+enum bipart_status save_bipart_index(struct bipart_counts *counts,
+		struct bipart_leaves *leaves, FILE *file)
+{
+	struct index_header header;
+	memcpy(header.magic, INDEX_MAGIC, sizeof(header.magic));
+	header.nb_leaves = leaves->nb_leaves;
+	header.nb_trees = counts->nb_trees;
+	header.nb_biparts = counts->nb_biparts;
+	size_t labels_size = 0;
+	int i;
+	for (i = 0; i < leaves->nb_leaves; i++)
+		labels_size += strlen(leaves->labels[i]) + 1;
+	size_t padding = (8 - labels_size % 8) % 8;
+	header.labels_size = labels_size + padding;
+
+	if (1 != fwrite(&header, sizeof(header), 1, file))
+		return BIPART_IO_ERROR;
+	for (i = 0; i < leaves->nb_leaves; i++) {
+		char *label = leaves->labels[i];
+		if (1 != fwrite(label, strlen(label) + 1, 1, file))
+			return BIPART_IO_ERROR;
+	}
+	for (i = 0; i < (int) padding; i++)
+		if (EOF == fputc('\0', file)) return BIPART_IO_ERROR;
+
+	int *order = malloc(counts->nb_biparts * sizeof(int));
+	uint32_t *sorted_counts = malloc(counts->nb_biparts *
+			sizeof(uint32_t));
+	enum bipart_status status;
+	if ((NULL == order || NULL == sorted_counts) &&
+			counts->nb_biparts > 0)
+		status = BIPART_MEM_ERROR;
+	else
+		status = write_biparts(counts, order, sorted_counts, file);
+	free(order);
+	free(sorted_counts);
+
+	return status;
+}
+
+enum bipart_status load_bipart_index(const char *filename,
+		struct bipart_index **index_ptr)
+{
+	int fd = open(filename, O_RDONLY);
+	if (-1 == fd) return BIPART_IO_ERROR;
+	struct stat st;
+	if (-1 == fstat(fd, &st)) { close(fd); return BIPART_IO_ERROR; }
+	size_t size = st.st_size;
+	if (size < sizeof(struct index_header)) {
+		close(fd);
+		return BIPART_BAD_INDEX;
+	}
+	void *map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (MAP_FAILED == map) return BIPART_IO_ERROR;
+
+	const struct index_header *header = map;
+	size_t labels_end = sizeof(struct index_header) + header->labels_size;
+	if (0 != memcmp(header->magic, INDEX_MAGIC, sizeof(header->magic)) ||
+		0 != header->labels_size % 8 || size != labels_end +
+		(size_t) header->nb_biparts *
+		(sizeof(uint64_t) + sizeof(uint32_t))) {
+		munmap(map, size);
+		return BIPART_BAD_INDEX;
+	}
+
+	/* the labels are already sorted, but we need them as an array */
+	char **labels = malloc(header->nb_leaves * sizeof(char *));
+	if (NULL == labels && header->nb_leaves > 0) {
+		munmap(map, size);
+		return BIPART_MEM_ERROR;
+	}
+	const char *p = (const char *) map + sizeof(struct index_header);
+	const char *end = (const char *) map + labels_end;
+	uint32_t i;
+	for (i = 0; i < header->nb_leaves; i++) {
+		if (p >= end || NULL == memchr(p, '\0', end - p)) {
+			free(labels);
+			munmap(map, size);
+			return BIPART_BAD_INDEX;
+		}
+		labels[i] = (char *) p;
+		p += strlen(p) + 1;
+	}
+
+	struct bipart_index *index = malloc(sizeof(struct bipart_index));
+	if (NULL == index) {
+		free(labels);
+		munmap(map, size);
+		return BIPART_MEM_ERROR;
+	}
+	enum bipart_status status = number_labels(labels, header->nb_leaves,
+			&(index->leaves));
+	free(labels);
+	if (BIPART_OK != status) {
+		munmap(map, size);
+		free(index);
+		return BIPART_MEM_ERROR == status ? status : BIPART_BAD_INDEX;
+	}
+	index->map = map;
+	index->map_size = size;
+	index->nb_trees = header->nb_trees;
+	index->nb_biparts = header->nb_biparts;
+	index->fingerprints = (const uint64_t *) ((char *) map + labels_end);
+	index->counts = (const uint32_t *) (index->fingerprints +
+			index->nb_biparts);
+
+	*index_ptr = index;
+	return BIPART_OK;
+}
+
+int bipart_index_count(struct bipart_index *index, uint64_t fingerprint)
+{
+	int low = 0, high = index->nb_biparts - 1;
+	while (low <= high) {
+		int mid = low + (high - low) / 2;
+		uint64_t fp = index->fingerprints[mid];
+		if (fp < fingerprint)
+			low = mid + 1;
+		else if (fp > fingerprint)
+			high = mid - 1;
+		else
+			return index->counts[mid];
+	}
+	return 0;
+}
+
+void destroy_bipart_index(struct bipart_index *index)
+{
+	destroy_bipart_leaves(index->leaves);
+	munmap(index->map, index->map_size);
+	free(index);
+}
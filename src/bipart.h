@@ -0,0 +1,197 @@
+/* 
+
+Copyright (c) 2009 Thomas Junier and Evgeny Zdobnov, University of Geneva
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+* Neither the name of the University of Geneva nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/* Bipartitions (splits) of unrooted trees, as bitsets over a shared leaf
+ * numbering. Each inner edge of a tree splits its leaves in two; we store the
+ * side that does NOT contain leaf 0, so that a split has exactly one
+ * representation regardless of where the tree is rooted. Trivial splits (one
+ * side has fewer than 2 leaves) are not stored. Each split also gets a 64-bit
+ * fingerprint (a hash of its bits), and the splits of a tree are kept sorted
+ * by fingerprint, so that two trees can be compared by merging the sorted
+ * fingerprints, without looking at the bits. Two different splits have the
+ * same fingerprint with a probability of about 2^-64. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stddef.h>
+
+struct rooted_tree;
+struct hash;
+
+enum bipart_status {BIPART_OK, BIPART_DUP_LABEL, BIPART_EMPTY_LABEL,
+	BIPART_UNKNOWN_LABEL, BIPART_WRONG_LEAF_COUNT, BIPART_MEM_ERROR,
+	BIPART_IO_ERROR, BIPART_BAD_INDEX};
+
+/* A numbering of leaf labels, to be shared by all trees whose splits are to
+ * be compared. Labels are numbered in lexical order. */
+
+struct bipart_leaves {
+	struct hash *numbers;	/**< label -> int* */
+	char **labels;		/**< labels, by number */
+	int *values;		/**< the numbers */
+	int nb_leaves;
+	int nb_words;		/**< 64-bit words per split */
+};
+
+/* The non-trivial splits of a tree */
+
+struct bipart_set {
+	int nb_biparts;
+	int nb_words;
+	uint64_t *bits;		/**< nb_biparts * nb_words, or NULL */
+	uint64_t *fingerprints;	/**< one per split, sorted */
+};
+
+/* Numbers the leaves of 'tree', which must have unique, non-empty labels, and
+ * stores the result in '*leaves_ptr'. */
+
+enum bipart_status create_bipart_leaves(struct rooted_tree *tree,
+		struct bipart_leaves **leaves_ptr);
+
+void destroy_bipart_leaves(struct bipart_leaves *);
+
+/* Computes the splits of 'tree', whose leaves must be exactly those of
+ * 'leaves', and stores them in '*set_ptr'. */
+
+enum bipart_status get_bipart_set(struct rooted_tree *tree,
+		struct bipart_leaves *leaves, struct bipart_set **set_ptr);
+
+/* Like get_bipart_set(), but for rooted trees: stores the leaf set of every
+ * inner node (the root included) as is, i.e. the tree's clusters. */
+
+enum bipart_status get_cluster_set(struct rooted_tree *tree,
+		struct bipart_leaves *leaves, struct bipart_set **set_ptr);
+
+/* Computes the leaf set of every node of 'tree' (whose leaves must be exactly
+ * those of 'leaves'), and stores them in '*bits_ptr' (to be free()d by the
+ * caller): nb_words words per node, indexed by the node's 'index' member
+ * (see tree_stats.h). */
+
+enum bipart_status get_node_clusters(struct rooted_tree *tree,
+		struct bipart_leaves *leaves, uint64_t **bits_ptr);
+
+/* Returns the fingerprint of a leaf set */
+
+uint64_t bipart_fingerprint(const uint64_t *bits, int nb_words);
+
+/* Frees the bits of the splits, keeping only the fingerprints (which is all
+ * that is needed for computing distances). */
+
+void drop_bipart_bits(struct bipart_set *);
+
+void destroy_bipart_set(struct bipart_set *);
+
+/* Returns the number of splits found in both sets. This is a merge of the
+ * sorted fingerprints, hence linear in the number of splits. */
+
+int common_bipart_count(struct bipart_set *, struct bipart_set *);
+
+/* Returns the Robinson-Foulds distance of two trees, i.e. the number of
+ * splits found in only one of them. */
+
+int rf_distance(struct bipart_set *, struct bipart_set *);
+
+/* Returns a string representation of a leaf set (cf. node_set_to_s()), or
+ * NULL in case of malloc() problems. */
+
+char *bits_to_s(const uint64_t *bits, int nb_leaves);
+
+/* Same, for split number 'i' of 'set' */
+
+char *bipart_to_s(struct bipart_set *set, int i, int nb_leaves);
+
+/* Numbers of trees in which each split occurs, e.g. over a set of bootstrap
+ * replicates. This is a hash table keyed by fingerprint; the splits
+ * themselves are stored densely, in order of first occurrence. */
+
+struct bipart_counts {
+	int nb_words;
+	int nb_trees;		/**< number of split sets added */
+	int nb_biparts;		/**< number of distinct splits */
+	int capacity;		/**< allocated splits */
+	uint64_t *fingerprints;	/**< by split */
+	int *counts;		/**< by split */
+	uint64_t *bits;		/**< by split, nb_words each */
+	int *slots;		/**< hash table: split number, or -1 */
+	int nb_slots;		/**< a power of 2 */
+};
+
+/* Returns NULL in case of malloc() problems */
+
+struct bipart_counts *create_bipart_counts(int nb_words);
+
+/* Counts the splits of one tree, whose bits must not have been dropped. */
+/* Returns FAILURE in case of malloc() problems, SUCCESS otherwise. */
+
+int add_bipart_counts(struct bipart_counts *, struct bipart_set *);
+
+/* Returns the number of trees with the split of that fingerprint. */
+
+int get_bipart_count(struct bipart_counts *, uint64_t fingerprint);
+
+void destroy_bipart_counts(struct bipart_counts *);
+
+/* Split counts can be saved to a file, and mapped back into memory (with
+ * mmap()) without re-reading the trees. The file contains a header, the leaf
+ * labels (so that leaves are numbered the same way when it is read), and the
+ * fingerprints (sorted) with their counts - the splits' bits are not saved.
+ * Numbers are in the machine's byte order, so the file is not portable
+ * across architectures. */
+
+struct bipart_index {
+	void *map;			/**< the mapped file */
+	size_t map_size;
+	int nb_trees;
+	int nb_biparts;
+	const uint64_t *fingerprints;	/**< sorted */
+	const uint32_t *counts;
+	struct bipart_leaves *leaves;	/**< as read from the file */
+};
+
+/* Writes 'counts' (whose leaves are numbered by 'leaves') to 'file'. */
+/* Returns BIPART_IO_ERROR or BIPART_MEM_ERROR in case of problems (see errno
+ * for details). */
+
+enum bipart_status save_bipart_index(struct bipart_counts *counts,
+		struct bipart_leaves *leaves, FILE *file);
+
+/* Maps the index saved in file 'filename', and stores it in '*index_ptr'. */
+/* Returns BIPART_BAD_INDEX if the file is not an index, BIPART_IO_ERROR or
+ * BIPART_MEM_ERROR in case of other problems (see errno for details). */
+
+enum bipart_status load_bipart_index(const char *filename,
+		struct bipart_index **index_ptr);
+
+/* Returns the number of trees with the split of that fingerprint (a binary
+ * search). */
+
+int bipart_index_count(struct bipart_index *, uint64_t fingerprint);
+
+void destroy_bipart_index(struct bipart_index *);
@@ -47,16 +47,21 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "common.h"
 #include "link.h"
 #include "subtree.h"
+#include "label_matcher.h"
+#include "tree_stats.h"
+#include "label_set.h"
 
-enum modes {EXACT, REGEXP};
+enum modes {EXACT, REGEXP, BATCH};
 
 struct parameters {
 	struct llist *labels;
+	struct llist *queries;	/* of struct label_set; -f only */
 	bool check_monophyly;
 	bool siblings;
 	enum modes mode;
 	char * regexp_string;
 	regex_t *regexp;
+	struct label_matcher *matcher;	/* -r only */
 	int context;	/* how many levels above LCA */
 };
 
@@ -69,6 +74,7 @@ void help(char *argv[])
 "--------\n"
 "\n"
 "%s [-chmrs] <target tree filename|-> <label> [label]+\n"
+"%s [-chms] -f <target tree filename|-> <queries filename>\n"
 "\n"
 "Input\n"
 "-----\n"
@@ -78,13 +84,13 @@ void help(char *argv[])
 "\n"
 "The next arguments are labels found in the tree (both leaf and internal\n"
 "labels work). Any label not found in the tree will be ignored. There\n"
-"must be at least one label. (See also option -r)\n"
+"must be at least one label. (See also options -f and -r)\n"
 "\n"
 "Output\n"
 "------\n"
 "\n"
 "Outputs the clade rooted at the last common ancestor of all labels passed\n"
-"as arguments, as Newick.\n"
+"as arguments, as Newick. With -f, does this for each query in turn.\n"
 "\n"
 "Options\n"
 "-------\n"
@@ -92,6 +98,11 @@ void help(char *argv[])
 "    -c <levels (int)>: give context, i.e. start the subtree not at the last\n"
 "        common ancestor of the labels, but 'level' nodes higher (limited\n"
 "        by the tree's root, of course).\n"
+"    -f: the second argument is the name of a file of queries, one per\n"
+"        line: each query is a set of labels, separated by whitespace,\n"
+"        and is answered as if its labels had been passed as arguments.\n"
+"        Lines starting with '#', and blank lines, are ignored. This is much\n"
+"        faster than one run per query, as the tree is indexed only once.\n"
 "    -h: prints this message and exits\n"
 "    -m: only prints the clade if it is monophyletic, in the sense that ONLY\n"
 "        the labels passed as arguments are found in the clade.\n"
@@ -122,7 +133,12 @@ void help(char *argv[])
 "$ %s -r data/HRV.nw '^POLIO.*'\n"
 "\n"
 "# clade defined by Homo and Pan, plus 1 level of context\n"
-"$ %s -c 1 data/catarrhini Homo Pan\n",
+"$ %s -c 1 data/catarrhini Homo Pan\n"
+"\n"
+"# one clade for each line of file 'queries'\n"
+"$ %s -f data/catarrhini queries\n",
+	argv[0],
+	argv[0],
 	argv[0],
 	argv[0],
 	argv[0],
@@ -163,11 +179,14 @@ struct parameters get_params(int argc, char *argv[])
 	params.context = 0;
 
 	int opt_char;
-	while ((opt_char = getopt(argc, argv, "c:hmrs")) != -1) {
+	while ((opt_char = getopt(argc, argv, "c:fhmrs")) != -1) {
 		switch (opt_char) {
 		case 'c':
 			params.context = atoi(optarg);
 			break;
+		case 'f':
+			params.mode = BATCH;
+			break;
 		case 'h':
 			help(argv);
 			exit(EXIT_SUCCESS);
@@ -215,20 +234,55 @@ struct parameters get_params(int argc, char *argv[])
 			optind++;	/* optind is now index of regexp */
 			params.regexp_string = argv[optind];
 			params.regexp = compile_regexp(params.regexp_string);
+			params.matcher = create_label_matcher(params.regexp,
+					params.regexp_string, 0);
+			if (NULL == params.matcher) {
+				perror(NULL);
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case BATCH:
+			optind++;	/* optind is now index of queries file */
+			params.queries = read_label_sets(argv[optind]);
+			if (NULL == params.queries) {
+				fprintf(stderr, "%s: ", argv[optind]);
+				perror(NULL);
+				exit(EXIT_FAILURE);
+			}
 			break;
 		default:
 			fprintf (stderr, "Unknown mode %d\n", params.mode);
 			exit(EXIT_FAILURE);
 		}
 	} else {
-		fprintf(stderr, "Usage: %s [-hm] <filename|-> <label> [label+]\n",
-				argv[0]);
+		fprintf(stderr, "Usage: %s [-chmrs] <filename|-> <label> [label+]\n"
+				"or     %s [-chms] -f <filename|-> <queries filename>\n",
+				argv[0], argv[0]);
 		exit(EXIT_FAILURE);
 	}
 
 	return params;
 }
 
+static void print_clade(struct rnode *subtree_root, struct parameters params)
+{
+	if (params.siblings) {
+		struct llist *sibs = siblings(subtree_root);
+		if (NULL == sibs) {
+			perror(NULL);
+			exit(EXIT_FAILURE);
+		}
+		struct list_elem *el;
+		for (el=sibs->head;NULL!=el;el=el->next) {
+			dump_newick(el->data);
+		}
+		destroy_llist(sibs);
+	} else {
+		/* normal operation: print clade defined by labels. */
+		dump_newick(subtree_root);
+	}
+}
+
 void process_tree(struct rooted_tree *tree, struct parameters params)
 {
 	struct llist *descendants;
@@ -246,7 +300,7 @@ void process_tree(struct rooted_tree *tree, struct parameters params)
 		}
 		break;
 	case REGEXP:
-		descendants = nodes_from_regexp(tree, params.regexp);
+		descendants = nodes_from_label_matcher(tree, params.matcher);
 		if (NULL == descendants) { perror(NULL); exit(EXIT_FAILURE); }
 		if (0 == descendants->count) {
 			fprintf (stderr, "WARNING: no match for regexp /%s/\n",
@@ -273,22 +327,7 @@ void process_tree(struct rooted_tree *tree, struct parameters params)
 		    (MONOPH_TRUE == is_monophyletic(descendants, subtree_root))) {
 			/* monophyly of input labels is verified or not
 			 * requested */
-			if (params.siblings) {
-				struct llist *sibs = siblings(subtree_root);
-				if (NULL == sibs) {
-					perror(NULL);
-					exit(EXIT_FAILURE);
-				}
-				struct list_elem *el;
-				for (el=sibs->head;NULL!=el;el=el->next) {
-					dump_newick(el->data);
-				}
-				destroy_llist(sibs);
-			} else {
-				/* normal operation: print clade defined by
-				 * labels. */
-				dump_newick(subtree_root);
-			}
+			print_clade(subtree_root, params);
 		}
 	} else {
 		fprintf (stderr, "WARNING: LCA not found\n");
@@ -298,6 +337,123 @@ void process_tree(struct rooted_tree *tree, struct parameters params)
 
 }
 
+/* What the -f mode needs to know about a tree, computed once for all the
+ * queries: the label set index, plus what the monophyly test needs. */
+
+struct clade_tree_index {
+	struct label_set_index *sets;
+	/* number of labeled leaves in each node's clade, by node->index */
+	int *nb_labeled_leaves;
+	/* true iff no two nodes share a label */
+	bool unique_labels;
+};
+
+/* A query's labels are monophyletic iff they are all leaves of the clade, and
+ * the clade has no other labeled leaves. This is what is_monophyletic()
+ * checks, but it takes time proportional to the number of labels rather than
+ * to the size of the clade. When labels are not unique, the clade's leaf
+ * count says nothing about distinct labels, so is_monophyletic() is used
+ * instead. */
+
+static bool query_is_monophyletic(struct clade_tree_index *tidx,
+		struct llist *descendants, struct rnode *subtree_root)
+{
+	if (! tidx->unique_labels)
+		return MONOPH_TRUE == is_monophyletic(descendants,
+				subtree_root);
+
+	struct list_elem *el;
+	for (el = descendants->head; NULL != el; el = el->next)
+		if (! is_leaf((struct rnode *) el->data))
+			return false;
+	return descendants->count ==
+		tidx->nb_labeled_leaves[subtree_root->index];
+}
+
+static void process_query(struct clade_tree_index *tidx,
+		struct label_set *query, struct parameters params)
+{
+	struct llist *descendants = create_llist();
+	if (NULL == descendants) { perror(NULL); exit(EXIT_FAILURE); }
+
+	int i;
+	struct rnode *subtree_root = NULL;
+	for (i = 0; i < query->nb_labels; i++) {
+		struct rnode *node = hash_get(tidx->sets->label2node,
+				query->labels[i]);
+		if (NULL == node) {
+			fprintf (stderr, "WARNING: label '%s' not found.\n",
+					query->labels[i]);
+			continue;
+		}
+		if (! append_element(descendants, node)) {
+			perror(NULL);
+			exit(EXIT_FAILURE);
+		}
+		if (NULL == subtree_root)
+			subtree_root = node;
+		else
+			subtree_root = lca_index_query(tidx->sets->lca,
+					subtree_root, node);
+	}
+	if (0 == descendants->count) {
+		/* Not a failure (see process_tree()), and the next query
+		 * may well match. */
+		fprintf (stderr, "WARNING: no label matches.\n");
+		destroy_llist(descendants);
+		return;
+	}
+
+	int context;
+	for (context = params.context; context > 0; context--)
+		if (! is_root(subtree_root))
+			subtree_root = subtree_root->parent;
+
+	if ((! params.check_monophyly) ||
+	    query_is_monophyletic(tidx, descendants, subtree_root))
+		print_clade(subtree_root, params);
+
+	destroy_llist(descendants);
+}
+
+void process_tree_batch(struct rooted_tree *tree, struct parameters params)
+{
+	struct clade_tree_index tidx;
+	tidx.sets = create_label_set_index(tree);
+	if (NULL == tidx.sets) { perror(NULL); exit(EXIT_FAILURE); }
+	struct tree_stats *stats = tidx.sets->stats;
+	int n = stats->nb_nodes;
+	tidx.nb_labeled_leaves = calloc(n, sizeof(int));
+	if (NULL == tidx.nb_labeled_leaves) {
+		perror(NULL);
+		exit(EXIT_FAILURE);
+	}
+
+	/* The stats' nodes are in post-order, so children come before their
+	 * parent. A label is shared iff the map holds another node for it. */
+	tidx.unique_labels = true;
+	int i;
+	for (i = 0; i < n; i++) {
+		struct rnode *node = stats->nodes[i];
+		bool labeled = '\0' != node->label[0];
+		if (labeled &&
+			hash_get(tidx.sets->label2node, node->label) != node)
+			tidx.unique_labels = false;
+		if (is_leaf(node) && labeled)
+			tidx.nb_labeled_leaves[i]++;
+		if (! is_root(node))
+			tidx.nb_labeled_leaves[node->parent->index] +=
+				tidx.nb_labeled_leaves[i];
+	}
+
+	struct list_elem *el;
+	for (el = params.queries->head; NULL != el; el = el->next)
+		process_query(&tidx, el->data, params);
+
+	destroy_label_set_index(tidx.sets);
+	free(tidx.nb_labeled_leaves);
+}
+
 int main(int argc, char *argv[])
 {
 	struct rooted_tree *tree;	
@@ -306,14 +462,20 @@ int main(int argc, char *argv[])
 	params = get_params(argc, argv);
 
 	while ((tree = parse_tree()) != NULL) {
-		process_tree(tree, params);
+		if (BATCH == params.mode)
+			process_tree_batch(tree, params);
+		else
+			process_tree(tree, params);
 		destroy_all_rnodes(NULL);
 		destroy_tree(tree);
 	}
 
 	if (EXACT == params.mode)
 		destroy_llist(params.labels);
-	else {
+	else if (BATCH == params.mode) {
+		destroy_label_sets(params.queries);
+	} else {
+		destroy_label_matcher(params.matcher);
 		/* This does not free 'params.regexp' itself, only memory
 		 * pointed to by 'params.regexp' members and allocated by
 		 * regcomp().*/
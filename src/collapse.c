@@ -0,0 +1,304 @@
+/* 
+
+Copyright (c) 2009 Thomas Junier and Evgeny Zdobnov, University of Geneva
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+* Neither the name of the University of Geneva nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "collapse.h"
+#include "tree.h"
+#include "rnode.h"
+#include "list.h"
+#include "link.h"
+#include "hash.h"
+#include "masprintf.h"
+#include "common.h"
+
+/* Most maps have a few hundred labels at most */
+
+static const int GROUP_HASH_SIZE = 1000;
+
+/* What collapse_by_groups() knows about a node, kept in its data member */
+
+struct group_record {
+	int group;	/**< -1 if the node's leaves are not all in one group */
+	int size;	/**< number of leaves */
+	char *sample;	/**< one of the leaves' labels (not a copy) */
+	bool collapsed;
+};
+
+struct collapse_groups *create_collapse_groups()
+{
+	struct collapse_groups *groups = malloc(sizeof(struct collapse_groups));
+	if (NULL == groups) return NULL;
+	groups->label2group = create_hash(GROUP_HASH_SIZE);
+	groups->name2group = create_hash(GROUP_HASH_SIZE);
+	groups->nb_groups = 0;
+	groups->capacity = 16;
+	groups->names = malloc(groups->capacity * sizeof(char *));
+	if (NULL == groups->label2group || NULL == groups->name2group ||
+			NULL == groups->names) {
+		destroy_collapse_groups(groups);
+		return NULL;
+	}
+	return groups;
+}
+
+/* Group numbers are stored in the hashes as pointers, offset by one since
+ * hash_get() returns NULL for unknown keys. */
+
+static int get_group(struct hash *map, const char *key)
+{
+	return (int) (intptr_t) hash_get(map, key) - 1;
+}
+
+static int set_group(struct hash *map, const char *key, int group)
+{
+	return hash_set(map, key, (void *) (intptr_t) (group + 1));
+}
+
+int add_to_collapse_group(struct collapse_groups *groups, char *label,
+		char *group_name)
+{
+	int group = get_group(groups->name2group, group_name);
+	if (-1 == group) {
+		if (groups->nb_groups == groups->capacity) {
+			char **names = realloc(groups->names,
+				2 * groups->capacity * sizeof(char *));
+			if (NULL == names) return FAILURE;
+			groups->names = names;
+			groups->capacity *= 2;
+		}
+		group = groups->nb_groups;
+		groups->names[group] = strdup(group_name);
+		if (NULL == groups->names[group]) return FAILURE;
+		groups->nb_groups++;
+		if (! set_group(groups->name2group, group_name, group))
+			return FAILURE;
+	}
+	return set_group(groups->label2group, label, group);
+}
+
+void destroy_collapse_groups(struct collapse_groups *groups)
+{
+	int i;
+	for (i = 0; i < groups->nb_groups; i++)
+		free(groups->names[i]);
+	free(groups->names);
+	/* NULL if create_collapse_groups() failed */
+	if (NULL != groups->label2group) destroy_hash(groups->label2group);
+	if (NULL != groups->name2group) destroy_hash(groups->name2group);
+	free(groups);
+}
+
+/* Removes the nodes that are no longer in the tree from its nodes_in_order
+ * list (all of them have been unlinked from their parent). With 'clear_data',
+ * also sets all nodes' data members to NULL. */
+
+static void update_nodes_in_order(struct rooted_tree *tree, bool clear_data)
+{
+	struct llist *nodes = tree->nodes_in_order;
+	struct list_elem dummy_head;
+	struct list_elem *prev = &dummy_head;
+
+	dummy_head.next = nodes->head;
+	while (NULL != prev->next) {
+		struct list_elem *el = prev->next;
+		struct rnode *node = el->data;
+		if (clear_data) node->data = NULL;
+		if (node->linked || node == tree->root) {
+			prev = el;
+		} else {
+			prev->next = el->next;
+			free(el);
+			nodes->count--;
+		}
+	}
+	nodes->head = dummy_head.next;
+	nodes->tail = (&dummy_head == prev) ? NULL : prev;
+}
+
+static bool is_collapsible(struct rnode *node,
+		struct collapse_criteria *criteria)
+{
+	if (is_leaf(node)) return false;
+	if (criteria->by_support && '\0' != node->label[0]) {
+		char *end;
+		double support = strtod(node->label, &end);
+		if ('\0' == *end && support < criteria->min_support)
+			return true;
+	}
+	if (criteria->by_length && '\0' != node->edge_length_as_string[0] &&
+		atof(node->edge_length_as_string) <= criteria->max_length)
+		return true;
+	return false;
+}
+
+/* Replaces the node's collapsible children by their own children. These have
+ * already been visited (post-order), so they have no collapsible children
+ * left, and the node's children list is rebuilt only once. */
+
+static int absorb_collapsible_children(struct rnode *node,
+		struct collapse_criteria *criteria)
+{
+	struct rnode *head = NULL;
+	struct rnode **tail = &head;
+	struct rnode *kid, *next_kid;
+	int count = 0;
+	bool changed = false;
+	int i, j;
+
+	for (i = 0, kid = node->first_child; i < node->child_count;
+			i++, kid = next_kid) {
+		next_kid = kid->next_sibling;
+		if (! is_collapsible(kid, criteria)) {
+			*tail = kid;
+			tail = &(kid->next_sibling);
+			count++;
+			continue;
+		}
+		struct rnode *grandkid, *next_grandkid;
+		for (j = 0, grandkid = kid->first_child; j < kid->child_count;
+				j++, grandkid = next_grandkid) {
+			next_grandkid = grandkid->next_sibling;
+			if ('\0' != kid->edge_length_as_string[0]) {
+				char *length = add_len_strings(
+					kid->edge_length_as_string,
+					grandkid->edge_length_as_string);
+				if (NULL == length) return FAILURE;
+				free(grandkid->edge_length_as_string);
+				grandkid->edge_length_as_string = length;
+			}
+			grandkid->parent = node;
+			*tail = grandkid;
+			tail = &(grandkid->next_sibling);
+			count++;
+		}
+		kid->linked = false;
+		changed = true;
+	}
+
+	if (changed) {
+		node->child_count = count;
+		set_children_order(node, head);
+	}
+	return SUCCESS;
+}
+
+int collapse_into_polytomies(struct rooted_tree *tree,
+		struct collapse_criteria *criteria)
+{
+	struct list_elem *el;
+
+	for (el = tree->nodes_in_order->head; NULL != el; el = el->next) {
+		struct rnode *current = el->data;
+		if (is_leaf(current)) continue;
+		if (! absorb_collapsible_children(current, criteria))
+			return FAILURE;
+	}
+	update_nodes_in_order(tree, false);
+	return SUCCESS;
+}
+
+/* Gives a collapsed clade its final label. This is only done for maximal
+ * clades, so that nested ones don't get labels that are never seen. */
+
+static int label_clade(struct rnode *node, struct collapse_groups *groups)
+{
+	struct group_record *record = node->data;
+	char *label = masprintf("%s_%s_%d", groups->names[record->group],
+			record->sample, record->size);
+	if (NULL == label) return FAILURE;
+	free(node->label);
+	node->label = label;
+	return SUCCESS;
+}
+
+int collapse_by_groups(struct rooted_tree *tree,
+		struct collapse_groups *groups)
+{
+	struct group_record *work = malloc(tree->nodes_in_order->count *
+			sizeof(struct group_record));
+	if (NULL == work) return FAILURE;
+	struct group_record *record = work;
+	struct list_elem *el;
+	int status = SUCCESS;
+	int i;
+
+	for (el = tree->nodes_in_order->head; NULL != el && SUCCESS == status;
+			el = el->next, record++) {
+		struct rnode *current = el->data;
+		current->data = record;
+		record->collapsed = false;
+		if (is_leaf(current)) {
+			record->group = get_group(groups->label2group,
+					current->label);
+			record->size = 1;
+			record->sample = current->label;
+			continue;
+		}
+
+		/* All children have their records (post-order), and pure
+		 * subtrees have already been collapsed to leaves. */
+		struct rnode *kid = current->first_child;
+		record->group = ((struct group_record *) kid->data)->group;
+		record->size = 0;
+		for (i = 0; i < current->child_count; i++) {
+			struct group_record *kid_record = kid->data;
+			if (kid_record->group != record->group)
+				record->group = -1;
+			record->size += kid_record->size;
+			record->sample = kid_record->sample;
+			kid = kid->next_sibling;
+		}
+
+		if (-1 != record->group) {
+			remove_children(current);
+			record->collapsed = true;
+			continue;
+		}
+		/* This node is mixed, so its collapsed children are maximal */
+		for (i = 0, kid = current->first_child;
+			i < current->child_count; i++, kid = kid->next_sibling) {
+			if (((struct group_record *) kid->data)->collapsed &&
+				! label_clade(kid, groups)) {
+				status = FAILURE;
+				break;
+			}
+		}
+	}
+	if (SUCCESS == status &&
+		((struct group_record *) tree->root->data)->collapsed)
+		status = label_clade(tree->root, groups);
+
+	update_nodes_in_order(tree, true);
+	free(work);
+	return status;
+}
@@ -0,0 +1,101 @@
+/* 
+
+Copyright (c) 2009 Thomas Junier and Evgeny Zdobnov, University of Geneva
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+* Neither the name of the University of Geneva nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+/* Collapsing nodes, in a single post-order pass. There are two kinds of
+ * collapse:
+ *
+ * - into polytomies: an inner node that is poorly supported, or whose parent
+ *   edge is very short, is replaced by its children (whose parent edges are
+ *   lengthened accordingly);
+ *
+ * - by groups: a clade whose leaves all belong to the same group (as given by
+ *   a label -> group map) is replaced by a single leaf.
+ *
+ * Apart from the new labels of collapsed clades and the new lengths of
+ * lengthened edges, the collapse functions allocate at most one work array
+ * per tree. The tree's nodes_in_order list is updated (nodes that are no
+ * longer in the tree are removed from it). */
+
+#include <stdbool.h>
+
+struct rooted_tree;
+struct hash;
+
+/* A label -> group map. Groups are numbered, so each node's group is an int
+ * and no names are compared or copied while collapsing. */
+
+struct collapse_groups {
+	struct hash *label2group;	/**< label -> group number + 1 */
+	struct hash *name2group;	/**< group name -> group number + 1 */
+	char **names;			/**< group number -> group name */
+	int nb_groups;
+	int capacity;
+};
+
+/* Which inner nodes to collapse into polytomies. A node is collapsed if its
+ * label is a number lower than 'min_support' (with 'by_support'), or if its
+ * parent edge's length is at most 'max_length' (with 'by_length'). Unlabeled
+ * nodes and edges without length are kept, and so is the root. */
+
+struct collapse_criteria {
+	bool by_support;
+	double min_support;
+	bool by_length;
+	double max_length;
+};
+
+/* Returns NULL in case of malloc() problems. */
+
+struct collapse_groups *create_collapse_groups();
+
+/* Puts 'label' in group 'group_name' (a label can only be in one group: the
+ * last one given). */
+/* Returns FAILURE in case of malloc() problems. */
+
+int add_to_collapse_group(struct collapse_groups *, char *label,
+		char *group_name);
+
+/* Also frees partially built groups (see create_collapse_groups()) */
+
+void destroy_collapse_groups(struct collapse_groups *);
+
+/* Collapses inner nodes that meet the criteria: their children become
+ * children of their parent, in their place. */
+/* Returns FAILURE in case of malloc() problems. */
+
+int collapse_into_polytomies(struct rooted_tree *,
+		struct collapse_criteria *);
+
+/* Replaces every maximal clade whose leaves all belong to the same group by a
+ * leaf labeled <group name>_<sample>_<size>, where <sample> is the label of
+ * one of the clade's leaves and <size> is the number of leaves. Leaves that
+ * are not in any group are never collapsed. */
+/* Returns FAILURE in case of malloc() problems. */
+
+int collapse_by_groups(struct rooted_tree *, struct collapse_groups *);
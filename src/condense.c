@@ -40,22 +40,17 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "parser.h"
 #include "to_newick.h"
 #include "readline.h"
-#include "hash.h"
-#include "list.h"
-#include "link.h"
-#include "masprintf.h"
+#include "pipeline.h"
+#include "collapse.h"
 
 enum actions { PURE_CLADES, STAIR_NODES }; /* not sure we'll keep stair nodes */
 
-struct group_data {
-	char *name;
-	char *repr_member;	/* the label of a "representative" for the group */
-	int size;
-};
-
 struct parameters {
 	enum actions action;	/* for now, only condense pure clades */
 	char *grp_map_fname;
+	int nb_workers;
+	struct collapse_criteria criteria;
+	struct collapse_groups *groups;	/* read from grp_map_fname, if any */
 };
 
 void help(char *argv[])
@@ -66,7 +61,7 @@ void help(char *argv[])
 "Synopsis\n"
 "--------\n"
 "\n"
-"%s [-hm:] <tree|->\n"
+"%s [-b <support>] [-hl:m:] [-j <processes>] <tree|->\n"
 "\n"
 "Input\n"
 "-----\n"
@@ -83,10 +78,22 @@ void help(char *argv[])
 "(A,B);. The collapsed clade's support value (if any) is preserved, as is\n"
 "its parent edge's length (if specified).\n"
 "\n"
+"With options -b and/or -l, poorly supported or very short inner branches\n"
+"are collapsed instead (and pure clades are not, unless -m is also\n"
+"passed): the node below the branch is replaced by its children, which\n"
+"makes a polytomy. The removed branch's length is added to the children's.\n"
+"\n"
 "Options\n"
 "-------\n"
 "\n"
+"   -b <support>: collapses inner nodes whose label is a number (e.g., a\n"
+"      bootstrap value) lower than <support>. Unlabeled nodes are kept.\n"
 "   -h: prints this message and exits\n"
+"   -j <n>: process the trees in n processes (default: 1). The output is\n"
+"      the same, and in the same order.\n"
+"   -l <length>: collapses inner nodes whose parent edge is not longer\n"
+"      than <length> (use 0 to collapse zero-length branches). Edges\n"
+"      without a length are kept.\n"
 "   -m <map file>: uses a group map. This is a text file that lists one\n"
 "      label and one group name per line. For example a file with the\n"
 "      following contents\n"
@@ -107,6 +114,8 @@ void help(char *argv[])
 "      map would condense all African apes into a single leaf (since they\n"
 "      form a clade) with label 'Africa_Homo_3'. It would not be able to\n"
 "      condense further, however, because Pongo belong to group 'Asia'.\n"
+"      Leaves that are not in the map do not belong to any group, and are\n"
+"      never condensed.\n"
 "\n"
 "Example\n"
 "-------\n"
@@ -117,7 +126,11 @@ void help(char *argv[])
 "$ %s data/falc_families\n"
 "\n"
 "# condense by geographic origin\n"
-"$ %s -m data/catarrhini_geog.map data/catarrhini\n",
+"$ %s -m data/catarrhini_geog.map data/catarrhini\n"
+"\n"
+"# collapse nodes with less than 70%% bootstrap support\n"
+"$ %s -b 70 data/HRV.nw\n",
+argv[0],
 argv[0],
 argv[0],
 argv[0]
@@ -131,14 +144,30 @@ struct parameters params;
 
 params.action = PURE_CLADES;
 params.grp_map_fname = NULL;
+params.nb_workers = 1;
+params.criteria.by_support = false;
+params.criteria.min_support = 0;
+params.criteria.by_length = false;
+params.criteria.max_length = 0;
 
 /* parse options and switches */
 int opt_char;
-while ((opt_char = getopt(argc, argv, "hm:s")) != -1) {
+while ((opt_char = getopt(argc, argv, "b:hj:l:m:s")) != -1) {
 	switch (opt_char) {
+	case 'b':
+		params.criteria.by_support = true;
+		params.criteria.min_support = atof(optarg);
+		break;
 	case 'h':
 		help(argv);
 		exit(EXIT_SUCCESS);
+	case 'j':
+		params.nb_workers = parse_nb_workers(optarg);
+		break;
+	case 'l':
+		params.criteria.by_length = true;
+		params.criteria.max_length = atof(optarg);
+		break;
 	case 'm':
 		// TODO: check return values of strdup() (in ALL the code)!
 			params.grp_map_fname = optarg;
@@ -162,7 +191,8 @@ while ((opt_char = getopt(argc, argv, "hm:s")) != -1) {
 			nwsin = fin;
 		}
 	} else {
-		fprintf(stderr, "Usage: %s [-hm:] <filename|->\n",
+		fprintf(stderr, "Usage: %s [-b <support>] [-hl:m:] [-j <processes>] "
+				"<filename|->\n",
 				argv[0]);
 		exit(EXIT_FAILURE);
 	}
@@ -170,18 +200,15 @@ while ((opt_char = getopt(argc, argv, "hm:s")) != -1) {
 	return params;
 }
 
-// TODO: this f() has been duplicated from condense.c. It should be removed from
-// there and from here, and moved to hash.c
+/* Reads a group map: one label and one group name per line */
 
-struct hash *read_map(const char *filename)
+struct collapse_groups *read_groups(const char *filename)
 {
-	const int HASH_SIZE = 1000;	/* most trees will have fewer nodes */
-
 	FILE *map_file = fopen(filename, "r");
 	if (NULL == map_file) { perror(NULL); exit(EXIT_FAILURE); }
 
-	struct hash *map = create_hash(HASH_SIZE);
-	if (NULL == map) { perror(NULL); exit(EXIT_FAILURE); }
+	struct collapse_groups *groups = create_collapse_groups();
+	if (NULL == groups) { perror(NULL); exit(EXIT_FAILURE); }
 
 	char *line;
 	while (NULL != (line = read_line(map_file))) {
@@ -191,167 +218,71 @@ struct hash *read_map(const char *filename)
 			continue;
 		}
 
-		char *key, *value;
+		char *label, *group;
 		struct word_tokenizer *wtok = create_word_tokenizer(line);
 		if (NULL == wtok) { perror(NULL); exit(EXIT_FAILURE); }
-		key = wt_next(wtok);	/* find first whitespace */
-		if (NULL == key) {
+		label = wt_next(wtok);	/* find first whitespace */
+		if (NULL == label) {
 			fprintf (stderr,
 				"Wrong format in line '%s' - aborting.\n",
 				line);
 			exit(EXIT_FAILURE);
 		}
-		value = wt_next(wtok);
-		if (NULL == value) {
-			/* If 2nd token is NULL, replace label with empty
-			 * string */
-			value = strdup("");
+		group = wt_next(wtok);
+		if (NULL == group) {
+			/* If 2nd token is NULL, the group has no name */
+			group = strdup("");
 		}
-		if (! hash_set(map, key, (void *) value)) {
+		if (! add_to_collapse_group(groups, label, group)) {
 			perror(NULL);
 			exit(EXIT_FAILURE);
 		}
 		destroy_word_tokenizer(wtok);
-		free(key); /* copied by hash_set(), so can be free()d now */
+		free(label); /* copied by add_to_collapse_group() */
+		free(group);
 		free(line);
 	}
+	fclose(map_file);
 
-	return map;
+	return groups;
 }
 
-/* Like all_children_have_same_label() in rnode.c, but returns true if all
- * children belong to the same group, as determined by the rnode->data member.
- * Sets group to the common group, if any, or else to NULL.  */
-
-bool all_children_in_same_group(struct rnode *node, struct group_data *grp_data)
+static void process_tree(struct rooted_tree *tree, void *arg)
 {
-
-	if (is_leaf(node))
-		return false;
-
-	/* get first child's group */
-	struct rnode *curr = node->first_child;
-	struct group_data *g_data = curr->data;
-	char *ref_group = g_data->name;
-
-	/* iterate over other children, and compare their group to the first's
-	 * */
-
-	int status = 1;
-	int size = 1;
-	for (curr = curr->next_sibling; curr; curr = curr->next_sibling) {
-		g_data = curr->data;
-		char *curr_group = g_data->name;
-		if (0 != strcmp(ref_group, curr_group))
-			status *= 0; /* found a different group */
-		size += g_data->size;
+	struct parameters *params = arg;
+	bool polytomies = params->criteria.by_support ||
+		params->criteria.by_length;
+	if (polytomies &&
+		! collapse_into_polytomies(tree, &(params->criteria))) {
+		perror(NULL);
+		exit(EXIT_FAILURE);
 	}
-
-	grp_data->name = strdup(g_data->name);
-	grp_data->repr_member = strdup(g_data->repr_member);
-	grp_data->size = size;
-
-	return (bool) status;
-}
-
-/* Same as collapse_pure_clades() (tree.c), but collapses clades of the same
- * group, usig a label->group map. */
-
-void collapse_by_groups(struct rooted_tree *tree, struct hash *group_map)
-{
-	struct list_elem *el;		
-	struct group_data *grp_data;
-
-	for (el = tree->nodes_in_order->head; NULL != el; el = el->next) {
-		struct rnode *current = el->data;
-		grp_data = malloc(sizeof(grp_data));
-		if (NULL == grp_data) { perror(NULL); exit (EXIT_FAILURE); }
-		current->data = grp_data;
-
-		if (is_leaf(current)) {
-			char *group = hash_get(group_map, current->label);
-			if (NULL == group) 
-				grp_data->name = strdup("");
-			else
-				grp_data->name = strdup(group);
-			grp_data->repr_member = strdup(current->label);
-			grp_data->size = 1;
-			
-			continue;
-		}
-
-		grp_data->name = strdup("MIXED");
-		grp_data->repr_member = strdup("");
-		grp_data->size = -1;
-
-		/* attempt collapse only if all children are leaves (any pure
-		 * subtree will have been collapsed to a leaf by now) */
-		if (! all_children_are_leaves(current)) continue;
-
-		/* this also sets grp_data */
-		if (all_children_in_same_group(current, grp_data)) {
-			/*
-			 fprintf(stderr,
-				"%s and %d other descendants of '%s' "
-				"belong to group '%s'\n",
-				grp_data->repr_member,
-				grp_data->size - 1,
-				current->label,
-				grp_data->name);
-				*/
-			remove_children(current);
-			char *new_label = masprintf("%s_%s_%d",
-					grp_data->name, grp_data->repr_member,
-					grp_data->size);
-			free(current->label);
-			current->label = new_label;
+	if (NULL != params->groups) {
+		if (! collapse_by_groups(tree, params->groups)) {
+			perror(NULL);
+			exit(EXIT_FAILURE);
 		}
+	} else if (! polytomies) {
+		collapse_pure_clades(tree);
 	}
-}
 
+	dump_newick(tree->root);
+	destroy_all_rnodes(NULL);
+	destroy_tree(tree);
+}
 
 int main(int argc, char *argv[])
 {
-	struct rooted_tree *tree;	
 	struct parameters params;
-	struct hash *group_map = NULL;
 	
 	params = get_params(argc, argv);
+	params.groups = NULL;
 	if (NULL != params.grp_map_fname)
-		group_map = read_map(params.grp_map_fname);
+		params.groups = read_groups(params.grp_map_fname);
 
-	// debug
-	// if (NULL != group_map) dump_hash(group_map, NULL);
-
-	while (true) {
-		tree = parse_tree();
-		if (NULL != tree) {
-			if (NULL == group_map)
-				collapse_pure_clades(tree);
-			else
-				collapse_by_groups(tree, group_map);
-
-			dump_newick(tree->root);
-			destroy_all_rnodes(NULL);
-			destroy_tree(tree);
-		}
-		else switch (newick_parser_status) {
-			case PARSER_STATUS_EMPTY:	/* EOF, etc. */
-				/* goto is ok to break "twice" */
-				goto end;
-			case PARSER_STATUS_PARSE_ERROR:
-				/* for now, the parser prints the error message
-				 * */
-				break;
-			case PARSER_STATUS_MALLOC_ERROR:
-				perror(NULL);
-				exit(EXIT_FAILURE);
-			default:
-				assert(0);	/* programmer error */
-		}
-	}
-
-end:
+	/* For now, the parser prints the error message, if any */
+	if (! run_tree_pipeline(params.nb_workers, process_tree, &params))
+		exit(EXIT_FAILURE);
 
 	return 0;
 }
@@ -0,0 +1,295 @@
+/* 
+
+Copyright (c) 2009 Thomas Junier and Evgeny Zdobnov, University of Geneva
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+* Neither the name of the University of Geneva nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "consensus.h"
+#include "bipart.h"
+#include "rnode.h"
+#include "link.h"
+#include "masprintf.h"
+
+/* The consensus is built as a tree of leaf sets, into which splits are
+ * inserted one at a time. Since splits are stored as the side without leaf 0
+ * (see bipart.h), compatible splits are either nested or disjoint, so the
+ * tree is simply rooted on leaf 0: its root is the set of all leaves, and
+ * leaf 0 stays one of the root's children. A split fits below the smallest
+ * node N that contains it, and it is compatible with the tree iff each of N's
+ * children is either inside it or disjoint from it - the former then become
+ * the children of the new node. Nodes 0 to nb_leaves - 1 are the leaves, and
+ * node nb_leaves is the root. */
+
+struct cons_tree {
+	int nb_words;
+	int nb_nodes;
+	uint64_t *bits;		/* per node, nb_words each */
+	int *size;		/* number of leaves */
+	int *parent;
+	int *first_child;
+	int *next_sibling;
+	int *split;		/* number of the split in the counts, or -1 */
+};
+
+static struct cons_tree *create_cons_tree(int nb_leaves, int nb_words)
+{
+	/* a tree with n leaves has at most 2n - 1 nodes */
+	int max_nodes = 2 * nb_leaves;
+	struct cons_tree *tree = malloc(sizeof(struct cons_tree));
+	if (NULL == tree) return NULL;
+	tree->nb_words = nb_words;
+	tree->bits = calloc((size_t) max_nodes * nb_words, sizeof(uint64_t));
+	tree->size = malloc(max_nodes * sizeof(int));
+	tree->parent = malloc(max_nodes * sizeof(int));
+	tree->first_child = malloc(max_nodes * sizeof(int));
+	tree->next_sibling = malloc(max_nodes * sizeof(int));
+	tree->split = malloc(max_nodes * sizeof(int));
+	if (NULL == tree->bits || NULL == tree->size || NULL == tree->parent ||
+		NULL == tree->first_child || NULL == tree->next_sibling ||
+		NULL == tree->split)
+		return NULL;
+
+	/* a star tree */
+	int root = nb_leaves;
+	int i;
+	for (i = 0; i < nb_leaves; i++) {
+		tree->bits[(size_t) i * nb_words + i / 64] = 1ULL << (i % 64);
+		tree->bits[(size_t) root * nb_words + i / 64] |=
+			1ULL << (i % 64);
+		tree->size[i] = 1;
+		tree->parent[i] = root;
+		tree->first_child[i] = -1;
+		tree->next_sibling[i] = i + 1 < nb_leaves ? i + 1 : -1;
+		tree->split[i] = -1;
+	}
+	tree->size[root] = nb_leaves;
+	tree->parent[root] = -1;
+	tree->first_child[root] = 0;
+	tree->next_sibling[root] = -1;
+	tree->split[root] = -1;
+	tree->nb_nodes = nb_leaves + 1;
+
+	return tree;
+}
+
+static void destroy_cons_tree(struct cons_tree *tree)
+{
+	free(tree->bits);
+	free(tree->size);
+	free(tree->parent);
+	free(tree->first_child);
+	free(tree->next_sibling);
+	free(tree->split);
+	free(tree);
+}
+
+static int popcount(const uint64_t *bits, int nb_words)
+{
+	int count = 0, i;
+	for (i = 0; i < nb_words; i++) {
+		uint64_t w = bits[i];
+		while (0 != w) { w &= w - 1; count++; }
+	}
+	return count;
+}
+
+/* Number of leaves in both sets */
+
+static int common_count(const uint64_t *a, const uint64_t *b, int nb_words)
+{
+	int count = 0, i;
+	for (i = 0; i < nb_words; i++) {
+		uint64_t w = a[i] & b[i];
+		while (0 != w) { w &= w - 1; count++; }
+	}
+	return count;
+}
+
+static int first_leaf(const uint64_t *bits, int nb_words)
+{
+	int i, b;
+	for (i = 0; i < nb_words; i++)
+		if (0 != bits[i])
+			for (b = 0; b < 64; b++)
+				if (bits[i] & (1ULL << b)) return 64 * i + b;
+	return -1;
+}
+
+/* Inserts split number 'split', if it is compatible with the tree. Returns
+ * true iff it was inserted. */
+
+static bool insert_split(struct cons_tree *tree, const uint64_t *bits,
+		int split)
+{
+	int nb_words = tree->nb_words;
+	int size = popcount(bits, nb_words);
+
+	/* smallest node that contains the split */
+	int node = tree->parent[first_leaf(bits, nb_words)];
+	while (tree->size[node] < size || common_count(bits,
+			tree->bits + (size_t) node * nb_words, nb_words) < size)
+		node = tree->parent[node];
+
+	int kid, inside = 0;
+	for (kid = tree->first_child[node]; -1 != kid;
+			kid = tree->next_sibling[kid]) {
+		int common = common_count(bits,
+			tree->bits + (size_t) kid * nb_words, nb_words);
+		if (common == tree->size[kid])
+			inside += common;
+		else if (0 != common)
+			return false;
+	}
+	if (inside == tree->size[node]) return false; /* same set */
+
+	int new = tree->nb_nodes++;
+	memcpy(tree->bits + (size_t) new * nb_words, bits,
+			nb_words * sizeof(uint64_t));
+	tree->size[new] = size;
+	tree->split[new] = split;
+	tree->parent[new] = node;
+	tree->first_child[new] = -1;
+
+	/* move the children that are inside the split below the new node */
+	int *link = tree->first_child + node;
+	int *new_link = tree->first_child + new;
+	for (kid = tree->first_child[node]; -1 != kid; ) {
+		int next = tree->next_sibling[kid];
+		if (common_count(bits, tree->bits + (size_t) kid * nb_words,
+					nb_words) > 0) {
+			*new_link = kid;
+			new_link = tree->next_sibling + kid;
+			tree->parent[kid] = new;
+		} else {
+			*link = kid;
+			link = tree->next_sibling + kid;
+		}
+		kid = next;
+	}
+	*new_link = -1;
+	*link = new;
+	tree->next_sibling[new] = -1;
+
+	return true;
+}
+
+static struct bipart_counts *sort_counts;
+
+/* By decreasing count, then by increasing split number (i.e., order of first
+ * occurrence), so that the result does not depend on qsort(). */
+
+static int compare_splits(const void *a, const void *b)
+{
+	int sa = * (int *) a, sb = * (int *) b;
+	int diff = sort_counts->counts[sb] - sort_counts->counts[sa];
+	if (0 != diff) return diff;
+	return sa - sb;
+}
+
+static struct rnode *to_rnode(struct cons_tree *tree, int node,
+		struct bipart_counts *counts, struct bipart_leaves *leaves,
+		bool use_percent)
+{
+	struct rnode *result;
+	if (-1 == tree->first_child[node])
+		return create_rnode(leaves->labels[node], "");
+
+	if (-1 == tree->split[node]) {
+		result = create_rnode("", "");
+	} else {
+		int count = counts->counts[tree->split[node]];
+		if (use_percent)
+			count = 100 * count / counts->nb_trees;
+		char *label = masprintf("%d", count);
+		if (NULL == label) return NULL;
+		result = create_rnode(label, "");
+		free(label);
+	}
+	if (NULL == result) return NULL;
+
+	int kid;
+	for (kid = tree->first_child[node]; -1 != kid;
+			kid = tree->next_sibling[kid]) {
+		struct rnode *child = to_rnode(tree, kid, counts, leaves,
+				use_percent);
+		if (NULL == child) return NULL;
+		add_child(result, child);
+	}
+
+	return result;
+}
+
+struct rnode *consensus_tree(struct bipart_counts *counts,
+		struct bipart_leaves *leaves, enum consensus_type type,
+		bool use_percent)
+{
+	int nb_words = leaves->nb_words;
+	struct cons_tree *tree = create_cons_tree(leaves->nb_leaves, nb_words);
+	if (NULL == tree) return NULL;
+
+	int min_count;
+	switch (type) {
+	case CONSENSUS_STRICT:
+		min_count = counts->nb_trees;
+		break;
+	case CONSENSUS_MAJORITY:
+		min_count = counts->nb_trees / 2 + 1;
+		break;
+	default:
+		min_count = 1;
+	}
+
+	int *order = malloc(counts->nb_biparts * sizeof(int));
+	if (NULL == order && counts->nb_biparts > 0) return NULL;
+	int i, nb_candidates = 0;
+	for (i = 0; i < counts->nb_biparts; i++)
+		if (counts->counts[i] >= min_count)
+			order[nb_candidates++] = i;
+	sort_counts = counts;
+	qsort(order, nb_candidates, sizeof(int), compare_splits);
+
+	/* a fully resolved tree has nb_leaves - 3 splits */
+	int nb_inserted = 0;
+	for (i = 0; i < nb_candidates &&
+			nb_inserted < leaves->nb_leaves - 3; i++) {
+		int split = order[i];
+		if (insert_split(tree, counts->bits + (size_t) split * nb_words,
+					split))
+			nb_inserted++;
+	}
+	free(order);
+
+	struct rnode *root = to_rnode(tree, leaves->nb_leaves, counts, leaves,
+			use_percent);
+	destroy_cons_tree(tree);
+	return root;
+}
@@ -0,0 +1,56 @@
+/* 
+
+Copyright (c) 2009 Thomas Junier and Evgeny Zdobnov, University of Geneva
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+* Neither the name of the University of Geneva nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/* Consensus trees, built from split counts (see bipart.h). */
+
+#include <stdbool.h>
+
+struct rnode;
+struct bipart_counts;
+struct bipart_leaves;
+
+enum consensus_type {
+	CONSENSUS_STRICT,	/**< splits found in all trees */
+	CONSENSUS_MAJORITY,	/**< splits found in more than half the trees */
+	CONSENSUS_EXTENDED	/**< majority, then the most frequent splits
+				  that are compatible with those already in
+				  the tree ("greedy" consensus) */
+};
+
+/* Builds the consensus tree, and returns its root. The tree is unrooted, but
+ * printed with the first leaf (in lexical order) as a child of the root.
+ * Inner nodes are labeled with the number of trees that have their split,
+ * or with its percentage if 'use_percent' is true. There are no branch
+ * lengths. */
+/* Returns NULL in case of malloc() problems. */
+
+struct rnode *consensus_tree(struct bipart_counts *counts,
+		struct bipart_leaves *leaves, enum consensus_type type,
+		bool use_percent);
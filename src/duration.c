@@ -40,6 +40,11 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "tree.h"
 #include "rnode.h"
 #include "masprintf.h"
+#include "pipeline.h"
+
+struct parameters {
+	int nb_workers;
+};
 
 void help(char *argv[])
 {
@@ -49,7 +54,7 @@ void help(char *argv[])
 "Synopsis\n"
 "--------\n"
 "\n"
-"%s [-h] <newick trees filename|->\n"
+"%s [-h] [-j <processes>] <newick trees filename|->\n"
 "\n"
 "Input\n"
 "-----\n"
@@ -72,6 +77,8 @@ void help(char *argv[])
 "-------\n"
 "\n"
 "    -h: print this message and exit\n"
+"    -j <n>: process the trees in n processes (default: 1). The output is\n"
+"        the same, and in the same order.\n"
 "\n"
 "Examples\n"
 "--------\n"
@@ -91,16 +98,20 @@ void help(char *argv[])
 		);
 }
 
-void get_params(int argc, char *argv[])
+struct parameters get_params(int argc, char *argv[])
 {
-
+	struct parameters params;
+	params.nb_workers = 1;
 
 	int opt_char;
-	while ((opt_char = getopt(argc, argv, "h")) != -1) {
+	while ((opt_char = getopt(argc, argv, "hj:")) != -1) {
 		switch (opt_char) {
 		case 'h':
 			help(argv);
 			exit(EXIT_SUCCESS);
+		case 'j':
+			params.nb_workers = parse_nb_workers(optarg);
+			break;
 		default:
 			fprintf (stderr, "Unknown option '-%c'\n", opt_char);
 			exit (EXIT_FAILURE);
@@ -119,9 +130,12 @@ void get_params(int argc, char *argv[])
 			nwsin = fin;
 		}
 	} else {
-		fprintf(stderr, "Usage: %s [-bhIL] <filename|->\n", argv[0]);
+		fprintf(stderr, "Usage: %s [-h] [-j <processes>] <filename|->\n",
+				argv[0]);
 		exit(EXIT_FAILURE);
 	}
+
+	return params;
 }
 
 void process_tree(struct rooted_tree *tree)
@@ -155,18 +169,22 @@ void process_tree(struct rooted_tree *tree)
 	}
 }
 
-int main (int argc, char* argv[])
+static void process_one_tree(struct rooted_tree *tree, void *arg)
 {
-	struct rooted_tree *tree;
+	(void) arg;
+	process_tree(tree);
+	dump_newick(tree->root);
+	recycle_all_rnodes(NULL);
+	destroy_tree(tree);
+}
 
-	get_params(argc, argv);
+int main (int argc, char* argv[])
+{
+	struct parameters params = get_params(argc, argv);
 
-	while ((tree = parse_tree()) != NULL) {
-		process_tree(tree);
-		dump_newick(tree->root);
-		destroy_all_rnodes(NULL);
-		destroy_tree(tree);
-	}
+	if (! run_tree_pipeline(params.nb_workers, process_one_tree, NULL))
+		exit(EXIT_FAILURE);
+	destroy_all_rnodes(NULL);
 
 	return 0;
 }
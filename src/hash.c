@@ -145,15 +145,17 @@ double resize_hash(struct hash *h, unsigned int new_size)
 
 int hash_set(struct hash *h, const char *key, void *value)
 {
-	int hash_code = hash_func(key) % h->size;
 	struct llist *bin;
 	struct key_val_pair *kvp;
 
 	if (HASH_DYNAMIC == h->type) {
 		if (load_factor(h) >= h->load_threshold) {
-			resize_hash(h, h->resize_factor * h->size);
+			if (resize_hash(h, h->resize_factor * h->size) < 0)
+				return FAILURE;
 		}
 	}
+	/* only now: resizing changes the bins */
+	int hash_code = hash_func(key) % h->size;
 
 	bin = (h->bins)[hash_code];
 
@@ -0,0 +1,114 @@
+/* 
+
+Copyright (c) 2009 Thomas Junier and Evgeny Zdobnov, University of Geneva
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+* Neither the name of the University of Geneva nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <regex.h>
+
+#include "label_matcher.h"
+#include "hash.h"
+
+/* Past this many distinct labels, results are no longer stored: the labels
+ * are then probably not shared between trees (e.g. support values). */
+
+static const unsigned int MAX_STORED_RESULTS = 1 << 20;
+
+/* Results are stored as pointers to these (hash_get() returns NULL for
+ * unknown keys) */
+
+static const char MATCH = 1;
+static const char NO_MATCH = 0;
+
+/* Returns the longest literal string that every match must start with, or ""
+ * if there is none we can be sure of. This is deliberately conservative: it
+ * only looks at a leading '^' followed by plain characters, and gives up on
+ * alternations and case-insensitive matching. */
+
+static char *literal_prefix(const char *regexp_string, int cflags)
+{
+	if ('^' != regexp_string[0] || (cflags & REG_ICASE) ||
+			NULL != strchr(regexp_string, '|'))
+		return strdup("");
+
+	const char *special = ".[]\\()*+?{}|^$";
+	const char *start = regexp_string + 1;
+	size_t length = strcspn(start, special);
+	/* a quantifier makes the last character optional */
+	if (length > 0 && '\0' != start[length] &&
+			NULL != strchr("*?{\\", start[length]))
+		length--;
+
+	char *prefix = malloc(length + 1);
+	if (NULL == prefix) return NULL;
+	strncpy(prefix, start, length);
+	prefix[length] = '\0';
+	return prefix;
+}
+
+struct label_matcher *create_label_matcher(regex_t *preg,
+		const char *regexp_string, int cflags)
+{
+	struct label_matcher *matcher = malloc(sizeof(struct label_matcher));
+	if (NULL == matcher) return NULL;
+	matcher->preg = preg;
+	matcher->prefix = literal_prefix(regexp_string, cflags);
+	matcher->results = create_dynamic_hash(1000, 0.75, 2);
+	if (NULL == matcher->prefix || NULL == matcher->results) {
+		free(matcher->prefix);
+		free(matcher);
+		return NULL;
+	}
+	matcher->prefix_length = strlen(matcher->prefix);
+	return matcher;
+}
+
+bool label_matcher_match(struct label_matcher *matcher, const char *label)
+{
+	if (0 != strncmp(matcher->prefix, label, matcher->prefix_length))
+		return false;
+
+	const char *result = hash_get(matcher->results, label);
+	if (NULL != result)
+		return &MATCH == result;
+
+	bool match = 0 == regexec(matcher->preg, label, 0, NULL, 0);
+	/* If the result can't be stored, it will just be computed again */
+	if (matcher->results->count < MAX_STORED_RESULTS)
+		hash_set(matcher->results, label,
+				(void *) (match ? &MATCH : &NO_MATCH));
+	return match;
+}
+
+void destroy_label_matcher(struct label_matcher *matcher)
+{
+	destroy_hash(matcher->results);	/* frees the labels, too */
+	free(matcher->prefix);
+	free(matcher);
+}
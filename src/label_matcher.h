@@ -0,0 +1,61 @@
+/* 
+
+Copyright (c) 2009 Thomas Junier and Evgeny Zdobnov, University of Geneva
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+* Neither the name of the University of Geneva nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+/* Matching node labels against a regular expression, over many trees. Trees
+ * in the same file usually share most of their labels, so the result is
+ * remembered for each distinct label, and regexec() runs only the first time
+ * a label is seen. A pattern anchored on a literal prefix (like '^HRV') also
+ * rejects labels that lack the prefix without calling regexec() at all. */
+
+#include <stdbool.h>
+#include <regex.h>
+
+struct hash;
+
+struct label_matcher {
+	regex_t *preg;
+	char *prefix;	/**< every match starts with this (may be "") */
+	int prefix_length;
+	struct hash *results;	/**< label -> match result */
+};
+
+/* Creates a matcher for 'preg', which must have been compiled from
+ * 'regexp_string' with flags 'cflags'. The regexp must outlive the matcher.
+ * Returns NULL in case of malloc() problems. */
+
+struct label_matcher *create_label_matcher(regex_t *preg,
+		const char *regexp_string, int cflags);
+
+/* True iff 'label' matches the regexp */
+
+bool label_matcher_match(struct label_matcher *matcher, const char *label);
+
+/* Does not free the regexp */
+
+void destroy_label_matcher(struct label_matcher *matcher);
@@ -0,0 +1,464 @@
+/* 
+
+Copyright (c) 2009 Thomas Junier and Evgeny Zdobnov, University of Geneva
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+* Neither the name of the University of Geneva nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <regex.h>
+
+#include "label_rewriter.h"
+#include "list.h"
+#include "masprintf.h"
+#include "common.h"
+
+/* Past this many distinct labels, results are no longer stored (see
+ * label_matcher.c) */
+
+static const unsigned int MAX_STORED_RESULTS = 1 << 20;
+
+static const unsigned int INITIAL_NB_SLOTS = 1024;
+
+struct rewritten_label {
+	uint64_t hash;	/**< compared before the label itself */
+	char *label;	/**< NULL if the slot is free */
+	char *result;	/**< NULL if the label is unchanged */
+};
+
+/* '&' and '\1' to '\9' */
+
+#define MAX_GROUPS 10
+
+struct substitution {
+	regex_t preg;
+	char *replacement;	/**< delimiters already unescaped */
+	bool global;
+};
+
+/* A growing string. Once an append() has failed, the following ones do
+ * nothing, so the caller only needs to check 'failed' at the end. */
+
+struct buffer {
+	char *text;
+	size_t length;
+	size_t capacity;
+	bool failed;
+};
+
+static void append(struct buffer *buf, const char *s, size_t n)
+{
+	if (buf->failed) return;
+	if (buf->length + n + 1 > buf->capacity) {
+		size_t capacity = 2 * (buf->length + n + 1);
+		char *text = realloc(buf->text, capacity);
+		if (NULL == text) { buf->failed = true; return; }
+		buf->text = text;
+		buf->capacity = capacity;
+	}
+	memcpy(buf->text + buf->length, s, n);
+	buf->length += n;
+	buf->text[buf->length] = '\0';
+}
+
+/* Returns the first occurrence of 'delimiter' in 's' that is not escaped by a
+ * backslash, or NULL if there is none. */
+
+static const char *find_delimiter(const char *s, char delimiter)
+{
+	for (; '\0' != *s; s++) {
+		if ('\\' == *s && '\0' != s[1])
+			s++;
+		else if (delimiter == *s)
+			return s;
+	}
+	return NULL;
+}
+
+/* Returns a copy of the first 'length' characters of 's', in which '\' +
+ * 'delimiter' becomes just 'delimiter'. Other escapes are left alone, as
+ * they mean something to regcomp() or in the replacement. */
+
+static char *unescape_delimiter(const char *s, size_t length, char delimiter)
+{
+	char *copy = malloc(length + 1);
+	if (NULL == copy) return NULL;
+	char *q = copy;
+	size_t i;
+	for (i = 0; i < length; i++) {
+		if ('\\' == s[i] && i + 1 < length) {
+			if (delimiter != s[i+1]) *q++ = s[i];
+			i++;
+		}
+		*q++ = s[i];
+	}
+	*q = '\0';
+	return copy;
+}
+
+/* Checks that the replacement refers to no more subexpressions than the
+ * regexp has. Returns the first wrong reference (as a digit), or '\0'. */
+
+static char bad_reference(const char *replacement, size_t nb_subexpressions)
+{
+	const char *p;
+	for (p = replacement; '\0' != *p; p++) {
+		if ('\\' != *p || '\0' == p[1]) continue;
+		p++;
+		if (isdigit((unsigned char) *p) &&
+				(size_t) (*p - '0') > nb_subexpressions)
+			return *p;
+	}
+	return '\0';
+}
+
+/* The finalizer of the SplitMix64 generator, as in topology_hash.c */
+
+static uint64_t mix64(uint64_t x)
+{
+	x ^= x >> 30;
+	x *= 0xbf58476d1ce4e5b9ULL;
+	x ^= x >> 27;
+	x *= 0x94d049bb133111ebULL;
+	x ^= x >> 31;
+	return x;
+}
+
+/* FNV-1a, followed by a mix (the slot is taken from the low bits) */
+
+static uint64_t label_hash(const char *label)
+{
+	uint64_t h = 0xcbf29ce484222325ULL;
+	for (; '\0' != *label; label++) {
+		h ^= (unsigned char) *label;
+		h *= 0x100000001b3ULL;
+	}
+	return mix64(h);
+}
+
+/* Returns the slot that holds 'label', or else the free slot where it would
+ * go (linear probing). */
+
+static unsigned int find_slot(struct label_rewriter *rewriter, uint64_t hash,
+		const char *label)
+{
+	unsigned int mask = rewriter->nb_slots - 1;
+	unsigned int slot = (unsigned int) hash & mask;
+	struct rewritten_label *entry;
+	for (;; slot = (slot + 1) & mask) {
+		entry = rewriter->results + slot;
+		if (NULL == entry->label) return slot;
+		if (hash == entry->hash && 0 == strcmp(label, entry->label))
+			return slot;
+	}
+}
+
+/* Doubles the number of slots (which keeps the load at most 1/2) */
+
+static int grow_results(struct label_rewriter *rewriter)
+{
+	struct rewritten_label *old = rewriter->results;
+	unsigned int old_nb_slots = rewriter->nb_slots;
+	rewriter->results = calloc(2 * old_nb_slots,
+			sizeof(struct rewritten_label));
+	if (NULL == rewriter->results) {
+		rewriter->results = old;
+		return FAILURE;
+	}
+	rewriter->nb_slots = 2 * old_nb_slots;
+	unsigned int i;
+	for (i = 0; i < old_nb_slots; i++) {
+		if (NULL == old[i].label) continue;
+		rewriter->results[find_slot(rewriter, old[i].hash,
+				old[i].label)] = old[i];
+	}
+	free(old);
+	return SUCCESS;
+}
+
+/* Stores 'result' (NULL if unchanged) for 'label', whose free slot is
+ * 'slot'. Returns FAILURE if it can't (which is not an error: the result
+ * will just be computed again). */
+
+static int store_result(struct label_rewriter *rewriter, unsigned int slot,
+		uint64_t hash, const char *label, char *result)
+{
+	if (rewriter->nb_results >= MAX_STORED_RESULTS) return FAILURE;
+	if (2 * (rewriter->nb_results + 1) > rewriter->nb_slots) {
+		if (! grow_results(rewriter)) return FAILURE;
+		slot = find_slot(rewriter, hash, label);
+	}
+	char *copy = strdup(label);
+	if (NULL == copy) return FAILURE;
+	struct rewritten_label *entry = rewriter->results + slot;
+	entry->hash = hash;
+	entry->label = copy;
+	entry->result = result;
+	rewriter->nb_results++;
+	return SUCCESS;
+}
+
+struct label_rewriter *create_label_rewriter()
+{
+	struct label_rewriter *rewriter = malloc(sizeof(struct label_rewriter));
+	if (NULL == rewriter) return NULL;
+	rewriter->substitutions = create_llist();
+	rewriter->results = calloc(INITIAL_NB_SLOTS,
+			sizeof(struct rewritten_label));
+	rewriter->nb_slots = INITIAL_NB_SLOTS;
+	rewriter->nb_results = 0;
+	rewriter->unstored = NULL;
+	if (NULL == rewriter->substitutions || NULL == rewriter->results) {
+		if (NULL != rewriter->substitutions)
+			destroy_llist(rewriter->substitutions);
+		free(rewriter->results);
+		free(rewriter);
+		return NULL;
+	}
+	return rewriter;
+}
+
+/* Frees a compiled substitution */
+
+static void destroy_substitution(struct substitution *sub)
+{
+	regfree(&(sub->preg));
+	free(sub->replacement);
+	free(sub);
+}
+
+int add_substitution(struct label_rewriter *rewriter, const char *expression,
+		char **error)
+{
+	*error = NULL;
+	char delimiter = expression[0] == 's' ? expression[1] : '\0';
+	if ('\0' == delimiter || '\\' == delimiter || '\n' == delimiter) {
+		*error = masprintf("substitution '%s' should look like "
+				"'s/regexp/replacement/'", expression);
+		return FAILURE;
+	}
+	const char *regexp_start = expression + 2;
+	const char *regexp_end = find_delimiter(regexp_start, delimiter);
+	const char *replacement_end = NULL;
+	if (NULL != regexp_end)
+		replacement_end = find_delimiter(regexp_end + 1, delimiter);
+	if (NULL == replacement_end) {
+		*error = masprintf("unterminated substitution '%s'",
+				expression);
+		return FAILURE;
+	}
+
+	int cflags = REG_EXTENDED;
+	bool global = false;
+	const char *flag;
+	for (flag = replacement_end + 1; '\0' != *flag; flag++) {
+		switch (*flag) {
+		case 'g':
+			global = true;
+			break;
+		case 'i':
+			cflags |= REG_ICASE;
+			break;
+		default:
+			*error = masprintf("unknown flag '%c' in substitution "
+					"'%s'", *flag, expression);
+			return FAILURE;
+		}
+	}
+
+	struct substitution *sub = malloc(sizeof(struct substitution));
+	char *regexp = unescape_delimiter(regexp_start,
+			regexp_end - regexp_start, delimiter);
+	if (NULL == sub || NULL == regexp) {
+		free(sub);
+		free(regexp);
+		return FAILURE;
+	}
+	sub->replacement = unescape_delimiter(regexp_end + 1,
+			replacement_end - (regexp_end + 1), delimiter);
+	if (NULL == sub->replacement) {
+		free(sub);
+		free(regexp);
+		return FAILURE;
+	}
+	sub->global = global;
+
+	int errcode = regcomp(&(sub->preg), regexp, cflags);
+	free(regexp);
+	if (errcode) {
+		/* no message (*error stays NULL) if there is no memory */
+		size_t errbufsize = regerror(errcode, &(sub->preg), NULL, 0);
+		char *errbuf = malloc(errbufsize);
+		if (NULL != errbuf) {
+			regerror(errcode, &(sub->preg), errbuf, errbufsize);
+			*error = masprintf("%s in substitution '%s'", errbuf,
+					expression);
+			free(errbuf);
+		}
+		free(sub->replacement);
+		free(sub);
+		return FAILURE;
+	}
+	char reference = bad_reference(sub->replacement, sub->preg.re_nsub);
+	if ('\0' != reference) {
+		*error = masprintf("reference to \\%c, but only %d "
+			"subexpression(s) in substitution '%s'", reference,
+			(int) sub->preg.re_nsub, expression);
+		destroy_substitution(sub);
+		return FAILURE;
+	}
+
+	if (! append_element(rewriter->substitutions, sub)) {
+		destroy_substitution(sub);
+		return FAILURE;
+	}
+	return SUCCESS;
+}
+
+/* Appends the replacement for 'match' (whose offsets are relative to
+ * 'subject') */
+
+static void append_replacement(struct buffer *buf, const char *replacement,
+		const char *subject, regmatch_t *match)
+{
+	const char *p;
+	for (p = replacement; '\0' != *p; p++) {
+		int group = -1;
+		if ('&' == *p)
+			group = 0;
+		else if ('\\' == *p && isdigit((unsigned char) p[1]))
+			group = *(++p) - '0';
+		else if ('\\' == *p && '\0' != p[1])
+			p++;	/* e.g. '\&' or '\\' */
+
+		if (group < 0)
+			append(buf, p, 1);
+		else if (match[group].rm_so >= 0)
+			append(buf, subject + match[group].rm_so,
+				match[group].rm_eo - match[group].rm_so);
+	}
+}
+
+/* Returns a new string with the substitution applied to 'text', or 'text'
+ * itself if the regexp does not match, or NULL in case of malloc() problems.
+ * As in sed, a global substitution does not match the empty string just
+ * after a previous match: replacing all matches of 'b*' by '-' turns 'abc'
+ * into '-a-c-'. */
+
+static char *apply_substitution(struct substitution *sub, const char *text)
+{
+	regmatch_t match[MAX_GROUPS];
+	struct buffer result = { NULL, 0, 0, false };
+	const char *start = text;
+	int eflags = 0;
+	bool matched = false;
+	bool after_match = false;
+
+	while (0 == regexec(&(sub->preg), start, MAX_GROUPS, match, eflags)) {
+		size_t match_start = match[0].rm_so;
+		size_t match_end = match[0].rm_eo;
+		if (after_match && 0 == match_end) {
+			/* empty match just after the previous one */
+			if ('\0' == *start) break;
+			append(&result, start, 1);
+			start++;
+			after_match = false;
+			continue;
+		}
+		matched = true;
+		append(&result, start, match_start);
+		append_replacement(&result, sub->replacement, start, match);
+		start += match_end;
+		if (! sub->global) break;
+		after_match = match_start != match_end;
+		if (! after_match) {
+			/* empty match: move on by one character */
+			if ('\0' == *start) break;
+			append(&result, start, 1);
+			start++;
+		}
+		eflags = REG_NOTBOL;
+	}
+
+	if (! matched) return (char *) text;
+	append(&result, start, strlen(start));
+	if (result.failed) {
+		free(result.text);
+		return NULL;
+	}
+	return result.text;
+}
+
+const char *label_rewriter_rewrite(struct label_rewriter *rewriter,
+		const char *label)
+{
+	/* Nothing to do, and nothing to remember */
+	if (0 == rewriter->substitutions->count) return label;
+
+	uint64_t hash = label_hash(label);
+	unsigned int slot = find_slot(rewriter, hash, label);
+	struct rewritten_label *stored = rewriter->results + slot;
+	if (NULL != stored->label)
+		return NULL == stored->result ? label : stored->result;
+
+	char *current = (char *) label;
+	struct list_elem *el;
+	for (el = rewriter->substitutions->head; NULL != el; el = el->next) {
+		char *next = apply_substitution(el->data, current);
+		if (current != next && current != label) free(current);
+		if (NULL == next) return NULL;
+		current = next;
+	}
+
+	free(rewriter->unstored);
+	rewriter->unstored = NULL;
+	if (store_result(rewriter, slot, hash, label,
+				current == label ? NULL : current))
+		return current;
+	if (current != label) rewriter->unstored = current;
+	return current;
+}
+
+void destroy_label_rewriter(struct label_rewriter *rewriter)
+{
+	unsigned int i;
+	for (i = 0; i < rewriter->nb_slots; i++) {
+		free(rewriter->results[i].label);
+		free(rewriter->results[i].result);
+	}
+	free(rewriter->results);
+
+	struct list_elem *el;
+
+	for (el = rewriter->substitutions->head; NULL != el; el = el->next)
+		destroy_substitution(el->data);
+	destroy_llist(rewriter->substitutions);
+	free(rewriter->unstored);
+	free(rewriter);
+}
@@ -0,0 +1,78 @@
+/* 
+
+Copyright (c) 2009 Thomas Junier and Evgeny Zdobnov, University of Geneva
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+* Neither the name of the University of Geneva nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+/* Rewriting node labels with a list of sed-like substitutions, over many
+ * trees. As with struct label_matcher, trees in the same file usually share
+ * most of their labels, so the result is remembered for each distinct label,
+ * and the substitutions run only the first time a label is seen. */
+
+#include <stdbool.h>
+
+struct llist;
+struct rewritten_label;
+
+struct label_rewriter {
+	struct llist *substitutions;	/**< applied in order */
+	/** Stored results, by label. This is an open-addressing table
+	 * rather than a struct hash, because it is searched for every
+	 * label: a lookup usually touches just one slot (and the label). */
+	struct rewritten_label *results;
+	unsigned int nb_slots;	/**< a power of 2 */
+	unsigned int nb_results;
+	char *unstored;	/**< last result that could not be stored */
+};
+
+/* Creates a rewriter without substitutions (which leaves all labels
+ * unchanged). Returns NULL in case of malloc() problems. */
+
+struct label_rewriter *create_label_rewriter();
+
+/* Adds a substitution, given as in sed: 's/regexp/replacement/flags'. The
+ * delimiter can be any character (it is the one after the 's'), and can occur
+ * in the regexp or the replacement if preceded by a backslash. The regexp is
+ * a POSIX extended regexp. In the replacement, '&' stands for the matched
+ * text, and '\1' to '\9' for the corresponding parenthesized subexpressions.
+ * Flags are 'g' (replace all matches, not just the first) and 'i' (ignore
+ * case). Substitutions must be added before any label is rewritten. */
+/* Returns SUCCESS or FAILURE. In case of FAILURE, '*error' is set to a
+ * message describing the problem (free() it after use), or to NULL if the
+ * problem was with malloc(). */
+
+int add_substitution(struct label_rewriter *rewriter, const char *expression,
+		char **error);
+
+/* Returns the result of applying all substitutions to 'label', in order (each
+ * one to the result of the previous). If this leaves the label unchanged,
+ * returns 'label' itself. The result belongs to the rewriter, and is valid
+ * until the next call. Returns NULL in case of malloc() problems. */
+
+const char *label_rewriter_rewrite(struct label_rewriter *rewriter,
+		const char *label);
+
+void destroy_label_rewriter(struct label_rewriter *rewriter);
@@ -0,0 +1,177 @@
+/* 
+
+Copyright (c) 2009 Thomas Junier and Evgeny Zdobnov, University of Geneva
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+* Neither the name of the University of Geneva nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "label_set.h"
+#include "tree.h"
+#include "tree_stats.h"
+#include "rnode.h"
+#include "list.h"
+#include "hash.h"
+#include "lca.h"
+#include "nodemap.h"
+#include "readline.h"
+
+static void destroy_label_set(struct label_set *set)
+{
+	int i;
+	for (i = 0; i < set->nb_labels; i++)
+		free(set->labels[i]);
+	free(set->labels);
+	free(set);
+}
+
+/* Frees the list and the labels it holds */
+
+static void destroy_label_list(struct llist *labels)
+{
+	struct list_elem *el;
+	for (el = labels->head; NULL != el; el = el->next)
+		free(el->data);
+	destroy_llist(labels);
+}
+
+/* Returns NULL in case of malloc() problems */
+
+static struct llist *split_line(char *line)
+{
+	struct llist *labels = create_llist();
+	if (NULL == labels) return NULL;
+	struct word_tokenizer *wtok = create_word_tokenizer(line);
+	if (NULL == wtok) { destroy_llist(labels); return NULL; }
+
+	char *label;
+	while (NULL != (label = wt_next(wtok))) {
+		if ('\0' == label[0]) {	/* trailing whitespace */
+			free(label);
+			continue;
+		}
+		if (! append_element(labels, label)) {
+			free(label);
+			break;
+		}
+	}
+	destroy_word_tokenizer(wtok);
+	if (NULL == label && NEXT_TOKEN_END == next_token_status)
+		return labels;
+	destroy_label_list(labels);
+	return NULL;
+}
+
+static struct label_set *create_label_set(char *line)
+{
+	struct llist *labels = split_line(line);
+	if (NULL == labels) return NULL;
+	struct label_set *set = malloc(sizeof(struct label_set));
+	if (NULL == set) { destroy_label_list(labels); return NULL; }
+	set->nb_labels = labels->count;
+	set->labels = (char **) llist_to_array(labels);
+	if (NULL == set->labels) {
+		destroy_label_list(labels);
+		free(set);
+		return NULL;
+	}
+	destroy_llist(labels);
+	return set;
+}
+
+struct llist *read_label_sets(const char *filename)
+{
+	FILE *file = fopen(filename, "r");
+	if (NULL == file) return NULL;
+	struct llist *sets = create_llist();
+	if (NULL == sets) { fclose(file); return NULL; }
+
+	char *line;
+	while (NULL != (line = read_line(file))) {
+		if ('#' == line[0] || is_all_whitespace(line)) {
+			free(line);
+			continue;
+		}
+		struct label_set *set = create_label_set(line);
+		free(line);
+		if (NULL == set) break;
+		if (! append_element(sets, set)) {
+			destroy_label_set(set);
+			break;
+		}
+	}
+	fclose(file);
+	if (NULL == line && READLINE_EOF == read_line_status)
+		return sets;
+	destroy_label_sets(sets);
+	return NULL;
+}
+
+void destroy_label_sets(struct llist *sets)
+{
+	struct list_elem *el;
+	for (el = sets->head; NULL != el; el = el->next)
+		destroy_label_set(el->data);
+	destroy_llist(sets);
+}
+
+struct label_set_index *create_label_set_index(struct rooted_tree *tree)
+{
+	struct tree_stats *stats = get_tree_stats(tree);
+	if (NULL == stats) return NULL;
+	struct label_set_index *index = malloc(sizeof(struct label_set_index));
+	if (NULL == index) return NULL;
+	index->stats = stats;
+	index->lca = create_lca_index(tree);
+	index->label2node = create_label2node_map(tree->nodes_in_order);
+	int n = stats->nb_nodes;
+	index->nb_lengths = malloc(n * sizeof(int));
+	if (NULL == index->lca || NULL == index->label2node ||
+			NULL == index->nb_lengths) {
+		destroy_label_set_index(index);
+		return NULL;
+	}
+
+	/* The stats' nodes are in post-order: the root comes last */
+	int i;
+	index->nb_lengths[n - 1] = 0;
+	for (i = n - 2; i >= 0; i--) {
+		struct rnode *node = stats->nodes[i];
+		index->nb_lengths[i] = index->nb_lengths[node->parent->index] +
+			('\0' != node->edge_length_as_string[0]);
+	}
+
+	return index;
+}
+
+void destroy_label_set_index(struct label_set_index *index)
+{
+	destroy_lca_index(index->lca);
+	if (NULL != index->label2node) destroy_hash(index->label2node);
+	free(index->nb_lengths);
+	free(index);
+}
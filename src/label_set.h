@@ -0,0 +1,69 @@
+/* 
+
+Copyright (c) 2009 Thomas Junier and Evgeny Zdobnov, University of Geneva
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+* Neither the name of the University of Geneva nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+/* Sets of labels, one per line of a file (nw_prune -s, nw_clade -f), and what
+ * needs to be known about a tree to answer questions about many such sets.
+ * The tree is indexed once, whatever the number of sets. */
+
+struct rooted_tree;
+struct llist;
+
+struct label_set {
+	int nb_labels;
+	char **labels;
+};
+
+/* Reads one set per line of file 'filename', the labels being separated by
+ * whitespace. Empty lines and lines starting with '#' are skipped. Returns a
+ * list of struct label_set, or NULL if the file cannot be read or in case of
+ * malloc() problems (errno tells which). */
+
+struct llist *read_label_sets(const char *filename);
+
+/* Frees the sets and their labels, and the list itself */
+
+void destroy_label_sets(struct llist *sets);
+
+/* The index. It relies on the tree's stats (node->index), and must not be
+ * used after the tree has changed. */
+
+struct label_set_index {
+	struct tree_stats *stats;
+	struct lca_index *lca;
+	struct hash *label2node;
+	/** number of edges with a length between the root and each node, by
+	 * node->index */
+	int *nb_lengths;
+};
+
+/* Returns NULL in case of malloc() problems. */
+
+struct label_set_index *create_label_set_index(struct rooted_tree *tree);
+
+void destroy_label_set_index(struct label_set_index *index);
@@ -195,8 +195,9 @@ int main (int argc, char* argv[])
 	while ((tree = parse_tree()) != NULL) {
 		process_tree(tree, params);
 		destroy_tree(tree);
-		destroy_all_rnodes(NULL);
+		recycle_all_rnodes(NULL);
 	}
+	destroy_all_rnodes(NULL);
 
 	return 0;
 }
@@ -37,6 +37,8 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "hash.h"
 #include "nodemap.h"
 #include "error.h"
+#include "tree_stats.h"
+#include "lca.h"
 
 struct rooted_tree *lca2w_tree;
 
@@ -123,17 +125,39 @@ static struct rnode *lca (struct rooted_tree *tree,
 	return result;
 }
 
+/* One bottom-up pass, instead of k - 1 calls to lca2(): in post-order, each
+ * node gets the number of listed nodes in its subtree (itself included), and
+ * the first node to get them all is the LCA. */
+
 struct rnode *lca_from_nodes (struct rooted_tree *tree,
 		struct llist *descendants)
 {
-	struct rnode *result;
-	struct llist *copy = shallow_copy(descendants);
-	if (NULL == copy) return NULL;
+	struct tree_stats *stats = get_tree_stats(tree);
+	if (NULL == stats) return NULL;
+	int *counts = calloc(stats->nb_nodes, sizeof(int));
+	if (NULL == counts) return NULL;
+	struct list_elem *el;
+	int i, nb_marked = 0;
 
-	result = lca(tree, copy);
-	if (NULL == result) return NULL;
+	for (el = descendants->head; NULL != el; el = el->next) {
+		i = tree_stats_index(stats, (struct rnode *) el->data);
+		if (-1 == i || 0 != counts[i]) continue;
+		counts[i] = 1;
+		nb_marked++;
+	}
+
+	struct rnode *result = NULL;
+	for (i = 0; i < stats->nb_nodes && 0 != nb_marked; i++) {
+		struct rnode *node = stats->nodes[i];
+		if (counts[i] == nb_marked) {
+			result = node;
+			break;
+		}
+		if (! is_root(node))
+			counts[node->parent->index] += counts[i];
+	}
 
-	destroy_llist(copy);
+	free(counts);
 	return result;
 }
 
@@ -219,3 +243,128 @@ struct rnode *lca_from_labels_multi (struct rooted_tree *tree,
 	return result;
 }
 
+
+#define LCA_BLOCK 32
+
+struct lca_index *create_lca_index(struct rooted_tree *tree)
+{
+	struct tree_stats *stats = get_tree_stats(tree);
+	if (NULL == stats) return NULL;
+	int n = stats->nb_nodes;
+
+	struct lca_index *index = malloc(sizeof(struct lca_index));
+	if (NULL == index) return NULL;
+	index->nb_nodes = n;
+	index->nodes = malloc(n * sizeof(struct rnode *));
+	index->depth = malloc(n * sizeof(int));
+	index->rank = malloc(n * sizeof(int));
+	index->nb_blocks = (n + LCA_BLOCK - 1) / LCA_BLOCK;
+	index->nb_levels = 1;
+	while ((1 << index->nb_levels) <= index->nb_blocks)
+		index->nb_levels++;
+	index->block_min = malloc(index->nb_levels * index->nb_blocks *
+			sizeof(int));
+	if (NULL == index->nodes || NULL == index->depth ||
+	    NULL == index->rank || NULL == index->block_min) {
+		destroy_lca_index(index);
+		return NULL;
+	}
+
+	/* Pre-order ranks, top-down: a node's first child comes right after
+	 * it, and each next child after the previous child's subtree. */
+	int i;
+	index->rank[n - 1] = 0;	/* root */
+	for (i = n - 1; i >= 0; i--) {
+		struct rnode *node = stats->nodes[i];
+		int r = index->rank[i];
+		index->nodes[r] = node;
+		index->depth[r] = stats->nb_ancestors[i];
+		if (is_leaf(node)) continue;
+		struct rnode *kid;
+		r++;
+		for (kid = node->first_child; ; kid = kid->next_sibling) {
+			index->rank[kid->index] = r;
+			r += stats->nb_descendants[kid->index] + 1;
+			if (kid == node->last_child) break;
+		}
+	}
+
+	int b, level;
+	int *depth = index->depth;
+	for (b = 0; b < index->nb_blocks; b++) {
+		int best = b * LCA_BLOCK;
+		int end = best + LCA_BLOCK < n ? best + LCA_BLOCK : n;
+		for (i = best + 1; i < end; i++)
+			if (depth[i] < depth[best]) best = i;
+		index->block_min[b] = best;
+	}
+	for (level = 1; level < index->nb_levels; level++) {
+		int *prev = index->block_min + (level - 1) * index->nb_blocks;
+		int *cur = index->block_min + level * index->nb_blocks;
+		int half = 1 << (level - 1);
+		for (b = 0; b + (1 << level) <= index->nb_blocks; b++) {
+			int left = prev[b], right = prev[b + half];
+			cur[b] = depth[right] < depth[left] ? right : left;
+		}
+	}
+
+	return index;
+}
+
+int lca_index_rank(struct lca_index *index, struct rnode *node)
+{
+	return index->rank[node->index];
+}
+
+/* Returns the rank of the shallowest node between ranks 'from' and 'to'
+ * (inclusive) */
+
+static int shallowest(struct lca_index *index, int from, int to)
+{
+	int *depth = index->depth;
+	int best = from;
+	int first_block = from / LCA_BLOCK;
+	int last_block = to / LCA_BLOCK;
+	int i;
+
+	if (first_block == last_block) {
+		for (i = from + 1; i <= to; i++)
+			if (depth[i] < depth[best]) best = i;
+		return best;
+	}
+	for (i = from + 1; i < (first_block + 1) * LCA_BLOCK; i++)
+		if (depth[i] < depth[best]) best = i;
+	for (i = last_block * LCA_BLOCK; i <= to; i++)
+		if (depth[i] < depth[best]) best = i;
+	if (first_block + 1 < last_block) {
+		int lo = first_block + 1, hi = last_block - 1;
+		int level = 0;
+		while ((2 << level) <= hi - lo + 1) level++;
+		int *mins = index->block_min + level * index->nb_blocks;
+		int left = mins[lo], right = mins[hi - (1 << level) + 1];
+		if (depth[left] < depth[best]) best = left;
+		if (depth[right] < depth[best]) best = right;
+	}
+	return best;
+}
+
+struct rnode *lca_index_query(struct lca_index *index, struct rnode *node1,
+		struct rnode *node2)
+{
+	if (node1 == node2) return node1;
+	int r1 = index->rank[node1->index];
+	int r2 = index->rank[node2->index];
+	if (r1 > r2) { int tmp = r1; r1 = r2; r2 = tmp; }
+
+	return index->nodes[shallowest(index, r1 + 1, r2)]->parent;
+}
+
+void destroy_lca_index(struct lca_index *index)
+{
+	if (NULL == index) return;
+	free(index->nodes);
+	free(index->depth);
+	free(index->rank);
+	free(index->block_min);
+	free(index);
+}
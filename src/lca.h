@@ -40,7 +40,9 @@ struct llist;
 struct rnode *lca2(struct rooted_tree *, struct rnode *,
 		struct rnode *);
 
-/* Given a tree and a list of nodes, returns the LCA */
+/* Given a tree and a list of nodes, returns the LCA. This is a single
+ * post-order pass, however many nodes are given. Nodes not in the tree are
+ * ignored; returns NULL if there are none, or on malloc() error. */
 
 struct rnode *lca_from_nodes(struct rooted_tree *tree, struct llist *labels);
 
@@ -56,3 +58,36 @@ struct rnode *lca_from_labels(struct rooted_tree *tree, struct llist *labels);
 labels unique in tree)  */
 
 struct rnode *lca_from_labels_multi(struct rooted_tree *tree, struct llist *labels);
+
+/* An index for LCA queries on a tree that does not change: nodes are numbered
+ * in pre-order, and the LCA of two nodes is the parent of the shallowest node
+ * between them in that order (the second excluded, the first not). The
+ * shallowest node in a range is found with a table of minima over blocks of
+ * 32 nodes, plus a scan at either end, so the index takes linear space and a
+ * query takes constant time. The index relies on the tree's stats
+ * (node->index), and must not be used after the tree has changed. */
+
+struct lca_index {
+	int nb_nodes;
+	struct rnode **nodes;	/**< in pre-order */
+	int *depth;		/**< number of ancestors, by pre-order rank */
+	int *rank;		/**< pre-order rank, by node->index */
+	int nb_blocks;
+	int nb_levels;
+	/** rank of the shallowest node in blocks [b, b + 2^level), at
+	 * [level * nb_blocks + b] */
+	int *block_min;
+};
+
+/* Returns NULL in case of malloc() problems. */
+
+struct lca_index *create_lca_index(struct rooted_tree *tree);
+
+/* The node's rank in pre-order (the root's is 0) */
+
+int lca_index_rank(struct lca_index *index, struct rnode *node);
+
+struct rnode *lca_index_query(struct lca_index *index, struct rnode *node1,
+		struct rnode *node2);
+
+void destroy_lca_index(struct lca_index *index);
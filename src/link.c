@@ -48,8 +48,21 @@ struct rnode *get_unlink_rnode_root_child()
 	return unlink_rnode_root_child;
 }
 
+/* Incremented by every function that changes the structure of a tree (or edge
+ * lengths). Cached tree properties compare it to the value they were computed
+ * with (see tree_stats.h). */
+
+static unsigned long link_change_count = 0;
+
+unsigned long get_link_change_count()
+{
+	return link_change_count;
+}
+
 void add_child(struct rnode *parent, struct rnode *child)
 {
+	link_change_count++;
+
 	child->parent = parent;
 
 	if (0 == parent->child_count)
@@ -107,6 +120,8 @@ int insert_node_above(struct rnode *this, char *label)
 	
 void replace_child (struct rnode *old, struct rnode *new)
 {
+	link_change_count++;
+
 	/* To replace the old rnode by the new one, we need a pointer to the
 	 * node _before_ the old node (so as to be able to change its
 	 * next_sibling member). We therefore start "ahead" of the list, using
@@ -162,6 +177,8 @@ int splice_out_rnode(struct rnode *this)
 	struct rnode *parent = this->parent;
 	struct rnode *current_child, *current_sibling;
 
+	link_change_count++;
+
 	/* change the children's parent edges: they must now point to their
 	 * 'grandparent', and the length from their parent to their grandparent
 	 * must be added. */
@@ -207,6 +224,8 @@ int splice_out_rnode(struct rnode *this)
 
 int remove_child(struct rnode *child)
 {
+	link_change_count++;
+
 	if (is_root(child)) return RM_CHILD_HAS_NO_PARENT;
 
 	struct rnode *parent = child->parent;
@@ -258,6 +277,8 @@ int remove_child(struct rnode *child)
 
 int insert_child(struct rnode *parent, struct rnode *insert, int index)
 {
+	link_change_count++;
+
 	struct rnode dummy_head, *current;
 	int n;
 
@@ -296,6 +317,8 @@ static int _swap_nodes(struct rnode *node, bool i_node_lbl_as_support)
 	assert(NULL != node->parent);
 	assert(is_root(node->parent));  /* must swap below root */
 
+	link_change_count++;
+
 	struct rnode *parent = node->parent;
 	char *length = strdup(node->edge_length_as_string);
 	if(remove_child(node) < 0) return FAILURE;
@@ -378,8 +401,23 @@ struct llist *siblings(struct rnode *node)
 	return result;
 }
 
+void set_children_order(struct rnode *node, struct rnode *first)
+{
+	link_change_count++;
+
+	node->first_child = first;
+	struct rnode *last = first;
+	int i;
+	for (i = 1; i < node->child_count; i++)
+		last = last->next_sibling;
+	last->next_sibling = NULL;
+	node->last_child = last;
+}
+
 void remove_children(struct rnode *node)
 {
+	link_change_count++;
+
 	struct rnode *child = node->first_child;
 	for (; NULL != child; child = child->next_sibling) {
 		child->linked = false;
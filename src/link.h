@@ -134,6 +134,18 @@ struct llist *siblings(struct rnode *);
 
 void remove_children(struct rnode *);
 
+/* Puts a node's children in a new order: 'first' is the new first child, and
+ * the others follow through next_sibling. The list must hold exactly the
+ * node's children. */
+
+void set_children_order(struct rnode *node, struct rnode *first);
+
+/* Returns the number of calls to the above functions that change a tree's
+ * structure or edge lengths, so far. Cached tree properties use this to detect
+ * that they are out of date. */
+
+unsigned long get_link_change_count();
+
 /* takes 2 lengths (as strings), and return their sum (as a string) */
 
 char *add_len_strings(char *ls1, char *ls2);
@@ -36,19 +36,16 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <ctype.h>
 #include <assert.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "parser.h"
 #include "to_newick.h"
 #include "tree.h"
-#include "order_tree.h"
-#include "hash.h"
 #include "list.h"
 #include "rnode.h"
-#include "link.h"
-#include "nodemap.h"
 #include "common.h"
-#include "rnode_iterator.h"
-#include "masprintf.h"
+#include "topology_hash.h"
+#include "hash.h"
 
 #ifdef DEBUG_MATCH
 #define DEBUG 1
@@ -62,8 +59,34 @@ void newick_scanner_set_file_input(FILE *);
 
 struct parameters {
 	char *pattern;
+	FILE *pattern_trees;	/* NULL unless -f */
 	FILE *target_trees;
 	bool reverse;
+	bool counts;
+};
+
+/* Patterns that have the same leaf set are matched together: a target tree's
+ * restricted hash is computed once per group, and looked up among the
+ * patterns' hashes. */
+
+struct pattern_ref {
+	uint64_t hash;
+	int id;		/* pattern number, from 0 */
+};
+
+struct pattern_group {
+	struct topo_leaf_set *leaves;
+	/* Union of the patterns' clades, for early rejection (its 'hash'
+	 * member is not used). */
+	struct topo_pattern clades;
+	struct pattern_ref *refs;	/* sorted by hash */
+	int nb_refs;
+};
+
+struct pattern_index {
+	struct llist *groups;
+	int nb_patterns;
+	char **newicks;		/* patterns, as read (for -c) */
 };
 
 void help(char* argv[])
@@ -73,7 +96,8 @@ void help(char* argv[])
 "\n"
 "Synopsis\n"
 "--------\n"
-"%s [-v] <target tree filename|-> <pattern tree>\n"
+"%s [-cv] <target tree filename|-> <pattern tree>\n"
+"%s [-cv] -f <pattern trees filename> <target tree filename|->\n"
 "\n"
 "Input\n"
 "-----\n"
@@ -82,23 +106,36 @@ void help(char* argv[])
 "which support values are to be attributed), or '-' (in which case the tree\n"
 "is read on stdin).\n"
 "\n"
-"The second argument is a pattern tree\n"
+"The second argument is a pattern tree. With option -f, the pattern trees are\n"
+"read from a file instead, and there is no second argument.\n"
 "\n"
 "Output\n"
 "------\n"
 "\n"
 "Outputs the target tree if the pattern tree is a subgraph of it.\n"
 "\n"
+"With several patterns (-f), outputs one line per target tree, with the\n"
+"numbers of the patterns it matches (the first pattern in the file is 1),\n"
+"separated by spaces. The line is empty if the tree matches no pattern.\n"
+"\n"
+"The target trees are read only once, however many patterns there are.\n"
+"\n"
 "Options\n"
 "-------\n"
 "\n"
-"    -v: prints tree which do NOT match the pattern.\n"
+"    -c: prints, for each pattern, the number of target trees that match it,\n"
+"        followed by a TAB and the pattern itself.\n"
+"    -f <file>: reads the pattern trees from <file>.\n"
+"    -v: prints tree which do NOT match the pattern (with -f: numbers of\n"
+"        patterns that the tree does NOT match; with -c: counts of trees\n"
+"        that do not match).\n"
 "\n"
 "Limits & Assumptions\n"
 "--------------------\n"
 "\n"
 "Assumes that the labels are leaf labels, and that they are unique in\n"
-"all trees (both target and pattern)\n"
+"all trees (both target and pattern). Inner labels and branch lengths are\n"
+"ignored, in the pattern as well as in the target trees.\n"
 "\n"
 "Example\n"
 "-------\n"
@@ -109,8 +146,14 @@ void help(char* argv[])
 "\n"
 "# Prints trees in data/vrt_gen.nw where Tamias is NOT closer to Homo than it is\n"
 "# to Vulpes:\n"
-"$ %s -v data/vrt_gen.nw '((Tamias,Homo),Vulpes);'\n",
+"$ %s -v data/vrt_gen.nw '((Tamias,Homo),Vulpes);'\n"
+"\n"
+"# Counts the trees in data/vrt_gen.nw that match each of the patterns in\n"
+"# patterns.nw:\n"
+"$ %s -c -f patterns.nw data/vrt_gen.nw\n",
 
+	argv[0],
+	argv[0],
 	argv[0],
 	argv[0],
 	argv[0]
@@ -124,10 +167,22 @@ struct parameters get_params(int argc, char *argv[])
 
 
 	params.reverse = false;
+	params.counts = false;
+	params.pattern_trees = NULL;
 
 	/* parse options and switches */
-	while ((opt_char = getopt(argc, argv, "hv")) != -1) {
+	while ((opt_char = getopt(argc, argv, "cf:hv")) != -1) {
 		switch (opt_char) {
+		case 'c':
+			params.counts = true;
+			break;
+		case 'f':
+			params.pattern_trees = fopen(optarg, "r");
+			if (NULL == params.pattern_trees) {
+				perror(NULL);
+				exit(EXIT_FAILURE);
+			}
+			break;
 		case 'h':
 			help(argv);
 			exit(EXIT_SUCCESS);
@@ -138,7 +193,8 @@ struct parameters get_params(int argc, char *argv[])
 		}
 	}
 	/* get arguments */
-	if (2 == (argc - optind))	{
+	int nb_args = NULL == params.pattern_trees ? 2 : 1;
+	if (nb_args == (argc - optind))	{
 		if (0 != strcmp("-", argv[optind])) {
 			FILE *fin = fopen(argv[optind], "r");
 			if (NULL == fin) {
@@ -149,251 +205,336 @@ struct parameters get_params(int argc, char *argv[])
 		} else {
 			params.target_trees = stdin;
 		}
-		params.pattern = argv[optind+1];
+		params.pattern = 2 == nb_args ? argv[optind+1] : NULL;
 	} else {
-		fprintf(stderr, "Usage: %s [-hv] <target trees filename|-> <pattern>\n", argv[0]);
+		fprintf(stderr, "Usage: %s [-chv] <target trees filename|-> <pattern>\n"
+			"       %s [-chv] -f <patterns filename> <target trees filename|->\n",
+			argv[0], argv[0]);
 		exit(EXIT_FAILURE);
 	}
 
 	return params;
 }
 
-/* A debugging function */
+/* Returns the pattern trees: either the one passed as argument, or those in
+ * the file passed to -f */
 
-void show_node_children_numbers(struct rooted_tree *tree)
+struct llist *get_pattern_trees(struct parameters params)
 {
-	struct list_elem *el;
-	for (el = tree->nodes_in_order->head; NULL != el; el = el->next) {
-		struct rnode *current = el->data;
-		printf ("node %p (%s): %d children\n", current,
-			current->label, children_count(current));
+	struct llist *pattern_trees = create_llist();
+	if (NULL == pattern_trees) { perror(NULL); exit(EXIT_FAILURE); }
+	struct rooted_tree *pattern_tree;
+
+	if (NULL == params.pattern_trees) {
+		newick_scanner_set_string_input(params.pattern);
+		pattern_tree = parse_tree();
+		if (NULL == pattern_tree) {
+			fprintf (stderr, "Could not parse pattern tree '%s'\n",
+					params.pattern);
+			exit(EXIT_FAILURE);
+		}
+		newick_scanner_clear_string_input();
+		if (! append_element(pattern_trees, pattern_tree)) {
+			perror(NULL);
+			exit(EXIT_FAILURE);
+		}
+	} else {
+		newick_scanner_set_file_input(params.pattern_trees);
+		while (NULL != (pattern_tree = parse_tree()))
+			if (! append_element(pattern_trees, pattern_tree)) {
+				perror(NULL);
+				exit(EXIT_FAILURE);
+			}
+		fclose(params.pattern_trees);
+		if (0 == pattern_trees->count) {
+			fprintf (stderr, "No pattern tree found.\n");
+			exit(EXIT_FAILURE);
+		}
 	}
-}
 
-/* Get pattern tree and order it */
+	return pattern_trees;
+}
 
-struct rooted_tree *get_ordered_pattern_tree(char *pattern)
+static int compare_labels(const void *a, const void *b)
 {
-	struct rooted_tree *pattern_tree;
+	return strcmp(*(char * const *) a, *(char * const *) b);
+}
 
-	newick_scanner_set_string_input(pattern);
-	pattern_tree = parse_tree();
-	if (NULL == pattern_tree) {
-		fprintf (stderr, "Could not parse pattern tree '%s'\n", pattern);
-		exit(EXIT_FAILURE);
-	}
-	newick_scanner_clear_string_input();
+/* Returns a string that identifies a set of labels: the sorted labels,
+ * separated by newlines. */
 
-	if (!order_tree_lbl(pattern_tree)) {
-		perror(NULL);
-		exit(EXIT_FAILURE);
+static char *leaf_set_key(struct llist *labels)
+{
+	char **array = (char **) llist_to_array(labels);
+	if (NULL == array) { perror(NULL); exit(EXIT_FAILURE); }
+	qsort(array, labels->count, sizeof(char *), compare_labels);
+
+	size_t length = 1;
+	int i;
+	for (i = 0; i < labels->count; i++)
+		length += strlen(array[i]) + 1;
+	char *key = malloc(length);
+	if (NULL == key) { perror(NULL); exit(EXIT_FAILURE); }
+	char *end = key;
+	for (i = 0; i < labels->count; i++) {
+		/* skip duplicates */
+		if (i > 0 && 0 == strcmp(array[i], array[i-1])) continue;
+		size_t len = strlen(array[i]);
+		memcpy(end, array[i], len);
+		end += len;
+		*end++ = '\n';
 	}
+	*end = '\0';
 
-	return pattern_tree;
+	free(array);
+	return key;
 }
 
-/* Removes inner labels, since match operates on leaf labels only (this might
- * change if operating on internal labels proves useful). */
+static int compare_refs(const void *a, const void *b)
+{
+	const struct pattern_ref *ra = a;
+	const struct pattern_ref *rb = b;
+	if (ra->hash != rb->hash) return (ra->hash > rb->hash) ? 1 : -1;
+	return ra->id - rb->id;
+}
 
-void remove_inner_node_labels(struct rooted_tree *target_tree)
+static int compare_clades(const void *a, const void *b)
 {
-	struct list_elem *el;
+	uint64_t ha = *(const uint64_t *) a;
+	uint64_t hb = *(const uint64_t *) b;
+	return (ha > hb) - (ha < hb);
+}
 
-	for (el=target_tree->nodes_in_order->head; NULL != el; el=el->next) {
-		struct rnode *current = el->data;
-		if (is_leaf(current)) continue;
-		free(current->label);
-		// We need to allocate dynamically, since this will later be
-		// passed to free().
-		current->label = strdup("");
+/* Adds a pattern to its group (creating the group if needed) */
+
+static void add_pattern(struct pattern_index *index, struct hash *groups_by_key,
+		struct rooted_tree *pattern_tree, int id)
+{
+	struct llist *labels = get_leaf_labels(pattern_tree);
+	if (NULL == labels) { perror(NULL); exit(EXIT_FAILURE); }
+	char *key = leaf_set_key(labels);
+
+	struct pattern_group *group = hash_get(groups_by_key, key);
+	if (NULL == group) {
+		group = malloc(sizeof(struct pattern_group));
+		if (NULL == group) { perror(NULL); exit(EXIT_FAILURE); }
+		group->leaves = create_topo_leaf_set(labels);
+		if (NULL == group->leaves) { perror(NULL); exit(EXIT_FAILURE); }
+		group->clades.clades = NULL;
+		group->clades.nb_clades = 0;
+		group->refs = NULL;
+		group->nb_refs = 0;
+		if (! hash_set(groups_by_key, key, group)) {
+			perror(NULL);
+			exit(EXIT_FAILURE);
+		}
+		if (! append_element(index->groups, group)) {
+			perror(NULL);
+			exit(EXIT_FAILURE);
+		}
 	}
-	/* The tree topology was not changed, so no need to recompute the node
-	 * list */
+	free(key);
+	destroy_llist(labels);
+
+	struct topo_pattern *pattern = create_topo_pattern(pattern_tree,
+			group->leaves);
+	if (NULL == pattern) { perror(NULL); exit(EXIT_FAILURE); }
+
+	group->refs = realloc(group->refs,
+			(group->nb_refs + 1) * sizeof(struct pattern_ref));
+	if (NULL == group->refs) { perror(NULL); exit(EXIT_FAILURE); }
+	group->refs[group->nb_refs].hash = pattern->hash;
+	group->refs[group->nb_refs].id = id;
+	group->nb_refs++;
+
+	int n = group->clades.nb_clades + pattern->nb_clades;
+	group->clades.clades = realloc(group->clades.clades,
+			n * sizeof(uint64_t));
+	if (NULL == group->clades.clades) { perror(NULL); exit(EXIT_FAILURE); }
+	memcpy(group->clades.clades + group->clades.nb_clades,
+			pattern->clades, pattern->nb_clades * sizeof(uint64_t));
+	group->clades.nb_clades = n;
+
+	destroy_topo_pattern(pattern);
 }
 
-/* Removes all nodes in target tree whose labels are not found in the 'kept'
- * hash */
+/* Sorts the groups' pattern references and clades, so that they can be
+ * searched. Duplicate clades are removed. */
 
-void prune_extra_labels(struct rooted_tree *target_tree, struct hash *kept)
+static void sort_groups(struct pattern_index *index)
 {
 	struct list_elem *el;
-
-	for (el=target_tree->nodes_in_order->head; NULL != el; el=el->next) {
-		struct rnode *current = el->data;
-		char *label = current->label;
-		if (0 == strcmp("", label)) continue;
-		if (is_root(current)) continue;
-		if (NULL == hash_get(kept, current->label)) {
-			/* not in 'kept': remove */
-			struct rnode *unlink_root;
-			enum unlink_rnode_status result = unlink_rnode(current);
-			switch(result) {
-			case UNLINK_RNODE_DONE:
-				break;
-			case UNLINK_RNODE_ROOT_CHILD:
-				unlink_root = get_unlink_rnode_root_child(); 
-				unlink_root->parent = NULL;
-				target_tree->root = unlink_root;
-				break;
-			case UNLINK_RNODE_ERROR:
-				fprintf (stderr, "Memory error - "
-						"exiting.\n");
-				exit(EXIT_FAILURE);
-			default:
-				assert(0); /* programmer error */
-			}
-		}
+	for (el = index->groups->head; NULL != el; el = el->next) {
+		struct pattern_group *group = el->data;
+		qsort(group->refs, group->nb_refs, sizeof(struct pattern_ref),
+				compare_refs);
+		uint64_t *clades = group->clades.clades;
+		int n = group->clades.nb_clades;
+		qsort(clades, n, sizeof(uint64_t), compare_clades);
+		int i, j = 0;
+		for (i = 0; i < n; i++)
+			if (0 == i || clades[i] != clades[j-1])
+				clades[j++] = clades[i];
+		group->clades.nb_clades = j;
 	}
-
-	/* Topology may have been altered: recompute nodes_in_order. */
-	destroy_llist(target_tree->nodes_in_order);
-	target_tree->nodes_in_order = get_nodes_in_order(target_tree->root);
 }
 
-void prune_empty_labels(struct rooted_tree *target_tree)
+/* Builds the index of patterns, then discards the pattern trees. */
+
+struct pattern_index *create_pattern_index(struct llist *pattern_trees)
 {
+	struct pattern_index *index = malloc(sizeof(struct pattern_index));
+	if (NULL == index) { perror(NULL); exit(EXIT_FAILURE); }
+	index->groups = create_llist();
+	index->nb_patterns = pattern_trees->count;
+	index->newicks = malloc(pattern_trees->count * sizeof(char *));
+	struct hash *groups_by_key = create_hash(pattern_trees->count);
+	if (NULL == index->groups || NULL == index->newicks ||
+			NULL == groups_by_key) {
+		perror(NULL);
+		exit(EXIT_FAILURE);
+	}
+
 	struct list_elem *el;
-	for (el=target_tree->nodes_in_order->head; NULL != el; el=el->next) {
-		struct rnode *current = el->data;
-		char *label = current->label;
-		/* If none of the labels in the target tree are found in the
-		 * pattern, we end up with a null tree consisting of nothing
-		 * but an unlabeled root. We can't unlink it, hence the test.
-		 * */
-		if (is_leaf(current) && ! is_root(current)) {
-			if (0 == strcmp("", label)) {
-				struct rnode *unlink_root;
-				enum unlink_rnode_status result =
-					unlink_rnode(current);
-				switch(result) {
-				case UNLINK_RNODE_DONE:
-					break;
-				case UNLINK_RNODE_ROOT_CHILD:
-					unlink_root =
-						get_unlink_rnode_root_child(); 
-					unlink_root->parent = NULL;
-					target_tree->root = unlink_root;
-					break;
-				case UNLINK_RNODE_ERROR:
-					perror(NULL);
-					exit(EXIT_FAILURE);
-				default:
-					assert(0); /* programmer error */
-				}
-			}
+	int id = 0;
+	for (el = pattern_trees->head; NULL != el; el = el->next, id++) {
+		struct rooted_tree *pattern_tree = el->data;
+		index->newicks[id] = to_newick(pattern_tree->root);
+		if (NULL == index->newicks[id]) {
+			perror(NULL);
+			exit(EXIT_FAILURE);
 		}
+		add_pattern(index, groups_by_key, pattern_tree, id);
+		destroy_tree(pattern_tree);
 	}
+	sort_groups(index);
 
-	/* Topology may have been altered: recompute nodes_in_order. */
-	destroy_llist(target_tree->nodes_in_order);
-	target_tree->nodes_in_order = get_nodes_in_order(target_tree->root);
+	destroy_hash(groups_by_key);
+	return index;
 }
 
-void remove_branch_lengths(struct rooted_tree *target_tree)
+void destroy_pattern_index(struct pattern_index *index)
 {
 	struct list_elem *el;
-
-	for (el = target_tree->nodes_in_order->head; NULL != el; el = el->next) {
-		struct rnode *current = el->data;
-		if (strcmp("", current->edge_length_as_string) != 0) {
-			free(current->edge_length_as_string);
-			// We need to allocate dynamically, since this will
-			// later be passed to free():
-			// cur_edge->length_as_string = "" *WRONG!*
-			current->edge_length_as_string = strdup("");
-		}
+	for (el = index->groups->head; NULL != el; el = el->next) {
+		struct pattern_group *group = el->data;
+		destroy_topo_leaf_set(group->leaves);
+		free(group->clades.clades);
+		free(group->refs);
+		free(group);
 	}
-	/* The tree topology was not changed, so no need to recompute
-	 * nodes_in_order */
+	destroy_llist(index->groups);
+	int i;
+	for (i = 0; i < index->nb_patterns; i++)
+		free(index->newicks[i]);
+	free(index->newicks);
+	free(index);
 }
 
-void remove_knee_nodes(struct rooted_tree *tree)
+/* A pattern matches the target tree iff the tree's topology, restricted to
+ * the pattern's leaf labels (see topology_hash.h), is the pattern's. Inner
+ * labels and branch lengths are ignored, in the target as well as in the
+ * pattern. The target tree is not modified. This sets 'matches[i]' to true
+ * iff the tree matches pattern i. */
+
+void match_tree(struct rooted_tree *tree, struct pattern_index *index,
+		bool *matches)
 {
-	struct list_elem *el;
+	memset(matches, 0, index->nb_patterns * sizeof(bool));
 
-	for (el = tree->nodes_in_order->head; NULL != el; el = el->next) {
-		struct rnode *current = el->data;
-		if (is_inner_node(current))
-			if (1 == children_count(current)) { 
-				if (! splice_out_rnode(current)) {
-					perror(NULL);
-					exit(EXIT_FAILURE);
-				}
-				/* NOTE: don't destroy the current node here.
-				 * This is taken care of later in main(). */
-			}
+	struct list_elem *el;
+	for (el = index->groups->head; NULL != el; el = el->next) {
+		struct pattern_group *group = el->data;
+		struct pattern_ref key;
+		key.id = -1;	/* sorts before all refs with the same hash */
+		switch (restricted_topology_hash(tree, group->leaves,
+					&(group->clades), &(key.hash))) {
+		case TOPO_HASH_OK:
+			break;
+		case TOPO_HASH_REJECTED:
+			continue;
+		default:
+			perror(NULL);
+			exit(EXIT_FAILURE);
+		}
+		/* find the first ref with this hash (binary search) */
+		int lo = 0, hi = group->nb_refs;
+		while (lo < hi) {
+			int mid = (lo + hi) / 2;
+			if (compare_refs(group->refs + mid, &key) < 0)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		for (; lo < group->nb_refs && group->refs[lo].hash == key.hash;
+				lo++)
+			matches[group->refs[lo].id] = true;
 	}
-
-	/* If the root has only one child, make that child the new root */
-	if (1 == children_count(tree->root)) 
-		tree->root = tree->root->first_child;
-
-	/* Topology may have been altered: recompute nodes_in_order. */
-	struct llist *nodes_in_order = get_nodes_in_order(tree->root);
-	if (NULL == nodes_in_order) { perror(NULL); exit(EXIT_FAILURE); }
-	destroy_llist(tree->nodes_in_order);
-	tree->nodes_in_order = nodes_in_order;
 }
 
-void process_tree(struct rooted_tree *tree, struct hash *pattern_labels,
-		char *pattern_newick, struct parameters params)
+void process_tree(struct rooted_tree *tree, struct pattern_index *index,
+		bool *matches, int *counts, struct parameters params)
 {
-	/* NOTE: whenever I alter the tree structure, I rebuild nodes_in_order
-	 * as soon as possible. Then I no longer need to guard against this
-	 * list being invalid. */
-
-	/* In this case I stick with the old, recursive to_newick, because it
-	 * directly returns a char* */
-	char *original_newick = to_newick(tree->root);
-	remove_inner_node_labels(tree);
-	prune_extra_labels(tree, pattern_labels);
-	prune_empty_labels(tree);
-	remove_knee_nodes(tree);
-	remove_branch_lengths(tree);	
-	if (! order_tree_lbl(tree)) { perror(NULL); exit(EXIT_FAILURE); }
-	/* Ordering does not change topology, but it does change node
-	 * oridering, hence nodes_in_order must be recomputed. */
-	struct llist *nodes_in_order = get_nodes_in_order(tree->root);
-	if (NULL == nodes_in_order) { perror(NULL); exit(EXIT_FAILURE); }
-	destroy_llist(tree->nodes_in_order);
-	tree->nodes_in_order = nodes_in_order;
-
-	char *processed_newick = to_newick(tree->root);
-	int match = (0 == strcmp(processed_newick, pattern_newick));
-	match = params.reverse ? !match : match;
-	if (match) printf ("%s\n", original_newick);
-	free(processed_newick);
-	free(original_newick);
+	match_tree(tree, index, matches);
+
+	int i;
+	bool first = true;
+	for (i = 0; i < index->nb_patterns; i++) {
+		bool match = params.reverse ? !matches[i] : matches[i];
+		if (! match) continue;
+		if (params.counts)
+			counts[i]++;
+		else if (NULL == params.pattern_trees)
+			dump_newick(tree->root);
+		else {
+			printf(first ? "%d" : " %d", i + 1);
+			first = false;
+		}
+	}
+	if (! params.counts && NULL != params.pattern_trees)
+		putchar('\n');
 }
 
 int main(int argc, char *argv[])
 {
-	struct rooted_tree *pattern_tree;	
 	struct rooted_tree *tree;	
-	char *pattern_newick;
-	struct hash *pattern_labels;
 
 	struct parameters params = get_params(argc, argv);
 
-	pattern_tree = get_ordered_pattern_tree(params.pattern);
-	pattern_newick = to_newick(pattern_tree->root);
-	pattern_labels = create_label2node_map(pattern_tree->nodes_in_order);
+	struct llist *pattern_trees = get_pattern_trees(params);
+	struct pattern_index *index = create_pattern_index(pattern_trees);
+	destroy_llist(pattern_trees);
+	destroy_all_rnodes(NULL);
 
-	/* get_ordered_pattern_tree() causes a tree to be read from a string,
-	 * which means that we must now tell the lexer to change its input
-	 * source. It's not enough to just set the external FILE pointer
-	 * 'nwsin' to standard input or the user-supplied file, apparently:
-	 * this would segfault. */
+	bool *matches = malloc(index->nb_patterns * sizeof(bool));
+	int *counts = calloc(index->nb_patterns, sizeof(int));
+	if (NULL == matches || NULL == counts) {
+		perror(NULL);
+		exit(EXIT_FAILURE);
+	}
+
+	/* Reading the patterns causes trees to be read from a string or
+	 * another file, which means that we must now tell the lexer to change
+	 * its input source. It's not enough to just set the external FILE
+	 * pointer 'nwsin' to standard input or the user-supplied file,
+	 * apparently: this would segfault. */
 	newick_scanner_set_file_input(params.target_trees);
 
 	while (NULL != (tree = parse_tree())) {
-		process_tree(tree, pattern_labels, pattern_newick, params);
+		process_tree(tree, index, matches, counts, params);
 		destroy_tree(tree);
+		recycle_all_rnodes(NULL);
+	}
+
+	if (params.counts) {
+		int i;
+		for (i = 0; i < index->nb_patterns; i++)
+			printf("%d\t%s\n", counts[i], index->newicks[i]);
 	}
 
-	destroy_hash(pattern_labels);
-	free(pattern_newick);
+	free(matches);
+	free(counts);
+	destroy_pattern_index(index);
 	destroy_all_rnodes(NULL);
-	destroy_tree(pattern_tree);
 	return 0;
 }
@@ -0,0 +1,201 @@
+/* 
+
+Copyright (c) 2009 Thomas Junier and Evgeny Zdobnov, University of Geneva
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+* Neither the name of the University of Geneva nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <assert.h>
+
+#include "node_attr.h"
+#include "tree.h"
+#include "tree_stats.h"
+#include "rnode.h"
+#include "common.h"
+
+#define WORD_BITS (CHAR_BIT * sizeof(unsigned long))
+
+static size_t value_size(enum node_attr_type type)
+{
+	switch (type) {
+	case NODE_ATTR_DOUBLE:
+		return sizeof(double);
+	case NODE_ATTR_INT:
+		return sizeof(int);
+	case NODE_ATTR_BITSET:
+		return sizeof(unsigned long);
+	case NODE_ATTR_POINTER:
+		return sizeof(void *);
+	default:
+		assert(0);	/* programmer error */
+	}
+	return 0;
+}
+
+/* Allocates a zeroed column with one value per node of 'stats'. Note that
+ * calloc() gives all-zero bits, which is 0.0 for doubles and NULL for pointers
+ * on all platforms we know of. */
+/* Returns FAILURE iff calloc() fails, in which case the column is unchanged. */
+
+static int alloc_values(struct node_attr *attr, struct tree_stats *stats)
+{
+	void *values = calloc((size_t) stats->nb_nodes * attr->nb_words,
+			value_size(attr->type));
+	if (NULL == values) return FAILURE;
+	free(attr->values);
+	attr->values = values;
+	attr->nb_nodes = stats->nb_nodes;
+	attr->link_change_count = stats->link_change_count;
+	return SUCCESS;
+}
+
+struct node_attr *add_node_attr(struct rooted_tree *tree, const char *name,
+		enum node_attr_type type, int nb_bits)
+{
+	struct tree_stats *stats = get_tree_stats(tree);
+	if (NULL == stats) return NULL;
+
+	struct node_attr *attr = get_node_attr(tree, name);
+	if (NULL != attr) {
+		if (attr->type != type) return NULL;
+		/* The tree has changed since the column was made: the nodes
+		 * have been renumbered (and their number may differ), so the
+		 * values no longer match them. */
+		if (attr->link_change_count != stats->link_change_count &&
+				! alloc_values(attr, stats))
+			return NULL;
+		return attr;
+	}
+
+	attr = malloc(sizeof(struct node_attr));
+	if (NULL == attr) return NULL;
+	attr->name = strdup(name);
+	if (NULL == attr->name) { free(attr); return NULL; }
+	attr->type = type;
+	attr->nb_bits = 0;
+	attr->nb_words = 1;
+	if (NODE_ATTR_BITSET == type) {
+		attr->nb_bits = nb_bits;
+		attr->nb_words = (nb_bits + WORD_BITS - 1) / WORD_BITS;
+		if (0 == attr->nb_words) attr->nb_words = 1;
+	}
+
+	/* One block for the whole column */
+	attr->values = NULL;
+	if (! alloc_values(attr, stats)) {
+		free(attr->name);
+		free(attr);
+		return NULL;
+	}
+
+	attr->next = tree->attrs;
+	tree->attrs = attr;
+
+	return attr;
+}
+
+struct node_attr *get_node_attr(struct rooted_tree *tree, const char *name)
+{
+	struct node_attr *attr;
+	for (attr = tree->attrs; NULL != attr; attr = attr->next)
+		if (0 == strcmp(name, attr->name))
+			return attr;
+	return NULL;
+}
+
+static void destroy_node_attr(struct node_attr *attr)
+{
+	free(attr->values);
+	free(attr->name);
+	free(attr);
+}
+
+void remove_node_attr(struct rooted_tree *tree, const char *name)
+{
+	struct node_attr **link;
+	for (link = &(tree->attrs); NULL != *link; link = &((*link)->next)) {
+		struct node_attr *attr = *link;
+		if (0 == strcmp(name, attr->name)) {
+			*link = attr->next;
+			destroy_node_attr(attr);
+			return;
+		}
+	}
+}
+
+void destroy_node_attrs(struct node_attr *attrs)
+{
+	while (NULL != attrs) {
+		struct node_attr *next = attrs->next;
+		destroy_node_attr(attrs);
+		attrs = next;
+	}
+}
+
+double *node_attr_doubles(struct node_attr *attr)
+{
+	assert(NODE_ATTR_DOUBLE == attr->type);
+	return attr->values;
+}
+
+int *node_attr_ints(struct node_attr *attr)
+{
+	assert(NODE_ATTR_INT == attr->type);
+	return attr->values;
+}
+
+void **node_attr_pointers(struct node_attr *attr)
+{
+	assert(NODE_ATTR_POINTER == attr->type);
+	return attr->values;
+}
+
+unsigned long *node_attr_bitset(struct node_attr *attr, struct rnode *node)
+{
+	assert(NODE_ATTR_BITSET == attr->type);
+	assert(node->index >= 0 && node->index < attr->nb_nodes);
+	return (unsigned long *) attr->values + node->index * attr->nb_words;
+}
+
+bool node_attr_test_bit(struct node_attr *attr, struct rnode *node, int bit)
+{
+	unsigned long *set = node_attr_bitset(attr, node);
+	return (set[bit / WORD_BITS] >> (bit % WORD_BITS)) & 1UL;
+}
+
+void node_attr_set_bit(struct node_attr *attr, struct rnode *node, int bit)
+{
+	unsigned long *set = node_attr_bitset(attr, node);
+	set[bit / WORD_BITS] |= 1UL << (bit % WORD_BITS);
+}
+
+void node_attr_clear_bit(struct node_attr *attr, struct rnode *node, int bit)
+{
+	unsigned long *set = node_attr_bitset(attr, node);
+	set[bit / WORD_BITS] &= ~(1UL << (bit % WORD_BITS));
+}
@@ -0,0 +1,106 @@
+/* 
+
+Copyright (c) 2009 Thomas Junier and Evgeny Zdobnov, University of Geneva
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+* Neither the name of the University of Geneva nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/* Per-node attributes stored in columns. Instead of hanging an app-specific
+ * structure on each node's 'data' member (one malloc() per node, and only one
+ * kind of data at any time), a pass can register a named, typed column on the
+ * tree. A column holds one value per node, in a single block of memory, and
+ * is indexed by the node's number (its 'index' member, see tree_stats.h).
+ * Several passes can thus keep their data side by side, e.g. depth, support
+ * and style. */
+
+/* NOTE: the nodes are numbered by get_tree_stats() when a column is created.
+ * Changing the tree's structure (see link.c) renumbers the nodes, so columns
+ * created before such a change must not be used after it; add_node_attr()
+ * resets them. Like the stats, columns cannot know about changes made outside
+ * of link.c. */
+
+#include <stdbool.h>
+
+struct rooted_tree;
+struct rnode;
+
+enum node_attr_type { NODE_ATTR_DOUBLE, NODE_ATTR_INT, NODE_ATTR_BITSET,
+	NODE_ATTR_POINTER };
+
+struct node_attr {
+	char *name;
+	enum node_attr_type type;
+	int nb_nodes;		/**< number of values in the column */
+	/** value of get_link_change_count() when the values were reset */
+	unsigned long link_change_count;
+	int nb_bits;		/**< bits per node (bitset columns only) */
+	int nb_words;		/**< words per node (bitset columns only) */
+	void *values;		/**< the column itself (nb_nodes values) */
+	struct node_attr *next;	/**< next column in the tree's registry */
+};
+
+/* Adds a column called 'name' to the tree, with one value of type 'type' per
+ * node. Values are initialized to 0 (or NULL, or the empty set). 'nb_bits' is
+ * the size of each node's set, for bitset columns; it is ignored for other
+ * types. If the tree already has a column of that name and type, it is
+ * returned as is - unless the tree's structure has changed since it was made
+ * (see get_link_change_count()), in which case it is first resized to the
+ * new number of nodes and its values reset to 0. */
+/* Returns NULL if there is a column with the same name but a different type,
+ * or in case of malloc() problems. */
+
+struct node_attr *add_node_attr(struct rooted_tree *tree, const char *name,
+		enum node_attr_type type, int nb_bits);
+
+/* Returns the tree's column called 'name', or NULL if there is none. */
+
+struct node_attr *get_node_attr(struct rooted_tree *tree, const char *name);
+
+/* Removes the column called 'name' from the tree and frees it. Does nothing if
+ * there is no such column. */
+
+void remove_node_attr(struct rooted_tree *tree, const char *name);
+
+/* Frees a list of columns (as pointed to by struct rooted_tree's 'attrs'
+ * member). Pointer columns do not own what they point to, so the pointed
+ * objects are NOT freed. This is called by destroy_tree(). */
+
+void destroy_node_attrs(struct node_attr *attrs);
+
+/* Typed access to whole columns: the value for node 'n' is at n->index. These
+ * check (with assert()) that the column has the requested type. */
+
+double *node_attr_doubles(struct node_attr *attr);
+int *node_attr_ints(struct node_attr *attr);
+void **node_attr_pointers(struct node_attr *attr);
+
+/* Bitset columns: tests, sets and clears bit 'bit' of the node's set, and
+ * returns a pointer to the node's set (attr->nb_words words). */
+
+bool node_attr_test_bit(struct node_attr *attr, struct rnode *node, int bit);
+void node_attr_set_bit(struct node_attr *attr, struct rnode *node, int bit);
+void node_attr_clear_bit(struct node_attr *attr, struct rnode *node, int bit);
+unsigned long *node_attr_bitset(struct node_attr *attr, struct rnode *node);
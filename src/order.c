@@ -34,6 +34,8 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <inttypes.h>
+#include <stdbool.h>
 
 #include "tree.h"
 #include "parser.h"
@@ -41,13 +43,18 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "list.h"
 #include "rnode.h"
 #include "order_tree.h"
+#include "pipeline.h"
 
-enum order_criterion { ORDER_ALNUM_LBL, ORDER_NUM_DESCENDANTS, ORDER_DELADDERIZE };
+enum order_criterion { ORDER_ALNUM_LBL, ORDER_NUM_DESCENDANTS, ORDER_DELADDERIZE,
+	ORDER_CANONICAL };
 enum sort_order { ORDER_DIRECT, ORDER_REVERSE };
 
 struct parameters {
 	enum order_criterion criterion;
 	enum sort_order order;
+	int nb_workers;
+	bool print_hashes;
+	int (*order_tree)(struct rooted_tree *);
 };
 
 void help (char *argv[])
@@ -58,7 +65,7 @@ void help (char *argv[])
 "Synopsis\n"
 "--------\n"
 "\n"
-"%s [-c:hn] <newick trees filename|->\n"
+"%s [-c:hHn] [-j <processes>] <newick trees filename|->\n"
 "\n"
 "Input\n"
 "-----\n"
@@ -84,13 +91,26 @@ void help (char *argv[])
 "        (alphanumeric oder of labels), 'n' (number of descendants:\n"
 "        nodes with fewer descendans appear first), 'd' (de-ladderize:\n"
 "        alternately put nodes with fewer descendants before or after\n"
-"        those with more)\n"
+"        those with more), 'c' (canonical: like 'a', but using only leaf\n"
+"        labels, with ties broken by structure - trees that differ only\n"
+"        in the order of children or in inner labels give the same output)\n"
 "        The default (i.e., if option -c is not given) is 'a'.\n"
 "    -h: print this message and exit\n"
+"    -H: instead of the tree, print two 128-bit canonical hashes (in\n"
+"        hexadecimal): one of the topology (leaf labels and shape), and\n"
+"        one of the topology with the branch lengths. Isomorphic trees\n"
+"        have the same hashes, so these can be used to find duplicate\n"
+"        trees. Branch lengths are compared as numbers, inner labels are\n"
+"        ignored. Implies -c c.\n"
+"    -j <n>: process the trees in n processes (default: 1). The output is\n"
+"        the same, and in the same order.\n"
 "\n"
 "Examples\n"
 "--------\n"
 "\n"
+"# Find out how many distinct topologies there are in a file\n"
+"$ %s -H trees.nw | cut -d ' ' -f 1 | sort -u | wc -l\n"
+"\n"
 "# De-ladderize tree\n"
 "$ %s -c d ladder.nw\n"
 "\n"
@@ -108,6 +128,7 @@ void help (char *argv[])
 	argv[0],
 	argv[0],
 	argv[0],
+	argv[0],
 	argv[0]
 	       );
 }
@@ -117,6 +138,8 @@ int get_criterion(char *optarg)
 	switch (optarg[0]) {
 	case 'a':
 		return ORDER_ALNUM_LBL;
+	case 'c':
+		return ORDER_CANONICAL;
 	case 'd':
 		return ORDER_DELADDERIZE;
 	case 'n':
@@ -133,16 +156,24 @@ struct parameters get_params(int argc, char *argv[])
 
 	struct parameters params;
 	params.criterion = ORDER_ALNUM_LBL;
+	params.nb_workers = 1;
+	params.print_hashes = false;
 
 	int opt_char;
-	while ((opt_char = getopt(argc, argv, "c:hr")) != -1) {
+	while ((opt_char = getopt(argc, argv, "c:hHj:r")) != -1) {
 		switch (opt_char) {
 		case 'h':
 			help(argv);
 			exit(EXIT_SUCCESS);
+		case 'H':
+			params.print_hashes = true;
+			break;
 		case 'c':
 			params.criterion = get_criterion(optarg);
 			break;
+		case 'j':
+			params.nb_workers = parse_nb_workers(optarg);
+			break;
 		case 'r':
 			params.order = ORDER_REVERSE;
 			break;
@@ -164,49 +195,70 @@ struct parameters get_params(int argc, char *argv[])
 			nwsin = fin;
 		}
 	} else {
-		fprintf(stderr, "Usage: %s [-c:hr] <filename|->\n", argv[0]);
+		fprintf(stderr, "Usage: %s [-c:hHr] [-j <processes>] <filename|->\n",
+				argv[0]);
 		exit(EXIT_FAILURE);
 	}
 
 	return params;
 }
 
-/* Counts the number of descendants of the tree, using the data pointer of each
- * node. */
+static int order_tree_canonical_no_hash(struct rooted_tree *tree)
+{
+	return order_tree_canonical(tree, NULL);
+}
+
+static void print_hashes(struct rooted_tree *tree)
+{
+	struct canonical_hash hash;
+	if (! order_tree_canonical(tree, &hash)) {
+		perror(NULL);
+		exit(EXIT_FAILURE);
+	}
+	printf("%016" PRIx64 "%016" PRIx64 " %016" PRIx64 "%016" PRIx64 "\n",
+		hash.topology.hi, hash.topology.lo,
+		hash.lengths.hi, hash.lengths.lo);
+}
+
+static void process_tree(struct rooted_tree *tree, void *arg)
+{
+	struct parameters *params = arg;
+	if (params->print_hashes) {
+		print_hashes(tree);
+	} else {
+		if (! params->order_tree(tree)) {
+			perror(NULL);
+			exit(EXIT_FAILURE);
+		}
+		dump_newick(tree->root);
+	}
+	destroy_all_rnodes(NULL);
+	destroy_tree(tree);
+}
 
 int main(int argc, char *argv[])
 {
-	struct rooted_tree *tree;	
 	struct parameters params = get_params(argc, argv);
-	int (*comparator)(const void*,const void*);
-	int (*sort_field_setter)(struct rnode *);
 
 	switch(params.criterion) {
 	case ORDER_ALNUM_LBL:
-		comparator = lbl_comparator;
-		sort_field_setter = set_sort_field_label;
+		params.order_tree = order_tree_lbl;
 		break;
 	case ORDER_DELADDERIZE:
-		comparator = num_desc_deladderize;
-		sort_field_setter = set_sort_field_num_desc;
+		params.order_tree = order_tree_deladderize;
 		break;
 	case ORDER_NUM_DESCENDANTS:
-		comparator = num_desc_comparator;
-		sort_field_setter = set_sort_field_num_desc;
+		params.order_tree = order_tree_num_desc;
+		break;
+	case ORDER_CANONICAL:
+		params.order_tree = order_tree_canonical_no_hash;
 		break;
 	default:
 		assert(0); // programmer error
 	}
 
-	while (NULL != (tree = parse_tree())) {
-		if (! order_tree (tree, comparator, sort_field_setter)) {
-			perror(NULL);
-			exit(EXIT_FAILURE);
-		}
-		dump_newick(tree->root);
-		destroy_all_rnodes(NULL);
-		destroy_tree(tree);
-	}
+	if (! run_tree_pipeline(params.nb_workers, process_tree, &params))
+		exit(EXIT_FAILURE);
 
 	return 0;
 }
@@ -33,6 +33,8 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
 
 #include "rnode.h"
 #include "tree.h"
@@ -41,145 +43,285 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "common.h"
 #include "order_tree.h"
 
-int order_tree(struct rooted_tree *tree,
-		int (*comparator)(const void*,const void*),
-		int (*sort_field_setter)(struct rnode *))
-{
-	struct list_elem *elem;
+enum order_key { KEY_LABEL, KEY_NUM_LEAVES, KEY_CANONICAL };
 
-	/* the rnode->data member is used to store the sort field. This is set
-	 * by the set_sort_field_num_desc callback.*/
+/* While a tree is being ordered, each node's sort key is kept in its data
+ * member: a pointer to a label (which belongs to the node or to one of its
+ * descendants), a number of leaves stored as an integer, or (for the
+ * canonical order) a pointer to a work record. Nothing else is allocated. A
+ * node's key is cleared once its parent's has been set, so all data members
+ * are NULL at the end. */
 
-	for (elem=tree->nodes_in_order->head; NULL!=elem; elem=elem->next) {
-		struct rnode *current = elem->data;
-		if (is_leaf(current)) {
-			sort_field_setter(current);
-		} else {
-			/* Since all children have been visited (because we're
-			 * traversing the tree in postorder), we can
-			 * just order the children on their sort field. */
-			struct rnode ** kids_array;
-			int count = current->child_count;
-			kids_array = (struct rnode **)
-				children_array(current);
-			if (NULL == kids_array) return FAILURE;
-
-			qsort(kids_array, count, sizeof(struct rnode *),
-					comparator);
-
-			remove_children(current);
-			int i;
-			for (i = 0; i < count; i++)
-				add_child(current, kids_array[i]);
-			current->last_child->next_sibling = NULL;
-
-			sort_field_setter(current);
-			free(kids_array);
-		}
-	}
+struct canonical_key {
+	char *min_label;
+	struct canonical_hash hash;
+};
 
-	return SUCCESS;
+static char *label_key(struct rnode *node)
+{
+	return node->data;
 }
 
-int order_tree_lbl(struct rooted_tree *tree)
+static intptr_t num_leaves_key(struct rnode *node)
 {
-	return order_tree(tree, lbl_comparator, set_sort_field_label);
+	return (intptr_t) node->data;
 }
 
-int num_desc_comparator(const void *a, const void *b)
+static struct canonical_key *canonical_key(struct rnode *node)
 {
-	struct rnode *rnode_a = *((struct rnode **) a);
-	struct rnode *rnode_b = *((struct rnode **) b);
-	int a_num_desc = *((int *) rnode_a->data);
-	int b_num_desc = *((int *) rnode_b->data);
+	return node->data;
+}
 
-	if (a_num_desc > b_num_desc)
-		return 1;
-	if (a_num_desc < b_num_desc)
-		return -1;
+static int compare_hash128(struct hash128 *a, struct hash128 *b)
+{
+	if (a->hi != b->hi) return a->hi < b->hi ? -1 : 1;
+	if (a->lo != b->lo) return a->lo < b->lo ? -1 : 1;
 	return 0;
 }
 
-int num_desc_deladderize(const void *a, const void *b)
+static int compare_canonical_keys(struct canonical_key *a,
+		struct canonical_key *b)
 {
-	static int orientation = -1;
+	int cmp = strcmp(a->min_label, b->min_label);
+	if (0 != cmp) return cmp;
+	cmp = compare_hash128(&(a->hash.topology), &(b->hash.topology));
+	if (0 != cmp) return cmp;
+	return compare_hash128(&(a->hash.lengths), &(b->hash.lengths));
+}
 
-	/* This changes sign at every invocation, therefore one call considers
-	 * a heavy node greater than a light node (in terms of number of
-	 * descendants), but the next call does the opposite. */
-	orientation *= -1;
+/* 'orientation' is 1 for increasing keys, -1 for decreasing (only numeric
+ * keys are ever decreasing). */
 
-	struct rnode *rnode_a = *((struct rnode **) a);
-	struct rnode *rnode_b = *((struct rnode **) b);
-	int a_num_desc = *((int *) rnode_a->data);
-	int b_num_desc = *((int *) rnode_b->data);
+static int compare_keys(struct rnode *a, struct rnode *b, enum order_key key,
+		int orientation)
+{
+	if (KEY_LABEL == key)
+		return strcmp(label_key(a), label_key(b));
+	if (KEY_CANONICAL == key)
+		return compare_canonical_keys(canonical_key(a),
+				canonical_key(b));
+	intptr_t ka = num_leaves_key(a), kb = num_leaves_key(b);
+	return orientation * ((ka > kb) - (ka < kb));
+}
 
-	if (a_num_desc > b_num_desc)
-		return orientation;
-	if (a_num_desc < b_num_desc)
-		return -orientation;
-	return 0;
+/* Merge sort on a list of siblings. Takes the first 'count' nodes of the list
+ * that starts at '*list', and returns them sorted (with the last one's
+ * next_sibling set to NULL); '*list' then points to the rest of the list.
+ * The sort is stable, so nodes with equal keys keep their order. */
+
+static struct rnode *sort_siblings(struct rnode **list, int count,
+		enum order_key key, int orientation)
+{
+	if (1 == count) {
+		struct rnode *node = *list;
+		*list = node->next_sibling;
+		node->next_sibling = NULL;
+		return node;
+	}
+	struct rnode *a = sort_siblings(list, count / 2, key, orientation);
+	struct rnode *b = sort_siblings(list, count - count / 2, key,
+			orientation);
+
+	struct rnode *head = NULL;
+	struct rnode **tail = &head;
+	while (NULL != a && NULL != b) {
+		if (compare_keys(a, b, key, orientation) <= 0) {
+			*tail = a;
+			a = a->next_sibling;
+		} else {
+			*tail = b;
+			b = b->next_sibling;
+		}
+		tail = &((*tail)->next_sibling);
+	}
+	*tail = (NULL != a) ? a : b;
+	return head;
 }
 
-int lbl_comparator(const void *a, const void *b)
+/* The finalizer of the SplitMix64 generator, as in topology_hash.c */
+
+static uint64_t mix64(uint64_t x)
 {
-	/* I really have trouble understanding how qsort() passes the
-	 * comparands to the comparator... but thanks to GDB I figured out this
-	 * one. */	
-	char *a_lbl = (*(struct rnode **)a)->data;
-	char *b_lbl = (*(struct rnode **)b)->data;
+	x ^= x >> 30;
+	x *= 0xbf58476d1ce4e5b9ULL;
+	x ^= x >> 27;
+	x *= 0x94d049bb133111ebULL;
+	x ^= x >> 31;
+	return x;
+}
+
+/* Each half of a 128-bit hash is computed in the same way, but from a
+ * different seed. */
 
-	int cmp = strcmp(a_lbl, b_lbl);
-	// printf ("%s <=> %s: %d\n", a_lbl, b_lbl, cmp);
+static const uint64_t seeds[2] = {
+	0x9e3779b97f4a7c15ULL, 0xc2b2ae3d27d4eb4fULL
+};
 
-	return cmp;
+/* FNV-1a, followed by a mix */
+
+static uint64_t label_hash(const char *label, uint64_t seed)
+{
+	uint64_t h = 0xcbf29ce484222325ULL ^ seed;
+	for (; '\0' != *label; label++) {
+		h ^= (unsigned char) *label;
+		h *= 0x100000001b3ULL;
+	}
+	return mix64(h);
 }
 
-int order_tree_num_desc(struct rooted_tree *tree)
+/* Lengths are hashed by value, so that e.g. '1' and '1.0' hash the same. */
+
+static uint64_t length_hash(const char *length, uint64_t seed)
 {
-	return order_tree(tree, num_desc_comparator, set_sort_field_num_desc);
+	if ('\0' == length[0]) return mix64(seed);
+	double value = atof(length);
+	if (0 == value) value = 0;	/* -0 is 0 */
+	uint64_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return mix64(seed ^ mix64(bits + 1));
 }
 
-int order_tree_deladderize(struct rooted_tree *tree)
+/* Hash of the (ordered) sequence of a node's children's hashes */
+
+static uint64_t inner_hash(struct rnode *node, uint64_t seed, int half,
+		bool lengths)
+{
+	uint64_t h = seed;
+	struct rnode *kid = node->first_child;
+	int i;
+	for (i = 0; i < node->child_count; i++) {
+		struct canonical_hash *kid_hash = &(canonical_key(kid)->hash);
+		struct hash128 *h128 = lengths ?
+			&(kid_hash->lengths) : &(kid_hash->topology);
+		h = mix64(h ^ (0 == half ? h128->hi : h128->lo));
+		kid = kid->next_sibling;
+	}
+	return mix64(h + (uint64_t) node->child_count);
+}
+
+/* Sets a node's canonical key, once its children have been ordered: the
+ * smallest leaf label is the first child's, and the hashes are computed from
+ * the children's. */
+
+static void set_canonical_key(struct rnode *node)
 {
-	return order_tree(tree, num_desc_deladderize, set_sort_field_num_desc);
+	struct canonical_key *key = canonical_key(node);
+	uint64_t topology[2], lengths[2];
+	int half;
+
+	key->min_label = is_leaf(node) ? node->label :
+		canonical_key(node->first_child)->min_label;
+	for (half = 0; half < 2; half++) {
+		if (is_leaf(node)) {
+			topology[half] = label_hash(node->label, seeds[half]);
+			lengths[half] = topology[half];
+		} else {
+			topology[half] = inner_hash(node, seeds[half], half,
+					false);
+			lengths[half] = inner_hash(node, ~seeds[half], half,
+					true);
+		}
+		lengths[half] = mix64(lengths[half] ^ length_hash(
+				node->edge_length_as_string, seeds[half]));
+	}
+	key->hash.topology.hi = topology[0];
+	key->hash.topology.lo = topology[1];
+	key->hash.lengths.hi = lengths[0];
+	key->hash.lengths.lo = lengths[1];
 }
 
-int set_sort_field_label(struct rnode *node)
+/* A node's key is its label if it has one (or is a leaf), or else its first
+ * child's key - after the children have been ordered. */
+
+static void set_key(struct rnode *node, enum order_key key)
 {
-	/* If the node has a non-empty label, or if it is a leaf (or both), we
-	 * just use the label as sort field. Otherwise, we use the first
-	 * child's sort field.  */
+	if (KEY_CANONICAL == key) {
+		set_canonical_key(node);
+	} else if (KEY_LABEL == key) {
+		if (is_leaf(node) || '\0' != node->label[0])
+			node->data = node->label;
+		else
+			node->data = node->first_child->data;
+	} else {
+		intptr_t num_leaves = 0;
+		if (is_leaf(node)) {
+			num_leaves = 1;
+		} else {
+			struct rnode *kid = node->first_child;
+			int i;
+			for (i = 0; i < node->child_count; i++) {
+				num_leaves += num_leaves_key(kid);
+				kid = kid->next_sibling;
+			}
+		}
+		node->data = (void *) num_leaves;
+	}
+}
 
-	if (is_leaf(node) || (strcmp(node->label, "") != 0))
-		node->data = strdup(node->label);
-	else 
-		node->data = strdup((char *) node->first_child->data);
+/* Orders the children of every node, in one post-order pass. With
+ * 'alternate', the order is reversed at every other inner node (in
+ * post-order), which breaks ladders. For the canonical order, 'work' has one
+ * record per node, in post-order. */
 
-	if (NULL == node->data)
-		return FAILURE;
+static void order_tree(struct rooted_tree *tree, enum order_key key,
+		bool alternate, struct canonical_key *work)
+{
+	int orientation = 1;
+	struct list_elem *elem;
 
+	for (elem=tree->nodes_in_order->head; NULL!=elem; elem=elem->next) {
+		struct rnode *current = elem->data;
+		if (KEY_CANONICAL == key) current->data = work++;
+		if (! is_leaf(current)) {
+			/* All children have been visited (we're traversing
+			 * the tree in post-order), so they have their keys. */
+			struct rnode *list = current->first_child;
+			struct rnode *sorted = sort_siblings(&list,
+					current->child_count, key,
+					orientation);
+			set_children_order(current, sorted);
+			if (alternate) orientation = -orientation;
+		}
+		set_key(current, key);
+		struct rnode *kid = current->first_child;
+		int i;
+		for (i = 0; i < current->child_count; i++) {
+			kid->data = NULL;
+			kid = kid->next_sibling;
+		}
+	}
+	tree->root->data = NULL;
+}
+
+int order_tree_lbl(struct rooted_tree *tree)
+{
+	order_tree(tree, KEY_LABEL, false, NULL);
 	return SUCCESS;
 }
 
-int set_sort_field_num_desc(struct rnode *node)
+int order_tree_num_desc(struct rooted_tree *tree)
 {
+	order_tree(tree, KEY_NUM_LEAVES, false, NULL);
+	return SUCCESS;
+}
 
-	/* node's descendant count is 1 + the sum of the descendant counts of
-	 * its children */
+int order_tree_deladderize(struct rooted_tree *tree)
+{
+	order_tree(tree, KEY_NUM_LEAVES, true, NULL);
+	return SUCCESS;
+}
 
-	node->data = malloc(sizeof(int));
-	if (NULL == node->data) return FAILURE;
+int order_tree_canonical(struct rooted_tree *tree, struct canonical_hash *hash)
+{
+	int nb_nodes = tree->nodes_in_order->count;
+	struct canonical_key *work = malloc(nb_nodes *
+			sizeof(struct canonical_key));
+	if (NULL == work) return FAILURE;
 
-	if (is_leaf(node)) {
-		*((int *) node->data) = 1;	/* counts as one */
-	} else {
-		int sum = 0;
-		struct rnode *kid = node->first_child;
-		for(; NULL != kid; kid = kid->next_sibling)
-			sum += *((int *) kid->data);
-		*((int *) node->data) = sum;
-	}
+	order_tree(tree, KEY_CANONICAL, false, work);
+	if (NULL != hash)
+		*hash = work[nb_nodes - 1].hash;	/* root */
 
+	free(work);
 	return SUCCESS;
 }
@@ -29,44 +29,52 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 /* order_tree.h: functions for ordering trees */
 
-struct rooted_tree;
+#include <stdint.h>
 
+struct rooted_tree;
 
-int order_tree_lbl(struct rooted_tree *);
-int order_tree_num_desc(struct rooted_tree *);
+/* These order the children of every node of a tree (without changing its
+ * topology). They take a single pass over the tree and allocate nothing; the
+ * nodes' data members are used during the pass, and are NULL afterwards. They
+ * return SUCCESS. */
 
-/* A general-purpose sort function. Arguments are a tree, a node comparator
- * function, and a sort field setter function. The comparator is used by
- * qsort() to sort the children of a node, and the setter function sets the
- * node's sort field once its children have been sorted. See also
- * order_tree_lbl() and order_tree_num_desc(), which are
- * canned, easy-to-remember calls to this function. */
+/* Children are in alphanumeric order of their label. An inner node without a
+ * label sorts as its first child (after ordering). */
 
-int order_tree(struct rooted_tree *tree,
-		int (*comparator)(const void*,const void*),
-		int (*sort_field_setter)(struct rnode *));
+int order_tree_lbl(struct rooted_tree *);
 
-/* Comparators */
+/* Children are in increasing order of their number of leaves. */
 
-/* This compares node labels. */
+int order_tree_num_desc(struct rooted_tree *);
 
-int lbl_comparator(const void *, const void *);
+/* Like order_tree_num_desc(), but the order is reversed at every other inner
+ * node (in post-order), which breaks any ladder. */
 
-/* Idem, but for ordering children by increasing number of descendants. Node
- * data must point to an int that holds the number of descendants. */
+int order_tree_deladderize(struct rooted_tree *);
 
-int num_desc_comparator(const void *a, const void *b);
+/* A 128-bit hash, as two 64-bit halves */
 
-/* This comparator is like num_desc_comparator(), but it reverses the
- * comparison every two nodes, breaking any ladder. */
+struct hash128 {
+	uint64_t hi;
+	uint64_t lo;
+};
 
-int num_desc_deladderize(const void *a, const void *b);
+/* The canonical hashes of a tree (see order_tree_canonical()). */
 
-/* Sort field setters. These return SUCCESS unless there was a memory problem.
- * */
+struct canonical_hash {
+	struct hash128 topology;	/**< leaf labels and shape */
+	struct hash128 lengths;		/**< same, and branch lengths */
+};
 
-/* Sets a node's sort field as the label of its first child */
-int set_sort_field_label(struct rnode *);
+/* Puts the tree in canonical order: children are in alphanumeric order of
+ * the smallest leaf label among their descendants. Ties (which only occur
+ * with repeated or empty labels) are broken by comparing the children's
+ * hashes, so two trees that differ only in the order of children (and in
+ * inner labels) come out the same. If 'hash' is not NULL, the canonical
+ * hashes of the tree are stored there. Inner labels are ignored; branch
+ * lengths are compared as numbers (so '1' and '1.0' are the same), and an
+ * absent length differs from any number. Unlike the above, this allocates
+ * one work record per node. */
+/* Returns FAILURE in case of malloc() problems. */
 
-/* Sets a node's sort field as the number of its descendants */
-int set_sort_field_num_desc(struct rnode *);
+int order_tree_canonical(struct rooted_tree *, struct canonical_hash *hash);
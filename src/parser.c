@@ -76,6 +76,8 @@ struct rooted_tree *parse_tree()
 		tree->root = root;
 		tree->nodes_in_order = nodes_in_order;
 		tree->type = TREE_TYPE_UNKNOWN; 
+		tree->stats = NULL;
+		tree->attrs = NULL;
 		return tree;
 	} else {
 		free(tree);
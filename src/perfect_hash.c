@@ -0,0 +1,249 @@
+/* 
+
+Copyright (c) 2009 Thomas Junier and Evgeny Zdobnov, University of Geneva
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+* Neither the name of the University of Geneva nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+
+#include "perfect_hash.h"
+
+/* Average number of keys per bucket. Larger buckets mean fewer seeds to
+ * store, but longer searches for them. */
+
+static const unsigned int BUCKET_SIZE = 4;
+
+/* A seed is always found well before this, unless two keys have the same
+ * hash (which is checked beforehand). */
+
+static const unsigned int MAX_SEED = 1 << 24;
+
+/* The finalizer of the SplitMix64 generator, as in topology_hash.c */
+
+static uint64_t mix64(uint64_t x)
+{
+	x ^= x >> 30;
+	x *= 0xbf58476d1ce4e5b9ULL;
+	x ^= x >> 27;
+	x *= 0x94d049bb133111ebULL;
+	x ^= x >> 31;
+	return x;
+}
+
+/* FNV-1a, followed by a mix. This is the only pass over the key (apart from
+ * the final strcmp()): both the bucket and the slot are derived from it. */
+
+static uint64_t key_hash(const char *key)
+{
+	uint64_t h = 0xcbf29ce484222325ULL;
+	for (; '\0' != *key; key++) {
+		h ^= (unsigned char) *key;
+		h *= 0x100000001b3ULL;
+	}
+	return mix64(h);
+}
+
+static unsigned int bucket_of(uint64_t h, unsigned int nb_buckets)
+{
+	return (unsigned int) ((h >> 32) % nb_buckets);
+}
+
+static unsigned int slot_of(uint64_t h, unsigned int seed,
+		unsigned int nb_slots)
+{
+	return (unsigned int) (mix64(h ^ (seed * 0x9e3779b97f4a7c15ULL)) %
+			nb_slots);
+}
+
+/* Slots are marked as taken in a bitmap, which is much smaller than the
+ * array of keys, and so stays in cache during the search for seeds. */
+
+static int is_taken(const uint64_t *taken, unsigned int slot)
+{
+	return (taken[slot / 64] >> (slot % 64)) & 1;
+}
+
+/* Tries to place the 'size' keys whose hashes are 'hashes' with 'seed'. On
+ * success, stores their slots in 'slots'. */
+
+static int try_seed(struct perfect_hash *ph, const uint64_t *taken,
+		uint64_t *hashes, unsigned int *members, unsigned int size,
+		unsigned int seed, unsigned int *slots)
+{
+	unsigned int i, j;
+	for (i = 0; i < size; i++) {
+		slots[i] = slot_of(hashes[members[i]], seed, ph->nb_slots);
+		if (is_taken(taken, slots[i])) return 0;
+		for (j = 0; j < i; j++)
+			if (slots[j] == slots[i]) return 0;
+	}
+	return 1;
+}
+
+/* Places the keys of one bucket: finds a seed, and fills the slots. */
+
+static int place_bucket(struct perfect_hash *ph, uint64_t *taken,
+		const char **keys, void **values, uint64_t *hashes,
+		unsigned int *members, unsigned int size, unsigned int bucket,
+		unsigned int *slots)
+{
+	unsigned int i, j, seed;
+
+	/* Keys with the same hash can never be separated */
+	for (i = 0; i < size; i++)
+		for (j = 0; j < i; j++)
+			if (hashes[members[i]] == hashes[members[j]]) {
+				errno = EINVAL;
+				return 0;
+			}
+
+	for (seed = 0; seed < MAX_SEED; seed++)
+		if (try_seed(ph, taken, hashes, members, size, seed, slots))
+			break;
+	if (MAX_SEED == seed) { errno = EINVAL; return 0; }
+
+	ph->seeds[bucket] = seed;
+	for (i = 0; i < size; i++) {
+		taken[slots[i] / 64] |= (uint64_t) 1 << (slots[i] % 64);
+		ph->keys[slots[i]] = keys[members[i]];
+		ph->values[slots[i]] = values[members[i]];
+	}
+	return 1;
+}
+
+/* Spreads the keys into buckets and places them, bucket by bucket. The work
+ * arrays are allocated by the caller (see create_perfect_hash()), except
+ * those whose size is only known here. Returns 0 on failure. */
+
+static int place_keys(struct perfect_hash *ph, const char **keys,
+		void **values, unsigned int n, uint64_t *hashes,
+		unsigned int *start, unsigned int *members, unsigned int *fill,
+		unsigned int *order)
+{
+	unsigned int i, b;
+	for (i = 0; i < n; i++) {
+		hashes[i] = key_hash(keys[i]);
+		start[bucket_of(hashes[i], ph->nb_buckets) + 1]++;
+	}
+	unsigned int max_size = 0;
+	for (b = 0; b < ph->nb_buckets; b++) {
+		if (start[b+1] > max_size) max_size = start[b+1];
+		start[b+1] += start[b];
+	}
+	for (i = 0; i < n; i++) {
+		b = bucket_of(hashes[i], ph->nb_buckets);
+		members[start[b] + fill[b]++] = i;
+	}
+
+	/* Largest buckets first (counting sort on the sizes), while there
+	 * are still many free slots */
+	unsigned int *count = calloc(max_size + 2, sizeof(unsigned int));
+	unsigned int *slots = malloc((max_size + 1) * sizeof(unsigned int));
+	uint64_t *taken = calloc(ph->nb_slots / 64 + 1, sizeof(uint64_t));
+	int status = NULL != count && NULL != slots && NULL != taken;
+	if (! status) {
+		free(count);
+		free(slots);
+		free(taken);
+		return 0;
+	}
+	for (b = 0; b < ph->nb_buckets; b++)
+		count[max_size - fill[b] + 1]++;
+	for (i = 1; i <= max_size + 1; i++)
+		count[i] += count[i-1];
+	for (b = 0; b < ph->nb_buckets; b++)
+		order[count[max_size - fill[b]]++] = b;
+
+	for (i = 0; i < ph->nb_buckets && status; i++) {
+		b = order[i];
+		if (0 == fill[b]) break;	/* and so are all the others */
+		status = place_bucket(ph, taken, keys, values, hashes,
+				members + start[b], fill[b], b, slots);
+	}
+
+	free(count);
+	free(slots);
+	free(taken);
+	return status;
+}
+
+struct perfect_hash *create_perfect_hash(const char **keys, void **values,
+		unsigned int n)
+{
+	struct perfect_hash *ph = malloc(sizeof(struct perfect_hash));
+	if (NULL == ph) return NULL;
+	ph->nb_buckets = n / BUCKET_SIZE + 1;
+	ph->nb_slots = n + n / 4 + 1;	/* a load of 0.8 */
+	ph->seeds = calloc(ph->nb_buckets, sizeof(unsigned int));
+	ph->keys = calloc(ph->nb_slots, sizeof(char *));
+	ph->values = calloc(ph->nb_slots, sizeof(void *));
+
+	uint64_t *hashes = malloc((n + 1) * sizeof(uint64_t));	/* n may be 0 */
+	/* bucket b's keys are members[start[b]] .. members[start[b+1] - 1] */
+	unsigned int *start = calloc(ph->nb_buckets + 1, sizeof(unsigned int));
+	unsigned int *members = malloc((n + 1) * sizeof(unsigned int));
+	unsigned int *fill = calloc(ph->nb_buckets, sizeof(unsigned int));
+	unsigned int *order = malloc(ph->nb_buckets * sizeof(unsigned int));
+
+	int status = NULL != ph->seeds && NULL != ph->keys &&
+		NULL != ph->values && NULL != hashes && NULL != start &&
+		NULL != members && NULL != fill && NULL != order;
+	if (status)
+		status = place_keys(ph, keys, values, n, hashes, start,
+				members, fill, order);
+
+	free(hashes);
+	free(start);
+	free(members);
+	free(fill);
+	free(order);
+	if (! status) {
+		destroy_perfect_hash(ph);
+		return NULL;
+	}
+	return ph;
+}
+
+void *perfect_hash_get(struct perfect_hash *ph, const char *key)
+{
+	uint64_t h = key_hash(key);
+	unsigned int seed = ph->seeds[bucket_of(h, ph->nb_buckets)];
+	unsigned int slot = slot_of(h, seed, ph->nb_slots);
+	const char *slot_key = ph->keys[slot];
+	if (NULL == slot_key || 0 != strcmp(slot_key, key)) return NULL;
+	return ph->values[slot];
+}
+
+void destroy_perfect_hash(struct perfect_hash *ph)
+{
+	free(ph->seeds);
+	free(ph->keys);
+	free(ph->values);
+	free(ph);
+}
@@ -0,0 +1,62 @@
+/* 
+
+Copyright (c) 2009 Thomas Junier and Evgeny Zdobnov, University of Geneva
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+* Neither the name of the University of Geneva nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+/* A static (read-only) hash table keyed by strings, built once from a known
+ * set of keys. It is "perfect": each key has its own slot, found by
+ * computing two hash functions, so a lookup costs one pass over the key and
+ * at most one strcmp(), whatever the number of keys. This is the "hash and
+ * displace" method: keys are first spread into small buckets, then for each
+ * bucket (largest first) a seed is found that sends all its keys to free
+ * slots. Only the seeds need to be stored. */
+
+struct perfect_hash {
+	unsigned int nb_buckets;
+	unsigned int nb_slots;
+	unsigned int *seeds;	/**< one per bucket */
+	const char **keys;	/**< one per slot (NULL if free) */
+	void **values;		/**< one per slot */
+};
+
+/* Builds a perfect hash for the 'n' keys in 'keys', with the corresponding
+ * 'values'. The keys must be distinct. Keys and values are NOT copied, so
+ * they must outlive the hash. */
+/* Returns NULL in case of malloc() problems, or if the keys are not distinct
+ * (in which case errno is set to EINVAL). */
+
+struct perfect_hash *create_perfect_hash(const char **keys, void **values,
+		unsigned int n);
+
+/* Returns the value for 'key', or NULL if 'key' is not in the hash. */
+
+void *perfect_hash_get(struct perfect_hash *, const char *key);
+
+/* Does not free the keys and values. Also frees partially built hashes (see
+ * create_perfect_hash()). */
+
+void destroy_perfect_hash(struct perfect_hash *);
@@ -0,0 +1,416 @@
+/* 
+
+Copyright (c) 2009 Thomas Junier and Evgeny Zdobnov, University of Geneva
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+* Neither the name of the University of Geneva nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "pipeline.h"
+#include "parser.h"
+#include "common.h"
+
+void newick_scanner_set_string_input(char *);
+void newick_scanner_clear_string_input();
+
+/* A batch is sent off as soon as it holds at least this many bytes (and
+ * whole trees only). */
+
+static const size_t BATCH_SIZE = 1 << 16;
+static const size_t READ_SIZE = 1 << 16;
+
+/* Ends a worker's output for a batch. Newick output never contains it. */
+
+static const char END_OF_BATCH = '\0';
+
+struct worker {
+	pid_t pid;
+	int input;	/**< batches are written here */
+	FILE *output;	/**< and their output is read from here */
+	bool exited;	/**< already waited for */
+};
+
+/* Reads whole trees from the input: a tree ends with a ';' that is not in a
+ * quoted label or a comment. */
+
+struct tree_reader {
+	FILE *input;
+	char *buffer;
+	size_t size;	/**< allocated */
+	size_t length;	/**< used */
+	size_t scanned;	/**< bytes already looked at */
+	size_t tree_end;	/**< just after the last complete tree */
+	int line;	/**< number of lines before the buffer */
+	bool in_quotes;
+	bool in_comment;
+	bool eof;
+};
+
+static bool write_all(int fd, const void *data, size_t length)
+{
+	const char *p = data;
+	while (length > 0) {
+		ssize_t n = write(fd, p, length);
+		if (n < 0) {
+			if (EINTR == errno) continue;
+			return false;
+		}
+		p += n;
+		length -= n;
+	}
+	return true;
+}
+
+/* Returns false on error, and at end of file */
+
+static bool read_all(int fd, void *data, size_t length)
+{
+	char *p = data;
+	while (length > 0) {
+		ssize_t n = read(fd, p, length);
+		if (n < 0 && EINTR == errno) continue;
+		if (n <= 0) return false;
+		p += n;
+		length -= n;
+	}
+	return true;
+}
+
+/* Sets '*length' to the length of the next batch, which starts at the
+ * beginning of the reader's buffer - 0 means that the input is exhausted.
+ * The last batch gets whatever follows the last tree, so that the worker can
+ * complain about it. Returns FAILURE on read or malloc() error. */
+
+static int next_batch(struct tree_reader *reader, size_t *length)
+{
+	for (;;) {
+		for (; reader->scanned < reader->length; reader->scanned++) {
+			char c = reader->buffer[reader->scanned];
+			if (reader->in_quotes) {
+				if ('\'' == c) reader->in_quotes = false;
+			} else if (reader->in_comment) {
+				if (']' == c) reader->in_comment = false;
+			} else if ('\'' == c) {
+				reader->in_quotes = true;
+			} else if ('[' == c) {
+				reader->in_comment = true;
+			} else if (';' == c) {
+				reader->tree_end = reader->scanned + 1;
+				if (reader->tree_end >= BATCH_SIZE) {
+					reader->scanned++;
+					*length = reader->tree_end;
+					return SUCCESS;
+				}
+			}
+		}
+		if (reader->eof) {
+			*length = reader->length;
+			return SUCCESS;
+		}
+		if (reader->size - reader->length < READ_SIZE) {
+			size_t new_size = 2 * reader->size + READ_SIZE;
+			char *new_buffer = realloc(reader->buffer, new_size);
+			if (NULL == new_buffer) return FAILURE;
+			reader->buffer = new_buffer;
+			reader->size = new_size;
+		}
+		size_t nread = fread(reader->buffer + reader->length, 1,
+				READ_SIZE, reader->input);
+		if (0 == nread) {
+			if (ferror(reader->input)) return FAILURE;
+			reader->eof = true;
+		}
+		reader->length += nread;
+	}
+}
+
+/* Drops the first 'length' bytes (a batch that has been sent) */
+
+static void consume(struct tree_reader *reader, size_t length)
+{
+	char *p = reader->buffer, *end = reader->buffer + length;
+	while (NULL != (p = memchr(p, '\n', end - p))) {
+		reader->line++;
+		p++;
+	}
+	memmove(reader->buffer, reader->buffer + length,
+			reader->length - length);
+	reader->length -= length;
+	reader->scanned -= length;
+	reader->tree_end = 0;
+}
+
+static bool process_all_trees(void (*process_tree)(struct rooted_tree *,
+			void *), void *arg)
+{
+	struct rooted_tree *tree;
+	while (NULL != (tree = parse_tree()))
+		process_tree(tree, arg);
+	return PARSER_STATUS_MALLOC_ERROR != newick_parser_status;
+}
+
+/* A worker's life: parse and process batches until there are no more, or
+ * until a tree can't be parsed. Does not return. */
+
+static void run_worker(int input,
+		void (*process_tree)(struct rooted_tree *, void *), void *arg)
+{
+	extern int lineno;	/* for the parser's error messages */
+	size_t length;
+	while (read_all(input, &length, sizeof(length))) {
+		if (! read_all(input, &lineno, sizeof(lineno))) {
+			perror(NULL);
+			exit(EXIT_FAILURE);
+		}
+		char *batch = malloc(length + 1);
+		if (NULL == batch) { perror(NULL); exit(EXIT_FAILURE); }
+		if (! read_all(input, batch, length)) {
+			perror(NULL);
+			exit(EXIT_FAILURE);
+		}
+		batch[length] = '\0';
+
+		/* Not all parse errors set the status, but the end of the
+		 * input always does. */
+		newick_parser_status = PARSER_STATUS_OK;
+		newick_scanner_set_string_input(batch);
+		if (! process_all_trees(process_tree, arg)) {
+			perror(NULL);
+			exit(EXIT_FAILURE);
+		}
+		newick_scanner_clear_string_input();
+		free(batch);
+		/* A parse error ends the run, as it does in the usual loop;
+		 * the output so far is still printed. */
+		if (PARSER_STATUS_EMPTY != newick_parser_status)
+			exit(EXIT_SUCCESS);
+
+		putchar(END_OF_BATCH);
+		fflush(stdout);
+	}
+	exit(EXIT_SUCCESS);
+}
+
+/* Copies the output of the worker's current batch to stdout. Returns false if
+ * the worker stopped before the end of the batch. */
+
+static bool print_batch_output(struct worker *worker, char **line,
+		size_t *line_size)
+{
+	ssize_t n = getdelim(line, line_size, END_OF_BATCH, worker->output);
+	if (n <= 0) return false;
+	bool complete = END_OF_BATCH == (*line)[n - 1];
+	fwrite(*line, 1, complete ? n - 1 : n, stdout);
+	return complete;
+}
+
+static bool start_workers(struct worker *workers, int nb_workers,
+		void (*process_tree)(struct rooted_tree *, void *), void *arg)
+{
+	/* or the child would print it, too */
+	fflush(stdout);
+
+	int w;
+	for (w = 0; w < nb_workers; w++) {
+		int to_worker[2], from_worker[2];
+		if (0 != pipe(to_worker) || 0 != pipe(from_worker))
+			return false;
+		pid_t pid = fork();
+		if (pid < 0) return false;
+		if (0 == pid) {
+			int i;
+			for (i = 0; i < w; i++) {
+				close(workers[i].input);
+				fclose(workers[i].output);
+			}
+			close(to_worker[1]);
+			close(from_worker[0]);
+			if (dup2(from_worker[1], STDOUT_FILENO) < 0) {
+				perror(NULL);
+				exit(EXIT_FAILURE);
+			}
+			close(from_worker[1]);
+			run_worker(to_worker[0], process_tree, arg);
+		}
+		close(to_worker[0]);
+		close(from_worker[1]);
+		workers[w].pid = pid;
+		workers[w].exited = false;
+		workers[w].input = to_worker[1];
+		workers[w].output = fdopen(from_worker[0], "r");
+		if (NULL == workers[w].output) return false;
+	}
+	return true;
+}
+
+/* Waits for all workers; if 'kill_them' is true, they are stopped first.
+ * Returns false if any worker failed. */
+
+static bool stop_workers(struct worker *workers, int nb_workers,
+		bool kill_them)
+{
+	bool ok = true;
+	int w;
+	for (w = 0; w < nb_workers; w++) {
+		if (workers[w].input >= 0) close(workers[w].input);
+		if (kill_them && ! workers[w].exited)
+			kill(workers[w].pid, SIGTERM);
+	}
+	for (w = 0; w < nb_workers; w++) {
+		int status;
+		if (! workers[w].exited) {
+			if (waitpid(workers[w].pid, &status, 0) < 0)
+				ok = false;
+			else if (! kill_them && (! WIFEXITED(status) ||
+					EXIT_SUCCESS != WEXITSTATUS(status)))
+				ok = false;
+		}
+		fclose(workers[w].output);
+	}
+	return ok;
+}
+
+/* Waits for a worker that stopped before the end of its batch: it either
+ * met a parse error (and exited normally) or failed. */
+
+static bool worker_failed(struct worker *worker)
+{
+	int status;
+	if (waitpid(worker->pid, &status, 0) < 0) return true;
+	worker->exited = true;
+	return ! WIFEXITED(status) || EXIT_SUCCESS != WEXITSTATUS(status);
+}
+
+int run_tree_pipeline(int nb_workers,
+		void (*process_tree)(struct rooted_tree *, void *),
+		void *arg)
+{
+	if (nb_workers <= 1) {
+		if (process_all_trees(process_tree, arg)) return SUCCESS;
+		perror(NULL);
+		return FAILURE;
+	}
+
+	extern FILE *nwsin;
+	struct tree_reader reader;
+	reader.input = (NULL == nwsin) ? stdin : nwsin;
+	reader.buffer = NULL;
+	reader.size = reader.length = reader.scanned = reader.tree_end = 0;
+	reader.line = 0;
+	reader.in_quotes = reader.in_comment = reader.eof = false;
+
+	struct worker *workers = malloc(nb_workers * sizeof(struct worker));
+	if (NULL == workers || ! start_workers(workers, nb_workers,
+				process_tree, arg)) {
+		perror(NULL);
+		return FAILURE;
+	}
+	/* A worker that has stopped is noticed when its output is read, not
+	 * when writing to it fails. */
+	signal(SIGPIPE, SIG_IGN);
+
+	char *line = NULL;
+	size_t line_size = 0;
+	/* batch i goes to worker i % nb_workers */
+	long nb_sent = 0, nb_printed = 0;
+	size_t length;
+	int result = SUCCESS;
+	bool stopped = false;
+	for (;;) {
+		if (! next_batch(&reader, &length)) {
+			perror(NULL);
+			result = FAILURE;
+			stopped = true;
+			break;
+		}
+		if (0 == length) break;
+		struct worker *worker = workers + nb_sent % nb_workers;
+		/* The worker's previous batch is the oldest one */
+		if (nb_sent - nb_printed == nb_workers) {
+			if (! print_batch_output(worker, &line, &line_size)) {
+				if (worker_failed(worker)) result = FAILURE;
+				stopped = true;
+				break;
+			}
+			nb_printed++;
+		}
+		write_all(worker->input, &length, sizeof(length));
+		write_all(worker->input, &reader.line, sizeof(reader.line));
+		write_all(worker->input, reader.buffer, length);
+		nb_sent++;
+		consume(&reader, length);
+	}
+
+	if (! stopped) {
+		/* no more batches: workers exit once they're done */
+		int w;
+		for (w = 0; w < nb_workers; w++) {
+			close(workers[w].input);
+			workers[w].input = -1;
+		}
+		for (; nb_printed < nb_sent; nb_printed++) {
+			struct worker *worker = workers +
+				nb_printed % nb_workers;
+			if (! print_batch_output(worker, &line, &line_size)) {
+				if (worker_failed(worker)) result = FAILURE;
+				stopped = true;
+				break;
+			}
+		}
+	}
+	fflush(stdout);
+	if (! stop_workers(workers, nb_workers, stopped))
+		result = FAILURE;
+	signal(SIGPIPE, SIG_DFL);
+
+	free(line);
+	free(reader.buffer);
+	free(workers);
+	return result;
+}
+
+int parse_nb_workers(const char *arg)
+{
+	char *end;
+	long nb_workers = strtol(arg, &end, 10);
+	if (end == arg || '\0' != *end || nb_workers < 1 ||
+			nb_workers > INT_MAX) {
+		fprintf(stderr, "Number of processes must be at least 1.\n");
+		exit(EXIT_FAILURE);
+	}
+	return nb_workers;
+}
@@ -0,0 +1,59 @@
+/* 
+
+Copyright (c) 2009 Thomas Junier and Evgeny Zdobnov, University of Geneva
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+* Neither the name of the University of Geneva nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+/* Running a per-tree filter on several processors. Most programs handle each
+ * tree on its own: they parse it, change it, print it, and forget it. The
+ * parser and the node allocator keep global state, so rather than threads
+ * this uses worker processes, each with its own parser and allocator. The
+ * calling process reads the input, cuts it into batches of whole trees, hands
+ * the batches out to the workers in turn, and prints their output in input
+ * order. */
+
+struct rooted_tree;
+
+/* Calls 'process_tree' on each tree of the parser's input (see parser.h),
+ * with 'arg' as second argument. 'process_tree' owns the tree: it prints
+ * what it has to print on stdout, and frees the tree and its nodes.
+ *
+ * With 'nb_workers' > 1, the trees are processed in that many worker
+ * processes, forked after this is called (so they see the same parameters,
+ * and any data read before); otherwise the usual loop runs in the calling
+ * process. Either way, the output comes in input order, and processing stops
+ * at the first tree that cannot be parsed. Returns FAILURE if a worker
+ * exited with an error, or in case of system errors; in both cases, an error
+ * message has been printed. */
+
+int run_tree_pipeline(int nb_workers,
+		void (*process_tree)(struct rooted_tree *, void *),
+		void *arg);
+
+/* Parses the argument of option -j, the number of worker processes. Prints an
+ * error message and exits unless it is a whole number of at least 1. */
+
+int parse_nb_workers(const char *arg);
@@ -45,16 +45,17 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "set.h"
 #include "list.h"
 #include "readline.h"
+#include "tree_stats.h"
+#include "masprintf.h"
+#include "lca.h"
+#include "label_set.h"
 
-enum prune_mode { PRUNE_DIRECT, PRUNE_REVERSE };
+enum prune_mode { PRUNE_DIRECT, PRUNE_REVERSE, PRUNE_SETS };
 enum label_source { COMMAND_LINE, IN_FILE }; /* can't use FILE... */
 
-struct prune_data {
-	bool kept_descendant;
-};
-
 struct parameters {
 	set_t 	*prune_labels;
+	struct llist *taxon_sets;	/* of struct label_set; -s only */
 	enum prune_mode mode;
 	enum label_source lbl_src;
 };
@@ -68,6 +69,7 @@ void help(char *argv[])
 "--------\n"
 "\n"
 "%s [-f:hv] <newick trees filename|-> <label> [label+]\n"
+"%s -s <newick trees filename|-> <taxon sets filename>\n"
 "\n"
 "Input\n"
 "-----\n"
@@ -94,6 +96,16 @@ void help(char *argv[])
 "        There should be one label per line, and no leading or trailing\n"
 "        whitespace.\n"
 "    -h: print this message and exit\n"
+"    -s: induced subtrees - the second argument is the name of a file with\n"
+"        one set of labels per line (separated by whitespace). For each\n"
+"        tree and each set, prints the subtree induced by the nodes with\n"
+"        these labels: it has just these nodes and their LCAs, and the\n"
+"        edges between them span the paths in the tree. This is like -v with\n"
+"        leaf labels, except that nodes with a single child are always\n"
+"        spliced out. The tree is read and indexed only once for all the\n"
+"        sets, so this is much faster than running -v once per set. Empty\n"
+"        lines and lines starting with '#' are skipped; a set none of whose\n"
+"        labels are found yields an empty tree (';').\n"
 "    -v: reverse: prune nodes whose labels are NOT passed on the command\n"
 "        line. Inner nodes are not pruned. This allows pruning of trees\n"
 "        with support values, which syntactically are node labels, withouti\n"
@@ -121,7 +133,12 @@ void help(char *argv[])
 "$ %s -v data/catarrhini Gorilla Pan Homo Pongo Simias Colobus\n"
 "\n"
 "# same, using clade labels:\n"
-"$ %s -v data/catarrhini Hominidae Colobinae\n",
+"$ %s -v data/catarrhini Hominidae Colobinae\n"
+"\n"
+"# one subtree per gene family's taxon set:\n"
+"$ %s -s species_tree.nw family_taxa.txt\n",
+	argv[0],
+	argv[0],
 	argv[0],
 	argv[0],
 	argv[0],
@@ -135,13 +152,14 @@ struct parameters get_params(int argc, char *argv[])
 {
 	const char *USAGE =
 "Usage: nw_prune [-hv] <filename|-> <label> [label+]\n"
-"or     nw_prune [-hv] -f <filename|-> <label_filename>";
+"or     nw_prune [-hv] -f <filename|-> <label_filename>\n"
+"or     nw_prune -s <filename|-> <taxon_sets_filename>\n";
 	struct parameters params;
 	params.mode = PRUNE_DIRECT;
 	params.lbl_src = COMMAND_LINE;
 
 	int opt_char;
-	while ((opt_char = getopt(argc, argv, "fhv")) != -1) {
+	while ((opt_char = getopt(argc, argv, "fhsv")) != -1) {
 		switch (opt_char) {
 		case 'f':
 			params.lbl_src = IN_FILE;
@@ -149,6 +167,9 @@ struct parameters get_params(int argc, char *argv[])
 		case 'h':
 			help(argv);
 			exit (EXIT_SUCCESS);
+		case 's':
+			params.mode = PRUNE_SETS;
+			break;
 		case 'v':
 			params.mode = PRUNE_REVERSE;
 			break;
@@ -181,7 +202,19 @@ struct parameters get_params(int argc, char *argv[])
 	if (NULL == prune_labels) { perror(NULL); exit(EXIT_FAILURE); }
 
 	optind++;	
-	if (COMMAND_LINE == params.lbl_src) {
+	params.taxon_sets = NULL;
+	if (PRUNE_SETS == params.mode) {
+		if ((argc - optind) != 1) {
+			fprintf(stderr, USAGE);
+			exit(EXIT_FAILURE);
+		}
+		params.taxon_sets = read_label_sets(argv[optind]);
+		if (NULL == params.taxon_sets) {
+			fprintf(stderr, "%s: ", argv[optind]);
+			perror(NULL);
+			exit(EXIT_FAILURE);
+		}
+	} else if (COMMAND_LINE == params.lbl_src) {
 		/* optind is now index of 1st label */
 		if ((argc - optind) < 1) {
 			fprintf(stderr, USAGE);
@@ -236,122 +269,360 @@ struct parameters get_params(int argc, char *argv[])
 	return params;
 }
 
-/* We buld a hash of the passed labels, and visit the tree, unlinking nodes as
- * needed. In Direct mode, we traverse in reverse order, unlinking nodes to
- * prune. In Reverse mode, things are a bit more hairy because we need to keep
- * not just the nodes passed as argument, but also their ancestors. So we pass
- * through th etree first in direct order, marking nodes to keep and their
- * ancestors. Then we go back in reverse order, pruning. */
+/* Both modes work the same way: we mark the nodes to remove (together with
+ * their subtrees) in a bitmap indexed by node, then compute what is left in
+ * a single post-order pass, relinking the remaining nodes in place. A node
+ * that is left with a single child (of several) is replaced by that child,
+ * whose edge then spans the whole chain: these lengths are summed as numbers
+ * and only turned back into a string once, at the end. A node that loses all
+ * its children disappears as well - unless it had just one, in which case it
+ * becomes a leaf (this is what successive unlink_rnode() calls would do). */
+
+struct prune_state {
+	/* by node index */
+	bool *removed;		/* node and subtree are to be removed */
+	struct rnode **stand_in; /* what replaces the node, NULL if none */
+	double *length;		/* summed length of a merged chain... */
+	bool *has_length;	/* ...and whether any of its edges had one */
+	bool *merged;		/* true iff the above are in use */
+};
 
-static struct rooted_tree * process_tree_direct(
-		struct rooted_tree *tree, set_t *prune_labels)
+static void merge_length(struct prune_state *state, struct rnode *from,
+		struct rnode *into)
 {
-	struct llist *rev_nodes = llist_reverse(tree->nodes_in_order);
-	struct list_elem *el;
-	struct rnode *current;
-	char *label;
-
-	for (el = rev_nodes->head; NULL != el; el = el->next) {
-		current = el->data;
-		label = current->label;
-		/* skip this node iff parent is marked ("seen") */
-		if (!is_root(current) && current->parent->seen) {
-			current->seen = true;	/* inherit mark */
-			continue;
+	int i = into->index;
+	if (! state->merged[i]) {
+		state->merged[i] = true;
+		state->length[i] = atof(into->edge_length_as_string);
+		state->has_length[i] = ('\0' != into->edge_length_as_string[0]);
+	}
+	state->length[i] += atof(from->edge_length_as_string);
+	if ('\0' != from->edge_length_as_string[0])
+		state->has_length[i] = true;
+}
+
+/* Relinks 'node' to the stand-ins of its children (in order), and returns
+ * how many there are. */
+
+static int relink_children(struct prune_state *state, struct rnode *node)
+{
+	struct rnode *kid, *next;
+	struct rnode *first = NULL, *last = NULL;
+	int count = 0;
+
+	if (is_leaf(node)) return 0;
+	for (kid = node->first_child; NULL != kid; kid = next) {
+		next = (kid == node->last_child) ? NULL : kid->next_sibling;
+		struct rnode *stand_in = state->stand_in[kid->index];
+		if (NULL == stand_in) continue;
+		stand_in->parent = node;
+		if (NULL == first)
+			first = stand_in;
+		else
+			last->next_sibling = stand_in;
+		last = stand_in;
+		count++;
+	}
+	if (NULL != last) last->next_sibling = NULL;
+	node->first_child = first;
+	node->last_child = last;
+	node->child_count = count;
+
+	return count;
+}
+
+/* Removes the nodes marked in 'state->removed' (which must be false for the
+ * root). If 'splice_root' is true, a root left with a single child is
+ * replaced by it, too. */
+
+static void bulk_prune(struct rooted_tree *tree, struct tree_stats *stats,
+		struct prune_state *state, bool splice_root)
+{
+	int i;
+	for (i = 0; i < stats->nb_nodes; i++) {
+		struct rnode *node = stats->nodes[i];
+		state->stand_in[i] = NULL;
+		if (state->removed[i]) continue;
+		int orig_count = node->child_count;
+		int count = relink_children(state, node);
+		if (orig_count < 2 || count >= 2) {
+			state->stand_in[i] = node;
+		} else if (1 == count) {
+			if (is_root(node) && ! splice_root) continue;
+			struct rnode *kid = node->first_child;
+			merge_length(state, node, kid);
+			state->stand_in[i] = kid;
+			if (is_root(node)) {
+				kid->parent = NULL;
+				kid->next_sibling = NULL;
+				tree->root = kid;
+			}
 		}
-		if (set_has_element(prune_labels, label)) {
-			unlink_rnode(current);
-			current->seen = true;
+		/* else the node lost all its children (and has no stand-in,
+		 * unless it is the root) */
+	}
+
+	struct llist *nodes_in_order = get_nodes_in_order(tree->root);
+	if (NULL == nodes_in_order) { perror(NULL); exit(EXIT_FAILURE); }
+	struct list_elem *el;
+	for (el = nodes_in_order->head; NULL != el; el = el->next) {
+		struct rnode *node = el->data;
+		if (! state->merged[node->index]) continue;
+		free(node->edge_length_as_string);
+		if (state->has_length[node->index])
+			node->edge_length_as_string = masprintf("%g",
+					state->length[node->index]);
+		else
+			node->edge_length_as_string = strdup("");
+		if (NULL == node->edge_length_as_string) {
+			perror(NULL);
+			exit(EXIT_FAILURE);
 		}
 	}
+	destroy_llist(tree->nodes_in_order);
+	tree->nodes_in_order = nodes_in_order;
+	invalidate_tree_stats(tree);
+}
+
+static struct prune_state *create_prune_state(int nb_nodes)
+{
+	struct prune_state *state = malloc(sizeof(struct prune_state));
+	if (NULL == state) return NULL;
+	state->removed = calloc(nb_nodes, sizeof(bool));
+	state->stand_in = malloc(nb_nodes * sizeof(struct rnode *));
+	state->length = malloc(nb_nodes * sizeof(double));
+	state->has_length = malloc(nb_nodes * sizeof(bool));
+	state->merged = calloc(nb_nodes, sizeof(bool));
+	if (NULL == state->removed || NULL == state->stand_in ||
+	    NULL == state->length || NULL == state->has_length ||
+	    NULL == state->merged)
+		return NULL;
+	return state;
+}
+
+static void destroy_prune_state(struct prune_state *state)
+{
+	free(state->removed);
+	free(state->stand_in);
+	free(state->length);
+	free(state->has_length);
+	free(state->merged);
+	free(state);
+}
+
+/* Direct mode: remove the nodes whose labels were passed (the root is never
+ * removed, and is not spliced out either). */
+
+static struct rooted_tree * process_tree_direct(
+		struct rooted_tree *tree, set_t *prune_labels)
+{
+	struct tree_stats *stats = get_tree_stats(tree);
+	if (NULL == stats) { perror(NULL); exit(EXIT_FAILURE); }
+	struct prune_state *state = create_prune_state(stats->nb_nodes);
+	if (NULL == state) { perror(NULL); exit(EXIT_FAILURE); }
+
+	int i;
+	for (i = 0; i < stats->nb_nodes - 1; i++)	/* not the root */
+		state->removed[i] = set_has_element(prune_labels,
+				stats->nodes[i]->label);
+
+	bulk_prune(tree, stats, state, false);
+	destroy_prune_state(state);
+	return tree;
+}
+
+/* Reverse mode: keep the nodes whose labels were passed, their descendants,
+ * and their ancestors - the rest is removed. */
+
+static struct rooted_tree * process_tree_reverse(
+		struct rooted_tree *tree, set_t *prune_labels)
+{
+	struct tree_stats *stats = get_tree_stats(tree);
+	if (NULL == stats) { perror(NULL); exit(EXIT_FAILURE); }
+	int n = stats->nb_nodes;
+	struct prune_state *state = create_prune_state(n);
+	/* 'passed' means the label was passed, or an ancestor's was */
+	bool *passed = calloc(n, sizeof(bool));
+	bool *passed_below = calloc(n, sizeof(bool));
+	if (NULL == state || NULL == passed || NULL == passed_below) {
+		perror(NULL);
+		exit(EXIT_FAILURE);
+	}
+
+	/* The loops below skip the root: if its label was passed, the
+	 * whole tree is kept. */
+	passed[n - 1] = set_has_element(prune_labels, tree->root->label);
+
+	int i;
+	for (i = 0; i < n - 1; i++) {
+		struct rnode *node = stats->nodes[i];
+		if (set_has_element(prune_labels, node->label))
+			passed[i] = passed_below[i] = true;
+		if (passed_below[i])
+			passed_below[node->parent->index] = true;
+	}
+	for (i = n - 2; i >= 0; i--) {
+		struct rnode *node = stats->nodes[i];
+		if (passed[node->parent->index])
+			passed[i] = true;
+		state->removed[i] = ! (passed[i] || passed_below[i]);
+	}
+	free(passed);
+	free(passed_below);
 
-	destroy_llist(rev_nodes);
-	reset_seen(tree);
+	bulk_prune(tree, stats, state, true);
+	destroy_prune_state(state);
 	return tree;
 }
 
-/* Prune predicate: retains the nodes passed on CL, but discards their
- * children. */
+static int compare_ints(const void *a, const void *b)
+{
+	int ia = *(const int *) a, ib = *(const int *) b;
+	return (ia > ib) - (ia < ib);
+}
+
+/* Sorts and removes duplicates; returns the new count */
 
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wunused-parameter"
+static int sort_unique(int *values, int count)
+{
+	qsort(values, count, sizeof(int), compare_ints);
+	int i, j = 0;
+	for (i = 0; i < count; i++)
+		if (0 == j || values[i] != values[j - 1])
+			values[j++] = values[i];
+	return j;
+}
 
-// TODO: this might be a useful prune predicate, add option to use it.
+/* Prints the length of the edge from 'node' up to 'ancestor', which spans
+ * the whole path between them. */
 
-bool prune_predicate_trim_kids(struct rnode *node, void *param)
+static void print_path_length(struct label_set_index *tidx,
+		struct rnode *node, struct rnode *ancestor)
 {
-	if (node->seen) {
-		/* ancestor of a passed node */
-		return true;
+	if (node->parent == ancestor) {
+		if ('\0' != node->edge_length_as_string[0])
+			printf(":%s", node->edge_length_as_string);
+		return;
 	}
+	struct tree_stats *stats = tidx->stats;
+	int n = node->index;
+	int a = ancestor->index;
+	if (tidx->nb_lengths[n] > tidx->nb_lengths[a])
+		printf(":%g", stats->depth[n] - stats->depth[a]);
+}
 
-	return false;
+/* The root of the induced tree gets the length of the whole path up to the
+ * tree's root (as nw_prune -v does). */
+
+static void print_root_length(struct label_set_index *tidx,
+		struct rooted_tree *tree, struct rnode *node)
+{
+	char *root_length = tree->root->edge_length_as_string;
+	if (node == tree->root) {
+		if ('\0' != root_length[0]) printf(":%s", root_length);
+		return;
+	}
+	if (tidx->nb_lengths[node->index] > 0 || '\0' != root_length[0])
+		printf(":%g", tidx->stats->depth[node->index] +
+				atof(root_length));
 }
 
-/* Prune predicate: retains the nodes passed on CL and their children. */
+/* Prints the tree induced by a taxon set (the "virtual tree" of its nodes):
+ * sorting the nodes in pre-order and adding the LCAs of adjacent nodes gives
+ * all the induced tree's nodes, and then each one's parent is the LCA of it
+ * and the previous one. */
 
-bool prune_predicate_keep_clade(struct rnode *node, void *param)
+static void print_induced_subtree(struct rooted_tree *tree,
+		struct label_set_index *tidx, struct label_set *set)
 {
-	// TODO: is this used?
-	// set_t *prune_labels = (set_t *) param;
+	struct lca_index *lca = tidx->lca;
+	/* pre-order ranks, then parents (as positions in 'ranks') */
+	/* n labels induce at most 2n - 1 nodes; one more element keeps
+	 * empty sets from calling malloc(0) */
+	int max_nodes = 2 * set->nb_labels + 1;
+	int *ranks = malloc(max_nodes * sizeof(int));
+	int *parents = malloc(max_nodes * sizeof(int));
+	int *stack = malloc(max_nodes * sizeof(int));
+	bool *has_kids = malloc(max_nodes * sizeof(bool));
+	if (NULL == ranks || NULL == parents || NULL == stack ||
+			NULL == has_kids) {
+		perror(NULL);
+		exit(EXIT_FAILURE);
+	}
 
-	if (node->seen) {
-		return true;
+	int count = 0, i;
+	for (i = 0; i < set->nb_labels; i++) {
+		struct rnode *node = hash_get(tidx->label2node,
+				set->labels[i]);
+		if (NULL == node)
+			fprintf(stderr, "WARNING: label '%s' not found.\n",
+					set->labels[i]);
+		else
+			ranks[count++] = lca_index_rank(lca, node);
 	}
-	/* Node isn't an ancestor of a passed node. Node can be a _descendant_
-	 * of a passed node, though, in which case we must keep it as well. */
-	if (!is_root(node)) {
-		if (NULL != node->parent->data) {
-			struct prune_data *pdata = node->parent->data;
-			if (pdata->kept_descendant) {
-				struct prune_data *pdata =
-					malloc(sizeof(struct prune_data));
-				if (NULL == pdata) {
-					perror(NULL); exit(EXIT_FAILURE);
-				}
-				pdata->kept_descendant = true;
-				node->data = pdata;
-				return true;
+	count = sort_unique(ranks, count);
+	int nb_leaves = count;
+	for (i = 1; i < nb_leaves; i++)
+		ranks[count++] = lca_index_rank(lca, lca_index_query(lca,
+				lca->nodes[ranks[i - 1]], lca->nodes[ranks[i]]));
+	count = sort_unique(ranks, count);
+
+	/* Print in one pass over the nodes, in pre-order: a node's subtree
+	 * is complete when a node that is not in it comes up. */
+	int depth = 0;
+	for (i = 0; i < count; i++) {
+		struct rnode *node = lca->nodes[ranks[i]];
+		has_kids[i] = false;
+		if (i > 0) {
+			int parent_rank = lca_index_rank(lca, lca_index_query(
+					lca, lca->nodes[ranks[i - 1]], node));
+			int *p = bsearch(&parent_rank, ranks, i, sizeof(int),
+					compare_ints);
+			parents[i] = p - ranks;
+			while (stack[depth - 1] != parents[i]) {
+				int done = stack[--depth];
+				struct rnode *done_node = lca->nodes[ranks[done]];
+				if (has_kids[done]) putchar(')');
+				printf("%s", done_node->label);
+				print_path_length(tidx, done_node,
+					lca->nodes[ranks[parents[done]]]);
 			}
+			int parent = stack[depth - 1];
+			putchar(has_kids[parent] ? ',' : '(');
+			has_kids[parent] = true;
 		}
+		stack[depth++] = i;
 	}
-	
-	/* neither an ancestor nor a descendant of a passed node - drop. */
-	return false;
+	while (depth > 0) {
+		int done = stack[--depth];
+		struct rnode *done_node = lca->nodes[ranks[done]];
+		if (has_kids[done]) putchar(')');
+		printf("%s", done_node->label);
+		if (depth > 0)
+			print_path_length(tidx, done_node,
+				lca->nodes[ranks[parents[done]]]);
+		else
+			print_root_length(tidx, tree, done_node);
+	}
+	printf(";\n");
+
+	free(ranks);
+	free(parents);
+	free(stack);
+	free(has_kids);
 }
 
-static struct rooted_tree * process_tree_reverse(
-		struct rooted_tree *tree, set_t *prune_labels)
+static void process_tree_sets(struct rooted_tree *tree,
+		struct llist *taxon_sets)
 {
-	struct list_elem *el = tree->nodes_in_order->head;
-	struct rnode *current;
-	char *label;
-
-	for (; NULL != el; el = el->next) {
-		current = el->data;
-		if (is_root(current)) break;
-		label = current->label;
-		/* mark this node (to keep it) if its label is on the CL */
-		if (set_has_element(prune_labels, label)) {
-			current->seen = true;
-			struct prune_data *pdata =
-				malloc(sizeof(struct prune_data));
-			if (NULL == pdata) {perror(NULL); exit(EXIT_FAILURE); }
-			pdata->kept_descendant = true;
-			current->data = pdata;
-		}
-		/* and propagate 'seen' to parent (kept_descendant is
-		 * propagated to children (not parents), see
-		 * prune_predicate_keep_clade() */
-		if (current->seen) {
-			current->parent->seen = true;	/* inherit mark */
-		}
-	}
+	struct label_set_index *tidx = create_label_set_index(tree);
+	if (NULL == tidx) { perror(NULL); exit(EXIT_FAILURE); }
 
-	struct rooted_tree *pruned = clone_tree_cond(tree,
-			prune_predicate_keep_clade, prune_labels);	
-	destroy_tree(tree);
-	return pruned;
+	struct list_elem *el;
+	for (el = taxon_sets->head; NULL != el; el = el->next)
+		print_induced_subtree(tree, tidx, el->data);
+
+	destroy_label_set_index(tidx);
 }
 
 int main(int argc, char *argv[])
@@ -362,6 +633,17 @@ int main(int argc, char *argv[])
 	
 	params = get_params(argc, argv);
 
+	if (PRUNE_SETS == params.mode) {
+		while (NULL != (tree = parse_tree())) {
+			process_tree_sets(tree, params.taxon_sets);
+			destroy_all_rnodes(NULL);
+			destroy_tree(tree);
+		}
+		destroy_label_sets(params.taxon_sets);
+		destroy_set(params.prune_labels);
+		return 0;
+	}
+
 	switch (params.mode) {
 	case PRUNE_DIRECT:
 		process_tree = process_tree_direct;
@@ -385,4 +667,3 @@ int main(int argc, char *argv[])
 	return 0;
 }
 
-#pragma GCC diagnostic pop
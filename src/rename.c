@@ -34,6 +34,8 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <unistd.h>
 #include <assert.h>
 #include <stdbool.h>
+#include <ctype.h>
+#include <limits.h>
 
 #include "tree.h"
 #include "parser.h"
@@ -43,16 +45,25 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "rnode.h"
 #include "readline.h"
 #include "common.h"
+#include "pipeline.h"
+#include "perfect_hash.h"
+#include "label_rewriter.h"
 
 
 struct parameters {
-	/* Either uses a rename map (whose name is then stored in
-	 * map_filename), or gets the old and new labels from the command line.
-	 * This is determined from the number of arguments. */
+	/* Uses the maps passed with -m (if any), then either a rename map
+	 * (whose name is then stored in map_filename), or the old and new
+	 * labels from the command line. This is determined from the number of
+	 * arguments. The substitutions (-r) are applied after the maps. */
+	struct llist *map_filenames;	/* from -m */
 	char *map_filename;
 	char *old_label;
 	char *new_label;
 	bool only_leaves;
+	bool text_mode;
+	int nb_workers;
+	struct perfect_hash *rename_map;	/* composed maps, or NULL */
+	struct label_rewriter *rewriter;	/* from -r */
 };
 
 void help(char *argv[])
@@ -63,9 +74,16 @@ void help(char *argv[])
 "Synopsis\n"
 "--------\n"
 "\n"
-"%s [-hl] <newick trees filename|-> <map filename>\n"
+"%s [-hlt] [-j <processes>] [-m <map filename>]... [-r <substitution>]...\n"
+"    <newick trees filename|-> <map filename>\n"
 "or\n"
-"%s [-hl] <newick trees filename|-> <old-label> <new-label>\n"
+"%s [-hlt] [-j <processes>] [-m <map filename>]... [-r <substitution>]...\n"
+"    <newick trees filename|-> <old-label> <new-label>\n"
+"or\n"
+"%s [-hlt] [-j <processes>] [-m <map filename>]... [-r <substitution>]...\n"
+"    <newick trees filename|->\n"
+"\n"
+"(the last form needs at least one -m or -r option)\n"
 "\n"
 "Input\n"
 "-----\n"
@@ -91,15 +109,44 @@ void help(char *argv[])
 "requires a map file, while the second form requires no file but is limited\n"
 "to one label.\n"
 "\n"
+"Maps can also be passed with option -m, and labels can be rewritten by\n"
+"regular expression substitutions with option -r (see below), in which case\n"
+"the trees file may be the only argument.\n"
+"\n"
 "Output\n"
 "------\n"
 "\n"
 "Prints the tree, after replacing all old names by the specified new name.\n"
 "\n"
+"In text mode (-t), the trees are not parsed: the Newick text is copied as\n"
+"is (layout and comments included) except for the labels, which are\n"
+"rewritten as they are read. This is much faster, and takes the same memory\n"
+"whatever the size of the trees, but only nodes that have a label can be\n"
+"renamed, and the input is not checked.\n"
+"\n"
 "Options\n"
 "-------\n"
 "\n"
 "    -h: print this message and exit\n"
+"    -j <n>: process the trees in n processes (default: 1). The output is\n"
+"        the same, and in the same order.\n"
+"    -m <map filename>: first rename nodes using this map. This option can\n"
+"        be repeated: the maps are applied in order, then the map (or the\n"
+"        old and new labels) passed as arguments, if any. For example, if\n"
+"        the first map renames A to B and the second renames B to C, A is\n"
+"        renamed to C. The maps are combined before the trees are read, so\n"
+"        the number of maps makes no difference to the time spent per\n"
+"        tree.\n"
+"    -r <substitution>: rewrite labels with a substitution of the form\n"
+"        's/regexp/replacement/flags', as in sed (but the regexp is a POSIX\n"
+"        extended regexp, as with 'sed -E'). In the replacement, & stands\n"
+"        for the matched text, and \\1 to \\9 for the text matched by\n"
+"        parenthesized subexpressions. Flags are g (replace all matches) and\n"
+"        i (ignore case). This option can be repeated: the substitutions are\n"
+"        applied in order, after the maps. Each distinct label is rewritten\n"
+"        only once, however many times it occurs. Labels are matched as they\n"
+"        appear in the Newick, i.e. quoted labels include their quotes.\n"
+"    -t: text mode (see Output).\n"
 "    -l: only replace leaf labels. This is useful if all labels are numeric,\n"
 "        but inner labels represent bootstraps, and you don't want to\n"
 "        accidentally modify bootstrap values.\n"
@@ -124,7 +171,21 @@ void help(char *argv[])
 "# In fact, we could directly condense the tree, so that only one leaf per\n"
 "# family is left:\n"
 "\n"
-"$ %s data/falconiformes data/falc_map | nw_condense -\n",
+"$ %s data/falconiformes data/falc_map | nw_condense -\n"
+"\n"
+"# Rename numeric IDs to genera, then genera to families\n"
+"$ %s -m data/HRV.map -m genus2family.map tree.nw\n"
+"\n"
+"# Strip version suffixes from accession numbers (e.g. AB123456.2 ->\n"
+"# AB123456), in a huge tree\n"
+"$ %s -t -r 's/\\.[0-9]+$//' big_tree.nw\n"
+"\n"
+"# Rename by prefix: all labels that start with HRV become Rhinovirus\n"
+"$ %s -l -r 's/^HRV.*/Rhinovirus/' data/HRV.nw\n",
+	argv[0],
+	argv[0],
+	argv[0],
+	argv[0],
 	argv[0],
 	argv[0],
 	argv[0],
@@ -195,23 +256,54 @@ struct parameters get_params(int argc, char *argv[])
 	params.map_filename = NULL;
 	params.old_label = NULL;
 	params.new_label = NULL;
-
+	params.only_leaves = false;
+	params.text_mode = false;
+	params.nb_workers = 1;
+	params.map_filenames = create_llist();
+	if (NULL == params.map_filenames) { perror(NULL); exit(EXIT_FAILURE); }
+	params.rewriter = create_label_rewriter();
+	if (NULL == params.rewriter) { perror(NULL); exit(EXIT_FAILURE); }
+
+	char *error;
 	int opt_char;
-	while ((opt_char = getopt(argc, argv, "hl")) != -1) {
+	while ((opt_char = getopt(argc, argv, "hj:lm:r:t")) != -1) {
 		switch (opt_char) {
 		case 'h':
 			help(argv);
 			exit(EXIT_SUCCESS);
+		case 'j':
+			params.nb_workers = parse_nb_workers(optarg);
+			break;
 		case 'l':
 			params.only_leaves = true;
 			break;
+		case 'm':
+			if (! append_element(params.map_filenames, optarg)) {
+				perror(NULL);
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case 'r':
+			if (! add_substitution(params.rewriter, optarg,
+						&error)) {
+				if (NULL == error) perror(NULL);
+				else fprintf(stderr, "%s\n", error);
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case 't':
+			params.text_mode = true;
+			break;
 		}
 	}
 
 	/* check arguments */
-	if ((argc - optind) < 2)	{
-		fprintf(stderr, "Usage: %s [-hl] <filename|-> <map_filename>\n",
-				argv[0]);
+	int min_args = 0 == params.map_filenames->count &&
+		0 == params.rewriter->substitutions->count ? 2 : 1;
+	if ((argc - optind) < min_args)	{
+		fprintf(stderr, "Usage: %s [-hlt] [-j <processes>] "
+				"[-m <map_filename>]... [-r <substitution>]... "
+				"<filename|-> [<map_filename>]\n", argv[0]);
 		exit(EXIT_FAILURE);
 	} 
 
@@ -226,7 +318,7 @@ struct parameters get_params(int argc, char *argv[])
 	}
 	if ((argc - optind) == 2)
 		params.map_filename = argv[optind+1];
-	else  {
+	else if ((argc - optind) > 2) {
 		params.old_label = argv[optind+1];
 		params.new_label = argv[optind+2];
 	}
@@ -234,18 +326,35 @@ struct parameters get_params(int argc, char *argv[])
 	return params;
 }
 
-void process_tree(struct rooted_tree *tree, struct hash *rename_map,
-		struct parameters params)
+/* Returns the new label for 'label' (which is returned itself if it does not
+ * change): the maps are applied first, then the substitutions. */
+
+static const char *renamed(const char *label, struct parameters *params)
+{
+	if (NULL != params->rename_map) {
+		const char *mapped = perfect_hash_get(params->rename_map,
+				label);
+		if (NULL != mapped) label = mapped;
+	}
+	const char *rewritten = label_rewriter_rewrite(params->rewriter, label);
+	if (NULL == rewritten) { perror(NULL); exit(EXIT_FAILURE); }
+	return rewritten;
+}
+
+void process_tree(struct rooted_tree *tree, struct parameters *params)
 {
 	/* visit each node, and change name if needed */
 	struct list_elem *elem;
 	for (elem = tree->nodes_in_order->head; NULL != elem; elem = elem->next) {
 		struct rnode *current = (struct rnode *) elem->data;
-		if (params.only_leaves && ! is_leaf(current)) { continue; }
+		if (params->only_leaves && ! is_leaf(current)) { continue; }
 		char *label = current->label;
-		char *new_label = hash_get(rename_map, label);
-		if (NULL != new_label) {
+		const char *new_label = renamed(label, params);
+		if (label != new_label) {
 			current->label = strdup(new_label);
+			if (NULL == current->label) {
+				perror(NULL); exit(EXIT_FAILURE);
+			}
 			free(label);
 		}
 	}
@@ -253,48 +362,282 @@ void process_tree(struct rooted_tree *tree, struct hash *rename_map,
 	dump_newick(tree->root);
 }
 
-struct hash *set_map(struct parameters params)
+/* Characters that can be part of an unquoted label (or edge length), as in
+ * newick_scanner.l. Looked up for every input char, hence the table. */
+
+static bool label_chars[UCHAR_MAX + 1];
+
+static void init_label_chars()
+{
+	int c;
+	for (c = 0; c <= UCHAR_MAX; c++)
+		label_chars[c] = isgraph(c) && NULL == strchr("();,:'[]", c);
+}
+
+static bool is_label_char(int c)
 {
-	if (NULL != params.map_filename)
-		return read_map(params.map_filename);
+	return EOF != c && label_chars[c];
+}
+
+/* Grows 'buf' (of size '*size') if needed to hold 'length' chars and a
+ * '\0' */
+
+static char *reserve(char *buf, size_t *size, size_t length)
+{
+	if (length + 1 <= *size) return buf;
+	*size = 2 * (length + 1);
+	buf = realloc(buf, *size);
+	if (NULL == buf) { perror(NULL); exit(EXIT_FAILURE); }
+	return buf;
+}
+
+/* Text mode: copies the Newick text from 'in' to stdout, renaming the labels
+ * on the way. The only thing we need to know about the tree structure is what
+ * precedes each label: a ':' means it is an edge length, and a ')' that it
+ * belongs to an inner node. */
+
+static void rename_in_text(FILE *in, struct parameters *params)
+{
+	size_t size = 64;
+	char *label = malloc(size);
+	if (NULL == label) { perror(NULL); exit(EXIT_FAILURE); }
+	int previous = ';';	/* last punctuation seen */
+	init_label_chars();
+
+	int c = getc_unlocked(in);
+	while (EOF != c) {
+		if ('[' == c) {
+			/* comment: copied as is */
+			while (EOF != c && ']' != c) {
+				putc_unlocked(c, stdout);
+				c = getc_unlocked(in);
+			}
+			continue;	/* ']' (if any) is copied below */
+		}
+		if ('\'' != c && ! is_label_char(c)) {
+			switch (c) {
+			case '(': case ')': case ',': case ':': case ';':
+				previous = c;
+			}
+			putc_unlocked(c, stdout);
+			c = getc_unlocked(in);
+			continue;
+		}
+
+		size_t length = 0;
+		size_t nb_trailing_spaces = 0;
+		if ('\'' == c) {
+			/* one or more quoted strings, as in 'Bob''s' */
+			while ('\'' == c) {
+				do {
+					label = reserve(label, &size,
+							length + 1);
+					label[length++] = c;
+					c = getc_unlocked(in);
+				} while (EOF != c && '\'' != c);
+				if (EOF == c) break;
+				label = reserve(label, &size, length + 1);
+				label[length++] = c;
+				c = getc_unlocked(in);
+			}
+		} else {
+			/* Like the parser (see newick_scanner.l), this takes
+			 * words separated by spaces as one label. */
+			bool has_spaces = false;
+			for (;;) {
+				while (is_label_char(c)) {
+					label = reserve(label, &size,
+							length + 1);
+					label[length++] = c;
+					c = getc_unlocked(in);
+				}
+				while (' ' == c) {
+					label = reserve(label, &size,
+							length + 1);
+					label[length++] = c;
+					c = getc_unlocked(in);
+				}
+				if (! is_label_char(c)) break;
+				has_spaces = true;
+			}
+			/* trailing spaces are not part of the label */
+			while (length > 0 && ' ' == label[length - 1]) {
+				length--;
+				nb_trailing_spaces++;
+			}
+			label[length] = '\0';
+			if (has_spaces) {
+				fprintf (stderr, "WARNING: spaces found in "
+					"label '%s' - converting to "
+					"underscores.\n", label);
+				char *p;
+				for (p = label; '\0' != *p; p++)
+					if (' ' == *p) *p = '_';
+			}
+		}
+		label[length] = '\0';
+
+		const char *out = label;
+		bool is_length = ':' == previous;
+		bool is_inner = ')' == previous;
+		if (! is_length && ! (params->only_leaves && is_inner))
+			out = renamed(label, params);
+		/* not fputs(), which locks stdout every time */
+		for (; '\0' != *out; out++) putc_unlocked(*out, stdout);
+		for (; nb_trailing_spaces > 0; nb_trailing_spaces--)
+			putc_unlocked(' ', stdout);
+	}
+
+	free(label);
+}
+
+/* Returns a map with just one (old label, new label) pair */
 
+struct hash *label_pair_map(char *old_label, char *new_label)
+{
 	struct hash *map = create_hash(1);
 	if (NULL == map) { perror(NULL); exit(EXIT_FAILURE); }
 
-	char *val = strdup(params.new_label);
-	if (! hash_set(map, params.old_label, val)) {
+	char *val = strdup(new_label);
+	if (NULL == val || ! hash_set(map, old_label, val)) {
 		perror(NULL); exit(EXIT_FAILURE);
 	}
 
 	return map;
 }
 
-int main(int argc, char *argv[])
+/* Composes maps into a single one that has the same effect as applying them
+ * in order: a label is renamed by the first map, the result by the second,
+ * etc. The composed map's values belong to the individual maps. */
+
+struct hash *compose_maps(struct llist *maps)
 {
-	struct rooted_tree *tree;	
-	struct hash *rename_map;
-	struct parameters params;
-	
-	params = get_params(argc, argv);
+	const unsigned int HASH_SIZE = 1000;
+	const double LOAD_THRESHOLD = 0.8;
+	const unsigned RESIZE_FACTOR = 10;
 
-	rename_map = set_map(params);
+	if (1 == maps->count) return maps->head->data;
 
-	while (NULL != (tree = parse_tree())) {
-		process_tree(tree, rename_map, params);
-		destroy_all_rnodes(NULL);
-		destroy_tree(tree);
+	struct hash *composed = create_dynamic_hash(HASH_SIZE,
+			LOAD_THRESHOLD, RESIZE_FACTOR);
+	if (NULL == composed) { perror(NULL); exit(EXIT_FAILURE); }
+
+	struct list_elem *m, *e;
+	for (m = maps->head; NULL != m; m = m->next) {
+		struct hash *map = m->data;
+		/* Labels renamed by the previous maps: rename the result */
+		struct llist *keys = hash_keys(composed);
+		if (NULL == keys) { perror(NULL); exit(EXIT_FAILURE); }
+		for (e = keys->head; NULL != e; e = e->next) {
+			char *new_label = hash_get(map,
+					hash_get(composed, e->data));
+			if (NULL != new_label &&
+				! hash_set(composed, e->data, new_label)) {
+				perror(NULL); exit(EXIT_FAILURE);
+			}
+		}
+		destroy_llist(keys);
+		/* Labels left alone by the previous maps */
+		keys = hash_keys(map);
+		if (NULL == keys) { perror(NULL); exit(EXIT_FAILURE); }
+		for (e = keys->head; NULL != e; e = e->next) {
+			if (NULL != hash_get(composed, e->data)) continue;
+			if (! hash_set(composed, e->data,
+					hash_get(map, e->data))) {
+				perror(NULL); exit(EXIT_FAILURE);
+			}
+		}
+		destroy_llist(keys);
 	}
 
-	struct llist *keys = hash_keys(rename_map);
+	return composed;
+}
+
+/* Builds a perfect hash from a (composed) map, whose keys and values it
+ * shares. */
+
+struct perfect_hash *perfect_map(struct hash *map)
+{
+	struct llist *keys = hash_keys(map);
 	if (NULL == keys) { perror(NULL); exit(EXIT_FAILURE); }
-	struct list_elem *e;
-	for (e = keys->head; NULL != e; e = e->next) {
-		char *key = (char *) e->data;
-		char *val = hash_get(rename_map, key);
-		free(val);
+	const char **key_array = (const char **) llist_to_array(keys);
+	void **values = malloc((keys->count + 1) * sizeof(void *));
+	if ((NULL == key_array && keys->count > 0) || NULL == values) {
+		perror(NULL); exit(EXIT_FAILURE);
 	}
+	int i;
+	for (i = 0; i < keys->count; i++)
+		values[i] = hash_get(map, key_array[i]);
+
+	struct perfect_hash *ph = create_perfect_hash(key_array, values,
+			keys->count);
+	if (NULL == ph) { perror(NULL); exit(EXIT_FAILURE); }
+
+	free(key_array);
+	free(values);
+	destroy_llist(keys);
+	return ph;
+}
+
+/* Frees a map read by read_map() or label_pair_map(), values included */
+
+void destroy_map(struct hash *map)
+{
+	struct llist *keys = hash_keys(map);
+	if (NULL == keys) { perror(NULL); exit(EXIT_FAILURE); }
+	struct list_elem *e;
+	for (e = keys->head; NULL != e; e = e->next)
+		free(hash_get(map, e->data));
 	destroy_llist(keys);
-	destroy_hash(rename_map);
+	destroy_hash(map);
+}
+
+static void process_one_tree(struct rooted_tree *tree, void *arg)
+{
+	struct parameters *params = arg;
+	process_tree(tree, params);
+	destroy_all_rnodes(NULL);
+	destroy_tree(tree);
+}
+
+int main(int argc, char *argv[])
+{
+	struct parameters params;
+	
+	params = get_params(argc, argv);
+
+	struct llist *maps = create_llist();
+	if (NULL == maps) { perror(NULL); exit(EXIT_FAILURE); }
+	struct list_elem *e;
+	for (e = params.map_filenames->head; NULL != e; e = e->next)
+		append_element(maps, read_map(e->data));
+	if (NULL != params.map_filename)
+		append_element(maps, read_map(params.map_filename));
+	else if (NULL != params.old_label)
+		append_element(maps, label_pair_map(params.old_label,
+					params.new_label));
+
+	struct hash *rename_map = NULL;
+	params.rename_map = NULL;
+	if (maps->count > 0) {
+		rename_map = compose_maps(maps);
+		params.rename_map = perfect_map(rename_map);
+	}
+
+	if (params.text_mode) {
+		extern FILE *nwsin;
+		rename_in_text(NULL == nwsin ? stdin : nwsin, &params);
+	} else if (! run_tree_pipeline(params.nb_workers, process_one_tree,
+				&params))
+		exit(EXIT_FAILURE);
+
+	if (NULL != params.rename_map) destroy_perfect_hash(params.rename_map);
+	if (maps->count > 1) destroy_hash(rename_map);
+	for (e = maps->head; NULL != e; e = e->next)
+		destroy_map(e->data);
+	destroy_llist(maps);
+	destroy_llist(params.map_filenames);
+	destroy_label_rewriter(params.rewriter);
 
 	return 0;
 }
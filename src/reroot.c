@@ -34,6 +34,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <stdlib.h>
 #include <stdbool.h>
 #include <assert.h>
+#include <pthread.h>
 
 #include "tree.h"
 #include "parser.h"
@@ -45,15 +46,39 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "hash.h"
 #include "common.h"
 #include "link.h"
+#include "rooting.h"
+
+/* Trees are rooted by position (-m, -v) in batches of this many trees per
+ * thread: the positions are found in parallel, then the trees are rerooted
+ * and printed in order. */
+#define TREES_PER_THREAD 64
 
 enum reroot_status { REROOT_OK, LCA_IS_TREE_ROOT, NOT_PHYLOGRAM };
 enum deroot_status { DEROOT_OK, BALANCED, NOT_BIFURCATING, MEM_PROB };
+enum root_mode { ROOT_OUTGROUP, ROOT_MIDPOINT, ROOT_MIN_VAR };
 
 struct parameters {
 	struct llist *labels;
+	/* label -> int*: position of its first occurrence in 'labels' */
+	struct hash *label_positions;
 	bool try_ingroup;
 	bool deroot;
 	bool i_node_lbl_as_support;	/* Treat inner node labels as support values */
+	enum root_mode mode;
+	int nb_threads;
+};
+
+/* The trees of a batch, shared by the threads that find their root
+ * positions. Each thread takes the next tree until there are none left. */
+
+struct position_job {
+	struct rooted_tree **trees;
+	struct root_position *positions;
+	enum root_pos_status *statuses;
+	int nb_trees;
+	int next_tree;
+	pthread_mutex_t lock;
+	enum root_mode mode;
 };
 
 void help(char *argv[])
@@ -64,7 +89,7 @@ void help(char *argv[])
 "Synopsis\n"
 "--------\n"
 "\n"
-"%s [-dhls] <newick trees filename|-> [label*]\n"
+"%s [-dhlmsv] [-j <threads>] <newick trees filename|-> [label*]\n"
 "\n"
 "Input\n"
 "-----\n"
@@ -75,6 +100,7 @@ void help(char *argv[])
 "Further arguments are node labels. If there is at least one label, the tree\n"
 "will be re-rooted on their LCAa. If there is no label, the tree is rerooted\n"
 "on the longest branch. In this case the tree must be a phylogram.\n"
+"Labels are not allowed with -m and -v.\n"
 "\n"
 "Output\n"
 "------\n"
@@ -90,16 +116,23 @@ void help(char *argv[])
 "        children. The root is expected to have two children. Other options\n"
 "        have no effect.\n"
 "    -h: print this message and exit\n"
+"    -j <n>: use n threads for -m and -v (default: the number of\n"
+"        processors). Trees are still printed in input order.\n"
 "    -l: lax - if it is not possible to reroot on the outgroup, try the\n"
 "        ingroup - that is, all nodes whose labels were NOT passed as\n"
 "        arguments.  This can also fail, if both the outgroup and the\n"
 "        ingroup have the tree's root as LCA. Note that to use this option\n"
 "        you must make sure that you pass ALL outgroup labels, otherwise the\n"
 "        ingroup will be wrong.\n"
+"    -m: midpoint rooting - root halfway along the longest path between two\n"
+"        leaves. The tree must be a phylogram.\n"
 "    -s: treat inner node labels as bipartition support values. Although they\n""        are attributed to nodes in Newick, these are actually properties of\n"
 "        edges, and are treated differently from clade labels, which are\n"
 "        really properties of nodes. The \"Rerooting\" section of the manual\n"
 "        has more details.\n"
+"    -v: minimum variance rooting - root at the point that minimizes the\n"
+"        variance of the root-to-leaf distances. The tree must be a\n"
+"        phylogram.\n"
 "\n"
 "Examples\n"
 "--------\n"
@@ -111,7 +144,12 @@ void help(char *argv[])
 "\n"
 "# We can reroot on more than one node:\n"
 "\n"
-"$ %s data/catarrhini_wrong_3og Cebus Aotus \n",
+"$ %s data/catarrhini_wrong_3og Cebus Aotus \n"
+"\n"
+"# Midpoint-root a file of gene trees, using 4 threads:\n"
+"\n"
+"$ %s -m -j 4 gene_trees.nw\n",
+	argv[0],
 	argv[0],
 	argv[0],
 	argv[0]
@@ -126,9 +164,12 @@ struct parameters get_params(int argc, char *argv[])
 	params.try_ingroup = false;
 	params.deroot = false;
 	params.i_node_lbl_as_support = false;
+	params.mode = ROOT_OUTGROUP;
+	params.nb_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (params.nb_threads < 1) params.nb_threads = 1;
 
 	int opt_char;
-	while ((opt_char = getopt(argc, argv, "dhls")) != -1) {
+	while ((opt_char = getopt(argc, argv, "dhj:lmsv")) != -1) {
 		switch (opt_char) {
 		case '?':
 			// TODO what is this case for?
@@ -139,12 +180,26 @@ struct parameters get_params(int argc, char *argv[])
 		case 'h':
 			help(argv);
 			exit(EXIT_SUCCESS);
+		case 'j':
+			params.nb_threads = atoi(optarg);
+			if (params.nb_threads < 1) {
+				fprintf(stderr, "Number of threads must be "
+						"at least 1.\n");
+				exit(EXIT_FAILURE);
+			}
+			break;
 		case 'l':
 			params.try_ingroup = true;
 			break;
+		case 'm':
+			params.mode = ROOT_MIDPOINT;
+			break;
 		case 's':
 			params.i_node_lbl_as_support = true;
 			break;
+		case 'v':
+			params.mode = ROOT_MIN_VAR;
+			break;
 		default:
 			fprintf (stderr, "Unknown option '-%c'\n", opt_char);
 			exit (EXIT_FAILURE);
@@ -155,7 +210,8 @@ struct parameters get_params(int argc, char *argv[])
 	int nargs = argc - optind; /* non-option arguments */
 	if (nargs < 1) {
 		fprintf(stderr,
-			"Usage: %s [-dhl] <filename|->  [label+]\n",
+			"Usage: %s [-dhlmsv] [-j <threads>] <filename|->  "
+			"[label+]\n",
 			argv[0]);
 		exit(EXIT_FAILURE);
 	}
@@ -179,6 +235,30 @@ struct parameters get_params(int argc, char *argv[])
 		}
 	}
 	params.labels = lbl_list;
+	if (ROOT_OUTGROUP != params.mode && lbl_list->count > 0) {
+		fprintf(stderr, "Options -m and -v take no labels.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	/* Looked up in every tree, so we make it only once */
+	params.label_positions = create_hash(lbl_list->count + 1);
+	int *positions = malloc((lbl_list->count + 1) * sizeof(int));
+	if (NULL == params.label_positions || NULL == positions) {
+		perror(NULL);
+		exit(EXIT_FAILURE);
+	}
+	struct list_elem *el;
+	int i;
+	for (i = 0, el = lbl_list->head; NULL != el; i++, el = el->next) {
+		if (NULL != hash_get(params.label_positions, el->data))
+			continue;
+		positions[i] = i;
+		if (! hash_set(params.label_positions, el->data,
+					positions + i)) {
+			perror(NULL);
+			exit(EXIT_FAILURE);
+		}
+	}
 
 	return params;
 }
@@ -212,20 +292,32 @@ struct rnode *node_with_longest_edge(struct rooted_tree *tree)
 }
 
 /* given the labels of the outgroup nodes, returns the nodes themselves, as a
- * llist. */
+ * llist. This is one pass over the tree, looking up each node's label among
+ * the outgroup labels (rather than making a map of all the tree's labels). If
+ * several nodes have the same label, the last one in the tree's order is
+ * used. */
 
-struct llist * get_outgroup_nodes(struct rooted_tree *tree, struct llist *labels)
+struct llist * get_outgroup_nodes(struct rooted_tree *tree,
+		struct llist *labels, struct hash *label_positions)
 {
-	struct hash *map;
 	struct llist *outgroup_nodes;
 	struct list_elem *el;
+	struct rnode **found = calloc(labels->count + 1,
+			sizeof(struct rnode *));
+	if (NULL == found) { perror(NULL); exit(EXIT_FAILURE); }
+
+	for (el = tree->nodes_in_order->head; NULL != el; el = el->next) {
+		struct rnode *current = el->data;
+		if ('\0' == current->label[0]) continue;
+		int *pos = hash_get(label_positions, current->label);
+		if (NULL != pos) found[*pos] = current;
+	}
 
-	map = create_label2node_map(tree->nodes_in_order);	
 	outgroup_nodes = create_llist();
 	if (NULL == outgroup_nodes) { perror(NULL); exit(EXIT_FAILURE); }
 	for (el = labels->head; NULL != el; el = el->next) {
-		struct rnode *desc;
-		desc = hash_get(map, (char *) el->data);
+		int *pos = hash_get(label_positions, (char *) el->data);
+		struct rnode *desc = found[*pos];
 		if (NULL == desc) {
 			fprintf (stderr, "WARNING: label '%s' does not occur in tree\n",
 					(char *) el->data);
@@ -236,7 +328,7 @@ struct llist * get_outgroup_nodes(struct rooted_tree *tree, struct llist *labels
 			}
 		}
 	}
-        destroy_hash(map);
+	free(found);
 
 	return outgroup_nodes;
 }
@@ -410,7 +502,8 @@ void try_ingroup(struct rooted_tree *tree, struct parameters params)
 
 void process_tree(struct rooted_tree *tree, struct parameters params)
 {
-	struct llist *outgroup_nodes = get_outgroup_nodes(tree, params.labels);
+	struct llist *outgroup_nodes = get_outgroup_nodes(tree, params.labels,
+			params.label_positions);
 	if (! params.deroot) {
 		/* re-root according to outgroup nodes */
 		enum reroot_status result = reroot(tree, outgroup_nodes, 
@@ -466,12 +559,126 @@ void process_tree(struct rooted_tree *tree, struct parameters params)
 	destroy_llist(outgroup_nodes);
 }
 
+static enum root_pos_status find_position(struct rooted_tree *tree,
+		enum root_mode mode, struct root_position *position)
+{
+	if (ROOT_MIDPOINT == mode)
+		return midpoint_root_position(tree, position);
+	else
+		return min_var_root_position(tree, position);
+}
+
+static void *find_positions(void *arg)
+{
+	struct position_job *job = arg;
+
+	for (;;) {
+		pthread_mutex_lock(&job->lock);
+		int i = job->next_tree++;
+		pthread_mutex_unlock(&job->lock);
+		if (i >= job->nb_trees) break;
+		job->statuses[i] = find_position(job->trees[i], job->mode,
+				job->positions + i);
+	}
+
+	return NULL;
+}
+
+/* Roots a batch of trees by position (midpoint or minimum variance), and
+ * prints them. The trees are then destroyed. */
+
+static void process_batch(struct rooted_tree **trees, int nb_trees,
+		struct parameters params)
+{
+	struct position_job job;
+	job.trees = trees;
+	job.nb_trees = nb_trees;
+	job.next_tree = 0;
+	job.mode = params.mode;
+	job.positions = malloc(nb_trees * sizeof(struct root_position));
+	job.statuses = malloc(nb_trees * sizeof(enum root_pos_status));
+	if (NULL == job.positions || NULL == job.statuses) {
+		perror(NULL);
+		exit(EXIT_FAILURE);
+	}
+	pthread_mutex_init(&job.lock, NULL);
+
+	int nb_threads = params.nb_threads;
+	if (nb_threads > nb_trees) nb_threads = nb_trees;
+	pthread_t *threads = malloc(nb_threads * sizeof(pthread_t));
+	if (NULL == threads) { perror(NULL); exit(EXIT_FAILURE); }
+	int t;
+	/* the calling thread works, too */
+	for (t = 1; t < nb_threads; t++) {
+		if (0 != pthread_create(threads + t, NULL, find_positions,
+					&job)) {
+			fprintf(stderr, "Could not start thread.\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	find_positions(&job);
+	for (t = 1; t < nb_threads; t++)
+		pthread_join(threads[t], NULL);
+	free(threads);
+	pthread_mutex_destroy(&job.lock);
+
+	int i;
+	for (i = 0; i < nb_trees; i++) {
+		struct rooted_tree *tree = trees[i];
+		switch (job.statuses[i]) {
+		case ROOT_POS_OK:
+			if (! reroot_at_position(tree, job.positions + i,
+					params.i_node_lbl_as_support)) {
+				perror(NULL);
+				exit(EXIT_FAILURE);
+			}
+			dump_newick(tree->root);
+			break;
+		case ROOT_POS_NOT_PHYLOGRAM:
+			fprintf (stderr, 
+				"ERROR: Tree must be a phylogram, but some "
+				"branch lengths are not defined - aborting.\n");
+			break;
+		case ROOT_POS_MEM_ERROR:
+			perror(NULL);
+			exit(EXIT_FAILURE);
+		default:
+			assert(0);
+		}
+		destroy_tree(tree);
+	}
+	destroy_all_rnodes(NULL);
+
+	free(job.positions);
+	free(job.statuses);
+}
+
 int main(int argc, char *argv[])
 {
 	struct rooted_tree *tree;	
 	struct parameters params;
 	
 	params = get_params(argc, argv);
+	if (ROOT_OUTGROUP != params.mode && ! params.deroot) {
+		int batch_size = TREES_PER_THREAD * params.nb_threads;
+		struct rooted_tree **batch = malloc(batch_size *
+				sizeof(struct rooted_tree *));
+		if (NULL == batch) { perror(NULL); exit(EXIT_FAILURE); }
+		int nb_trees = 0;
+		while (NULL != (tree = parse_tree())) {
+			batch[nb_trees++] = tree;
+			if (batch_size == nb_trees) {
+				process_batch(batch, nb_trees, params);
+				nb_trees = 0;
+			}
+		}
+		if (nb_trees > 0)
+			process_batch(batch, nb_trees, params);
+		free(batch);
+		destroy_llist(params.labels);
+		return 0;
+	}
+
 	while (NULL != (tree = parse_tree())) {
 		/* tree is free()d in process_tree(), as derooting is
 		 * compatible with ordinary free()ing (with
@@ -0,0 +1,377 @@
+/* 
+
+Copyright (c) 2009 Thomas Junier and Evgeny Zdobnov, University of Geneva
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+* Neither the name of the University of Geneva nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+/* nw_rf - Robinson-Foulds distances between trees */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <getopt.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "parser.h"
+#include "tree.h"
+#include "rnode.h"
+#include "bipart.h"
+#include "common.h"
+
+extern FILE *nwsin;
+
+struct parameters {
+	FILE *trees_file;
+	FILE *ref_trees_file;	/* NULL: compare the trees among themselves */
+	bool binary;
+	int nb_threads;
+};
+
+/* A growable array of split sets, one per tree */
+
+struct tree_biparts {
+	struct bipart_set **sets;
+	int count;
+	int capacity;
+};
+
+/* What a thread needs to fill its rows of the distance matrix */
+
+struct rf_job {
+	struct tree_biparts *rows;
+	struct tree_biparts *cols;
+	bool symmetric;
+	int32_t *matrix;
+	int first_row;
+	int row_step;
+};
+
+void help(char *argv[])
+{
+	printf(
+"Computes Robinson-Foulds distances between trees\n"
+"\n"
+"Synopsis\n"
+"--------\n"
+"\n"
+"%s [-bh] [-j <threads>] <trees filename|-> [reference trees filename]\n"
+"\n"
+"Input\n"
+"-----\n"
+"\n"
+"The first argument is the name of a file containing Newick trees, or '-'\n"
+"(in which case the trees are read on standard input). The optional second\n"
+"argument is the name of a file containing reference trees.\n"
+"\n"
+"All trees must have the same leaf labels, and these must be unique.\n"
+"\n"
+"Output\n"
+"------\n"
+"\n"
+"Outputs a matrix of Robinson-Foulds (RF) distances, i.e. the number of\n"
+"bipartitions (splits) found in only one of the two trees. Trees are\n"
+"considered unrooted. If there are reference trees, there is one row per\n"
+"tree and one column per reference tree; otherwise the matrix is square,\n"
+"with one row and one column per tree. By default, rows are printed one per\n"
+"line, with TAB-separated distances.\n"
+"\n"
+"Options\n"
+"-------\n"
+"\n"
+"    -b: binary output: the distances are written as 32-bit integers in the\n"
+"        machine's byte order, row by row, without any separator\n"
+"    -h: prints this message and exits\n"
+"    -j <n>: use n threads (default: the number of processors)\n"
+"\n"
+"Examples\n"
+"--------\n"
+"\n"
+"# Distances between all trees in a sample\n"
+"$ %s data/HRV_20reps.nw\n"
+"\n"
+"# Distance of each replicate to the consensus\n"
+"$ %s data/HRV_20reps.nw data/HRV.nw\n",
+	argv[0],
+	argv[0],
+	argv[0]
+	      );
+}
+
+static FILE *open_trees_file(char *filename)
+{
+	if (0 == strcmp("-", filename)) return stdin;
+	FILE *file = fopen(filename, "r");
+	if (NULL == file) {
+		perror(NULL);
+		exit(EXIT_FAILURE);
+	}
+	return file;
+}
+
+struct parameters get_params(int argc, char *argv[])
+{
+	struct parameters params;
+	int opt_char;
+
+	params.ref_trees_file = NULL;
+	params.binary = false;
+	params.nb_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (params.nb_threads < 1) params.nb_threads = 1;
+
+	while ((opt_char = getopt(argc, argv, "bhj:")) != -1) {
+		switch (opt_char) {
+		case 'b':
+			params.binary = true;
+			break;
+		case 'h':
+			help(argv);
+			exit(EXIT_SUCCESS);
+		case 'j':
+			params.nb_threads = atoi(optarg);
+			if (params.nb_threads < 1) {
+				fprintf(stderr, "Number of threads must be "
+						"at least 1\n");
+				exit(EXIT_FAILURE);
+			}
+			break;
+		default:
+			fprintf (stderr, "Unknown option '-%c'\n", opt_char);
+			exit (EXIT_FAILURE);
+		}
+	}
+
+	int nb_args = argc - optind;
+	if (1 == nb_args || 2 == nb_args) {
+		params.trees_file = open_trees_file(argv[optind]);
+		if (2 == nb_args)
+			params.ref_trees_file = open_trees_file(argv[optind+1]);
+	} else {
+		fprintf(stderr, "Usage: %s [-bh] [-j <threads>] "
+			"<trees filename|-> [reference trees filename]\n",
+			argv[0]);
+		exit(EXIT_FAILURE);
+	}
+
+	return params;
+}
+
+static void bipart_error(enum bipart_status status, int tree_num)
+{
+	switch (status) {
+	case BIPART_MEM_ERROR:
+		perror(NULL);
+		break;
+	case BIPART_DUP_LABEL:
+		fprintf(stderr, "Tree #%d has duplicate leaf labels.\n",
+				tree_num);
+		break;
+	case BIPART_EMPTY_LABEL:
+		fprintf(stderr, "Tree #%d has unlabeled leaves.\n", tree_num);
+		break;
+	case BIPART_UNKNOWN_LABEL:
+	case BIPART_WRONG_LEAF_COUNT:
+		fprintf(stderr, "Tree #%d does not have the same leaves as "
+				"the first tree.\n", tree_num);
+		break;
+	default:
+		fprintf(stderr, "Unexpected error on tree #%d\n", tree_num);
+	}
+	exit(EXIT_FAILURE);
+}
+
+/* Reads all trees from 'nwsin' and stores their splits (only the
+ * fingerprints: the trees themselves are not kept). The leaves are numbered
+ * after the first tree read, unless 'leaves' already points to a numbering. */
+
+static struct tree_biparts *read_biparts(struct bipart_leaves **leaves,
+		int *tree_num)
+{
+	struct tree_biparts *result = malloc(sizeof(struct tree_biparts));
+	if (NULL == result) { perror(NULL); exit(EXIT_FAILURE); }
+	result->count = 0;
+	result->capacity = 16;
+	result->sets = malloc(result->capacity * sizeof(struct bipart_set *));
+	if (NULL == result->sets) { perror(NULL); exit(EXIT_FAILURE); }
+
+	struct rooted_tree *tree;
+	enum bipart_status status;
+	while (NULL != (tree = parse_tree())) {
+		(*tree_num)++;
+		if (NULL == *leaves) {
+			status = create_bipart_leaves(tree, leaves);
+			if (BIPART_OK != status)
+				bipart_error(status, *tree_num);
+		}
+		if (result->count == result->capacity) {
+			result->capacity *= 2;
+			result->sets = realloc(result->sets,
+				result->capacity * sizeof(struct bipart_set *));
+			if (NULL == result->sets) {
+				perror(NULL); exit(EXIT_FAILURE);
+			}
+		}
+		struct bipart_set *set;
+		status = get_bipart_set(tree, *leaves, &set);
+		if (BIPART_OK != status) bipart_error(status, *tree_num);
+		drop_bipart_bits(set);
+		result->sets[result->count++] = set;
+
+		destroy_tree(tree);
+		recycle_all_rnodes(NULL);
+	}
+
+	return result;
+}
+
+/* In the symmetric case, only the upper half of the matrix is computed (and
+ * copied to the lower half). Threads take rows in turn, which balances their
+ * work well enough since consecutive rows have similar lengths. */
+
+static void *compute_rows(void *arg)
+{
+	struct rf_job *job = (struct rf_job *) arg;
+	int nb_cols = job->cols->count;
+	int i, j;
+
+	for (i = job->first_row; i < job->rows->count; i += job->row_step) {
+		struct bipart_set *set = job->rows->sets[i];
+		int32_t *row = job->matrix + (size_t) i * nb_cols;
+		if (job->symmetric) {
+			row[i] = 0;
+			for (j = i + 1; j < nb_cols; j++) {
+				int dist = rf_distance(set, job->cols->sets[j]);
+				row[j] = dist;
+				job->matrix[(size_t) j * nb_cols + i] = dist;
+			}
+		} else {
+			for (j = 0; j < nb_cols; j++)
+				row[j] = rf_distance(set, job->cols->sets[j]);
+		}
+	}
+
+	return NULL;
+}
+
+static int32_t *compute_matrix(struct tree_biparts *rows,
+		struct tree_biparts *cols, int nb_threads)
+{
+	int32_t *matrix = malloc((size_t) rows->count * cols->count *
+			sizeof(int32_t));
+	struct rf_job *jobs = malloc(nb_threads * sizeof(struct rf_job));
+	pthread_t *threads = malloc(nb_threads * sizeof(pthread_t));
+	if (NULL == jobs || NULL == threads ||
+		(NULL == matrix && rows->count * cols->count > 0)) {
+		perror(NULL);
+		exit(EXIT_FAILURE);
+	}
+
+	int t;
+	for (t = 0; t < nb_threads; t++) {
+		jobs[t].rows = rows;
+		jobs[t].cols = cols;
+		jobs[t].symmetric = (rows == cols);
+		jobs[t].matrix = matrix;
+		jobs[t].first_row = t;
+		jobs[t].row_step = nb_threads;
+	}
+	/* the calling thread does the first job */
+	for (t = 1; t < nb_threads; t++) {
+		if (0 != pthread_create(threads + t, NULL, compute_rows,
+					jobs + t)) {
+			fprintf(stderr, "Could not start thread.\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	compute_rows(jobs);
+	for (t = 1; t < nb_threads; t++)
+		pthread_join(threads[t], NULL);
+
+	free(jobs);
+	free(threads);
+	return matrix;
+}
+
+static void print_matrix(int32_t *matrix, int nb_rows, int nb_cols,
+		bool binary)
+{
+	int i, j;
+	if (binary) {
+		if (fwrite(matrix, sizeof(int32_t), (size_t) nb_rows * nb_cols,
+				stdout) != (size_t) nb_rows * nb_cols) {
+			perror(NULL);
+			exit(EXIT_FAILURE);
+		}
+		return;
+	}
+	for (i = 0; i < nb_rows; i++) {
+		int32_t *row = matrix + (size_t) i * nb_cols;
+		for (j = 0; j < nb_cols; j++) {
+			if (j > 0) putchar('\t');
+			printf("%d", row[j]);
+		}
+		putchar('\n');
+	}
+}
+
+static void destroy_tree_biparts(struct tree_biparts *biparts)
+{
+	int i;
+	for (i = 0; i < biparts->count; i++)
+		destroy_bipart_set(biparts->sets[i]);
+	free(biparts->sets);
+	free(biparts);
+}
+
+int main(int argc, char *argv[])
+{
+	struct parameters params = get_params(argc, argv);
+	struct bipart_leaves *leaves = NULL;
+	int tree_num = 0;
+
+	nwsin = params.trees_file;
+	struct tree_biparts *rows = read_biparts(&leaves, &tree_num);
+	struct tree_biparts *cols = rows;
+	if (NULL != params.ref_trees_file) {
+		nwsin = params.ref_trees_file;
+		cols = read_biparts(&leaves, &tree_num);
+	}
+
+	if (params.nb_threads > rows->count)
+		params.nb_threads = rows->count > 0 ? rows->count : 1;
+	int32_t *matrix = compute_matrix(rows, cols, params.nb_threads);
+	print_matrix(matrix, rows->count, cols->count, params.binary);
+
+	free(matrix);
+	if (cols != rows) destroy_tree_biparts(cols);
+	destroy_tree_biparts(rows);
+	if (NULL != leaves) destroy_bipart_leaves(leaves);
+	destroy_all_rnodes(NULL);
+
+	return 0;
+}
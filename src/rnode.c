@@ -50,22 +50,65 @@ static const int rnode_array_size_increment = 1000;
 static int rnode_count = 0;
 static int rnode_array_size = 0;	/* in number of nodes */
 static struct rnode** rnode_array = NULL;
+/* Number of nodes actually allocated, i.e. in use (the first rnode_count) or
+ * waiting to be reused (the rest, see recycle_all_rnodes()). */
+static int rnode_pool_size = 0;
+
+/* Copies 'src' into '*dest', which must point to a string previously
+ * obtained from malloc(). The buffer is reused if it is long enough. */
+/* Returns FAILURE iff realloc() fails. */
+
+static int reuse_string(char **dest, char *src)
+{
+	size_t len = strlen(src);
+	/* We only know that the buffer holds strlen(*dest)+1 bytes: it may
+	 * have been replaced by another one since we allocated it. */
+	if (strlen(*dest) < len) {
+		char *new = realloc(*dest, len + 1);
+		if (NULL == new) return FAILURE;
+		*dest = new;
+	}
+	memcpy(*dest, src, len + 1);
+	return SUCCESS;
+}
 
 struct rnode *create_rnode(char *label, char *length_as_string)
 {
 	struct rnode *node;
 
-	node = malloc(sizeof(struct rnode));
-	if (NULL == node) return NULL;
-
 	if (NULL == label) {
 		label = "";
 	}
 	if (NULL == length_as_string) {
 		length_as_string = "";
 	}
-	node->label = strdup(label);
-	node->edge_length_as_string = strdup(length_as_string);
+
+	if (rnode_count < rnode_pool_size) {
+		/* Reuse a recycled node, and its strings if possible. */
+		node = rnode_array[rnode_count];
+		if (! reuse_string(&(node->label), label)) return NULL;
+		if (! reuse_string(&(node->edge_length_as_string),
+					length_as_string))
+			return NULL;
+	} else {
+		node = malloc(sizeof(struct rnode));
+		if (NULL == node) return NULL;
+		node->label = strdup(label);
+		node->edge_length_as_string = strdup(length_as_string);
+
+		/* Now add to list of nodes */
+		if (rnode_pool_size == rnode_array_size) {
+			int new_size = rnode_array_size +
+				rnode_array_size_increment;
+			rnode_array = realloc(rnode_array,
+				new_size * sizeof(struct rnode*));
+			if (NULL == rnode_array) return NULL;
+			rnode_array_size = new_size;
+		}
+		rnode_array[rnode_pool_size++] = node;
+	}
+	rnode_count++;
+
 	node->parent = NULL;
 	node->next_sibling = NULL;
 	node->first_child = NULL;
@@ -82,32 +125,20 @@ struct rnode *create_rnode(char *label, char *length_as_string)
 	 * rnode_iterator.c */
 	node->current_child = NULL;
 	node->seen = false;
+	node->index = -1;
 	node->linked = false;
 
 #ifdef SHOW_RNODE_CREATE
 	fprintf(stderr, "creating rnode %p '%s'\n", node, node->label);
 #endif
 
-	/* Now add to list of nodes */
-	rnode_count++;
-	if (rnode_count > rnode_array_size) {
-		int new_size = rnode_array_size + rnode_array_size_increment;
-		rnode_array = realloc(rnode_array,
-			new_size * sizeof(struct rnode*));
-		if (NULL == rnode_array) return NULL;
-		rnode_array_size = new_size;
-	}
-	rnode_array[rnode_count - 1] = node;
 	return node;
 }
 
-void destroy_rnode(struct rnode *node, void (*free_data)(void *))
+/* Releases the node's data (see destroy_rnode()) */
+
+static void free_rnode_data(struct rnode *node, void (*free_data)(void *))
 {
-#ifdef SHOW_RNODE_DESTROY
-	fprintf (stderr, " freeing rnode %p '%s'\n", node, node->label);
-#endif
-	free(node->label);
-	free(node->edge_length_as_string);
 	/* if free_data is not NULL, we call it to free the node data (use this
 	 * when the data cannot just be free()d); otherwise we just free()
 	 * node->data  */
@@ -115,18 +146,41 @@ void destroy_rnode(struct rnode *node, void (*free_data)(void *))
 		free_data(node->data);
 	else if (NULL != node->data)
 		free(node->data);
+	node->data = NULL;
+}
+
+void destroy_rnode(struct rnode *node, void (*free_data)(void *))
+{
+#ifdef SHOW_RNODE_DESTROY
+	fprintf (stderr, " freeing rnode %p '%s'\n", node, node->label);
+#endif
+	free(node->label);
+	free(node->edge_length_as_string);
+	free_rnode_data(node, free_data);
 	free(node);
 }
 
 void destroy_all_rnodes(void (*free_data)(void *))
 {
+	/* Recycled nodes have no data left */
+	while (rnode_pool_size > rnode_count)
+		destroy_rnode(rnode_array[--rnode_pool_size], NULL);
 	while (rnode_count > 0)
 		destroy_rnode(rnode_array[--rnode_count], free_data);
 	free(rnode_array);
 	rnode_array_size = 0;
+	rnode_pool_size = 0;
 	rnode_array = NULL;
 }
 
+void recycle_all_rnodes(void (*free_data)(void *))
+{
+	int i;
+	for (i = 0; i < rnode_count; i++)
+		free_rnode_data(rnode_array[i], free_data);
+	rnode_count = 0;
+}
+
 void show_all_rnodes()
 {
 	struct rnode **rnode_h;
@@ -212,115 +266,213 @@ struct rnode** children_array(struct rnode *node)
 
 	struct rnode *kid = NULL;
 	int i = 0;
+	/* last_child's next_sibling may be stale (see add_child()) */
 	for (kid = node->first_child; NULL != kid; kid = kid->next_sibling) {
 		array[i] = kid;
 		i++;
+		if (node->last_child == kid) break;
 	}
 
 	return array;
 }
 
-/* Computes the list by doing a tree traversal, then reversing it. */
+/* Uses a stack iterator in post-order, which leaves the nodes untouched. */
 
 struct llist *get_nodes_in_order(struct rnode *root)
 {
-	struct rnode_iterator *it = create_rnode_iterator(root);
+	struct rnode_stack_iterator *it =
+		create_rnode_stack_iterator(root, RNODE_POSTORDER);
 	if (NULL == it) return NULL;
+	struct llist *nodes_in_order = create_llist();
+	if (NULL == nodes_in_order) return NULL;
 	struct rnode *current;
-	struct llist *traversal = create_llist();
-	if (NULL == traversal) return NULL;
-	struct llist *reverse_traversal;
-	struct llist *nodes_in_reverse_order = create_llist();
-	if (NULL == nodes_in_reverse_order) return NULL;
-	struct llist *nodes_in_order;
-
-	/* Iterates over the whole tree - note that a node is visited more than
-	 * once, except leaves. */
-	while ((current = rnode_iterator_next(it)) != NULL) {
-		current->seen = 0;
-		if (! append_element (traversal, current)) return NULL;
-	}
 
-	destroy_rnode_iterator(it);
-
-	reverse_traversal = llist_reverse(traversal);
-	if (NULL == reverse_traversal) return NULL;
-	destroy_llist(traversal);
-
-	/* This keeps only the first 'visit' through any node */
-	struct list_elem *el;
-	for (el = reverse_traversal->head; NULL != el; el = el->next) {
-		current = el->data;
-		/* Nodes will have been seen by the iterator above, hence they
-		 * start with a 'seen' value of 1. */
-		if (current->seen == 0) {
-			/* Not seen yet? add to list, and mark as seen (hash) */
-			if (! append_element
-					(nodes_in_reverse_order, current))
-				return NULL;
-			current->seen = 1;
-		}
+	while ((current = rnode_stack_iterator_next(it)) != NULL)
+		if (! append_element(nodes_in_order, current)) return NULL;
+	if (rnode_stack_iterator_error(it)) return NULL;
+
+	destroy_rnode_stack_iterator(it);
+	return nodes_in_order;
+}
+
+/* Makes room for at least 'n' more nodes in rnode_array, so that a batch of
+ * create_rnode() calls (e.g. when cloning) causes at most one realloc(). */
+/* Returns FAILURE iff realloc() fails. */
+
+static int reserve_rnodes(int n)
+{
+	int needed = rnode_count + n;
+	if (needed <= rnode_array_size) return SUCCESS;
+	int new_size = rnode_array_size + rnode_array_size_increment;
+	if (new_size < needed) new_size = needed;
+	struct rnode **new_array = realloc(rnode_array,
+			new_size * sizeof(struct rnode*));
+	if (NULL == new_array) return FAILURE;
+	rnode_array = new_array;
+	rnode_array_size = new_size;
+	return SUCCESS;
+}
+
+/* Returns the node that follows 'node' in a pre-order traversal of the
+ * subtree rooted at 'root', skipping the descendants of 'node' (i.e., its next
+ * sibling, or the next sibling of its nearest ancestor that has one). Returns
+ * NULL when the traversal is over. Sets 'levels_up' to the number of parent
+ * edges climbed. */
+
+static struct rnode *next_preorder_skip(struct rnode *root,
+		struct rnode *node, int *levels_up)
+{
+	*levels_up = 0;
+	/* NOTE: a last child's next_sibling is not always NULL (see
+	 * add_child()) */
+	while (node != root && node == node->parent->last_child) {
+		node = node->parent;
+		(*levels_up)++;
 	}
+	return (node == root) ? NULL : node->next_sibling;
+}
 
-	destroy_llist(reverse_traversal);
-	nodes_in_order = llist_reverse(nodes_in_reverse_order);
-	if (NULL == nodes_in_order) return NULL;
-	destroy_llist(nodes_in_reverse_order);
+/* Returns the number of nodes in the subtree rooted at 'root'. */
 
-	/* remove the 'seen' marks */
-	for (el = nodes_in_order->head; NULL != el; el = el->next) {
-		current = el->data;
-		current->seen = 0;
+static int subtree_node_count(struct rnode *root)
+{
+	int n = 0, levels_up;
+	struct rnode *node = root;
+	while (NULL != node) {
+		n++;
+		if (! is_leaf(node))
+			node = node->first_child;
+		else
+			node = next_preorder_skip(root, node, &levels_up);
 	}
-	return nodes_in_order;
+	return n;
 }
 
+/* The cloning functions below are iterative, since trees can be far deeper
+ * (think of a large ladder) than the C stack allows for recursion. They visit
+ * the target in pre-order, so that a node's parent is always cloned before the
+ * node itself, and siblings are cloned in Newick order: each clone can thus be
+ * appended to its parent's clone right away. Climbing up n edges in the target
+ * means climbing up n edges in the clone, too. */
+
 /* One could get this one by passing a constantly true predicate to
  * clone_rnode_cond() - but this will be a bit faster. */
 
 struct rnode *clone_rnode(struct rnode *target)
 {
-	struct rnode *result = create_rnode(target->label,
-			target->edge_length_as_string);
-	if (NULL == result) return NULL;
-	struct rnode *kid = target->first_child;
-	for (; NULL != kid; kid = kid->next_sibling) {
-		struct rnode *kid_clone = clone_rnode(kid);
-		if (NULL == kid_clone) return NULL;
-		add_child(result, kid_clone);
+	if (! reserve_rnodes(subtree_node_count(target))) return NULL;
+
+	struct rnode *result = NULL;
+	struct rnode *clone_parent = NULL;
+	struct rnode *node = target;
+	int levels_up;
+
+	while (NULL != node) {
+		struct rnode *clone = create_rnode(node->label,
+				node->edge_length_as_string);
+		if (NULL == clone) return NULL;
+		if (NULL == clone_parent)
+			result = clone;
+		else
+			add_child(clone_parent, clone);
+
+		if (! is_leaf(node)) {
+			clone_parent = clone;
+			node = node->first_child;
+			continue;
+		}
+		node = next_preorder_skip(target, node, &levels_up);
+		for (; levels_up > 0; levels_up--)
+			clone_parent = clone_parent->parent;
 	}
 
 	return result;
 }
 
+/* The predicate is called on each child just before (and only if) that child
+ * would be visited by the recursive algorithm, i.e. in pre-order: some
+ * predicates (see e.g. prune.c) rely on their parent having been evaluated
+ * first. Splicing out the clones that end up with a single child is done
+ * afterwards, bottom-up. */
+
 struct rnode *clone_rnode_cond(struct rnode *target,
 		bool (*predicate)(struct rnode *, void *param), void *param)
 {
-	struct rnode *result = create_rnode(target->label,
-			target->edge_length_as_string);
-	if (NULL == result) return NULL;
-
-	struct rnode *kid = target->first_child;
-	for (; NULL != kid; kid = kid->next_sibling) {
-		if (predicate(kid, param)) {
-			struct rnode *kid_clone =
-				clone_rnode_cond(kid, predicate, param);
-			add_child(result, kid_clone);
+	int max_count = subtree_node_count(target);
+	if (! reserve_rnodes(max_count)) return NULL;
+
+	/* pre-order lists of the cloned nodes and of their clones */
+	struct rnode **originals = malloc(max_count * sizeof(struct rnode *));
+	if (NULL == originals) return NULL;
+	struct rnode **clones = malloc(max_count * sizeof(struct rnode *));
+	if (NULL == clones) { free(originals); return NULL; }
+	int count = 0;
+
+	struct rnode *result = NULL;
+	struct rnode *clone_parent = NULL;
+	struct rnode *node = target;
+	int levels_up;
+
+	while (NULL != node) {
+		bool cloned = (node == target || predicate(node, param));
+		if (cloned) {
+			struct rnode *clone = create_rnode(node->label,
+					node->edge_length_as_string);
+			if (NULL == clone) {
+				free(originals);
+				free(clones);
+				return NULL;
+			}
+			if (NULL == clone_parent)
+				result = clone;
+			else
+				add_child(clone_parent, clone);
+			originals[count] = node;
+			clones[count] = clone;
+			count++;
+
+			if (! is_leaf(node)) {
+				clone_parent = clone;
+				node = node->first_child;
+				continue;
+			}
 		}
+		node = next_preorder_skip(target, node, &levels_up);
+		for (; levels_up > 0; levels_up--)
+			clone_parent = clone_parent->parent;
 	}
 
-	if (1 == children_count(result) &&
-	    1 != children_count(target))
-	{
+	/* Reverse pre-order visits children before their parent. A clone
+	 * that kept only one child (of several) is replaced by that child,
+	 * whose edge gets the combined length. */
+	int i;
+	for (i = count - 1; i >= 0; i--) {
+		struct rnode *clone = clones[i];
+		if (1 != children_count(clone) ||
+		    1 == children_count(originals[i]))
+			continue;
+		struct rnode *kid = clone->first_child;
 		char *new_edge_len_s = add_len_strings(
-			result->first_child->edge_length_as_string,
-			result->edge_length_as_string);
-		if (NULL == new_edge_len_s) return NULL;
-		free(result->first_child->edge_length_as_string);
-		result->first_child->edge_length_as_string = new_edge_len_s;
-		return result->first_child;
+			kid->edge_length_as_string,
+			clone->edge_length_as_string);
+		if (NULL == new_edge_len_s) {
+			free(originals);
+			free(clones);
+			return NULL;
+		}
+		free(kid->edge_length_as_string);
+		kid->edge_length_as_string = new_edge_len_s;
+		if (is_root(clone)) {
+			kid->parent = NULL;
+			kid->next_sibling = NULL;
+			result = kid;
+		} else {
+			replace_child(clone, kid);
+		}
 	}
 
+	free(originals);
+	free(clones);
 	return result;
 }
 
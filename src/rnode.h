@@ -65,6 +65,9 @@ struct rnode {
 	/** Used by lua_ed to skip nodes */
 	bool seen;	// TODO: rename to 'marked' (more multi-purpose)'
 	bool linked;
+	/** The node's number in its tree's cached stats (see tree_stats.h),
+	 * -1 if none was assigned. */
+	int index;
 
 };
 
@@ -84,6 +87,16 @@ struct rnode *create_rnode(char *label, char *length_as_string);
 
 void destroy_all_rnodes();
 
+/* Like destroy_all_rnodes(), but keeps the nodes' storage (the structures and
+ * their label and length strings) for reuse by create_rnode(). When processing
+ * a stream of trees, calling this between trees instead of
+ * destroy_all_rnodes() spares most of the per-node malloc() and free() calls.
+ * Node data is freed as by destroy_all_rnodes(). Call destroy_all_rnodes()
+ * at the end to release everything. */
+/* NOTE: as with destroy_all_rnodes(), all nodes become invalid. */
+
+void recycle_all_rnodes(void (*free_data)(void *));
+
 /* returns the number of children a node has. */
 
 int children_count(struct rnode *node);
@@ -37,6 +37,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "list.h"
 #include "rnode.h"
 #include "tree.h"
+#include "common.h"
 
 /* Some debugging macros. Compile with -DDEBUG_ITERATOR and the addresses and
  * labels of the next nodes (as returned by rnode_iterator_next()) will be
@@ -214,3 +215,178 @@ struct rnode *rnode_iterator_next_sibling(struct rnode_iterator *iter)
 	SHOW;
 	return iter->current;
 }
+
+/* Stack iterator. Each stack frame holds a node on the path from the root to
+ * the current node, and the next of its children to visit (NULL if all have
+ * been visited). */
+
+struct rnode_stack_frame {
+	struct rnode *node;
+	struct rnode *next_child;
+};
+
+struct rnode_stack_iterator
+{
+	struct rnode *root;
+	enum rnode_traversal order;
+	struct rnode_stack_frame *stack;
+	int stack_size;		/* allocated frames */
+	int top;		/* index of top frame, -1 iff stack is empty */
+	bool started;
+	bool error;
+	/* describe the last returned node */
+	struct rnode_stack_frame *current;
+	int current_depth;
+	bool first_visit;
+};
+
+static const int rnode_stack_init_size = 64;
+
+struct rnode_stack_iterator *create_rnode_stack_iterator(struct rnode *root,
+		enum rnode_traversal order)
+{
+	struct rnode_stack_iterator *iter =
+		malloc(sizeof(struct rnode_stack_iterator));
+	if (NULL == iter) return NULL;
+	iter->stack = malloc(rnode_stack_init_size *
+			sizeof(struct rnode_stack_frame));
+	if (NULL == iter->stack) { free(iter); return NULL; }
+
+	iter->root = root;
+	iter->order = order;
+	iter->stack_size = rnode_stack_init_size;
+	iter->top = -1;
+	iter->started = false;
+	iter->error = false;
+	iter->current = NULL;
+	iter->current_depth = -1;
+	iter->first_visit = false;
+
+	return iter;
+}
+
+void destroy_rnode_stack_iterator(struct rnode_stack_iterator *iter)
+{
+	free(iter->stack);
+	free(iter);
+}
+
+/* Pushes 'node' on the stack. Returns FAILURE iff the stack must grow but
+ * cannot. */
+
+static int push_frame(struct rnode_stack_iterator *iter, struct rnode *node)
+{
+	if (iter->top + 1 == iter->stack_size) {
+		int new_size = 2 * iter->stack_size;
+		struct rnode_stack_frame *new_stack = realloc(iter->stack,
+				new_size * sizeof(struct rnode_stack_frame));
+		if (NULL == new_stack) {
+			iter->error = true;
+			return FAILURE;
+		}
+		iter->stack = new_stack;
+		iter->stack_size = new_size;
+	}
+	iter->top++;
+	iter->stack[iter->top].node = node;
+	iter->stack[iter->top].next_child = node->first_child;
+	return SUCCESS;
+}
+
+/* Sets the iterator's 'current' node to the top of the stack */
+
+static struct rnode *return_top(struct rnode_stack_iterator *iter,
+		bool first_visit)
+{
+	iter->current = &(iter->stack[iter->top]);
+	iter->current_depth = iter->top;
+	iter->first_visit = first_visit;
+	return iter->current->node;
+}
+
+/* Descends into the top frame's next child, if any. Returns true IFF there
+ * was such a child (it is then on top of the stack). */
+
+static bool descend(struct rnode_stack_iterator *iter)
+{
+	struct rnode_stack_frame *frame = &(iter->stack[iter->top]);
+	struct rnode *kid = frame->next_child;
+	if (NULL == kid) return false;
+	/* NOTE: don't rely on the last child's next_sibling being NULL (see
+	 * add_child()) */
+	if (kid == frame->node->last_child)
+		frame->next_child = NULL;
+	else
+		frame->next_child = kid->next_sibling;
+	if (! push_frame(iter, kid)) return false;
+	return true;
+}
+
+struct rnode *rnode_stack_iterator_next(struct rnode_stack_iterator *iter)
+{
+	if (iter->error) return NULL;
+
+	if (! iter->started) {
+		iter->started = true;
+		if (! push_frame(iter, iter->root)) return NULL;
+		if (RNODE_POSTORDER != iter->order)
+			return return_top(iter, true);
+	} else if (RNODE_POSTORDER == iter->order && iter->top >= 0) {
+		/* the last returned node was on top: it's done */
+		iter->top--;
+	}
+
+	switch (iter->order) {
+	case RNODE_PREORDER:
+		/* go down to the next unvisited child of the deepest node that
+		 * has one */
+		while (iter->top >= 0) {
+			if (descend(iter)) return return_top(iter, true);
+			if (iter->error) return NULL;
+			iter->top--;
+		}
+		break;
+	case RNODE_POSTORDER:
+		/* go down to the leftmost unvisited leaf, or return the
+		 * top node if all its children have been visited. */
+		if (iter->top < 0) break;
+		while (descend(iter))
+			;
+		if (iter->error) return NULL;
+		return return_top(iter, true);
+	case RNODE_EULER_TOUR:
+		if (iter->top < 0) break;
+		if (descend(iter)) return return_top(iter, true);
+		if (iter->error) return NULL;
+		/* all children visited: back to parent, if any */
+		iter->top--;
+		if (iter->top >= 0) return return_top(iter, false);
+		break;
+	default:
+		assert(0);
+	}
+
+	iter->current = NULL;
+	iter->current_depth = -1;
+	return NULL;
+}
+
+bool rnode_stack_iterator_first_visit(struct rnode_stack_iterator *iter)
+{
+	return iter->first_visit;
+}
+
+bool rnode_stack_iterator_more_children(struct rnode_stack_iterator *iter)
+{
+	return NULL != iter->current && NULL != iter->current->next_child;
+}
+
+int rnode_stack_iterator_depth(struct rnode_stack_iterator *iter)
+{
+	return iter->current_depth;
+}
+
+bool rnode_stack_iterator_error(struct rnode_stack_iterator *iter)
+{
+	return iter->error;
+}
@@ -98,3 +98,57 @@ bool more_children_to_visit (struct rnode_iterator *);
  * state. */
 
 struct rnode *rnode_iterator_next_sibling(struct rnode_iterator *iter);
+
+/* An alternative iterator that keeps its state (the path from its root to the
+ * current node) on a stack of its own, instead of in the nodes. It therefore
+ * never writes to the tree, so that any number of these iterators can traverse
+ * the same (sub)tree at the same time - including from different threads, as
+ * long as no one modifies the tree meanwhile. It is also cache-friendlier,
+ * since visiting a node does not dirty it. */
+
+/* The order in which a stack iterator returns the nodes. In pre- and
+ * post-order, each node is returned exactly once. In an Euler tour, a node is
+ * returned when it is first reached, and again after each of its children has
+ * been visited (so an inner node is returned 1 + <number of children> times,
+ * and a leaf once). */
+
+enum rnode_traversal { RNODE_PREORDER, RNODE_POSTORDER, RNODE_EULER_TOUR };
+
+struct rnode_stack_iterator;
+
+/* Creates a stack iterator on 'root' and its descendants. */
+/* Returns NULL in case of malloc() problems. */
+
+struct rnode_stack_iterator *create_rnode_stack_iterator(struct rnode *root,
+		enum rnode_traversal order);
+
+/* Destroys the iterator (but of course not the tree). */
+
+void destroy_rnode_stack_iterator(struct rnode_stack_iterator *);
+
+/* Returns the next node, or NULL when the traversal is over (or in case of
+ * malloc() problems while growing the stack - see
+ * rnode_stack_iterator_error()). */
+
+struct rnode *rnode_stack_iterator_next(struct rnode_stack_iterator *);
+
+/* Returns true IFF the node last returned by rnode_stack_iterator_next() has
+ * just been reached for the first time (always true in pre- and post-order,
+ * false in an Euler tour when returning to a node from one of its
+ * children). */
+
+bool rnode_stack_iterator_first_visit(struct rnode_stack_iterator *);
+
+/* Returns true IFF the node last returned by rnode_stack_iterator_next() has
+ * children that have not yet been visited. */
+
+bool rnode_stack_iterator_more_children(struct rnode_stack_iterator *);
+
+/* Returns the depth (number of edges from the iterator's root) of the node last
+ * returned by rnode_stack_iterator_next(). */
+
+int rnode_stack_iterator_depth(struct rnode_stack_iterator *);
+
+/* Returns true IFF the iterator stopped because of a malloc() problem. */
+
+bool rnode_stack_iterator_error(struct rnode_stack_iterator *);
@@ -0,0 +1,299 @@
+/* 
+
+Copyright (c) 2009 Thomas Junier and Evgeny Zdobnov, University of Geneva
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+* Neither the name of the University of Geneva nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "rooting.h"
+#include "tree.h"
+#include "tree_stats.h"
+#include "rnode.h"
+#include "masprintf.h"
+#include "common.h"
+
+/* Returns the edge lengths, by node index (the root's is 0), or NULL if some
+ * (non-root) edge has no length or in case of malloc() problems - '*status'
+ * tells which. */
+
+static double *edge_lengths(struct tree_stats *stats,
+		enum root_pos_status *status)
+{
+	double *lengths = malloc(stats->nb_nodes * sizeof(double));
+	if (NULL == lengths) {
+		*status = ROOT_POS_MEM_ERROR;
+		return NULL;
+	}
+	int i;
+	for (i = 0; i < stats->nb_nodes - 1; i++) {
+		char *length = stats->nodes[i]->edge_length_as_string;
+		if ('\0' == length[0]) {
+			free(lengths);
+			*status = ROOT_POS_NOT_PHYLOGRAM;
+			return NULL;
+		}
+		lengths[i] = atof(length);
+	}
+	lengths[stats->nb_nodes - 1] = 0;	/* root */
+	*status = ROOT_POS_OK;
+	return lengths;
+}
+
+/* Sets 'position' to the point on the edge above 'node' at distance
+ * 'length_above' - or to the root, if that is where the point is. */
+
+static void set_position(struct root_position *position, struct rnode *node,
+		double length, double length_above)
+{
+	if (length_above >= length && is_root(node->parent))
+		position->node = NULL;
+	else
+		position->node = node;
+	position->length_above = length_above;
+}
+
+enum root_pos_status midpoint_root_position(struct rooted_tree *tree,
+		struct root_position *position)
+{
+	position->node = NULL;
+	position->length_above = 0;
+
+	struct tree_stats *stats = get_tree_stats(tree);
+	if (NULL == stats) return ROOT_POS_MEM_ERROR;
+	enum root_pos_status status;
+	double *lengths = edge_lengths(stats, &status);
+	if (NULL == lengths) return status;
+	int n = stats->nb_nodes;
+	/* height of each node's subtree, and the child it is reached through */
+	double *height = malloc(n * sizeof(double));
+	struct rnode **deepest = malloc(n * sizeof(struct rnode *));
+	if (NULL == height || NULL == deepest) {
+		free(lengths); free(height); free(deepest);
+		return ROOT_POS_MEM_ERROR;
+	}
+
+	/* First pass (bottom-up): the longest path whose highest node is
+	 * 'node' goes down through its two "deepest" children. */
+	double diameter = -1;
+	struct rnode *side1 = NULL;	/* the path's deeper side */
+	double height1 = 0, height2 = 0;
+	int i;
+	for (i = 0; i < n; i++) {
+		struct rnode *node = stats->nodes[i];
+		height[i] = 0;
+		deepest[i] = NULL;
+		if (is_leaf(node)) continue;
+		struct rnode *second = NULL;
+		double second_height = 0;
+		struct rnode *kid;
+		for (kid = node->first_child; ; kid = kid->next_sibling) {
+			double h = height[kid->index] + lengths[kid->index];
+			if (NULL == deepest[i] || h > height[i]) {
+				second = deepest[i];
+				second_height = height[i];
+				deepest[i] = kid;
+				height[i] = h;
+			} else if (NULL == second || h > second_height) {
+				second = kid;
+				second_height = h;
+			}
+			if (kid == node->last_child) break;
+		}
+		if (NULL != second && height[i] + second_height > diameter) {
+			diameter = height[i] + second_height;
+			side1 = deepest[i];
+			height1 = height[i];
+			height2 = second_height;
+		}
+	}
+
+	/* Second pass (top-down, along the path): the midpoint is on the
+	 * deeper side, (height1 - height2) / 2 below the path's top. */
+	if (NULL != side1) {
+		double remaining = (height1 - height2) / 2;
+		struct rnode *node = side1;
+		while (remaining > lengths[node->index] &&
+				NULL != deepest[node->index]) {
+			remaining -= lengths[node->index];
+			node = deepest[node->index];
+		}
+		double length = lengths[node->index];
+		if (remaining > length) remaining = length;
+		set_position(position, node, length, length - remaining);
+	}
+
+	free(lengths);
+	free(height);
+	free(deepest);
+	return ROOT_POS_OK;
+}
+
+/* The root-to-leaf distances, with the root on the edge above a node at
+ * distance x from it, are x + (distances from the node to the s leaves below
+ * it) and (l - x) + (distances from the node's parent to the m other leaves),
+ * where l is the edge's length. So their variance is a quadratic function of
+ * x, which we can minimize on each edge if we know the sums of these
+ * distances and of their squares. The sums for the leaves below each node are
+ * found bottom-up, and those for the other leaves top-down. */
+
+enum root_pos_status min_var_root_position(struct rooted_tree *tree,
+		struct root_position *position)
+{
+	position->node = NULL;
+	position->length_above = 0;
+
+	struct tree_stats *stats = get_tree_stats(tree);
+	if (NULL == stats) return ROOT_POS_MEM_ERROR;
+	enum root_pos_status status;
+	double *lengths = edge_lengths(stats, &status);
+	if (NULL == lengths) return status;
+	int n = stats->nb_nodes;
+	/* sums of distances (and squares) from each node to the leaves below
+	 * it, and from its parent to the leaves not below it */
+	double *sum_in = malloc(n * sizeof(double));
+	double *sq_in = malloc(n * sizeof(double));
+	double *sum_out = malloc(n * sizeof(double));
+	double *sq_out = malloc(n * sizeof(double));
+	if (NULL == sum_in || NULL == sq_in || NULL == sum_out ||
+			NULL == sq_out) {
+		free(lengths); free(sum_in); free(sq_in);
+		free(sum_out); free(sq_out);
+		return ROOT_POS_MEM_ERROR;
+	}
+
+	int *nb_leaves = stats->nb_leaves;
+	int i;
+	for (i = 0; i < n; i++) {
+		struct rnode *node = stats->nodes[i];
+		sum_in[i] = sq_in[i] = 0;
+		if (is_leaf(node)) continue;
+		struct rnode *kid;
+		for (kid = node->first_child; ; kid = kid->next_sibling) {
+			int k = kid->index;
+			double l = lengths[k];
+			sum_in[i] += sum_in[k] + l * nb_leaves[k];
+			sq_in[i] += sq_in[k] + 2 * l * sum_in[k] +
+				l * l * nb_leaves[k];
+			if (kid == node->last_child) break;
+		}
+	}
+
+	int root = n - 1;
+	double N = nb_leaves[root];
+	sum_out[root] = sq_out[root] = 0;
+	double best_var = 0;
+	for (i = n - 2; i >= 0; i--) {
+		struct rnode *node = stats->nodes[i];
+		int p = node->parent->index;
+		double l = lengths[i];
+		double s = nb_leaves[i];
+		double m = N - s;
+
+		/* distances from the parent to all leaves */
+		double sum_all = sum_in[p], sq_all = sq_in[p];
+		if (p != root) {
+			double lp = lengths[p];
+			double mp = N - nb_leaves[p];
+			sum_all += sum_out[p] + lp * mp;
+			sq_all += sq_out[p] + 2 * lp * sum_out[p] +
+				lp * lp * mp;
+		}
+		sum_out[i] = sum_all - (sum_in[i] + l * s);
+		sq_out[i] = sq_all - (sq_in[i] + 2 * l * sum_in[i] +
+				l * l * s);
+
+		if (0 == m) continue;	/* the root's only child */
+		/* variance = a x^2 + b x + c */
+		double c0 = sum_in[i] + sum_out[i] + m * l;
+		double c1 = s - m;
+		double q0 = sq_in[i] + sq_out[i] + 2 * l * sum_out[i] +
+			m * l * l;
+		double q1 = 2 * sum_in[i] - 2 * sum_out[i] - 2 * m * l;
+		double a = 1 - (c1 * c1) / (N * N);
+		double b = q1 / N - 2 * c0 * c1 / (N * N);
+		double c = q0 / N - (c0 * c0) / (N * N);
+		double x = a > 0 ? -b / (2 * a) : 0;
+		if (x > l) x = l;
+		if (x < 0) x = 0;
+		double var = a * x * x + b * x + c;
+		if (NULL == position->node || var < best_var) {
+			best_var = var;
+			position->node = node;
+			position->length_above = x;
+		}
+	}
+	if (NULL != position->node) {
+		struct rnode *node = position->node;
+		set_position(position, node, lengths[node->index],
+				position->length_above);
+	}
+
+	free(lengths); free(sum_in); free(sq_in);
+	free(sum_out); free(sq_out);
+	return ROOT_POS_OK;
+}
+
+int reroot_at_position(struct rooted_tree *tree,
+		struct root_position *position, bool i_node_lbl_as_support)
+{
+	struct rnode *node = position->node;
+	if (NULL == node) return SUCCESS;
+
+	double length = atof(node->edge_length_as_string);
+	struct rnode *parent = node->parent;
+	struct rnode *other;
+	double other_length;
+	if (is_root(parent) && 2 == parent->child_count) {
+		/* Already rooted on that edge: only the lengths change (and the
+		 * order of the root's children does not). */
+		other = parent->first_child == node ?
+			parent->last_child : parent->first_child;
+		other_length = atof(other->edge_length_as_string) + length -
+			position->length_above;
+	} else {
+		if (! reroot_tree(tree, node, i_node_lbl_as_support))
+			return FAILURE;
+		other = tree->root->first_child == node ?
+			tree->root->last_child : tree->root->first_child;
+		other_length = length - position->length_above;
+	}
+
+	char *node_length_str = masprintf("%g", position->length_above);
+	char *other_length_str = masprintf("%g", other_length);
+	if (NULL == node_length_str || NULL == other_length_str) return FAILURE;
+	free(node->edge_length_as_string);
+	node->edge_length_as_string = node_length_str;
+	free(other->edge_length_as_string);
+	other->edge_length_as_string = other_length_str;
+	invalidate_tree_stats(tree);
+
+	return SUCCESS;
+}
@@ -0,0 +1,74 @@
+/* 
+
+Copyright (c) 2009 Thomas Junier and Evgeny Zdobnov, University of Geneva
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+* Neither the name of the University of Geneva nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/* Root positions computed from branch lengths: midpoint rooting (the root is
+ * halfway along the longest leaf-to-leaf path) and minimum-variance rooting
+ * (the root minimizes the variance of the root-to-leaf distances). Both take
+ * a constant number of passes over the tree, whatever its size.
+ *
+ * Finding a position does not change the tree (nor allocate any rnode), so
+ * it can be done for several trees at the same time, in different threads;
+ * rerooting the tree at that position cannot. */
+
+#include <stdbool.h>
+
+struct rooted_tree;
+struct rnode;
+
+enum root_pos_status { ROOT_POS_OK, ROOT_POS_NOT_PHYLOGRAM,
+	ROOT_POS_MEM_ERROR };
+
+/* A point on a tree: on the edge above 'node', at distance 'length_above'
+ * from it. If 'node' is NULL, the point is the current root. */
+
+struct root_position {
+	struct rnode *node;
+	double length_above;
+};
+
+/* Finds the midpoint of the longest path between two leaves. All edges
+ * (except the root's) must have a length. */
+
+enum root_pos_status midpoint_root_position(struct rooted_tree *tree,
+		struct root_position *position);
+
+/* Finds the point that minimizes the variance of the distances to the
+ * leaves. All edges (except the root's) must have a length. */
+
+enum root_pos_status min_var_root_position(struct rooted_tree *tree,
+		struct root_position *position);
+
+/* Reroots 'tree' at 'position' (which must have been computed on 'tree' as
+ * it is now), setting the new root's edge lengths accordingly. Does nothing
+ * if the position is the current root. The last argument is as for
+ * reroot_tree(). Returns FAILURE in case of malloc() problems. */
+
+int reroot_at_position(struct rooted_tree *tree,
+		struct root_position *position, bool i_node_lbl_as_support);
@@ -7,7 +7,7 @@ static const int DEFAULT_SET_SIZE = 100;
 
 set_t* create_set()
 {
-	return create_hash(DEFAULT_SET_SIZE);
+	return create_dynamic_hash(DEFAULT_SET_SIZE, 0.75, 2);
 }
 
 int set_cardinal(set_t *s) { return s->count; }
@@ -251,9 +251,10 @@ int main (int argc, char* argv[])
 	struct rooted_tree *tree;
 	while ((tree = parse_tree()) != NULL) {
 		process_tree(tree, params.output_function);
-		destroy_all_rnodes(NULL);
+		recycle_all_rnodes(NULL);
 		destroy_tree(tree);
 	}
+	destroy_all_rnodes(NULL);
 
 	return 0;
 }
@@ -43,21 +43,30 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "list.h"
 #include "hash.h"
 #include "rnode.h"
-#include "node_set.h"
 #include "to_newick.h"
+#include "bipart.h"
+#include "consensus.h"
+#include "tree_stats.h"
+#include "masprintf.h"
 #include "common.h"
 
 extern FILE *nwsin;
 
-static struct hash *lbl2num = NULL;
-static struct hash *bipart_counts = NULL;
-static int num_leaves;
+/* Counts of the replicates' clusters: either computed from the replicates, or
+ * read from an index file (-i) */
+static struct bipart_leaves *leaves = NULL;
+static struct bipart_counts *bipart_counts = NULL;
+static struct bipart_index *bipart_index = NULL;
 
 struct parameters {
 	FILE * target_tree_file;
 	FILE * rep_trees_file;
 	bool show_label_numbers;
 	bool use_percent;
+	bool consensus;
+	enum consensus_type consensus_type;
+	char *index_in;		/* NULL unless -i */
+	char *index_out;	/* NULL unless -w */
 };
 
 void help(char* argv[])
@@ -68,6 +77,9 @@ void help(char* argv[])
 "Synopsis\n"
 "--------\n"
 "%s [-ph] <target tree filename|-> <replicate trees filename>\n"
+"%s -c <s|m|e> [-p] <replicate trees filename|->\n"
+"%s -w <index filename> <replicate trees filename|->\n"
+"%s -i <index filename> [-p] <target tree filename|->\n"
 "\n"
 "Input\n"
 "-----\n"
@@ -78,16 +90,40 @@ void help(char* argv[])
 "\n"
 "The second argument is the name of the file containing the replicates.\n"
 "\n"
+"With -c or -w, the only argument is the name of the file containing the\n"
+"replicates (or '-', for standard input). With -i, the only argument is the\n"
+"name of the file containing the target tree(s), and the replicates are not\n"
+"read at all: their bipartition counts are taken from the index file, which\n"
+"is much faster when many target trees are to be annotated against the same\n"
+"replicates.\n"
+"\n"
 "Output\n"
 "------\n"
 "\n"
 "Outputs the target tree, with a bipartition frequencies as inner node labels.\n"
 "\n"
+"With -c, outputs a consensus tree of the replicates instead, with the\n"
+"frequencies of its bipartitions as inner node labels, and without branch\n"
+"lengths. The consensus is unrooted: it is printed with the first leaf (in\n"
+"lexical order) as a child of the root.\n"
+"\n"
+"With -w, outputs nothing: the replicates' bipartition counts are written to\n"
+"the index file (a binary file, which can only be read on the same kind of\n"
+"machine).\n"
+"\n"
 "Options\n"
 "-------\n"
 "\n"
+"    -c <type>: computes a consensus tree of the replicates (see Output).\n"
+"       Type is one of:\n"
+"         s: strict (bipartitions found in all replicates)\n"
+"         m: majority-rule (bipartitions found in more than half)\n"
+"         e: extended majority-rule: majority-rule, then adds the most\n"
+"            frequent bipartitions that are compatible with the tree\n"
 "    -h: prints this message and exits\n"
+"    -i <file>: reads bipartition counts from an index file made with -w\n"
 "    -p: prints values as percentages (default: absolute frequencies)\n"
+"    -w <file>: writes the replicates' bipartition counts to an index file\n"
 "\n"
 "Limits & Assumptions\n"
 "--------------------\n"
@@ -100,12 +136,36 @@ void help(char* argv[])
 "\n"
 "# Attributes bipartition counts to data/HRV.nw, based on 20 replicates\n"
 "# stored in data/HRV_20reps.nw\n"
-"$ %s data/HRV.nw data/HRV_20reps.nw\n",
+"$ %s data/HRV.nw data/HRV_20reps.nw\n"
+"\n"
+"# Same, but saving the counts first\n"
+"$ %s -w HRV_20reps.idx data/HRV_20reps.nw\n"
+"$ %s -i HRV_20reps.idx data/HRV.nw\n"
+"\n"
+"# Majority-rule consensus of the same replicates\n"
+"$ %s -c m data/HRV_20reps.nw\n",
+	argv[0],
+	argv[0],
+	argv[0],
+	argv[0],
+	argv[0],
+	argv[0],
 	argv[0],
 	argv[0]
 	      );
 }
 
+static FILE *open_trees_file(char *filename)
+{
+	if (0 == strcmp("-", filename)) return stdin;
+	FILE *file = fopen(filename, "r");
+	if (NULL == file) {
+		perror(NULL);
+		exit(EXIT_FAILURE);
+	}
+	return file;
+}
+
 struct parameters get_params(int argc, char *argv[])
 {
 	struct parameters params;
@@ -113,13 +173,39 @@ struct parameters get_params(int argc, char *argv[])
 
 	params.show_label_numbers = false;
 	params.use_percent = false;
+	params.consensus = false;
+	params.index_in = NULL;
+	params.index_out = NULL;
+	params.target_tree_file = NULL;
+	params.rep_trees_file = NULL;
 
 	/* parse options and switches */
-	while ((opt_char = getopt(argc, argv, "hlp")) != -1) {
+	while ((opt_char = getopt(argc, argv, "c:hi:lpw:")) != -1) {
 		switch (opt_char) {
+		case 'c':
+			params.consensus = true;
+			switch (optarg[0]) {
+			case 's':
+				params.consensus_type = CONSENSUS_STRICT;
+				break;
+			case 'm':
+				params.consensus_type = CONSENSUS_MAJORITY;
+				break;
+			case 'e':
+				params.consensus_type = CONSENSUS_EXTENDED;
+				break;
+			default:
+				fprintf(stderr, "Unknown consensus type '%s' "
+					"(should be s, m or e)\n", optarg);
+				exit(EXIT_FAILURE);
+			}
+			break;
 		case 'h':
 			help(argv);
 			exit(EXIT_SUCCESS);
+		case 'i':
+			params.index_in = optarg;
+			break;
 		/* we keep this for debugging, but not documented */
 		case 'l':
 			params.show_label_numbers = true;
@@ -127,20 +213,27 @@ struct parameters get_params(int argc, char *argv[])
 		case 'p':
 			params.use_percent = true;
 			break;
+		case 'w':
+			params.index_out = optarg;
+			break;
 		}
 	}
+	int modes = params.consensus + (NULL != params.index_in) +
+		(NULL != params.index_out);
+	if (modes > 1) {
+		fprintf(stderr, "Options -c, -i and -w are mutually "
+				"exclusive.\n");
+		exit(EXIT_FAILURE);
+	}
 	/* get arguments */
-	if (2 == (argc - optind))	{
-		if (0 != strcmp("-", argv[optind])) {
-			FILE *ttf = fopen(argv[optind], "r");
-			if (NULL == ttf) {
-				perror(NULL);
-				exit(EXIT_FAILURE);
-			}
-			params.target_tree_file = ttf;
-		} else {
-			params.target_tree_file = stdin;
-		}
+	if (1 == modes && 1 == (argc - optind)) {
+		FILE *file = open_trees_file(argv[optind]);
+		if (NULL != params.index_in)
+			params.target_tree_file = file;
+		else
+			params.rep_trees_file = file;
+	} else if (0 == modes && 2 == (argc - optind))	{
+		params.target_tree_file = open_trees_file(argv[optind]);
 		FILE *rtf = fopen(argv[optind+1], "r");
 		if (NULL == rtf) {
 			perror(NULL);
@@ -149,260 +242,220 @@ struct parameters get_params(int argc, char *argv[])
 		params.rep_trees_file = rtf;
 	} else {
 		fprintf(stderr, "Usage: %s [-hlp] <target tree filename|-> <replicates filename>\n", argv[0]);
+		fprintf(stderr, "       %s -c <s|m|e> [-p] <replicates filename|->\n", argv[0]);
+		fprintf(stderr, "       %s -w <index filename> <replicates filename|->\n", argv[0]);
+		fprintf(stderr, "       %s -i <index filename> [-p] <target tree filename|->\n", argv[0]);
 		exit(EXIT_FAILURE);
 	}
 
 	return params;
 }
 
-int init_lbl2num(struct rooted_tree *tree)
+static void bipart_error(enum bipart_status status, const char *what,
+		int tree_num)
 {
-	struct list_elem *el;
-	lbl2num = create_hash(num_leaves);
-	if (NULL == lbl2num) return FAILURE;
-	int n = 0;
-
-	for (el = tree->nodes_in_order->head; NULL != el; el = el->next) {
-		struct rnode *current = (struct rnode *) el->data;
-		if (! is_leaf(current)) { continue; }
-		int *num = malloc(sizeof(int));
-		if (NULL == num) return FAILURE;
-		*num = n;
-		if (! hash_set(lbl2num, current->label, num))
-			return FAILURE;
-		n++;
-	}	
-
-	return SUCCESS;
-}
-
-/* This could also be done with node_set_union(), but it's easier to write with
- * 'result' as an accumulator. */
-
-node_set union_of_child_node_sets(struct rnode *node)
-{
-	node_set result = create_node_set(num_leaves);
-	if (NULL == result) { perror(NULL); exit(EXIT_FAILURE); }
-	struct rnode *curr;
-
-	for (curr=node->first_child; NULL != curr; curr = curr->next_sibling) {
-		node_set child_node_set = (node_set) curr->data;
-		node_set_add_set(result, child_node_set, num_leaves);
+	switch (status) {
+	case BIPART_MEM_ERROR:
+	case BIPART_IO_ERROR:
+		perror(NULL);
+		break;
+	case BIPART_BAD_INDEX:
+		fprintf(stderr, "Not a valid index file.\n");
+		break;
+	default:
+		fprintf(stderr, "%s #%d: leaves must be uniquely labeled, "
+			"and the same in all trees.\n", what, tree_num);
 	}
-
-	return result;
+	exit(EXIT_FAILURE);
 }
 
-int add_bipart_count(const char *node_set_string)
-{
-	int *count = hash_get(bipart_counts, node_set_string);
-	if (NULL == count) {
-		int *num = malloc(sizeof(int));
-		if (NULL == num) {
-			perror(NULL);
-			exit(EXIT_FAILURE);
-		}
-		*num = 1;
-		if (! hash_set(bipart_counts, node_set_string, num))
-			return FAILURE;
-	} else {
-		(*count)++;
-	}
-
-	return SUCCESS;
-}
+/* Counts the clusters (if 'rooted') or the splits of the replicates. Each
+ * replicate is discarded once counted. Returns the number of replicates. */
 
-void compute_bipartitions(struct rooted_tree *tree)
+int count_biparts(bool rooted)
 {
-	struct list_elem *el;
-	
-	for (el = tree->nodes_in_order->head; NULL != el; el = el->next) {
-		struct rnode *current = (struct rnode *) el->data;
-		node_set set;
-		if (is_leaf(current)) {
-			int *num = hash_get(lbl2num, current->label);
-			if (NULL == num) {
-				fprintf(stderr,
-					"Label '%s' not found - aborting\n",
-					current->label);
-				exit(EXIT_FAILURE);
-			}
-			set = create_node_set(num_leaves);
-			if (NULL == set) {perror(NULL); exit(EXIT_FAILURE);}
-			node_set_add(set, *num, num_leaves);
-		} else {
-			set = union_of_child_node_sets(current);
-			char *node_set_string = node_set_to_s(set, num_leaves);
-			if (NULL == node_set_string) {
-				perror(NULL);
-				exit(EXIT_FAILURE);
-			}
-			if (! add_bipart_count(node_set_string)) {
+	struct rooted_tree *tree;
+	enum bipart_status status;
+	int rep_count = 0;
+
+	while (NULL != (tree = parse_tree())) {
+		rep_count++;
+		if (NULL == leaves) {
+			status = create_bipart_leaves(tree, &leaves);
+			if (BIPART_OK != status)
+				bipart_error(status, "Replicate", rep_count);
+			bipart_counts = create_bipart_counts(leaves->nb_words);
+			if (NULL == bipart_counts) {
 				perror(NULL);
 				exit(EXIT_FAILURE);
 			}
-			free(node_set_string);
 		}
-		current->data = set;
-	}
-}
-
-int process_tree(struct rooted_tree *tree)
-{
-	if (NULL == lbl2num) { /* first tree */
-		num_leaves = leaf_count(tree);
-		if (! init_lbl2num(tree)) return FAILURE;
-		bipart_counts = create_hash(num_leaves);
-		if (NULL == bipart_counts) return FAILURE;
-	}
-	compute_bipartitions(tree);
-	destroy_all_rnodes(NULL);
-	destroy_tree(tree);
-
-	return SUCCESS;
-}
-
-void show_bipartition_counts()
-{
-	struct llist *keys = hash_keys(bipart_counts);
-	struct list_elem *el;
-	assert(NULL != keys);
-
-	for (el = keys->head; NULL != el; el = el->next) {
-		char * key = (char *) el->data;
-		int * value = (int *) hash_get(bipart_counts, key);
-		printf ("%2d\t%s\n", *value, key);
+		struct bipart_set *set;
+		if (rooted)
+			status = get_cluster_set(tree, leaves, &set);
+		else
+			status = get_bipart_set(tree, leaves, &set);
+		if (BIPART_OK != status)
+			bipart_error(status, "Replicate", rep_count);
+		if (! add_bipart_counts(bipart_counts, set)) {
+			perror(NULL);
+			exit(EXIT_FAILURE);
+		}
+		destroy_bipart_set(set);
+		destroy_tree(tree);
+		recycle_all_rnodes(NULL);
 	}
 
-	destroy_llist(keys);
+	return rep_count;
 }
 
-/* A wrapper around strcmp() for passing to qsort() */
-
-int qsort_strcmp(const void *s1, const void *s2)
+static int cluster_count(uint64_t fingerprint)
 {
-	return strcmp(* (char **) s1, * (char **) s2);
+	if (NULL != bipart_index)
+		return bipart_index_count(bipart_index, fingerprint);
+	return get_bipart_count(bipart_counts, fingerprint);
 }
 
 void show_label_numbers()
 {
-	struct llist *keys = hash_keys(lbl2num);
-	struct list_elem *el;
-	int i = 0;
-	assert(NULL != keys);
-	assert(0 != keys->count);
-
-	char **labels = malloc(keys->count * sizeof(char *));
-	if (NULL == labels) {
-		perror(NULL);
-		exit(EXIT_FAILURE);
-	}
-	for (el = keys->head; NULL != el; el = el->next) {
-		char * key = (char *) el->data;
-		labels[i++] = key;
+	int i;
+	for (i = 0; i < leaves->nb_leaves; i++) {
+		printf ("%d: %s\n", i, leaves->labels[i]);
 	}
-	qsort(labels, keys->count, sizeof(char *), qsort_strcmp);
-	for (i = 0; i < keys->count; i++) {
-		printf ("%d: %s\n", i, labels[i]);
-	}
-	destroy_llist(keys);
-	free(labels);
 }
 
 /* Attributes support values to inner nodes. Argument is the tree, and the
  * number of replicates. If this number is > 0, the counts will be expressed as
  * percentages of it. Otherwise, the counts will be absolute. */
 
-void attribute_support_to_target_tree(struct rooted_tree *tree, int rep_count)
+void attribute_support_to_target_tree(struct rooted_tree *tree, int rep_count,
+		int tree_num)
 {
-	/* # of digits for bipart count - need this to know string length */
-	/* e.g. if count = 143, need 3 characters */
-	int max_count_length;
-       	if (0 == rep_count)	/* percent: 3 chars or less */
-		max_count_length = 3;
-	else
-		max_count_length = log10(bipart_counts->count) + 1;	
-	struct list_elem *el;
-	
-	for (el = tree->nodes_in_order->head; NULL != el; el = el->next) {
-		struct rnode *current = (struct rnode *) el->data;
-		node_set set;
-		if (is_leaf(current)) {
-			int *num = (int *) hash_get(lbl2num, current->label);
-			assert (NULL != num);
-			set = create_node_set(num_leaves);
-			if (NULL == set) {perror(NULL); exit(EXIT_FAILURE);}
-			node_set_add(set, *num, num_leaves);
-		} else {
-			set = union_of_child_node_sets(current);
-			char *node_set_string = node_set_to_s(set, num_leaves);
-			if (NULL == node_set_string) {
-				perror(NULL);
-				exit(EXIT_FAILURE);
-			}
-			int * count_p = hash_get(bipart_counts, node_set_string);
-			int count;
-			if (NULL == count_p) {
-				fprintf(stderr, "WARNING: zero bipart count for %s\n",
-						node_set_string);
-				count = 0;
-			}
-			else {
-				count = *count_p;
-			}
-			/* + 1 for '\0' */
-			char * lbl = malloc(max_count_length * sizeof(char) + 1);
-			if (NULL == lbl) {
+	uint64_t *clusters;
+	enum bipart_status status = get_node_clusters(tree, leaves, &clusters);
+	if (BIPART_OK != status) bipart_error(status, "Target tree", tree_num);
+	struct tree_stats *stats = tree->stats;
+	int nb_words = leaves->nb_words;
+	int i;
+
+	for (i = 0; i < stats->nb_nodes; i++) {
+		struct rnode *current = stats->nodes[i];
+		if (is_leaf(current)) continue;
+		uint64_t *cluster = clusters + (size_t) i * nb_words;
+		int count = cluster_count(bipart_fingerprint(cluster, nb_words));
+		if (0 == count) {
+			char *cluster_string = bits_to_s(cluster,
+					leaves->nb_leaves);
+			if (NULL == cluster_string) {
 				perror(NULL);
 				exit(EXIT_FAILURE);
 			}
-			free(current->label);
-			if (rep_count > 0) {	/* percent */
-				sprintf (lbl, "%d", 100 * count / rep_count);
-			} else {
-				sprintf (lbl, "%d", count);
-			}
-			current->label = lbl;
-			free(node_set_string);
+			fprintf(stderr, "WARNING: zero bipart count for %s\n",
+					cluster_string);
+			free(cluster_string);
+		}
+		char *lbl;
+		if (rep_count > 0) {	/* percent */
+			lbl = masprintf("%d", 100 * count / rep_count);
+		} else {
+			lbl = masprintf("%d", count);
+		}
+		if (NULL == lbl) {
+			perror(NULL);
+			exit(EXIT_FAILURE);
 		}
-		current->data = set;
+		free(current->label);
+		current->label = lbl;
+	}
+	free(clusters);
+}
+
+/* Consensus mode: unlike for attributing support, the splits are unrooted. */
+
+void print_consensus(struct parameters params)
+{
+	nwsin = params.rep_trees_file;
+	count_biparts(false);
+	if (NULL == bipart_counts) return;	/* no replicates */
+
+	struct rnode *root = consensus_tree(bipart_counts, leaves,
+			params.consensus_type, params.use_percent);
+	if (NULL == root) { perror(NULL); exit(EXIT_FAILURE); }
+	char *newick = to_newick(root);
+	printf("%s\n", newick);
+	free(newick);
+}
+
+void write_index(struct parameters params)
+{
+	nwsin = params.rep_trees_file;
+	count_biparts(true);
+	if (NULL == bipart_counts) {
+		fprintf(stderr, "No replicates - no index written.\n");
+		exit(EXIT_FAILURE);
 	}
+
+	FILE *index_file = fopen(params.index_out, "wb");
+	if (NULL == index_file) { perror(NULL); exit(EXIT_FAILURE); }
+	enum bipart_status status = save_bipart_index(bipart_counts, leaves,
+			index_file);
+	if (BIPART_OK != status) bipart_error(status, "", 0);
+	if (0 != fclose(index_file)) { perror(NULL); exit(EXIT_FAILURE); }
 }
 
 int main(int argc, char *argv[])
 {
 	struct rooted_tree *tree;	
 	struct parameters params = get_params(argc, argv);
-	
-	/* Build the bipartition counts hash, and counts the number of
-	 * replicates. */
-	nwsin = params.rep_trees_file;
-	int rep_count = 0;
-	while (NULL != (tree = parse_tree())) {
-		if (! process_tree(tree)) {
-			fprintf(stderr, "Could not process tree "
-				"(memory error) - exiting.\n");
-			exit(EXIT_FAILURE);
-		}
-		rep_count++;
-	}
 
-	if (! params.use_percent) { rep_count = 0; }
-
-	/* Attribute counts to the target trees */
-	nwsin = params.target_tree_file;
-	while ((tree = parse_tree()) != NULL) {
-		attribute_support_to_target_tree(tree, rep_count);
-		char *newick = to_newick(tree->root);
-		printf ("%s\n", newick);
-		free(newick);
-		if (params.show_label_numbers) show_label_numbers();
-		destroy_all_rnodes(NULL);
-		destroy_tree(tree);
+	if (params.consensus) {
+		print_consensus(params);
+	} else if (NULL != params.index_out) {
+		write_index(params);
+	} else {
+		int rep_count;
+		if (NULL != params.index_in) {
+			enum bipart_status status = load_bipart_index(
+					params.index_in, &bipart_index);
+			if (BIPART_OK != status) bipart_error(status, "", 0);
+			leaves = bipart_index->leaves;
+			rep_count = bipart_index->nb_trees;
+		} else {
+			/* Build the bipartition counts, and count the
+			 * number of replicates. */
+			nwsin = params.rep_trees_file;
+			rep_count = count_biparts(true);
+		}
+		if (! params.use_percent) { rep_count = 0; }
+
+		/* Attribute counts to the target trees */
+		nwsin = params.target_tree_file;
+		int tree_num = 0;
+		while ((tree = parse_tree()) != NULL) {
+			tree_num++;
+			if (NULL == leaves) {
+				fprintf(stderr, "No replicates.\n");
+				exit(EXIT_FAILURE);
+			}
+			attribute_support_to_target_tree(tree, rep_count,
+					tree_num);
+			char *newick = to_newick(tree->root);
+			printf ("%s\n", newick);
+			free(newick);
+			if (params.show_label_numbers) show_label_numbers();
+			destroy_tree(tree);
+			recycle_all_rnodes(NULL);
+		}
 	}
 
-	fclose(params.target_tree_file);
-	fclose(params.rep_trees_file);
+	if (NULL != bipart_index)
+		destroy_bipart_index(bipart_index);
+	else if (NULL != leaves)
+		destroy_bipart_leaves(leaves);
+	if (NULL != bipart_counts) destroy_bipart_counts(bipart_counts);
+	destroy_all_rnodes(NULL);
+	if (NULL != params.target_tree_file) fclose(params.target_tree_file);
+	if (NULL != params.rep_trees_file) fclose(params.rep_trees_file);
 
 	return 0;
 }
@@ -146,7 +146,6 @@ static int append_leaf(struct llist *result, struct rnode *current)
  * representing the end of an inner node. This always contains a ')', and may
  * also contain a label and a length (plus the node's address, if
  * show_addresses is true.) */
-/* Also, takes care of resetting the 'seen' member of the node. */
 /* Return value indicates SUCCESS or FAILURE. */
 
 static int append_inner_node_end(struct llist *result,
@@ -167,7 +166,6 @@ static int append_inner_node_end(struct llist *result,
 				strdup(current->edge_length_as_string)))
 			return FAILURE;
 	}
-	current->seen = 0;	/* reset */
 
 	return SUCCESS;
 }
@@ -176,18 +174,16 @@ static int append_inner_node_end(struct llist *result,
  * representing an inner node. */
 /* Return value indicates SUCCESS or FAILURE. */
 
-static int append_inner_node(struct rnode_iterator *it,
+static int append_inner_node(struct rnode_stack_iterator *it,
 		struct llist *result, struct rnode *current)
 {
-	/* inner node: behaviour depends on whether we've
-	 * already 'seen' this node or not. */
-	if (0 == current->seen) {
-		/* not seen: print '(' */
-		current->seen = 1;
+	/* inner node: behaviour depends on whether we're reaching this node
+	 * for the first time, or coming back from one of its children. */
+	if (rnode_stack_iterator_first_visit(it)) {
 		if (! append_element(result, strdup("(")))
 			return FAILURE;
 	} else {
-		if (more_children_to_visit(it)) {
+		if (rnode_stack_iterator_more_children(it)) {
 			if (! append_element(result, strdup(",")))
 				return FAILURE;
 		}
@@ -200,23 +196,22 @@ static int append_inner_node(struct rnode_iterator *it,
 	return SUCCESS;
 }
 
+/* An Euler tour returns each inner node once before its children, and once
+ * after each child, which is just what we need to place parentheses and
+ * commas. The stack iterator does not touch the nodes, so this function may
+ * be called on the same tree by several threads. */
+
 struct llist *to_newick_i(struct rnode *node)
 {
-	struct rnode_iterator *it;
+	struct rnode_stack_iterator *it;
 	struct rnode *current;
 	struct llist *result = create_llist();
+	if (NULL == result) return NULL;
 
-	it = create_rnode_iterator(node);
+	it = create_rnode_stack_iterator(node, RNODE_EULER_TOUR);
 	if (NULL == it) return NULL;
 	
-	struct rnode *it_root = get_rnode_iterator_root(it);
-	it_root->seen = 1;
-
-	if (! is_leaf(it_root))
-		if (! append_element(result, strdup("(")))
-			return NULL;
-
-	while ((current = rnode_iterator_next(it)) != NULL) {
+	while ((current = rnode_stack_iterator_next(it)) != NULL) {
 		if (is_leaf(current)) {
 			if (! append_leaf(result, current))
 				return NULL;
@@ -226,10 +221,11 @@ struct llist *to_newick_i(struct rnode *node)
 				return NULL;
 		}
 	}
+	if (rnode_stack_iterator_error(it)) return NULL;
 	if (! append_element(result, strdup(";")))
 		return NULL;
 
-	destroy_rnode_iterator(it);
+	destroy_rnode_stack_iterator(it);
 
 	return result;
 }
@@ -40,12 +40,26 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "tree.h"
 #include "rnode.h"
 #include "list.h"
+#include "hash.h"
+#include "order_tree.h"
 #include "common.h"
+#include "pipeline.h"
 
 struct parameters {
 	bool show_inner_labels;
 	bool show_leaf_labels;
 	bool show_branch_lengths;
+	bool count_topologies;
+	bool unrooted;
+	int nb_workers;
+};
+
+/* Number of trees with a given topology (-c) */
+
+struct topology_count {
+	int count;
+	int first_seen;		/* number of the first tree with it */
+	char *newick;		/* belongs to the hash */
 };
 
 void help(char *argv[])
@@ -56,7 +70,8 @@ void help(char *argv[])
 "Synopsis\n"
 "--------\n"
 "\n"
-"%s [-bhIL] <newick trees filename|->\n"
+"%s [-bhIL] [-j <processes>] <newick trees filename|->\n"
+"%s -c [-u] <newick trees filename|->\n"
 "\n"
 "Input\n"
 "-----\n"
@@ -70,13 +85,26 @@ void help(char *argv[])
 "By default, prints the input trees without branch lengths, effectively\n"
 "creating cladograms.\n"
 "\n"
+"With -c, prints the distinct topologies found in the input instead, one per\n"
+"line, preceded by the number of trees that have it and a TAB. Topologies are\n"
+"sorted by decreasing frequency (ties are broken by order of first\n"
+"appearance). Only the leaf labels and the tree's structure count (inner\n"
+"labels and branch lengths are ignored), and the order of children does not\n"
+"matter. Each topology is printed in a canonical form (children ordered by\n"
+"label, as by nw_order). Leaf labels are assumed to be unique.\n"
+"\n"
 "Options\n"
 "-------\n"
 "\n"
 "    -b: keep branch lengths\n"
+"    -c: count distinct topologies (see Output)\n"
 "    -h: print this message and exit\n"
 "    -I: discard inner node labels\n"
+"    -j <n>: process the trees in n processes (default: 1). The output is\n"
+"        the same, and in the same order. Ignored with -c.\n"
 "    -L: discard leaf labels\n"
+"    -u: with -c, consider the trees as unrooted (e.g. ((A,B),(C,D)); and\n"
+"        (A,B,(C,D)); then have the same topology)\n"
 "\n"
 "Examples\n"
 "--------\n"
@@ -88,7 +116,13 @@ void help(char *argv[])
 "\n"
 "# Make a purely structural tree (still valid Newick!)\n"
 "\n"
-"$ %s -IL data/catarrhini\n",
+"$ %s -IL data/catarrhini\n"
+"\n"
+"# Frequencies of the unrooted topologies in a sample of trees\n"
+"\n"
+"$ %s -cu data/vrt_gen.nw\n",
+	argv[0],
+	argv[0],
 	argv[0],
 	argv[0],
 	argv[0]
@@ -104,22 +138,34 @@ struct parameters get_params(int argc, char *argv[])
 	params.show_inner_labels = true;
 	params.show_leaf_labels = true;
 	params.show_branch_lengths = false;
+	params.count_topologies = false;
+	params.unrooted = false;
+	params.nb_workers = 1;
 
 	int opt_char;
-	while ((opt_char = getopt(argc, argv, "bhIL")) != -1) {
+	while ((opt_char = getopt(argc, argv, "bchIj:Lu")) != -1) {
 		switch (opt_char) {
 		case 'b':
 			params.show_branch_lengths = true;
 			break;
+		case 'c':
+			params.count_topologies = true;
+			break;
 		case 'h':
 			help(argv);
 			exit(EXIT_SUCCESS);
 		case 'I':
 			params.show_inner_labels = false;
 			break;
+		case 'j':
+			params.nb_workers = parse_nb_workers(optarg);
+			break;
 		case 'L':
 			params.show_leaf_labels = false;
 			break;
+		case 'u':
+			params.unrooted = true;
+			break;
 		default:
 			fprintf (stderr, "Unknown option '-%c'\n", opt_char);
 			exit (EXIT_FAILURE);
@@ -138,7 +184,8 @@ struct parameters get_params(int argc, char *argv[])
 			nwsin = fin;
 		}
 	} else {
-		fprintf(stderr, "Usage: %s [-bhIL] <filename|->\n", argv[0]);
+		fprintf(stderr, "Usage: %s [-bchILu] [-j <processes>] "
+				"<filename|->\n", argv[0]);
 		exit(EXIT_FAILURE);
 	}
 
@@ -171,19 +218,141 @@ void process_tree(struct rooted_tree *tree, struct parameters params)
 	}
 }
 
-int main (int argc, char* argv[])
+/* Reroots an (unrooted) tree on the leaf with the smallest label, so that
+ * trees with the same unrooted topology end up with the same rooted one. */
+
+static void canonical_root(struct rooted_tree *tree)
+{
+	struct list_elem *elem;
+	struct rnode *outgroup = NULL;
+
+	for (elem = tree->nodes_in_order->head; NULL != elem; elem = elem->next) {
+		struct rnode *current = elem->data;
+		if (! is_leaf(current) || is_root(current)) continue;
+		if (NULL == outgroup || strcmp(current->label,
+					outgroup->label) < 0)
+			outgroup = current;
+	}
+	if (NULL == outgroup) return;	/* single node */
+
+	if (! reroot_tree(tree, outgroup, false)) {
+		perror(NULL);
+		exit(EXIT_FAILURE);
+	}
+}
+
+/* Returns the tree's topology as a Newick string in canonical form (see
+ * help). The tree is modified. */
+
+static char *canonical_topology(struct rooted_tree *tree, bool unrooted)
+{
+	struct parameters strip;
+	strip.show_inner_labels = false;
+	strip.show_leaf_labels = true;
+	strip.show_branch_lengths = false;
+	process_tree(tree, strip);
+
+	if (unrooted) canonical_root(tree);
+
+	if (! order_tree_lbl(tree)) { perror(NULL); exit(EXIT_FAILURE); }
+	char *newick = to_newick(tree->root);
+	if (NULL == newick) { perror(NULL); exit(EXIT_FAILURE); }
+	return newick;
+}
+
+static int compare_counts(const void *a, const void *b)
+{
+	const struct topology_count *ca = *(struct topology_count * const *) a;
+	const struct topology_count *cb = *(struct topology_count * const *) b;
+
+	if (ca->count != cb->count) return cb->count - ca->count;
+	return ca->first_seen - cb->first_seen;
+}
+
+static void print_counts(struct hash *counts)
+{
+	struct llist *keys = hash_keys(counts);
+	if (NULL == keys) { perror(NULL); exit(EXIT_FAILURE); }
+	struct topology_count **array = malloc(keys->count *
+			sizeof(struct topology_count *));
+	if (NULL == array) { perror(NULL); exit(EXIT_FAILURE); }
+
+	struct list_elem *el;
+	int n = 0;
+	for (el = keys->head; NULL != el; el = el->next)
+		array[n++] = hash_get(counts, el->data);
+	qsort(array, n, sizeof(struct topology_count *), compare_counts);
+
+	int i;
+	for (i = 0; i < n; i++) {
+		printf("%d\t%s\n", array[i]->count, array[i]->newick);
+		free(array[i]->newick);
+		free(array[i]);
+	}
+
+	free(array);
+	destroy_llist(keys);
+}
+
+/* Counts the topologies in the input. Memory use depends on the number of
+ * distinct topologies, not on the number of trees. */
+
+static void count_topologies(struct parameters params)
 {
 	struct rooted_tree *tree;
+	struct hash *counts = create_dynamic_hash(1000, 0.75, 2);
+	if (NULL == counts) { perror(NULL); exit(EXIT_FAILURE); }
+	int tree_nb = 0;
+
+	while ((tree = parse_tree()) != NULL) {
+		char *newick = canonical_topology(tree, params.unrooted);
+		struct topology_count *count = hash_get(counts, newick);
+		if (NULL == count) {
+			count = malloc(sizeof(struct topology_count));
+			if (NULL == count) { perror(NULL); exit(EXIT_FAILURE); }
+			count->count = 0;
+			count->first_seen = tree_nb;
+			count->newick = newick;
+			if (! hash_set(counts, newick, count)) {
+				perror(NULL);
+				exit(EXIT_FAILURE);
+			}
+		} else {
+			free(newick);
+		}
+		count->count++;
+		tree_nb++;
+		destroy_tree(tree);
+		recycle_all_rnodes(NULL);
+	}
+
+	print_counts(counts);
+	destroy_hash(counts);
+}
+
+static void process_one_tree(struct rooted_tree *tree, void *arg)
+{
+	process_tree(tree, *(struct parameters *) arg);
+	dump_newick(tree->root);
+	recycle_all_rnodes(NULL);
+	destroy_tree(tree);
+}
+
+int main (int argc, char* argv[])
+{
 	struct parameters params;
 
 	params = get_params(argc, argv);
 
-	while ((tree = parse_tree()) != NULL) {
-		process_tree(tree, params);
-		dump_newick(tree->root);
+	if (params.count_topologies) {
+		count_topologies(params);
 		destroy_all_rnodes(NULL);
-		destroy_tree(tree);
+		return 0;
 	}
 
+	if (! run_tree_pipeline(params.nb_workers, process_one_tree, &params))
+		exit(EXIT_FAILURE);
+	destroy_all_rnodes(NULL);
+
 	return 0;
 }
@@ -0,0 +1,258 @@
+/* 
+
+Copyright (c) 2009 Thomas Junier and Evgeny Zdobnov, University of Geneva
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+* Neither the name of the University of Geneva nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "topology_hash.h"
+#include "tree.h"
+#include "tree_stats.h"
+#include "rnode.h"
+#include "list.h"
+#include "hash.h"
+#include "common.h"
+
+/* The finalizer of the SplitMix64 generator: a fast bijective mix with good
+ * avalanche properties. */
+
+static uint64_t mix64(uint64_t x)
+{
+	x ^= x >> 30;
+	x *= 0xbf58476d1ce4e5b9ULL;
+	x ^= x >> 27;
+	x *= 0x94d049bb133111ebULL;
+	x ^= x >> 31;
+	return x;
+}
+
+/* FNV-1a, followed by a mix */
+
+static uint64_t label_hash(const char *label)
+{
+	uint64_t h = 0xcbf29ce484222325ULL;
+	for (; '\0' != *label; label++) {
+		h ^= (unsigned char) *label;
+		h *= 0x100000001b3ULL;
+	}
+	h = mix64(h);
+	return 0 == h ? 1 : h;	/* 0 means "empty" */
+}
+
+/* Hash of a multiset of children's hashes ('n' >= 2, sorted) */
+
+static uint64_t inner_hash(const uint64_t *kids, int n)
+{
+	uint64_t h = 0x9e3779b97f4a7c15ULL;
+	int i;
+	for (i = 0; i < n; i++)
+		h = mix64(h ^ kids[i]);
+	h = mix64(h + (uint64_t) n);
+	return 0 == h ? 1 : h;
+}
+
+static int compare_hashes(const void *a, const void *b)
+{
+	uint64_t ha = *(const uint64_t *) a;
+	uint64_t hb = *(const uint64_t *) b;
+	return (ha > hb) - (ha < hb);
+}
+
+struct topo_leaf_set *create_topo_leaf_set(struct llist *labels)
+{
+	struct topo_leaf_set *set = malloc(sizeof(struct topo_leaf_set));
+	if (NULL == set) return NULL;
+	set->leaf_hashes = create_hash(labels->count > 0 ?
+			2 * labels->count : 1);
+	set->values = malloc((labels->count + 1) * sizeof(uint64_t));
+	if (NULL == set->leaf_hashes || NULL == set->values) return NULL;
+	set->nb_leaves = 0;
+	set->node_hashes = NULL;
+	set->node_capacity = 0;
+	set->kid_hashes = NULL;
+	set->kid_capacity = 0;
+
+	struct list_elem *el;
+	for (el = labels->head; NULL != el; el = el->next) {
+		char *label = el->data;
+		if (NULL != hash_get(set->leaf_hashes, label)) continue;
+		uint64_t *value = set->values + set->nb_leaves;
+		*value = label_hash(label);
+		if (! hash_set(set->leaf_hashes, label, value)) return NULL;
+		set->nb_leaves++;
+	}
+
+	return set;
+}
+
+void destroy_topo_leaf_set(struct topo_leaf_set *set)
+{
+	destroy_hash(set->leaf_hashes);
+	free(set->values);
+	free(set->node_hashes);
+	free(set->kid_hashes);
+	free(set);
+}
+
+bool topo_leaf_set_has(struct topo_leaf_set *set, char *label)
+{
+	return NULL != hash_get(set->leaf_hashes, label);
+}
+
+/* Grows an array of hashes, if needed. */
+/* Returns FAILURE iff realloc() fails. */
+
+static int reserve_hashes(uint64_t **array, int *capacity, int n)
+{
+	if (n <= *capacity) return SUCCESS;
+	uint64_t *new = realloc(*array, n * sizeof(uint64_t));
+	if (NULL == new) return FAILURE;
+	*array = new;
+	*capacity = n;
+	return SUCCESS;
+}
+
+/* Does the work for restricted_topology_hash() and create_topo_pattern(): if
+ * 'clades' is not NULL, the hashes of the restriction's inner nodes are
+ * appended to it (it must have room for them). */
+
+static enum topo_hash_status hash_tree(struct rooted_tree *tree,
+		struct topo_leaf_set *set, struct topo_pattern *pattern,
+		uint64_t *clades, int *nb_clades, uint64_t *hash)
+{
+	struct tree_stats *stats = get_tree_stats(tree);
+	if (NULL == stats) return TOPO_HASH_ERROR;
+	if (! reserve_hashes(&(set->node_hashes), &(set->node_capacity),
+				stats->nb_nodes))
+		return TOPO_HASH_ERROR;
+	uint64_t *node_hashes = set->node_hashes;
+
+	int i;
+	/* post-order: children come before their parent */
+	for (i = 0; i < stats->nb_nodes; i++) {
+		struct rnode *node = stats->nodes[i];
+		if (is_leaf(node)) {
+			uint64_t *value = hash_get(set->leaf_hashes,
+					node->label);
+			node_hashes[i] = NULL == value ? 0 : *value;
+			continue;
+		}
+		if (! reserve_hashes(&(set->kid_hashes), &(set->kid_capacity),
+					node->child_count))
+			return TOPO_HASH_ERROR;
+		int n = 0;
+		struct rnode *kid;
+		for (kid = node->first_child; NULL != kid;
+				kid = kid->next_sibling) {
+			uint64_t h = node_hashes[kid->index];
+			if (0 != h) {
+				/* insertion sort: there are few children */
+				int j = n++;
+				while (j > 0 && set->kid_hashes[j-1] > h) {
+					set->kid_hashes[j] =
+						set->kid_hashes[j-1];
+					j--;
+				}
+				set->kid_hashes[j] = h;
+			}
+			if (kid == node->last_child) break;
+		}
+		switch (n) {
+		case 0:		/* nothing from the leaf set below */
+			node_hashes[i] = 0;
+			break;
+		case 1:		/* knee: disappears in the restriction */
+			node_hashes[i] = set->kid_hashes[0];
+			break;
+		default:
+			node_hashes[i] = inner_hash(set->kid_hashes, n);
+			if (NULL != pattern && NULL == bsearch(
+					node_hashes + i, pattern->clades,
+					pattern->nb_clades, sizeof(uint64_t),
+					compare_hashes))
+				return TOPO_HASH_REJECTED;
+			if (NULL != clades)
+				clades[(*nb_clades)++] = node_hashes[i];
+		}
+	}
+
+	*hash = node_hashes[stats->nb_nodes - 1];	/* root */
+	return TOPO_HASH_OK;
+}
+
+enum topo_hash_status restricted_topology_hash(struct rooted_tree *tree,
+		struct topo_leaf_set *leaves, struct topo_pattern *pattern,
+		uint64_t *hash)
+{
+	return hash_tree(tree, leaves, pattern, NULL, NULL, hash);
+}
+
+bool topo_pattern_match(struct topo_pattern *pattern,
+		struct topo_leaf_set *leaves, struct rooted_tree *tree)
+{
+	uint64_t hash;
+	switch (restricted_topology_hash(tree, leaves, pattern, &hash)) {
+	case TOPO_HASH_OK:
+		return hash == pattern->hash;
+	case TOPO_HASH_REJECTED:
+		return false;
+	default:
+		perror(NULL);
+		exit(EXIT_FAILURE);
+	}
+}
+
+struct topo_pattern *create_topo_pattern(struct rooted_tree *tree,
+		struct topo_leaf_set *leaves)
+{
+	struct topo_pattern *pattern = malloc(sizeof(struct topo_pattern));
+	if (NULL == pattern) return NULL;
+
+	/* A restriction has fewer inner nodes than the tree has nodes. */
+	struct tree_stats *stats = get_tree_stats(tree);
+	if (NULL == stats) return NULL;
+	pattern->clades = malloc(stats->nb_nodes * sizeof(uint64_t));
+	if (NULL == pattern->clades) return NULL;
+	pattern->nb_clades = 0;
+
+	if (TOPO_HASH_OK != hash_tree(tree, leaves, NULL, pattern->clades,
+				&(pattern->nb_clades), &(pattern->hash)))
+		return NULL;
+	qsort(pattern->clades, pattern->nb_clades, sizeof(uint64_t),
+			compare_hashes);
+
+	return pattern;
+}
+
+void destroy_topo_pattern(struct topo_pattern *pattern)
+{
+	free(pattern->clades);
+	free(pattern);
+}
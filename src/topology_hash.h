@@ -0,0 +1,111 @@
+/* 
+
+Copyright (c) 2009 Thomas Junier and Evgeny Zdobnov, University of Geneva
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+* Neither the name of the University of Geneva nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/* Canonical hashes of rooted topologies, restricted to a set of leaf labels.
+ * The restriction of a tree to a leaf set is what remains after removing all
+ * leaves whose labels are not in the set, then all nodes with a single child
+ * (the root included). Only leaf labels count: inner labels and branch
+ * lengths are ignored, and so is the order of children.
+ *
+ * The hash is computed bottom-up in one pass, without changing the tree: a
+ * leaf's hash is derived from its label, and an inner node's hash from the
+ * sorted hashes of its (non-empty) children. Two trees whose restrictions
+ * are isomorphic have the same hash; different restrictions have different
+ * hashes except with a probability of about 2^-64 per comparison. */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+struct rooted_tree;
+struct llist;
+struct hash;
+
+/* A set of leaf labels, with each label's hash. Also holds work space for
+ * hashing trees, so it should not be shared between threads. */
+
+struct topo_leaf_set {
+	struct hash *leaf_hashes;	/**< label -> uint64_t* */
+	uint64_t *values;		/**< the hashes, one per label */
+	int nb_leaves;
+	uint64_t *node_hashes;		/**< work space, one per node */
+	int node_capacity;
+	uint64_t *kid_hashes;		/**< work space, one per child */
+	int kid_capacity;
+};
+
+/* A restricted topology, as needed for matching trees against it. */
+
+struct topo_pattern {
+	uint64_t hash;		/**< hash of the whole restricted topology */
+	uint64_t *clades;	/**< hashes of its inner nodes, sorted */
+	int nb_clades;
+};
+
+enum topo_hash_status { TOPO_HASH_OK, TOPO_HASH_REJECTED, TOPO_HASH_ERROR };
+
+/* Creates a leaf set from a list of labels (char*). Duplicate labels are only
+ * counted once. */
+/* Returns NULL in case of malloc() problems. */
+
+struct topo_leaf_set *create_topo_leaf_set(struct llist *labels);
+
+void destroy_topo_leaf_set(struct topo_leaf_set *);
+
+/* Returns true iff the label is in the leaf set. */
+
+bool topo_leaf_set_has(struct topo_leaf_set *, char *label);
+
+/* Computes the hash of 'tree''s topology restricted to the leaf set, and
+ * stores it in '*hash'. The hash of an empty restriction (no leaf of the tree
+ * is in the set) is 0. If 'pattern' is not NULL, the computation stops as
+ * soon as the restriction is found to have a clade that the pattern does not
+ * have, in which case TOPO_HASH_REJECTED is returned (and '*hash' is not
+ * set). */
+/* Returns TOPO_HASH_ERROR in case of malloc() problems. */
+
+enum topo_hash_status restricted_topology_hash(struct rooted_tree *tree,
+		struct topo_leaf_set *leaves, struct topo_pattern *pattern,
+		uint64_t *hash);
+
+/* Returns true iff 'tree''s topology, restricted to the leaf set, is the
+ * pattern's. This rejects most non-matching trees early (see above). */
+/* In case of malloc() problems, prints an error message and exits. */
+
+bool topo_pattern_match(struct topo_pattern *pattern,
+		struct topo_leaf_set *leaves, struct rooted_tree *tree);
+
+/* Creates a pattern from a tree, restricted to 'leaves' (normally, the
+ * tree's own leaf labels). */
+/* Returns NULL in case of malloc() problems. */
+
+struct topo_pattern *create_topo_pattern(struct rooted_tree *tree,
+		struct topo_leaf_set *leaves);
+
+void destroy_topo_pattern(struct topo_pattern *);
@@ -41,61 +41,183 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "nodemap.h"
 #include "hash.h"
 #include "rnode_iterator.h"
+#include "tree_stats.h"
+#include "node_attr.h"
 #include "common.h"
+#include "label_matcher.h"
 
 const int FREE_NODE_DATA = 1;
 const int DONT_FREE_NODE_DATA = 0;
 
 
-/* 'outgroup' is the node which will be the outgroup after rerooting. */
+/* Appends the elements from 'first' to 'last' (which are already linked to
+ * each other) to the list being built in 'order' */
 
-int reroot_tree(struct rooted_tree *tree, struct rnode *outgroup,
-		bool i_node_lbl_as_support)
+static void append_elems(struct llist *order, struct list_elem *first,
+		struct list_elem *last)
+{
+	if (NULL == order->head)
+		order->head = first;
+	else
+		order->tail->next = first;
+	order->tail = last;
+}
+
+/* Appends the subtree of 'node', which was not changed by the rerooting: its
+ * nodes are still in one block of the old order, ending with 'node'. */
+
+static void append_subtree(struct llist *order, struct tree_stats *stats,
+		struct list_elem **elems, struct rnode *node)
+{
+	int i = node->index;
+	append_elems(order, elems[i - stats->nb_descendants[i]], elems[i]);
+}
+
+/* After rerooting, only the order of the nodes along the path from the new
+ * root to the old one changes: any other subtree is still a block of the old
+ * order. So instead of traversing the whole tree again, we reuse the old list
+ * elements, and only relink them around the path. 'path' is the path from the
+ * new root down (each node is a child of the previous one); 'stats' and
+ * 'elems' (the old order's elements, by post-order index) describe the tree
+ * as it was before rerooting. 'root_elem' is a new element, for the new root.
+ * This cannot fail, since all memory is allocated beforehand. */
+
+static void fix_nodes_in_order(struct rooted_tree *tree,
+		struct tree_stats *stats, struct list_elem **elems,
+		struct rnode **path, int path_length,
+		struct list_elem *root_elem)
+{
+	struct llist *order = tree->nodes_in_order;
+	root_elem->data = path[0];	/* new root, not in the old order */
+
+	order->head = order->tail = NULL;
+	int i;
+	/* Going down the path: the subtrees that come before the path */
+	for (i = 0; i < path_length; i++) {
+		struct rnode *next = i + 1 < path_length ? path[i+1] : NULL;
+		struct rnode *kid;
+		for (kid = path[i]->first_child; kid != next;
+				kid = kid->next_sibling) {
+			append_subtree(order, stats, elems, kid);
+			if (kid == path[i]->last_child) break;
+		}
+	}
+	/* Going back up: the subtrees after the path, then the node itself */
+	for (i = path_length - 1; i >= 0; i--) {
+		struct rnode *node = path[i];
+		if (i + 1 < path_length && path[i+1] != node->last_child) {
+			struct rnode *kid;
+			for (kid = path[i+1]->next_sibling; ;
+					kid = kid->next_sibling) {
+				append_subtree(order, stats, elems, kid);
+				if (kid == node->last_child) break;
+			}
+		}
+		struct list_elem *elem = 0 == i ? root_elem :
+			elems[node->index];
+		append_elems(order, elem, elem);
+	}
+	order->tail->next = NULL;
+	order->count++;		/* the new root */
+}
+
+/* Does the work of reroot_tree(), with the work arrays allocated by it:
+ * 'elems' has room for all nodes, and 'path' for the path from the outgroup
+ * to the root. If 'root_elem' is used, it is set to NULL. */
+
+static int reroot_with(struct rooted_tree *tree, struct rnode *outgroup,
+		bool i_node_lbl_as_support, struct tree_stats *stats,
+		struct list_elem **elems, struct rnode **path,
+		struct list_elem **root_elem)
 {
 	struct rnode *old_root = tree->root;
 	struct rnode *new_root;
-	struct llist *swap_list;
 	struct rnode *node;
+	int i;
+
+	/* The tree as it is now, for fixing the order of nodes afterwards -
+	 * unless the order does not match the tree, in which case it is just
+	 * recomputed. */
+	bool order_ok = (tree->nodes_in_order->count == stats->nb_nodes);
 	struct list_elem *elem;
+	for (i = 0, elem = tree->nodes_in_order->head;
+			order_ok && NULL != elem; i++, elem = elem->next) {
+		if (elem->data != stats->nodes[i])
+			order_ok = false;
+		elems[i] = elem;
+	}
+
+	/* The nodes to swap (i.e., swap a node with its parent), from the
+	 * soon-to-be new root to the old (which is still the root). The
+	 * first element is for the new root. */
+	int path_length = stats->nb_ancestors[outgroup->index] + 1;
+	for (i = 1, node = outgroup->parent; NULL != node;
+			i++, node = node->parent)
+		path[i] = node;
 
 	/* Insert node (will be the new root) above outgroup */
 	if (! insert_node_above(outgroup, ""))
 		return FAILURE;
 	new_root = outgroup->parent;
+	path[0] = new_root;
 
-	/* We need to swap the nodes from new root to the old root (i.e., swap
-	 * a node with its parent), so the tree is always in a consistent
-	 * state */
-
-	/* First, we make a list of the nodes we need to swap, by visiting
-	 * the tree from the soon-to-be new root to the old (which is still the
-	 * root) */
-	swap_list = create_llist();
-	if (NULL == swap_list) return FAILURE;
-	for (node = new_root; ! is_root(node); node = node->parent) {
-		/* order of swaps is important: tree is always consistent */
-		if (! prepend_element(swap_list, node)) return FAILURE;
-	}
-	/* Now, we swap the nodes in the list. */ 
-	for (elem = swap_list->head; NULL != elem; elem = elem->next) {
-		struct rnode *to_swap = elem->data;
-		if (! swap_nodes_wsupport(to_swap, i_node_lbl_as_support))
+	/* Now, we swap the nodes, starting from the old root, so that the
+	 * tree is always in a consistent state. */
+	for (i = path_length - 2; i >= 0; i--) {
+		if (! swap_nodes_wsupport(path[i], i_node_lbl_as_support))
 			return FAILURE;
 	}
-        destroy_llist(swap_list);
 
 	if (children_count(old_root) == 1) {
 		if (! splice_out_rnode(old_root))
 			return FAILURE;
+		path_length--;	/* the old root is the last node */
+		if (order_ok) {
+			free(elems[old_root->index]);
+			tree->nodes_in_order->count--;
+		}
 	}
 
 	tree->root = new_root;
-        destroy_llist(tree->nodes_in_order);
-	tree->nodes_in_order = get_nodes_in_order(tree->root);
+	if (order_ok) {
+		fix_nodes_in_order(tree, stats, elems, path, path_length,
+				*root_elem);
+		*root_elem = NULL;
+	} else {
+		destroy_llist(tree->nodes_in_order);
+		tree->nodes_in_order = get_nodes_in_order(tree->root);
+		if (NULL == tree->nodes_in_order) return FAILURE;
+	}
 
 	return SUCCESS;
 }
 
+/* 'outgroup' is the node which will be the outgroup after rerooting. */
+
+int reroot_tree(struct rooted_tree *tree, struct rnode *outgroup,
+		bool i_node_lbl_as_support)
+{
+	struct tree_stats *stats = get_tree_stats(tree);
+	if (NULL == stats) return FAILURE;
+
+	/* All work memory is allocated here, and freed whatever happens */
+	int path_length = stats->nb_ancestors[outgroup->index] + 1;
+	struct list_elem **elems = malloc(stats->nb_nodes *
+			sizeof(struct list_elem *));
+	struct rnode **path = malloc(path_length * sizeof(struct rnode *));
+	struct list_elem *root_elem = malloc(sizeof(struct list_elem));
+
+	int status = FAILURE;
+	if (NULL != elems && NULL != path && NULL != root_elem)
+		status = reroot_with(tree, outgroup, i_node_lbl_as_support,
+				stats, elems, path, &root_elem);
+
+	free(elems);
+	free(path);
+	free(root_elem);
+	return status;
+}
+
 void collapse_pure_clades(struct rooted_tree *tree)
 {
 	struct list_elem *el;		
@@ -122,11 +244,18 @@ void destroy_tree(struct rooted_tree *tree)
 	/* The nodes themselves are destroyed using destroy_all_rnodes() */
 
 	destroy_llist(tree->nodes_in_order);
+	destroy_tree_stats(tree->stats);
+	destroy_node_attrs(tree->attrs);
 	free(tree);
 }
 
 int leaf_count(struct rooted_tree * tree)
 {
+	struct tree_stats *stats = get_tree_stats(tree);
+	if (NULL != stats)
+		return stats->nb_leaves[stats->nb_nodes - 1];	/* root */
+
+	/* Could not compute stats (malloc() problem): count the hard way. */
 	struct list_elem *el;
 	int n = 0;
 
@@ -247,6 +376,23 @@ struct llist *nodes_from_regexp(struct rooted_tree *tree, regex_t *preg)
 	return result;
 }
 
+struct llist *nodes_from_label_matcher(struct rooted_tree *tree,
+		struct label_matcher *matcher)
+{
+	struct llist *result = create_llist();
+	if (NULL == result) return NULL;
+	struct list_elem *el;
+
+	for (el = tree->nodes_in_order->head; NULL != el; el = el->next) {
+		struct rnode *node = el->data;
+		if (label_matcher_match(matcher, node->label))
+			if (! append_element(result, node))
+				return NULL;
+	}
+
+	return result;
+}
+
 void reset_seen(struct rooted_tree *tree)
 {
 	struct list_elem *el = tree->nodes_in_order->head;
@@ -262,6 +408,9 @@ struct rooted_tree *clone_tree(struct rooted_tree *target)
 	struct rooted_tree *result = malloc(sizeof(struct rooted_tree));
 	if (NULL == result) return NULL;
 
+	result->type = target->type;
+	result->stats = NULL;
+	result->attrs = NULL;
 	result->root = clone_rnode(target->root);
 	result->nodes_in_order = get_nodes_in_order(result->root);
 
@@ -275,6 +424,9 @@ struct rooted_tree *clone_tree_cond(struct rooted_tree *target,
 	struct rooted_tree *result = malloc(sizeof(struct rooted_tree));
 	if (NULL == result) return NULL;
 
+	result->type = target->type;
+	result->stats = NULL;
+	result->attrs = NULL;
 	result->root = clone_rnode_cond(target->root, predicate, param);
 	result->nodes_in_order = get_nodes_in_order(result->root);
 
@@ -33,6 +33,9 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 struct rnode;
 struct llist;
 struct hash;
+struct tree_stats;
+struct node_attr;
+struct label_matcher;
 
 extern const int FREE_NODE_DATA;
 extern const int DONT_FREE_NODE_DATA;
@@ -48,6 +51,11 @@ struct rooted_tree {
 	struct rnode *root;		/**< tree's root */
 	struct llist *nodes_in_order;	/**< llist of nodes, in postorder */
 	enum tree_type type;		/**< see enum tree_type */
+	/** cached per-node properties (see tree_stats.h), NULL until first
+	 * needed */
+	struct tree_stats *stats;
+	/** per-node attribute columns (see node_attr.h), NULL if none */
+	struct node_attr *attrs;
 };
 
 /* Reroots the tree in such a way that 'outgroup' and descendants are one of
@@ -74,7 +82,8 @@ void collapse_pure_clades(struct rooted_tree *tree);
 
 void destroy_tree(struct rooted_tree *);
 
-/* Returns the number of leaves of this tree */
+/* Returns the number of leaves of this tree (this uses the tree's cached stats,
+ * see tree_stats.h) */
 
 int leaf_count(struct rooted_tree *);
 
@@ -114,6 +123,13 @@ struct llist *nodes_from_regexp_string(struct rooted_tree *tree,
 struct llist *nodes_from_regexp(struct rooted_tree *tree,
 		regex_t *preg);
 
+/* Like nodes_from_regexp(), but through a label matcher (see label_matcher.h),
+ * which should be kept from one tree to the next: each distinct label is then
+ * matched only once. Returns NULL on failure. */
+
+struct llist *nodes_from_label_matcher(struct rooted_tree *tree,
+		struct label_matcher *matcher);
+
 /* Clones a (sub)tree, given the root node of the subtree. All nodes and edges
  * are new: one can modify or delete the clone without affecting the original
  * in any way. */
@@ -39,6 +39,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "link.h"
 #include "list.h"
 #include "tree.h"
+#include "tree_stats.h"
 #include "parser.h"
 #include "to_newick.h"
 #include "address_parser.h"
@@ -278,85 +279,39 @@ struct parameters get_params(int argc, char *argv[])
 	return params;
 }
 
-/* A helper for parse_order_traversal() - gets the number of descendants of a
- * node. This function is NOT recursive, the node data of all descendants must
- * have been set already - which is why we're calling it from
- * parse_order_traversal().
- * */
+/* This allocates the rnode_data structures of all nodes as one array, which
+ * the caller frees (once the nodes are no longer used), and fills it. Most
+ * values (depth, number of ancestors and descendants) come from the tree's
+ * cached stats (see tree_stats.h), which are computed in a single pass. */
 
-int get_nb_descendants(struct rnode *node)
+struct rnode_data *set_node_data(struct rooted_tree *tree)
 {
-	struct rnode *kid;
-	struct rnode_data *rndata;
-	int descendants = 0;
-
-	for (kid = node->first_child; NULL != kid; kid = kid->next_sibling) {
-		rndata = kid->data;
-		descendants += rndata->nb_descendants;
-		descendants += 1;	/* kid itself (no pun intended :-) ) */
-	}
-
-	return descendants;
-}
-
-/* This allocates the rnode_data structure for each node, and fills it with
- * "top-down" data,  i.e. data for which the parent's value needs to be known
- * (such as depth and number of ancestors). Some values do not depend on the
- * parent nor on the children, I also set them here (this is arbitrary, I
- * could set them in parse_order_traversal() below as well). */
-
-void reverse_parse_order_traversal(struct rooted_tree *tree)
-{
-	struct list_elem *el;
-	struct llist *rev_nodes = llist_reverse(tree->nodes_in_order);
-	if (NULL == rev_nodes) { perror(NULL), exit(EXIT_FAILURE); }
-	struct rnode *node;
-	struct rnode_data *rndata;
-
-	el = rev_nodes->head;	/* root */
-	node = (struct rnode *) el->data;
-	rndata = malloc(sizeof(struct rnode_data));
-	if (NULL == rndata) { perror(NULL); exit (EXIT_FAILURE); }
-	rndata->nb_ancestors = 0;
-	rndata->depth = 0;
-	rndata->stop_mark = false;
-	node->data = rndata;
-
-	/* WARNING: don't forget to set values for the root's data, above. The
-	 * following loop starts at the first non-root node! */
-
-	for (el = rev_nodes->head->next; NULL != el; el = el -> next) {
-		node = (struct rnode *) el->data;
-		struct rnode_data *parent_data = node->parent->data;
-		rndata = malloc(sizeof(struct rnode_data));
-		if (NULL == rndata) { perror(NULL); exit (EXIT_FAILURE); }
-		rndata->nb_ancestors = parent_data->nb_ancestors + 1;
-		rndata->depth = parent_data->depth +
-			atof(node->edge_length_as_string);
-
+	struct tree_stats *stats = get_tree_stats(tree);
+	if (NULL == stats) { perror(NULL); exit(EXIT_FAILURE); }
+	struct rnode_data *node_data = malloc(stats->nb_nodes *
+			sizeof(struct rnode_data));
+	if (NULL == node_data) { perror(NULL); exit (EXIT_FAILURE); }
+	int i;
+
+	for (i = 0; i < stats->nb_nodes; i++) {
+		struct rnode *node = stats->nodes[i];
+		struct rnode_data *rndata = node_data + i;
+		rndata->nb_ancestors = stats->nb_ancestors[i];
+		rndata->nb_descendants = stats->nb_descendants[i];
+		rndata->depth = stats->depth[i];
+		rndata->support = atof(node->label);
 		rndata->stop_mark = false;
 		node->data = rndata;
 	}
-
-	destroy_llist(rev_nodes);
+	return node_data;
 }
 
-/* This fills bottom-up data. Note that it relies on rnode_data being already
- * allocated, which is done in reverse_parse_order_traversal(). Data that does
- * not depend on order is also filled in here. */
+/* Passed to destroy_all_rnodes(): the node data are one array, freed by the
+ * caller of set_node_data(). */
 
-void parse_order_traversal(struct rooted_tree *tree)
+static void keep_node_data(void *data)
 {
-	struct list_elem *el;
-	struct rnode *node;
-	struct rnode_data *rndata;
-
-	for (el = tree->nodes_in_order->head; NULL != el; el = el -> next) {
-		node = (struct rnode *) el->data;
-		rndata = (struct rnode_data *) node->data;
-		rndata->support = atof(node->label);	
-		rndata->nb_descendants = get_nb_descendants(node);
-	}
+	(void) data;
 }
 
 void process_tree(struct rooted_tree *tree, struct parameters params)
@@ -366,10 +321,6 @@ void process_tree(struct rooted_tree *tree, struct parameters params)
 	enum unlink_rnode_status result;
 	struct rnode *root_child;
 
-	/* these two traversals fill the node data. */
-	reverse_parse_order_traversal(tree);
-	parse_order_traversal(tree);
-
 	if (POST_ORDER == params.order)
 		nodes = tree->nodes_in_order;
 	else if (PRE_ORDER == params.order) {
@@ -485,12 +436,14 @@ int main(int argc, char* argv[])
 	address_scanner_clear_input();
 
 	while (NULL != (tree = parse_tree())) {
+		struct rnode_data *node_data = set_node_data(tree);
 		process_tree(tree, params);
 		if (params.show_tree) {
 			dump_newick(tree->root);
 		}
-		destroy_all_rnodes(NULL);
+		destroy_all_rnodes(keep_node_data);
 		destroy_tree(tree);
+		free(node_data);
 	}
 
 	return 0;
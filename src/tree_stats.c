@@ -0,0 +1,216 @@
+/* 
+
+Copyright (c) 2009 Thomas Junier and Evgeny Zdobnov, University of Geneva
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+* Neither the name of the University of Geneva nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "tree_stats.h"
+#include "tree.h"
+#include "rnode.h"
+#include "rnode_iterator.h"
+#include "link.h"
+#include "common.h"
+
+/* (Re)allocates the arrays so that they can hold 'n' nodes. */
+/* Returns FAILURE iff realloc() fails. */
+
+static int grow_stats(struct tree_stats *stats, int n)
+{
+	if (n <= stats->capacity) return SUCCESS;
+
+	void *p;
+	if (NULL == (p = realloc(stats->nodes, n * sizeof(struct rnode *))))
+		return FAILURE;
+	stats->nodes = p;
+	if (NULL == (p = realloc(stats->nb_leaves, n * sizeof(int))))
+		return FAILURE;
+	stats->nb_leaves = p;
+	if (NULL == (p = realloc(stats->nb_descendants, n * sizeof(int))))
+		return FAILURE;
+	stats->nb_descendants = p;
+	if (NULL == (p = realloc(stats->nb_ancestors, n * sizeof(int))))
+		return FAILURE;
+	stats->nb_ancestors = p;
+	if (NULL == (p = realloc(stats->depth, n * sizeof(double))))
+		return FAILURE;
+	stats->depth = p;
+	if (NULL == (p = realloc(stats->depth_defined, n * sizeof(bool))))
+		return FAILURE;
+	stats->depth_defined = p;
+	if (NULL == (p = realloc(stats->height, n * sizeof(double))))
+		return FAILURE;
+	stats->height = p;
+
+	stats->capacity = n;
+	return SUCCESS;
+}
+
+static struct tree_stats *create_tree_stats()
+{
+	struct tree_stats *stats = malloc(sizeof(struct tree_stats));
+	if (NULL == stats) return NULL;
+
+	stats->valid = false;
+	stats->link_change_count = 0;
+	stats->nb_nodes = 0;
+	stats->capacity = 0;
+	stats->nodes = NULL;
+	stats->nb_leaves = NULL;
+	stats->nb_descendants = NULL;
+	stats->nb_ancestors = NULL;
+	stats->depth = NULL;
+	stats->depth_defined = NULL;
+	stats->height = NULL;
+
+	return stats;
+}
+
+/* Numbers the nodes in post-order, and fills in the bottom-up values (leaf
+ * and descendant counts, height) on the way: in post-order, a node's children
+ * are always visited before the node itself. */
+/* Returns FAILURE iff there is a malloc() problem. */
+
+static int bottom_up_pass(struct tree_stats *stats, struct rnode *root)
+{
+	struct rnode_stack_iterator *it =
+		create_rnode_stack_iterator(root, RNODE_POSTORDER);
+	if (NULL == it) return FAILURE;
+
+	struct rnode *node;
+	int n = 0;
+	while (NULL != (node = rnode_stack_iterator_next(it))) {
+		if (n == stats->capacity)
+			if (! grow_stats(stats, 2 * stats->capacity + 64))
+				return FAILURE;
+		node->index = n;
+		stats->nodes[n] = node;
+		stats->nb_ancestors[n] = rnode_stack_iterator_depth(it);
+		if (is_leaf(node)) {
+			stats->nb_leaves[n] = 1;
+			stats->nb_descendants[n] = 0;
+			stats->height[n] = 0;
+		} else {
+			int leaves = 0, descendants = 0;
+			double height = 0;
+			struct rnode *kid;
+			for (kid = node->first_child; NULL != kid;
+					kid = kid->next_sibling) {
+				int k = kid->index;
+				leaves += stats->nb_leaves[k];
+				descendants += stats->nb_descendants[k] + 1;
+				double h = stats->height[k] +
+					atof(kid->edge_length_as_string);
+				if (h > height) height = h;
+				if (kid == node->last_child) break;
+			}
+			stats->nb_leaves[n] = leaves;
+			stats->nb_descendants[n] = descendants;
+			stats->height[n] = height;
+		}
+		n++;
+	}
+	bool error = rnode_stack_iterator_error(it);
+	destroy_rnode_stack_iterator(it);
+	if (error) return FAILURE;
+
+	stats->nb_nodes = n;
+	return SUCCESS;
+}
+
+/* Fills in the top-down values (depth). Visiting the nodes in reverse
+ * post-order guarantees that a node's parent is visited before the node. As
+ * in the tree editors' original code, a length is defined iff strtod() can
+ * convert it. */
+
+static void top_down_pass(struct tree_stats *stats)
+{
+	int i = stats->nb_nodes - 1;	/* root */
+	stats->depth[i] = 0;
+	stats->depth_defined[i] = true;
+
+	for (i--; i >= 0; i--) {
+		struct rnode *node = stats->nodes[i];
+		int parent = node->parent->index;
+		char *length = node->edge_length_as_string;
+		char *end;
+		double value = strtod(length, &end);
+		stats->depth[i] = stats->depth[parent] + value;
+		stats->depth_defined[i] = stats->depth_defined[parent] &&
+			end != length;
+	}
+}
+
+struct tree_stats *get_tree_stats(struct rooted_tree *tree)
+{
+	if (NULL == tree->stats) {
+		tree->stats = create_tree_stats();
+		if (NULL == tree->stats) return NULL;
+	}
+	struct tree_stats *stats = tree->stats;
+
+	if (stats->valid &&
+	    stats->link_change_count == get_link_change_count())
+		return stats;
+
+	if (! bottom_up_pass(stats, tree->root)) return NULL;
+	top_down_pass(stats);
+
+	stats->link_change_count = get_link_change_count();
+	stats->valid = true;
+
+	return stats;
+}
+
+void invalidate_tree_stats(struct rooted_tree *tree)
+{
+	if (NULL != tree->stats)
+		tree->stats->valid = false;
+}
+
+int tree_stats_index(struct tree_stats *stats, struct rnode *node)
+{
+	int i = node->index;
+	if (i < 0 || i >= stats->nb_nodes || stats->nodes[i] != node)
+		return -1;
+	return i;
+}
+
+void destroy_tree_stats(struct tree_stats *stats)
+{
+	if (NULL == stats) return;
+
+	free(stats->nodes);
+	free(stats->nb_leaves);
+	free(stats->nb_descendants);
+	free(stats->nb_ancestors);
+	free(stats->depth);
+	free(stats->depth_defined);
+	free(stats->height);
+	free(stats);
+}
@@ -0,0 +1,94 @@
+/* 
+
+Copyright (c) 2009 Thomas Junier and Evgeny Zdobnov, University of Geneva
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+* Neither the name of the University of Geneva nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/* Cached per-node properties of a tree: number of leaves and of descendants,
+ * depth, height, etc. Many programs need some of these, and rather than
+ * computing them again in every app (and storing them in each node's 'data'
+ * member), they are computed once for the whole tree, on demand, and stored in
+ * arrays indexed by node. The cache is attached to the tree (member 'stats' of
+ * struct rooted_tree) and is recomputed automatically if the tree's structure
+ * has been changed by the functions in link.c since it was last computed. */
+
+/* The nodes are numbered in post-order (from the tree's root, which therefore
+ * has the highest index), and each node's number is stored in its 'index'
+ * member. All arrays below are indexed by this number. */
+
+/* NOTE: the cache cannot know about changes made outside of link.c, e.g. by
+ * assigning to a node's edge_length_as_string directly. Call
+ * invalidate_tree_stats() after such changes. */
+
+#include <stdbool.h>
+
+struct rooted_tree;
+struct rnode;
+
+struct tree_stats {
+	/** value of get_link_change_count() when the stats were computed */
+	unsigned long link_change_count;
+	bool valid;		/**< false iff the stats must be recomputed */
+	int nb_nodes;		/**< number of nodes in the tree */
+	int capacity;		/**< number of allocated array elements */
+	struct rnode **nodes;	/**< the nodes, in post-order */
+	/** number of leaves in the node's subtree (a leaf counts as 1) */
+	int *nb_leaves;
+	/** number of nodes in the node's subtree, not counting the node */
+	int *nb_descendants;
+	int *nb_ancestors;	/**< number of edges up to the root */
+	/** distance from the root, i.e. the sum of the lengths on the path
+	 * from the root (the root's own length is not counted). Missing
+	 * lengths count as 0. */
+	double *depth;
+	/** false iff any edge on the path from the root has no length, or
+	 * one that is not a number */
+	bool *depth_defined;
+	/** length of the longest path from the node down to a leaf */
+	double *height;
+};
+
+/* Returns the tree's stats, computing them first if they have not been computed
+ * yet, or if they are out of date. The returned structure belongs to the tree:
+ * do not free() it (destroy_tree() does it). */
+/* Returns NULL in case of malloc() problems. */
+
+struct tree_stats *get_tree_stats(struct rooted_tree *tree);
+
+/* Marks the tree's stats as out of date, so that they will be recomputed by
+ * the next call to get_tree_stats(). */
+
+void invalidate_tree_stats(struct rooted_tree *tree);
+
+/* Returns the node's index in 'stats', or -1 if the node was not part of the
+ * tree when the stats were computed (e.g., it was created since). */
+
+int tree_stats_index(struct tree_stats *stats, struct rnode *node);
+
+/* Releases the memory used by a tree_stats structure. */
+
+void destroy_tree_stats(struct tree_stats *stats);
@@ -34,29 +34,37 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
-#include <assert.h>
 
 #include "to_newick.h"
 #include "tree.h"
+#include "tree_stats.h"
 #include "parser.h"
-#include "masprintf.h"
 #include "rnode.h"
-#include "list.h"
-#include "link.h"
+#include "pipeline.h"
 
 enum {DEPTH_DISTANCE, DEPTH_ANCESTORS};
 
-const int TRIM_UNDEFINED = -1;
+/* A depth of -1 (which is what -a 0 becomes, see get_params()) means the same
+ * as no depth at all: only the root's length is removed. This is what
+ * earlier versions did. */
 
-struct node_data {
-	bool trimmed;
-	int ancestry_depth;
-	double distance_depth;
-};
+static const double TRIM_ROOT = -1;
 
 struct parameters {
 	int depth_type;
-	double threshold;
+	double *thresholds;
+	int nb_thresholds;	/* 0 means "trim the root" */
+	int nb_workers;
+	bool ltt;		/* print lineages-through-time instead */
+};
+
+/* A lineage-through-time event: a node, at which 'delta' lineages start
+ * (children) or end (the node's own lineage). */
+
+struct ltt_event {
+	double depth;
+	int delta;
+	bool is_leaf;
 };
 
 void help(char *argv[])
@@ -67,10 +75,10 @@ void help(char *argv[])
 "Synopsis\n"
 "--------\n"
 "\n"
-"%s [-ah] <newick trees filename|-> <maximum depth>\n"
+"%s [-ahl] [-j <processes>] <newick trees filename|-> <maximum depth>...\n"
 "\n"
 "or\n"
-"%s [-h] <newick trees filename|->\n"
+"%s [-hl] [-j <processes>] <newick trees filename|->\n"
 "\n"
 "Input\n"
 "-----\n"
@@ -78,7 +86,8 @@ void help(char *argv[])
 "Two-argument form:\n"
 "The first argument is the name of a file that contains Newick trees, or '-'\n"
 "(in which case trees are read from standard input). The second argument is\n"
-"the maximum depth: nodes deeper than this will be trimmed.\n"
+"the maximum depth: nodes deeper than this will be trimmed. More than one\n"
+"maximum depth may be given, see below.\n"
 "\n"
 "One-argument form:\n"
 "The argument is the name of the trees file, or '-' for standard input. The \n"
@@ -90,6 +99,21 @@ void help(char *argv[])
 "A tree whose depth is at most the maximum depth (second argument).\n"
 "Effectively, it is like cutting the tree at that value: nodes that are too\n"
 "deep get trimmed, and internal nodes also lose their children.\n"
+"If several maximum depths are given, each tree is output once for each\n"
+"depth, in the order of the arguments. This is much faster than running\n"
+"the program once per depth.\n"
+"\n"
+"With -l, no tree is output. Instead, the program prints the number of\n"
+"lineages through time (LTT). A lineage is a branch of the tree: it starts\n"
+"at its parent node's depth and ends at its child node's depth. In the\n"
+"one-argument form, the output has one line per distinct node depth (an\n"
+"'event'), in increasing order: the depth and the number of lineages just\n"
+"after it, separated by a TAB. The root's depth is 0, and the count is 0\n"
+"after the deepest leaf. Trees are separated by an empty line. If depths are\n"
+"given, the output has one line per tree, with the number of lineages at\n"
+"each depth (TAB-separated, in the order of the arguments). A lineage that\n"
+"ends at a leaf is counted at the leaf's depth, so for a tree whose leaves\n"
+"are all at depth d, the count at d is the number of leaves.\n"
 "\n"
 "Options\n"
 "-------\n"
@@ -98,6 +122,11 @@ void help(char *argv[])
 "        Nodes are not shortened, but no node is retained that has more\n"
 "        ancestors than the maximum.\n"
 "    -h: print this message and exit\n"
+"    -l: print lineages through time (see above). With -a, depths are\n"
+"        numbers of ancestors. Without -a, trees without branch lengths\n"
+"        have all their nodes at depth 0 (a warning is printed).\n"
+"    -j <n>: process the trees in n processes (default: 1). The output is\n"
+"        the same, and in the same order.\n"
 "\n"
 "Examples\n"
 "--------\n"
@@ -106,7 +135,15 @@ void help(char *argv[])
 "$ %s data/catarrhini 20\n"
 "\n"
 "# Discard nodes with more than 3 ancestors\n"
-"$ %s -a data/catarrhini 3\n",
+"$ %s -a data/catarrhini 3\n"
+"\n"
+"# Cut tree at depths 10, 20 and 30 (outputs three trees)\n"
+"$ %s data/catarrhini 10 20 30\n"
+"\n"
+"# Number of lineages at depths 10, 20 and 30, in all trees\n"
+"$ %s -l -j 4 posterior.nw 10 20 30\n",
+	argv[0],
+	argv[0],
 	argv[0],
 	argv[0],
 	argv[0],
@@ -118,10 +155,13 @@ struct parameters get_params(int argc, char *argv[])
 {
 	struct parameters params;
 	params.depth_type = DEPTH_DISTANCE;
-	params.threshold = TRIM_UNDEFINED;
+	params.thresholds = NULL;
+	params.nb_thresholds = 0;
+	params.nb_workers = 1;
+	params.ltt = false;
 
 	int opt_char;
-	while ((opt_char = getopt(argc, argv, "ah")) != -1) {
+	while ((opt_char = getopt(argc, argv, "ahj:l")) != -1) {
 		switch (opt_char) {
 		case 'a':
 			params.depth_type = DEPTH_ANCESTORS;
@@ -129,6 +169,12 @@ struct parameters get_params(int argc, char *argv[])
 		case 'h':
 			help(argv);
 			exit (EXIT_SUCCESS);
+		case 'j':
+			params.nb_workers = parse_nb_workers(optarg);
+			break;
+		case 'l':
+			params.ltt = true;
+			break;
 		default:
 			fprintf (stderr, "Unknown option '-%c'\n", opt_char);
 			exit (EXIT_FAILURE);
@@ -136,7 +182,7 @@ struct parameters get_params(int argc, char *argv[])
 	}
 
 	/* check arguments */
-	if ((argc - optind) == 2)	{
+	if ((argc - optind) >= 2)	{
 		if (0 != strcmp("-", argv[optind])) {
 			FILE *fin = fopen(argv[optind], "r");
 			extern FILE *nwsin;
@@ -147,10 +193,21 @@ struct parameters get_params(int argc, char *argv[])
 			nwsin = fin;
 		}
 		optind++;	/* optind is now index of 2nd arg - depth */
-		params.threshold = atof(argv[optind]);
-		/* A value of n means "n ancestors or less" */
-		if (DEPTH_ANCESTORS == params.depth_type)
-			params.threshold -= 1;
+		params.nb_thresholds = argc - optind;
+		params.thresholds = malloc(params.nb_thresholds *
+				sizeof(double));
+		if (NULL == params.thresholds) {
+			perror(NULL);
+			exit(EXIT_FAILURE);
+		}
+		int i;
+		for (i = 0; i < params.nb_thresholds; i++) {
+			params.thresholds[i] = atof(argv[optind + i]);
+			/* A value of n means "n ancestors or less" */
+			if (DEPTH_ANCESTORS == params.depth_type &&
+					! params.ltt)
+				params.thresholds[i] -= 1;
+		}
 	} else if ((argc - optind) == 1) {
 		if (0 != strcmp("-", argv[optind])) {
 			FILE *fin = fopen(argv[optind], "r");
@@ -162,119 +219,226 @@ struct parameters get_params(int argc, char *argv[])
 			nwsin = fin;
 		}
 	} else {
-		fprintf(stderr, "Usage: %s [-ah] <filename|-> [depth]\n",
-				argv[0]);
+		fprintf(stderr, "Usage: %s [-ahl] [-j <processes>] <filename|-> "
+				"[depth...]\n", argv[0]);
 		exit(EXIT_FAILURE);
 	}
 
 	return params;
 }
 
-void trim(struct rnode *node, struct parameters params)
+/* True iff 'node' is deeper than 'threshold'. The root never is. */
+
+static bool too_deep(struct rnode *node, struct tree_stats *stats,
+		int depth_type, double threshold)
+{
+	if (is_root(node)) return false;
+	if (DEPTH_DISTANCE == depth_type)
+		return stats->depth[node->index] > threshold;
+	else
+		return stats->nb_ancestors[node->index] > threshold;
+}
+
+/* Prints a node's label and length. A node that is too deep is a trimmed
+ * leaf: when trimming by distance, its parent edge is shortened so that it
+ * ends exactly at the threshold. */
+
+static void print_label_and_length(struct rnode *node,
+		struct tree_stats *stats, int depth_type, double threshold)
 {
-	struct node_data *ndata = node->data;
-
-	if (DEPTH_DISTANCE == params.depth_type) {
-		/* Shrink parent edge length */
-		double excess = ndata->distance_depth - params.threshold;
-		double trimmed_edge_length = node->edge_length - excess;
-		free(node->edge_length_as_string);
-		char *new_length = masprintf("%g", trimmed_edge_length);
-		if (NULL == new_length) { perror(NULL); exit(EXIT_FAILURE); }
-		node->edge_length_as_string = new_length;
+	fputs(node->label, stdout);
+	if (DEPTH_DISTANCE == depth_type &&
+			too_deep(node, stats, depth_type, threshold)) {
+		double excess = stats->depth[node->index] - threshold;
+		printf(":%g", atof(node->edge_length_as_string) - excess);
+	} else if ('\0' != node->edge_length_as_string[0]) {
+		putchar(':');
+		fputs(node->edge_length_as_string, stdout);
 	}
+}
 
-	remove_children(node);	/* no effect on leaves */
+/* Prints the whole tree, without the root's length */
 
-	ndata->trimmed = true;
+static void print_root_trimmed(struct rooted_tree *tree)
+{
+	static char no_length[] = "";
+	char *root_length = tree->root->edge_length_as_string;
+	tree->root->edge_length_as_string = no_length;
+	dump_newick(tree->root);
+	tree->root->edge_length_as_string = root_length;
 }
 
-void process_tree(struct rooted_tree *tree, struct parameters params)
+/* Prints the tree as if it had been trimmed at 'threshold', without changing
+ * it (so that it can be printed again at another threshold). This is a
+ * pre-order walk that does not enter the subtrees of nodes that are too deep:
+ * these are printed as leaves. */
+
+static void print_trimmed_tree(struct rooted_tree *tree,
+		struct tree_stats *stats, int depth_type, double threshold)
 {
-	struct llist *nodes_in_preorder;
-	struct list_elem *elem;
-	struct rnode *node;
-
-	/* Simple case: trim root */
-	if (TRIM_UNDEFINED == params.threshold) {
-		free(tree->root->edge_length_as_string);
-		tree->root->edge_length_as_string = strdup("");
-		return;
-	} 
-
-	/* Harder case: trim other nodes */
-	nodes_in_preorder = llist_reverse(tree->nodes_in_order);
-	if (NULL == nodes_in_preorder) { perror(NULL); exit(EXIT_FAILURE); }
-	node = (struct rnode *) nodes_in_preorder->head->data; /* root */
-	struct node_data * ndata = malloc(sizeof(struct node_data));
-	if (NULL == ndata) { perror(NULL); exit(EXIT_FAILURE); }
-	ndata->distance_depth = 0.0;
-	ndata->ancestry_depth = 0;
-	ndata->trimmed = false;
-	node->data = ndata;
-
-	/* This starts just AFTER the root! */
-	for (elem = nodes_in_preorder->head->next;
-			NULL != elem; elem = elem->next) {
-		node = (struct rnode *) elem->data;
-		struct node_data *parent_data = node->parent->data;
-		/* allocate this node's data structure */
-		ndata = malloc(sizeof(struct node_data));
-		if (NULL == ndata) { perror(NULL); exit(EXIT_FAILURE); }
-		node->data = ndata;
-
-		/* See if parent has been trimmed */
-		if (parent_data->trimmed) {
-			// printf ("trimmed.\n");
-			ndata->trimmed = true; 	/* inherit trimmed status */
+	struct rnode *node = tree->root;
+
+	for (;;) {
+		if (! is_leaf(node) &&
+			! too_deep(node, stats, depth_type, threshold)) {
+			putchar('(');
+			node = node->first_child;
 			continue;
-		} else {
-			/* If we don't do this, ndata->trimmed may
-			 * contain garbage!  (thanks Valgrind :-) */
-			ndata->trimmed = false;
 		}
+		print_label_and_length(node, stats, depth_type, threshold);
+		/* Go back up until there is a next sibling (or to the root) */
+		while (! is_root(node) && NULL == node->next_sibling) {
+			node = node->parent;
+			putchar(')');
+			print_label_and_length(node, stats, depth_type,
+					threshold);
+		}
+		if (is_root(node)) break;
+		putchar(',');
+		node = node->next_sibling;
+	}
+	puts(";");
+}
 
+static int compare_events(const void *a, const void *b)
+{
+	const struct ltt_event *ea = a, *eb = b;
+	if (ea->depth != eb->depth) return ea->depth < eb->depth ? -1 : 1;
+	/* At the same depth, leaves come last: see lineages_at() */
+	return (int) ea->is_leaf - (int) eb->is_leaf;
+}
 
-		/* Parent not trimmed: See if we must trim this node. */
-	
-		/* compute this node's depth measures */
-		double edge_length = atof(node->edge_length_as_string);
-		node->edge_length = edge_length;
-		ndata->distance_depth = edge_length + parent_data->distance_depth;
-		ndata->ancestry_depth = 1 + parent_data->ancestry_depth;
-
-		switch (params.depth_type) {
-		case DEPTH_DISTANCE:
-			if (ndata->distance_depth > params.threshold)
-				trim(node, params);
-			break;
-		case DEPTH_ANCESTORS:
-			if (ndata->ancestry_depth > params.threshold)
-				trim(node, params);
-			break;
-		default:
-			assert (false);	/* programmer error */
-			exit(EXIT_FAILURE);
+/* Fills 'events' with one event per node, sorted by depth, and sets
+ * 'counts[i]' to the number of lineages after events 0..i. Both arrays have
+ * one element per node. */
+
+static void ltt_events(struct tree_stats *stats, int depth_type,
+		struct ltt_event *events, int *counts)
+{
+	int n = stats->nb_nodes;
+	int i;
+
+	for (i = 0; i < n; i++) {
+		struct rnode *node = stats->nodes[i];
+		struct ltt_event *event = events + i;
+		event->depth = DEPTH_DISTANCE == depth_type ?
+			stats->depth[i] : stats->nb_ancestors[i];
+		event->is_leaf = is_leaf(node);
+		event->delta = node->child_count - (is_root(node) ? 0 : 1);
+	}
+	qsort(events, n, sizeof(struct ltt_event), compare_events);
+
+	int lineages = 0;
+	for (i = 0; i < n; i++) {
+		lineages += events[i].delta;
+		counts[i] = lineages;
+	}
+}
+
+/* Number of lineages at depth 'depth': this counts all events up to 'depth',
+ * except leaves at exactly 'depth' (whose lineages are still there). Events
+ * are sorted, so a binary search finds the last event to count. */
+
+static int lineages_at(struct ltt_event *events, int *counts, int n,
+		double depth)
+{
+	int lo = 0, hi = n;	/* the answer is in [lo, hi) */
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		if (events[mid].depth < depth || (events[mid].depth == depth &&
+					! events[mid].is_leaf))
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return 0 == lo ? 0 : counts[lo - 1];
+}
+
+/* True iff some edge of the tree has a length */
+
+static bool has_lengths(struct tree_stats *stats)
+{
+	int i;
+	for (i = 0; i < stats->nb_nodes - 1; i++)	/* not the root */
+		if ('\0' != stats->nodes[i]->edge_length_as_string[0])
+			return true;
+	return false;
+}
+
+static void print_ltt(struct tree_stats *stats, struct parameters *params)
+{
+	int n = stats->nb_nodes;
+	if (DEPTH_DISTANCE == params->depth_type && n > 1 &&
+			! has_lengths(stats))
+		fprintf(stderr, "WARNING: tree has no branch lengths, all "
+				"nodes are at depth 0 (use -a?)\n");
+
+	struct ltt_event *events = malloc(n * sizeof(struct ltt_event));
+	int *counts = malloc(n * sizeof(int));
+	if (NULL == events || NULL == counts) {
+		perror(NULL);
+		exit(EXIT_FAILURE);
+	}
+	ltt_events(stats, params->depth_type, events, counts);
+	int i;
+
+	if (0 == params->nb_thresholds) {
+		/* one line per distinct depth */
+		for (i = 0; i < n; i++) {
+			if (i < n - 1 && events[i+1].depth == events[i].depth)
+				continue;
+			printf("%g\t%d\n", events[i].depth, counts[i]);
 		}
+		putchar('\n');
+	} else {
+		for (i = 0; i < params->nb_thresholds; i++)
+			printf("%s%d", 0 == i ? "" : "\t",
+				lineages_at(events, counts, n,
+					params->thresholds[i]));
+		putchar('\n');
 	}
+	free(events);
+	free(counts);
+}
 
-	destroy_llist(nodes_in_preorder);
+static void process_one_tree(struct rooted_tree *tree, void *arg)
+{
+	struct parameters *params = arg;
+
+	if (params->ltt) {
+		struct tree_stats *stats = get_tree_stats(tree);
+		if (NULL == stats) { perror(NULL); exit(EXIT_FAILURE); }
+		print_ltt(stats, params);
+	} else if (0 == params->nb_thresholds) {
+		print_root_trimmed(tree);
+	} else {
+		/* Depths are computed once, for all thresholds */
+		struct tree_stats *stats = get_tree_stats(tree);
+		if (NULL == stats) { perror(NULL); exit(EXIT_FAILURE); }
+		int i;
+		for (i = 0; i < params->nb_thresholds; i++) {
+			if (TRIM_ROOT == params->thresholds[i])
+				print_root_trimmed(tree);
+			else
+				print_trimmed_tree(tree, stats,
+					params->depth_type,
+					params->thresholds[i]);
+		}
+	}
 
+	destroy_all_rnodes(NULL);
+	destroy_tree(tree);
 }
 
 int main(int argc, char *argv[])
 {
-	struct rooted_tree *tree;	
 	struct parameters params;
 	
 	params = get_params(argc, argv);
 
-	while (NULL != (tree = parse_tree())) {
-		process_tree(tree, params);
-		dump_newick(tree->root);
-		destroy_all_rnodes(NULL);
-		destroy_tree(tree);
-	}
+	if (! run_tree_pipeline(params.nb_workers, process_one_tree, &params))
+		exit(EXIT_FAILURE);
 
+	free(params.thresholds);
 	return 0;
 }
@@ -0,0 +1,119 @@
+/* bench_clone.c: measures the throughput of clone_rnode() and
+ * clone_rnode_cond() (in nodes per second) on balanced and ladder trees. This
+ * is not part of the test suite - run it by hand, e.g.
+
+	$ ./bench_clone 1000000 5
+
+ * where the first argument is the (approximate) number of leaves and the
+ * second is the number of repetitions. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "rnode.h"
+#include "link.h"
+
+/* Builds a complete binary tree with 2^levels leaves (iteratively, level by
+ * level) */
+
+static struct rnode *balanced_tree(int levels)
+{
+	int width = 1;
+	struct rnode **level = malloc(sizeof(struct rnode *));
+	if (NULL == level) { perror(NULL); exit(EXIT_FAILURE); }
+	level[0] = create_rnode("", "");
+	struct rnode *root = level[0];
+	int l, i;
+	for (l = 0; l < levels; l++) {
+		struct rnode **next = malloc(2 * width * sizeof(struct rnode *));
+		if (NULL == next) { perror(NULL); exit(EXIT_FAILURE); }
+		for (i = 0; i < width; i++) {
+			next[2*i] = create_rnode("a", "1");
+			next[2*i+1] = create_rnode("b", "1");
+			add_child(level[i], next[2*i]);
+			add_child(level[i], next[2*i+1]);
+		}
+		free(level);
+		level = next;
+		width *= 2;
+	}
+	free(level);
+	return root;
+}
+
+/* Builds a ladder (caterpillar) with 'nb_leaves' leaves */
+
+static struct rnode *ladder_tree(int nb_leaves)
+{
+	struct rnode *root = create_rnode("", "");
+	struct rnode *current = root;
+	int i;
+	for (i = 0; i < nb_leaves - 2; i++) {
+		struct rnode *inner = create_rnode("", "1");
+		add_child(current, create_rnode("a", "1"));
+		add_child(current, inner);
+		current = inner;
+	}
+	add_child(current, create_rnode("a", "1"));
+	add_child(current, create_rnode("b", "1"));
+	return root;
+}
+
+static bool always_true(struct rnode *node, void *param)
+{
+	node = node; param = param;	/* avoid 'unused' warnings */
+	return true;
+}
+
+static void bench(const char *name, struct rnode *(*build)(int), int arg,
+		int reps)
+{
+	int r;
+	double total = 0, total_cond = 0;
+	int nb_nodes = 0;
+
+	for (r = 0; r < reps; r++) {
+		struct rnode *root = build(arg);
+		nb_nodes = _get_rnode_count();
+
+		clock_t start = clock();
+		if (NULL == clone_rnode(root)) {
+			perror(NULL); exit(EXIT_FAILURE);
+		}
+		total += (double) (clock() - start) / CLOCKS_PER_SEC;
+
+		start = clock();
+		if (NULL == clone_rnode_cond(root, always_true, NULL)) {
+			perror(NULL); exit(EXIT_FAILURE);
+		}
+		total_cond += (double) (clock() - start) / CLOCKS_PER_SEC;
+
+		destroy_all_rnodes(NULL);
+	}
+
+	printf("%-10s %10d nodes  clone_rnode(): %12.0f nodes/s"
+		"  clone_rnode_cond(): %12.0f nodes/s\n", name, nb_nodes,
+		nb_nodes * reps / total, nb_nodes * reps / total_cond);
+}
+
+int main(int argc, char *argv[])
+{
+	int nb_leaves = 1000000;
+	int reps = 5;
+	if (argc > 1) nb_leaves = atoi(argv[1]);
+	if (argc > 2) reps = atoi(argv[2]);
+	if (nb_leaves < 2 || reps < 1) {
+		fprintf(stderr, "Usage: %s [nb_leaves [reps]]\n", argv[0]);
+		exit(EXIT_FAILURE);
+	}
+
+	int levels = 1;
+	while ((1 << levels) < nb_leaves) levels++;
+
+	bench("balanced", balanced_tree, levels, reps);
+	bench("ladder", ladder_tree, nb_leaves, reps);
+
+	return 0;
+}
@@ -0,0 +1,256 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "rnode.h"
+#include "list.h"
+#include "parser.h"
+#include "tree.h"
+#include "bipart.h"
+
+void newick_scanner_set_string_input(char *);
+void newick_scanner_clear_string_input();
+
+static struct rooted_tree *parse(char *newick)
+{
+	newick_scanner_set_string_input(newick);
+	struct rooted_tree *tree = parse_tree();
+	newick_scanner_clear_string_input();
+	return tree;
+}
+
+static struct bipart_set *biparts(char *newick, struct bipart_leaves *leaves)
+{
+	struct bipart_set *set;
+	if (BIPART_OK != get_bipart_set(parse(newick), leaves, &set))
+		return NULL;
+	return set;
+}
+
+int test_leaves()
+{
+	const char *test_name = __func__;
+	struct bipart_leaves *leaves;
+
+	if (BIPART_OK != create_bipart_leaves(parse("((C,A),(D,B));"),
+				&leaves)) {
+		printf("%s: could not number leaves\n", test_name);
+		return 1;
+	}
+	if (4 != leaves->nb_leaves || 1 != leaves->nb_words) {
+		printf("%s: expected 4 leaves in 1 word, got %d in %d\n",
+			test_name, leaves->nb_leaves, leaves->nb_words);
+		return 1;
+	}
+	/* lexical order */
+	if (0 != strcmp("A", leaves->labels[0]) ||
+			0 != strcmp("D", leaves->labels[3])) {
+		printf("%s: leaves are not in lexical order\n", test_name);
+		return 1;
+	}
+	if (BIPART_DUP_LABEL != create_bipart_leaves(parse("((A,B),A);"),
+				&leaves)) {
+		printf("%s: duplicate label not detected\n", test_name);
+		return 1;
+	}
+	if (BIPART_EMPTY_LABEL != create_bipart_leaves(parse("((A,B),);"),
+				&leaves)) {
+		printf("%s: empty label not detected\n", test_name);
+		return 1;
+	}
+
+	printf("%s ok.\n", test_name);
+	return 0;
+}
+
+int test_splits()
+{
+	const char *test_name = __func__;
+	struct bipart_leaves *leaves;
+	create_bipart_leaves(parse("(A,B,C,D,E);"), &leaves);
+
+	/* The two edges below the root are the same split, and (A,B) is the
+	 * complement of (C,(D,E)) */
+	struct bipart_set *set = biparts("((A,B),(C,(D,E)));", leaves);
+	if (NULL == set || 2 != set->nb_biparts) {
+		printf("%s: expected 2 splits\n", test_name);
+		return 1;
+	}
+	char *s0 = bipart_to_s(set, 0, 5);
+	char *s1 = bipart_to_s(set, 1, 5);
+	/* the side without A is stored */
+	if (! ((0 == strcmp("..***", s0) && 0 == strcmp("...**", s1)) ||
+	       (0 == strcmp("...**", s0) && 0 == strcmp("..***", s1)))) {
+		printf("%s: wrong splits %s and %s\n", test_name, s0, s1);
+		return 1;
+	}
+
+	struct bipart_set *star = biparts("(A,B,C,D,E);", leaves);
+	if (0 != star->nb_biparts) {
+		printf("%s: a star tree has no split\n", test_name);
+		return 1;
+	}
+	if (BIPART_UNKNOWN_LABEL != get_bipart_set(parse("((A,B),(C,(D,X)));"),
+				leaves, &set) ||
+		BIPART_WRONG_LEAF_COUNT != get_bipart_set(
+				parse("((A,B),(C,D));"), leaves, &set)) {
+		printf("%s: wrong leaves not detected\n", test_name);
+		return 1;
+	}
+
+	printf("%s ok.\n", test_name);
+	return 0;
+}
+
+int test_rf()
+{
+	const char *test_name = __func__;
+	struct bipart_leaves *leaves;
+	create_bipart_leaves(parse("(A,B,C,D,E,F);"), &leaves);
+
+	struct bipart_set *t1 = biparts("((A,B),(C,(D,(E,F))));", leaves);
+	/* same unrooted tree, rooted elsewhere and with children swapped */
+	struct bipart_set *t2 = biparts("(((F,E),D),(C,(B,A)));", leaves);
+	struct bipart_set *t3 = biparts("((A,C),(B,(D,(E,F))));", leaves);
+	struct bipart_set *star = biparts("(A,B,C,D,E,F);", leaves);
+
+	if (0 != rf_distance(t1, t2)) {
+		printf("%s: expected RF 0, got %d\n", test_name,
+				rf_distance(t1, t2));
+		return 1;
+	}
+	/* t1 has AB|CDEF, t3 has AC|BDEF; both have ABC|DEF and ABCD|EF */
+	if (2 != rf_distance(t1, t3) || 2 != common_bipart_count(t1, t3)) {
+		printf("%s: expected RF 2, got %d\n", test_name,
+				rf_distance(t1, t3));
+		return 1;
+	}
+	if (3 != rf_distance(t1, star) || 3 != rf_distance(star, t3)) {
+		printf("%s: expected RF 3 to star tree\n", test_name);
+		return 1;
+	}
+
+	printf("%s ok.\n", test_name);
+	return 0;
+}
+
+int test_counts()
+{
+	const char *test_name = __func__;
+	struct bipart_leaves *leaves;
+	create_bipart_leaves(parse("(A,B,C,D,E,F);"), &leaves);
+	struct bipart_counts *counts = create_bipart_counts(leaves->nb_words);
+
+	struct bipart_set *t1 = biparts("((A,B),(C,(D,(E,F))));", leaves);
+	struct bipart_set *t2 = biparts("((A,C),(B,(D,(E,F))));", leaves);
+	struct bipart_set *t3 = biparts("(((A,B),C),D,(E,F));", leaves);
+	add_bipart_counts(counts, t1);
+	add_bipart_counts(counts, t2);
+	add_bipart_counts(counts, t3);
+
+	if (3 != counts->nb_trees || 4 != counts->nb_biparts) {
+		printf("%s: expected 4 distinct splits in 3 trees, got %d in "
+			"%d\n", test_name, counts->nb_biparts,
+			counts->nb_trees);
+		return 1;
+	}
+	/* t1's splits: AB|CDEF (2 trees), ABC|DEF (3), ABCD|EF (3) */
+	int i, exp[] = {2, 3, 3};
+	for (i = 0; i < 3; i++) {
+		char *s = bipart_to_s(t1, i, 6);
+		int exp_count = 0 == strcmp("..****", s) ? exp[0] :
+			0 == strcmp("...***", s) ? exp[1] : exp[2];
+		int count = get_bipart_count(counts, t1->fingerprints[i]);
+		if (exp_count != count) {
+			printf("%s: expected count %d for %s, got %d\n",
+				test_name, exp_count, s, count);
+			return 1;
+		}
+	}
+	if (0 != get_bipart_count(counts, 12345)) {
+		printf("%s: expected count 0 for unknown split\n", test_name);
+		return 1;
+	}
+
+	destroy_bipart_counts(counts);
+	printf("%s ok.\n", test_name);
+	return 0;
+}
+
+int test_index()
+{
+	const char *test_name = __func__;
+	struct bipart_leaves *leaves;
+	create_bipart_leaves(parse("(A,B,C,D,E);"), &leaves);
+	struct bipart_counts *counts = create_bipart_counts(leaves->nb_words);
+	struct bipart_set *set;
+
+	/* rooted clusters: the root's and the knee's count */
+	get_cluster_set(parse("(((A,B)),(C,(D,E)));"), leaves, &set);
+	if (4 != set->nb_biparts) {
+		printf("%s: expected 4 clusters, got %d\n", test_name,
+				set->nb_biparts);
+		return 1;
+	}
+	add_bipart_counts(counts, set);
+	get_cluster_set(parse("((A,B),C,(D,E));"), leaves, &set);
+	add_bipart_counts(counts, set);
+
+	char *filename = "test_bipart.idx";
+	FILE *file = fopen(filename, "w");
+	if (NULL == file || BIPART_OK != save_bipart_index(counts, leaves,
+				file)) {
+		printf("%s: could not save index\n", test_name);
+		return 1;
+	}
+	fclose(file);
+
+	struct bipart_index *index;
+	if (BIPART_OK != load_bipart_index(filename, &index)) {
+		printf("%s: could not load index\n", test_name);
+		return 1;
+	}
+	if (2 != index->nb_trees || 4 != index->nb_biparts ||
+		5 != index->leaves->nb_leaves ||
+		0 != strcmp("E", index->leaves->labels[4])) {
+		printf("%s: wrong index header\n", test_name);
+		return 1;
+	}
+	int i;
+	for (i = 0; i < counts->nb_biparts; i++) {
+		if (counts->counts[i] != bipart_index_count(index,
+					counts->fingerprints[i])) {
+			printf("%s: wrong count for split #%d\n", test_name,
+					i);
+			return 1;
+		}
+	}
+	if (0 != bipart_index_count(index, 12345)) {
+		printf("%s: expected count 0 for unknown split\n", test_name);
+		return 1;
+	}
+	destroy_bipart_index(index);
+	remove(filename);
+
+	printf("%s ok.\n", test_name);
+	return 0;
+}
+
+int main()
+{
+	int failures = 0;
+	printf("Starting bipartition test...\n");
+	failures += test_leaves();
+	failures += test_splits();
+	failures += test_rf();
+	failures += test_counts();
+	failures += test_index();
+	if (0 == failures) {
+		printf("All tests ok.\n");
+	} else {
+		printf("%d test(s) FAILED.\n", failures);
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,146 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "rnode.h"
+#include "list.h"
+#include "parser.h"
+#include "tree.h"
+#include "to_newick.h"
+#include "collapse.h"
+
+void newick_scanner_set_string_input(char *);
+void newick_scanner_clear_string_input();
+
+static struct rooted_tree *parse(char *newick)
+{
+	newick_scanner_set_string_input(newick);
+	struct rooted_tree *tree = parse_tree();
+	newick_scanner_clear_string_input();
+	return tree;
+}
+
+/* Checks that the tree's nodes_in_order list holds exactly its nodes */
+
+static int check_nodes_in_order(const char *test_name,
+		struct rooted_tree *tree)
+{
+	struct llist *nodes = get_nodes_in_order(tree->root);
+	struct list_elem *el1, *el2;
+	for (el1 = nodes->head, el2 = tree->nodes_in_order->head;
+			NULL != el1 && NULL != el2;
+			el1 = el1->next, el2 = el2->next) {
+		if (el1->data != el2->data) break;
+		if (NULL != ((struct rnode *) el2->data)->data) {
+			printf("%s: node data should be NULL\n", test_name);
+			return 1;
+		}
+	}
+	if (NULL != el1 || NULL != el2 ||
+		nodes->count != tree->nodes_in_order->count ||
+		tree->nodes_in_order->tail->data != tree->root) {
+		printf("%s: wrong nodes_in_order\n", test_name);
+		return 1;
+	}
+	destroy_llist(nodes);
+	return 0;
+}
+
+static int check_newick(const char *test_name, struct rooted_tree *tree,
+		char *exp)
+{
+	char *obt = to_newick(tree->root);
+	if (0 != strcmp(exp, obt)) {
+		printf("%s: expected '%s', got '%s'\n", test_name, exp, obt);
+		return 1;
+	}
+	free(obt);
+	return check_nodes_in_order(test_name, tree);
+}
+
+int test_polytomies()
+{
+	const char *test_name = __func__;
+	char *newick = "((A:1,B:1)50:2,(C:1,(D:1,E:1)90:2)30:3,(F,G)x)r;";
+	struct collapse_criteria criteria = { true, 60, false, 0 };
+
+	struct rooted_tree *tree = parse(newick);
+	if (! collapse_into_polytomies(tree, &criteria)) {
+		printf("%s: collapse failed\n", test_name);
+		return 1;
+	}
+	/* 30 is collapsed after 90 is kept: (D,E) moves up with it */
+	if (check_newick(test_name, tree,
+			"(A:3,B:3,C:4,(D:1,E:1)90:5,(F,G)x)r;"))
+		return 1;
+
+	/* Nested collapses */
+	tree = parse("(((A:0,B:1)95:0,C:1)80:0,D:2);");
+	criteria.by_support = false;
+	criteria.by_length = true;
+	if (! collapse_into_polytomies(tree, &criteria)) {
+		printf("%s: collapse failed\n", test_name);
+		return 1;
+	}
+	if (check_newick(test_name, tree, "(A:0,B:1,C:1,D:2);"))
+		return 1;
+
+	printf("%s ok.\n", test_name);
+	return 0;
+}
+
+int test_groups()
+{
+	const char *test_name = __func__;
+	struct collapse_groups *groups = create_collapse_groups();
+	char *labels[] = { "A", "B", "C", "D", "E", NULL };
+	char *names[] = { "g", "g", "h", "g", "g" };
+	int i;
+	for (i = 0; NULL != labels[i]; i++)
+		add_to_collapse_group(groups, labels[i], names[i]);
+	if (2 != groups->nb_groups) {
+		printf("%s: expected 2 groups, got %d\n", test_name,
+				groups->nb_groups);
+		return 1;
+	}
+
+	/* X is in no group, so (X,Y) stays */
+	struct rooted_tree *tree = parse(
+		"((A:1,(B,A)90:1)50:2,(C:1,(D:1,E:1)90:2)30:3,(X,Y))r;");
+	if (! collapse_by_groups(tree, groups)) {
+		printf("%s: collapse failed\n", test_name);
+		return 1;
+	}
+	if (check_newick(test_name, tree,
+			"(g_A_3:2,(C:1,g_E_2:2)30:3,(X,Y))r;"))
+		return 1;
+
+	/* the root can be collapsed too */
+	tree = parse("((A,B),(D,E));");
+	if (! collapse_by_groups(tree, groups)) {
+		printf("%s: collapse failed\n", test_name);
+		return 1;
+	}
+	if (check_newick(test_name, tree, "g_E_4;"))
+		return 1;
+
+	destroy_collapse_groups(groups);
+	printf("%s ok.\n", test_name);
+	return 0;
+}
+
+int main()
+{
+	int failures = 0;
+	printf("Starting collapse test...\n");
+	failures += test_polytomies();
+	failures += test_groups();
+	if (0 == failures) {
+		printf("All tests ok.\n");
+	} else {
+		printf("%d test(s) FAILED.\n", failures);
+		return 1;
+	}
+
+	return 0;
+}
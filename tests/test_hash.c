@@ -281,9 +281,19 @@ int test_self_resizing()
 		return 1;
 	}
 
-	/*
-	 * now check keys & values*/
-
+	/* now check keys & values: "four" was added just as the hash grew */
+	const char *keys[] = {"one", "two", "three", "four", "five", "six"};
+	const char *values[] = {"uno", "dos", "tres", "cuatro", "cinco",
+		"seis"};
+	int i;
+	for (i = 0; i < 6; i++) {
+		char *value = hash_get(h, keys[i]);
+		if (NULL == value || strcmp(values[i], value) != 0) {
+			printf ("%s: wrong value for key '%s'\n", test_name,
+					keys[i]);
+			return 1;
+		}
+	}
 
 	printf ("%s ok.\n", test_name);
 	return 0;
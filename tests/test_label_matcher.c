@@ -0,0 +1,100 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <regex.h>
+
+#include "label_matcher.h"
+#include "hash.h"
+
+static struct label_matcher *matcher_for(char *regexp_string, int cflags)
+{
+	regex_t *preg = malloc(sizeof(regex_t));
+	if (NULL == preg || 0 != regcomp(preg, regexp_string, cflags))
+		return NULL;
+	return create_label_matcher(preg, regexp_string, cflags);
+}
+
+int test_prefix()
+{
+	const char *test_name = __func__;
+	struct { char *regexp; int cflags; char *prefix; } cases[] = {
+		{"^HRV.*", 0, "HRV"},
+		{"^HRV", 0, "HRV"},
+		{"HRV", 0, ""},
+		{"^HRVa*", 0, "HRV"},
+		{"^HRV\\.", 0, "HR"},
+		{"^HRV?", REG_EXTENDED, "HR"},
+		{"^HRV|^POLIO", REG_EXTENDED, ""},
+		{"^HRV", REG_ICASE, ""},
+		{NULL, 0, NULL}
+	};
+	int i;
+	for (i = 0; NULL != cases[i].regexp; i++) {
+		struct label_matcher *matcher = matcher_for(cases[i].regexp,
+				cases[i].cflags);
+		if (NULL == matcher) {
+			printf("%s: could not create matcher\n", test_name);
+			return 1;
+		}
+		if (0 != strcmp(cases[i].prefix, matcher->prefix)) {
+			printf("%s: expected prefix '%s' for /%s/, got '%s'\n",
+				test_name, cases[i].prefix, cases[i].regexp,
+				matcher->prefix);
+			return 1;
+		}
+		destroy_label_matcher(matcher);
+	}
+
+	printf("%s ok.\n", test_name);
+	return 0;
+}
+
+int test_match()
+{
+	const char *test_name = __func__;
+	struct label_matcher *matcher = matcher_for("^HRV.*[0-9]$", 0);
+	if (NULL == matcher) {
+		printf("%s: could not create matcher\n", test_name);
+		return 1;
+	}
+
+	/* twice each: the second time, the stored result is used */
+	int pass;
+	for (pass = 0; pass < 2; pass++) {
+		if (! label_matcher_match(matcher, "HRV12") ||
+		    ! label_matcher_match(matcher, "HRV_A1") ||
+		    label_matcher_match(matcher, "HRV") ||
+		    label_matcher_match(matcher, "POLIO1") ||
+		    label_matcher_match(matcher, "") ||
+		    label_matcher_match(matcher, "xHRV1")) {
+			printf("%s: wrong match (pass %d)\n", test_name, pass);
+			return 1;
+		}
+	}
+	/* labels that lack the prefix are never stored */
+	if (3 != matcher->results->count) {
+		printf("%s: expected 3 stored results, got %d\n", test_name,
+				matcher->results->count);
+		return 1;
+	}
+
+	destroy_label_matcher(matcher);
+	printf("%s ok.\n", test_name);
+	return 0;
+}
+
+int main()
+{
+	int failures = 0;
+	printf("Starting label matcher test...\n");
+	failures += test_prefix();
+	failures += test_match();
+	if (0 == failures) {
+		printf("All tests ok.\n");
+	} else {
+		printf("%d test(s) FAILED.\n", failures);
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,164 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "label_rewriter.h"
+#include "list.h"
+
+/* Rewrites 'label' with a single substitution */
+
+static const char *rewrite(char *expression, char *label)
+{
+	static struct label_rewriter *rewriter = NULL;
+	char *error;
+	if (NULL != rewriter) destroy_label_rewriter(rewriter);
+	rewriter = create_label_rewriter();
+	if (NULL == rewriter ||
+			! add_substitution(rewriter, expression, &error))
+		return NULL;
+	return label_rewriter_rewrite(rewriter, label);
+}
+
+int test_substitution()
+{
+	const char *test_name = __func__;
+	struct { char *expression; char *label; char *exp; } cases[] = {
+		{"s/\\.[0-9]+$//", "AB123456.2", "AB123456"},
+		{"s/\\.[0-9]+$//", "AB123456", "AB123456"},
+		{"s/^HRV.*/Rhinovirus/", "HRV_A1", "Rhinovirus"},
+		{"s/^HRV.*/Rhinovirus/", "POLIO1", "POLIO1"},
+		{"s/([A-Z]+)_([0-9]+)/\\2_\\1/", "HRV_16", "16_HRV"},
+		{"s/a/[&]/g", "banana", "b[a]n[a]n[a]"},
+		{"s/a/\\&/", "banana", "b&nana"},
+		{"s/A/x/gi", "aA", "xx"},
+		{"s|/|_|g", "a/b/c", "a_b_c"},
+		{"s/\\//_/", "a/b", "a_b"},
+		{"s/b*/-/g", "abc", "-a-c-"},
+		{"s/^/x/g", "ab", "xab"},
+		{"s/'//g", "'Bob''s'", "Bobs"},
+		{"s/$/_1/", "", "_1"},
+		{NULL, NULL, NULL}
+	};
+	int i;
+	for (i = 0; NULL != cases[i].expression; i++) {
+		const char *result = rewrite(cases[i].expression,
+				cases[i].label);
+		if (NULL == result || 0 != strcmp(cases[i].exp, result)) {
+			printf("%s: expected '%s' for '%s' on '%s', got '%s'\n",
+				test_name, cases[i].exp, cases[i].expression,
+				cases[i].label, result);
+			return 1;
+		}
+	}
+
+	printf("%s ok.\n", test_name);
+	return 0;
+}
+
+int test_errors()
+{
+	const char *test_name = __func__;
+	char *wrong[] = {"", "s", "x/a/b/", "s/a/b", "s/a/b/q", "s/(/b/",
+		"s/a/\\1/", "s/(a)/\\2/", NULL};
+	struct label_rewriter *rewriter = create_label_rewriter();
+	char **e;
+	for (e = wrong; NULL != *e; e++) {
+		char *error;
+		if (add_substitution(rewriter, *e, &error)) {
+			printf("%s: '%s' should be rejected\n", test_name, *e);
+			return 1;
+		}
+		if (NULL == error) {
+			printf("%s: expected an error message for '%s'\n",
+					test_name, *e);
+			return 1;
+		}
+		free(error);
+	}
+	if (0 != rewriter->substitutions->count) {
+		printf("%s: no substitution should have been added\n",
+				test_name);
+		return 1;
+	}
+	destroy_label_rewriter(rewriter);
+
+	printf("%s ok.\n", test_name);
+	return 0;
+}
+
+int test_chain()
+{
+	const char *test_name = __func__;
+	struct label_rewriter *rewriter = create_label_rewriter();
+	char *error;
+	if (! add_substitution(rewriter, "s/_[0-9]+$//", &error) ||
+	    ! add_substitution(rewriter, "s/^HRV$/Rhinovirus/", &error)) {
+		printf("%s: could not add substitutions\n", test_name);
+		return 1;
+	}
+
+	/* twice each: the second time, the stored result is used */
+	int pass;
+	for (pass = 0; pass < 2; pass++) {
+		const char *result = label_rewriter_rewrite(rewriter, "HRV_12");
+		if (0 != strcmp("Rhinovirus", result)) {
+			printf("%s: expected 'Rhinovirus', got '%s' "
+				"(pass %d)\n", test_name, result, pass);
+			return 1;
+		}
+		char *label = "POLIO";
+		if (label_rewriter_rewrite(rewriter, label) != label) {
+			printf("%s: an unchanged label should be returned "
+				"as is (pass %d)\n", test_name, pass);
+			return 1;
+		}
+	}
+	if (2 != rewriter->nb_results) {
+		printf("%s: expected 2 stored results, got %d\n", test_name,
+				rewriter->nb_results);
+		return 1;
+	}
+
+	/* enough labels to grow the table of results, twice over */
+	char label[20];
+	for (pass = 0; pass < 2; pass++) {
+		int i;
+		for (i = 0; i < 3000; i++) {
+			sprintf(label, "HRV_%d", i);
+			const char *result = label_rewriter_rewrite(rewriter,
+					label);
+			if (0 != strcmp("Rhinovirus", result)) {
+				printf("%s: expected 'Rhinovirus' for '%s', "
+					"got '%s'\n", test_name, label, result);
+				return 1;
+			}
+		}
+	}
+	/* HRV_12 was already stored */
+	if (3001 != rewriter->nb_results) {
+		printf("%s: expected 3001 stored results, got %d\n",
+				test_name, rewriter->nb_results);
+		return 1;
+	}
+	destroy_label_rewriter(rewriter);
+
+	printf("%s ok.\n", test_name);
+	return 0;
+}
+
+int main()
+{
+	int failures = 0;
+	printf("Starting label rewriter test...\n");
+	failures += test_substitution();
+	failures += test_errors();
+	failures += test_chain();
+	if (0 == failures) {
+		printf("All tests ok.\n");
+	} else {
+		printf("%d test(s) FAILED.\n", failures);
+		return 1;
+	}
+
+	return 0;
+}
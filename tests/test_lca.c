@@ -9,6 +9,8 @@
 #include "list.h"
 #include "tree.h"
 #include "hash.h"
+#include "link.h"
+#include "tree_stats.h"
 
 int test_lca2()
 {
@@ -270,6 +272,95 @@ int test_lca_from_labels_multi()
 
 #pragma GCC diagnostic pop
 
+/* Builds a tree of more than 2 * 32 nodes (so that LCA queries span whole
+ * blocks), with ladders, multifurcations and a knee. */
+
+static struct rooted_tree irregular_tree()
+{
+	struct rnode *root = create_rnode("root", "");
+	struct rnode *current = root;
+	int i, j;
+	for (i = 0; i < 30; i++) {
+		struct rnode *inner = create_rnode("", "1");
+		add_child(current, create_rnode("", "1"));
+		if (0 == i % 7) {
+			struct rnode *fan = create_rnode("", "1");
+			for (j = 0; j < 4; j++)
+				add_child(fan, create_rnode("", "1"));
+			add_child(current, fan);
+		}
+		add_child(current, inner);
+		current = inner;
+	}
+	struct rnode *knee = create_rnode("", "1");
+	add_child(current, knee);
+	add_child(knee, create_rnode("", "1"));
+	add_child(current, create_rnode("", "1"));
+
+	struct rooted_tree tree;
+	tree.root = root;
+	tree.nodes_in_order = get_nodes_in_order(root);
+	tree.type = TREE_TYPE_UNKNOWN;
+	tree.stats = NULL;
+	tree.attrs = NULL;
+	return tree;
+}
+
+/* LCA by walking up from the deeper node */
+
+static struct rnode *naive_lca(struct tree_stats *stats, struct rnode *n1,
+		struct rnode *n2)
+{
+	while (stats->nb_ancestors[n1->index] > stats->nb_ancestors[n2->index])
+		n1 = n1->parent;
+	while (stats->nb_ancestors[n2->index] > stats->nb_ancestors[n1->index])
+		n2 = n2->parent;
+	while (n1 != n2) {
+		n1 = n1->parent;
+		n2 = n2->parent;
+	}
+	return n1;
+}
+
+int test_lca_index()
+{
+	const char *test_name = __func__;
+	struct rooted_tree tree = irregular_tree();
+	struct lca_index *index = create_lca_index(&tree);
+	struct tree_stats *stats = get_tree_stats(&tree);
+	if (NULL == index || NULL == stats) {
+		printf("%s: could not create index\n", test_name);
+		return 1;
+	}
+	if (stats->nb_nodes < 2 * 32 + 1) {
+		printf("%s: expected more than 64 nodes, got %d\n",
+				test_name, stats->nb_nodes);
+		return 1;
+	}
+	if (0 != lca_index_rank(index, tree.root)) {
+		printf("%s: root should have rank 0\n", test_name);
+		return 1;
+	}
+
+	int i, j;
+	for (i = 0; i < stats->nb_nodes; i++) {
+		for (j = 0; j < stats->nb_nodes; j++) {
+			struct rnode *n1 = stats->nodes[i];
+			struct rnode *n2 = stats->nodes[j];
+			if (lca_index_query(index, n1, n2) !=
+					naive_lca(stats, n1, n2)) {
+				printf("%s: wrong LCA for nodes %d and %d\n",
+						test_name, i, j);
+				return 1;
+			}
+		}
+	}
+
+	destroy_lca_index(index);
+	printf("%s ok.\n", test_name);
+	return 0;
+}
+
 int main()
 {
 	int failures = 0;
@@ -278,6 +369,7 @@ int main()
 	failures += test_lca_from_labels();
 	failures += test_lca_from_labels_multi();
 	failures += test_lca_from_nodes();
+	failures += test_lca_index();
 	if (0 == failures) {
 		printf("All tests ok.\n");
 	} else {
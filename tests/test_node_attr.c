@@ -0,0 +1,231 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "rnode.h"
+#include "list.h"
+#include "link.h"
+#include "tree_stubs.h"
+#include "tree.h"
+#include "node_attr.h"
+#include "nodemap.h"
+#include "hash.h"
+
+int test_add_get()
+{
+	const char *test_name = __func__;
+	/* ((A:1,B:1.0)f:2.0,(C:1,(D:1,E:1)g:2)h:3)i; */
+	struct rooted_tree tree = tree_3();
+
+	struct node_attr *depth = add_node_attr(&tree, "depth",
+			NODE_ATTR_DOUBLE, 0);
+	struct node_attr *mark = add_node_attr(&tree, "mark",
+			NODE_ATTR_INT, 0);
+	if (NULL == depth || NULL == mark) {
+		printf("%s: could not add columns\n", test_name);
+		return 1;
+	}
+	if (9 != depth->nb_nodes || 9 != mark->nb_nodes) {
+		printf("%s: expected 9 values per column, got %d and %d\n",
+			test_name, depth->nb_nodes, mark->nb_nodes);
+		return 1;
+	}
+	if (get_node_attr(&tree, "depth") != depth ||
+			get_node_attr(&tree, "mark") != mark) {
+		printf("%s: get_node_attr() did not find the columns\n",
+				test_name);
+		return 1;
+	}
+	if (NULL != get_node_attr(&tree, "colour")) {
+		printf("%s: found a column that was never added\n",
+				test_name);
+		return 1;
+	}
+	/* same name, same type: same column */
+	if (add_node_attr(&tree, "depth", NODE_ATTR_DOUBLE, 0) != depth) {
+		printf("%s: re-adding 'depth' should return the column\n",
+				test_name);
+		return 1;
+	}
+	/* same name, other type: error */
+	if (NULL != add_node_attr(&tree, "depth", NODE_ATTR_INT, 0)) {
+		printf("%s: re-adding 'depth' as int should fail\n",
+				test_name);
+		return 1;
+	}
+
+	/* Both columns can be used at the same time */
+	double *depths = node_attr_doubles(depth);
+	int *marks = node_attr_ints(mark);
+	struct list_elem *el;
+	for (el = tree.nodes_in_order->head; NULL != el; el = el->next) {
+		struct rnode *node = el->data;
+		if (0 != depths[node->index] || 0 != marks[node->index]) {
+			printf("%s: values should be initialized to 0\n",
+					test_name);
+			return 1;
+		}
+		marks[node->index] = 1;
+		if (! is_root(node))
+			depths[node->index] = depths[node->parent->index] +
+				atof(node->edge_length_as_string);
+	}
+	struct hash *map = create_label2node_map(tree.nodes_in_order);
+	struct rnode *node_g = hash_get(map, "g");
+	if (1 != marks[node_g->index]) {
+		printf("%s: expected mark 1 for g\n", test_name);
+		return 1;
+	}
+
+	remove_node_attr(&tree, "mark");
+	if (NULL != get_node_attr(&tree, "mark") ||
+			get_node_attr(&tree, "depth") != depth) {
+		printf("%s: wrong columns after removal\n", test_name);
+		return 1;
+	}
+
+	destroy_node_attrs(tree.attrs);
+	printf("%s ok.\n", test_name);
+	return 0;
+}
+
+int test_bitset()
+{
+	const char *test_name = __func__;
+	/* ((A:1,B:1.0)f:2.0,(C:1,(D:1,E:1)g:2)h:3)i; */
+	struct rooted_tree tree = tree_3();
+	struct hash *map = create_label2node_map(tree.nodes_in_order);
+	struct rnode *node_f = hash_get(map, "f");
+	struct rnode *node_g = hash_get(map, "g");
+
+	/* more than one word per node */
+	struct node_attr *bits = add_node_attr(&tree, "bits",
+			NODE_ATTR_BITSET, 130);
+	if (NULL == bits) {
+		printf("%s: could not add column\n", test_name);
+		return 1;
+	}
+	node_attr_set_bit(bits, node_f, 0);
+	node_attr_set_bit(bits, node_f, 129);
+	node_attr_set_bit(bits, node_g, 64);
+
+	if (! node_attr_test_bit(bits, node_f, 0) ||
+	    ! node_attr_test_bit(bits, node_f, 129) ||
+	    node_attr_test_bit(bits, node_f, 64) ||
+	    ! node_attr_test_bit(bits, node_g, 64) ||
+	    node_attr_test_bit(bits, node_g, 0) ||
+	    node_attr_test_bit(bits, node_g, 129)) {
+		printf("%s: wrong bits\n", test_name);
+		return 1;
+	}
+
+	node_attr_clear_bit(bits, node_f, 129);
+	if (node_attr_test_bit(bits, node_f, 129)) {
+		printf("%s: bit 129 of f should be cleared\n", test_name);
+		return 1;
+	}
+
+	destroy_node_attrs(tree.attrs);
+	printf("%s ok.\n", test_name);
+	return 0;
+}
+
+int test_resize()
+{
+	const char *test_name = __func__;
+	/* ((A:1,B:1.0)f:2.0,(C:1,(D:1,E:1)g:2)h:3)i; */
+	struct rooted_tree tree = tree_3();
+	struct hash *map = create_label2node_map(tree.nodes_in_order);
+
+	struct node_attr *mark = add_node_attr(&tree, "mark",
+			NODE_ATTR_INT, 0);
+	node_attr_ints(mark)[0] = 1;
+
+	/* Same tree: same column, values kept */
+	if (add_node_attr(&tree, "mark", NODE_ATTR_INT, 0) != mark ||
+			1 != node_attr_ints(mark)[0]) {
+		printf("%s: column should be returned as is\n", test_name);
+		return 1;
+	}
+
+	/* One node fewer: the column must shrink, and is reset */
+	splice_out_rnode(hash_get(map, "g"));
+	if (add_node_attr(&tree, "mark", NODE_ATTR_INT, 0) != mark) {
+		printf("%s: expected the same column\n", test_name);
+		return 1;
+	}
+	if (8 != mark->nb_nodes) {
+		printf("%s: expected 8 values, got %d\n", test_name,
+				mark->nb_nodes);
+		return 1;
+	}
+	int i;
+	for (i = 0; i < mark->nb_nodes; i++) {
+		if (0 != node_attr_ints(mark)[i]) {
+			printf("%s: values should be reset to 0\n",
+					test_name);
+			return 1;
+		}
+	}
+
+	destroy_node_attrs(tree.attrs);
+	printf("%s ok.\n", test_name);
+	return 0;
+}
+
+/* Same number of nodes, but renumbered */
+
+int test_renumber()
+{
+	const char *test_name = __func__;
+	/* ((A:1,B:1.0)f:2.0,(C:1,(D:1,E:1)g:2)h:3)i; */
+	struct rooted_tree tree = tree_3();
+	struct hash *map = create_label2node_map(tree.nodes_in_order);
+
+	struct node_attr *mark = add_node_attr(&tree, "mark",
+			NODE_ATTR_INT, 0);
+	node_attr_ints(mark)[0] = 1;
+
+	/* h becomes the root, i its child */
+	tree.root = hash_get(map, "h");
+	swap_nodes(tree.root);
+	if (add_node_attr(&tree, "mark", NODE_ATTR_INT, 0) != mark) {
+		printf("%s: expected the same column\n", test_name);
+		return 1;
+	}
+	if (9 != mark->nb_nodes) {
+		printf("%s: expected 9 values, got %d\n", test_name,
+				mark->nb_nodes);
+		return 1;
+	}
+	int i;
+	for (i = 0; i < mark->nb_nodes; i++) {
+		if (0 != node_attr_ints(mark)[i]) {
+			printf("%s: values should be reset to 0\n",
+					test_name);
+			return 1;
+		}
+	}
+
+	destroy_node_attrs(tree.attrs);
+	printf("%s ok.\n", test_name);
+	return 0;
+}
+
+int main()
+{
+	int failures = 0;
+	printf("Starting node attribute test...\n");
+	failures += test_add_get();
+	failures += test_bitset();
+	failures += test_resize();
+	failures += test_renumber();
+	if (0 == failures) {
+		printf("All tests ok.\n");
+	} else {
+		printf("%d test(s) FAILED.\n", failures);
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1 @@
+test_nw_prog.sh
\ No newline at end of file
@@ -8,6 +8,8 @@
 #include "nodemap.h"
 #include "hash.h"
 #include "rnode.h"
+#include "link.h"
+#include "list.h"
 
 /* Many tests involve creating trees or nodes which are not "used" (in the GCC
  * sense, i.e. in a statement), causing compiler warnings. However, they affect
@@ -32,7 +34,7 @@ int test_order()
 	struct rnode *node_insects = tree.root->first_child;
 	struct rnode *node_vertebrates = tree.root->last_child;
 
-	order_tree(&tree, lbl_comparator, set_sort_field_label);
+	order_tree_lbl(&tree);
 	
 	/* insect node should still be 1st */
 	if (tree.root->first_child != node_insects) {
@@ -87,7 +89,7 @@ int test_order_num_desc()
 	struct rooted_tree test_tree = tree_15();
 	/* expected tree is top-light */
 	struct rooted_tree exp_tree = tree_14();
-	order_tree(&test_tree, num_desc_comparator, set_sort_field_num_desc);
+	order_tree_num_desc(&test_tree);
 	char *obt_newick = to_newick(test_tree.root);
 	char *exp_newick = to_newick(exp_tree.root);
 
@@ -106,7 +108,7 @@ int test_order_deladderize()
 {
 	const char *test_name = __func__;
 	struct rooted_tree test_tree = tree_15();
-	order_tree(&test_tree, num_desc_deladderize, set_sort_field_num_desc);
+	order_tree_deladderize(&test_tree);
 	char *obt_newick = to_newick(test_tree.root);
 	char *exp_newick = "(Petromyzon,((Xenopus,((Equus,Homo)Mammalia,Columba)Amniota)Tetrapoda,Carcharodon)Gnathostomata)Vertebrata;";
 
@@ -122,6 +124,124 @@ int test_order_deladderize()
 	return 0;
 }
 
+int test_order_multifurcation()
+{
+	const char *test_name = __func__;
+	/* (X,(C,D),Y,(A,B),Z); - ties keep their order */
+	struct rnode *root = create_rnode("", "");
+	struct rnode *cd = create_rnode("", "");
+	struct rnode *ab = create_rnode("", "");
+	struct llist *nodes_in_order = create_llist();
+	char *labels[] = {"X", "C", "D", "Y", "A", "B", "Z"};
+	int i;
+	for (i = 0; i < 7; i++) {
+		struct rnode *leaf = create_rnode(labels[i], "");
+		append_element(nodes_in_order, leaf);
+		if (1 == i || 2 == i) add_child(cd, leaf);
+		else if (4 == i || 5 == i) add_child(ab, leaf);
+		else add_child(root, leaf);
+		if (2 == i) {
+			add_child(root, cd);
+			append_element(nodes_in_order, cd);
+		}
+		if (5 == i) {
+			add_child(root, ab);
+			append_element(nodes_in_order, ab);
+		}
+	}
+	append_element(nodes_in_order, root);
+	struct rooted_tree tree;
+	tree.root = root;
+	tree.nodes_in_order = nodes_in_order;
+
+	order_tree_num_desc(&tree);
+	char *obt_newick = to_newick(tree.root);
+	char *exp_newick = "(X,Y,Z,(C,D),(A,B));";
+	if (0 != strcmp(obt_newick, exp_newick)) {
+		printf ("%s: expected '%s', got '%s'.\n",
+			test_name, exp_newick, obt_newick);
+		return 1;
+	}
+
+	order_tree_lbl(&tree);
+	obt_newick = to_newick(tree.root);
+	exp_newick = "((A,B),(C,D),X,Y,Z);";
+	if (0 != strcmp(obt_newick, exp_newick)) {
+		printf ("%s: expected '%s', got '%s'.\n",
+			test_name, exp_newick, obt_newick);
+		return 1;
+	}
+
+	/* sort keys are not left behind */
+	struct list_elem *el;
+	for (el = nodes_in_order->head; NULL != el; el = el->next) {
+		if (NULL != ((struct rnode *) el->data)->data) {
+			printf ("%s: node data should be NULL\n", test_name);
+			return 1;
+		}
+	}
+
+	printf("%s ok.\n", test_name);
+	return 0;
+}
+
+int test_order_canonical()
+{
+	const char *test_name = __func__;
+	/* same tree as tree_14(), differently ordered */
+	struct rooted_tree tree_a = tree_15();
+	struct rooted_tree tree_b = tree_14();
+	struct canonical_hash hash_a, hash_b;
+	order_tree_canonical(&tree_a, &hash_a);
+	order_tree_canonical(&tree_b, &hash_b);
+	char *newick_a = to_newick(tree_a.root);
+	char *newick_b = to_newick(tree_b.root);
+	char *exp_newick = "((Carcharodon,((Columba,(Equus,Homo)Mammalia)Amniota,Xenopus)Tetrapoda)Gnathostomata,Petromyzon)Vertebrata;";
+
+	if (0 != strcmp(newick_a, exp_newick)) {
+		printf ("%s: expected '%s', got '%s'.\n",
+			test_name, exp_newick, newick_a);
+		return 1;
+	}
+	if (0 != strcmp(newick_a, newick_b)) {
+		printf ("%s: '%s' and '%s' should be the same.\n",
+			test_name, newick_a, newick_b);
+		return 1;
+	}
+	if (hash_a.topology.hi != hash_b.topology.hi ||
+	    hash_a.topology.lo != hash_b.topology.lo ||
+	    hash_a.lengths.hi != hash_b.lengths.hi ||
+	    hash_a.lengths.lo != hash_b.lengths.lo) {
+		printf ("%s: hashes should be the same.\n", test_name);
+		return 1;
+	}
+
+	/* ((A:1,B:1.0)f:2.0,(C:1,(D:1,E:1)g:2)h:3)i; */
+	struct rooted_tree tree_c = tree_3();
+	struct canonical_hash hash_c;
+	order_tree_canonical(&tree_c, &hash_c);
+	if (hash_a.topology.hi == hash_c.topology.hi &&
+	    hash_a.topology.lo == hash_c.topology.lo) {
+		printf ("%s: hashes should differ.\n", test_name);
+		return 1;
+	}
+	/* Changing a length changes only the lengths hash */
+	struct rnode *leaf_a = tree_c.root->first_child->first_child;
+	leaf_a->edge_length_as_string = "1.5";
+	struct canonical_hash hash_d;
+	order_tree_canonical(&tree_c, &hash_d);
+	if (hash_c.topology.hi != hash_d.topology.hi ||
+	    hash_c.topology.lo != hash_d.topology.lo ||
+	    hash_c.lengths.hi == hash_d.lengths.hi) {
+		printf ("%s: only the lengths hash should change.\n",
+				test_name);
+		return 1;
+	}
+
+	printf("%s ok.\n", test_name);
+	return 0;
+}
+
 int main()
 {
 	int failures = 0;
@@ -129,6 +249,8 @@ int main()
 	failures += test_order();
 	failures += test_order_num_desc();
 	failures += test_order_deladderize();
+	failures += test_order_multifurcation();
+	failures += test_order_canonical();
 	if (0 == failures) {
 		printf("All tests ok.\n");
 	} else {
@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "perfect_hash.h"
+#include "masprintf.h"
+
+int test_get()
+{
+	const char *test_name = __func__;
+	const int n = 10000;
+	const char **keys = malloc(n * sizeof(char *));
+	void **values = malloc(n * sizeof(void *));
+	int i;
+	for (i = 0; i < n; i++) {
+		keys[i] = masprintf("key_%d", i);
+		values[i] = masprintf("value_%d", i);
+	}
+
+	struct perfect_hash *ph = create_perfect_hash(keys, values, n);
+	if (NULL == ph) {
+		printf("%s: could not build hash\n", test_name);
+		return 1;
+	}
+	for (i = 0; i < n; i++) {
+		char *key = masprintf("key_%d", i);	/* not the same address */
+		if (perfect_hash_get(ph, key) != values[i]) {
+			printf("%s: wrong value for '%s'\n", test_name, key);
+			return 1;
+		}
+		free(key);
+	}
+	char *absent[] = { "", "key_", "key_10000", "key_-1", "Key_1", NULL };
+	char **a;
+	for (a = absent; NULL != *a; a++) {
+		if (NULL != perfect_hash_get(ph, *a)) {
+			printf("%s: '%s' should not be found\n", test_name, *a);
+			return 1;
+		}
+	}
+
+	destroy_perfect_hash(ph);
+	printf("%s ok.\n", test_name);
+	return 0;
+}
+
+int test_empty()
+{
+	const char *test_name = __func__;
+	struct perfect_hash *ph = create_perfect_hash(NULL, NULL, 0);
+	if (NULL == ph) {
+		printf("%s: could not build hash\n", test_name);
+		return 1;
+	}
+	if (NULL != perfect_hash_get(ph, "A")) {
+		printf("%s: 'A' should not be found\n", test_name);
+		return 1;
+	}
+	destroy_perfect_hash(ph);
+	printf("%s ok.\n", test_name);
+	return 0;
+}
+
+int test_duplicates()
+{
+	const char *test_name = __func__;
+	const char *keys[] = { "A", "B", "C", "B" };
+	void *values[] = { "a", "b", "c", "d" };
+	errno = 0;
+	if (NULL != create_perfect_hash(keys, values, 4) || EINVAL != errno) {
+		printf("%s: duplicate keys should be rejected\n", test_name);
+		return 1;
+	}
+	printf("%s ok.\n", test_name);
+	return 0;
+}
+
+int main()
+{
+	int failures = 0;
+	printf("Starting perfect hash test...\n");
+	failures += test_get();
+	failures += test_empty();
+	failures += test_duplicates();
+	if (0 == failures) {
+		printf("All tests ok.\n");
+	} else {
+		printf("%d test(s) FAILED.\n", failures);
+		return 1;
+	}
+
+	return 0;
+}
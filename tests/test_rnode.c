@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <string.h>
+#include <stdlib.h>
 
 #include "rnode.h"
 #include "tree.h"
@@ -133,6 +134,61 @@ int test_static_rnode_vars_2()
 	return 0;
 }
 
+int test_recycle_all_rnodes()
+{
+	const char *test_name = __func__;
+
+	destroy_all_rnodes(NULL);
+	struct rnode *a = create_rnode("a_long_label", "1.5");
+	struct rnode *b = create_rnode("b", "");
+	b->data = malloc(sizeof(int));	/* must be freed by recycling */
+
+	recycle_all_rnodes(NULL);
+	if (0 != _get_rnode_count()) {
+		printf("%s: expected node count of 0, got %d.\n",
+				test_name, _get_rnode_count());
+		return 1;
+	}
+
+	/* The new nodes reuse the old ones' storage, in the same order */
+	struct rnode *c = create_rnode("c", NULL);
+	struct rnode *d = create_rnode("a_longer_label", "2");
+	struct rnode *e = create_rnode("e", "3");
+	if (c != a || d != b) {
+		printf("%s: recycled nodes were not reused.\n", test_name);
+		return 1;
+	}
+	if (3 != _get_rnode_count()) {
+		printf("%s: expected node count of 3, got %d.\n",
+				test_name, _get_rnode_count());
+		return 1;
+	}
+	if (strcmp("c", c->label) != 0 ||
+	    strcmp("", c->edge_length_as_string) != 0 ||
+	    strcmp("a_longer_label", d->label) != 0 ||
+	    strcmp("2", d->edge_length_as_string) != 0 ||
+	    strcmp("e", e->label) != 0) {
+		printf("%s: wrong labels or lengths in reused nodes.\n",
+				test_name);
+		return 1;
+	}
+	if (NULL != d->data || NULL != d->parent || 0 != d->child_count ||
+			-1 != d->index) {
+		printf("%s: reused node was not reset.\n", test_name);
+		return 1;
+	}
+
+	destroy_all_rnodes(NULL);
+	if (0 != _get_rnode_count()) {
+		printf("%s: expected node count of 0, got %d.\n",
+				test_name, _get_rnode_count());
+		return 1;
+	}
+
+	printf("%s ok.\n", test_name);
+	return 0;
+}
+
 int test_create_rnode_nulllabel()
 {
 	const char *test_name = "test_create_rnode_nulllabel";
@@ -800,6 +856,181 @@ int test_clone_rnode_wkids()
 	return 0;
 }
 
+/* Builds a ladder ("caterpillar") of 'depth' inner nodes, each of which has a
+ * leaf labelled 'l' as first child and the next inner node as second child.
+ * Returns the root. */
+
+static struct rnode *ladder(int depth)
+{
+	struct rnode *root = create_rnode("r", "");
+	struct rnode *current = root;
+	int i;
+	for (i = 0; i < depth; i++) {
+		struct rnode *leaf = create_rnode("l", "1");
+		struct rnode *inner = create_rnode("", "1");
+		add_child(current, leaf);
+		add_child(current, inner);
+		current = inner;
+	}
+	add_child(current, create_rnode("end", "1"));
+	add_child(current, create_rnode("l", "1"));
+	return root;
+}
+
+/* Cloning must not depend on the C stack, so a very deep ladder should not be
+ * a problem. */
+
+int test_clone_rnode_deep()
+{
+	const char *test_name = __func__;
+	int depth = 500000;
+	struct rnode *root = ladder(depth);
+	struct rnode *clone = clone_rnode(root);
+	if (NULL == clone) {
+		printf ("%s: clone should not be NULL\n", test_name);
+		return 1;
+	}
+
+	struct rnode *orig_n = root, *clone_n = clone;
+	int n = 0;
+	while (! is_leaf(orig_n)) {
+		if (clone_n == orig_n) {
+			printf ("%s: clone node should be a new node\n",
+					test_name);
+			return 1;
+		}
+		if (2 != clone_n->child_count) {
+			printf ("%s: expected 2 children at depth %d, got %d\n",
+				test_name, n, clone_n->child_count);
+			return 1;
+		}
+		if (0 != strcmp(orig_n->first_child->label,
+				clone_n->first_child->label)) {
+			printf ("%s: expected label '%s' at depth %d, got '%s'\n",
+				test_name, orig_n->first_child->label, n,
+				clone_n->first_child->label);
+			return 1;
+		}
+		if (clone_n->last_child->parent != clone_n) {
+			printf ("%s: wrong parent at depth %d\n",
+				test_name, n);
+			return 1;
+		}
+		orig_n = orig_n->last_child;
+		clone_n = clone_n->last_child;
+		n++;
+	}
+	if (depth + 1 != n) {
+		printf ("%s: expected depth %d, got %d\n", test_name, depth + 1, n);
+		return 1;
+	}
+
+	destroy_all_rnodes(NULL);
+	printf("%s ok.\n", test_name);
+	return 0;
+}
+
+/* add_child() does not reset the child's next_sibling: here 'b' is the last
+ * child of 'p', but its next_sibling is still 'c' (its former sibling under
+ * 'x'). Cloning must stop at the last child. */
+
+static struct rnode *stale_sibling_tree()
+{
+	struct rnode *x = create_rnode("x", "");
+	struct rnode *b = create_rnode("b", "1");
+	struct rnode *c = create_rnode("c", "1");
+	add_child(x, b);
+	add_child(x, c);
+
+	struct rnode *p = create_rnode("p", "");
+	add_child(p, create_rnode("a", "1"));
+	add_child(p, b);
+	return p;
+}
+
+static bool always_true(struct rnode *node, void *param)
+{
+	node = node; param = param;	/* avoid 'unused' warnings */
+	return true;
+}
+
+int test_clone_rnode_stale_sibling()
+{
+	const char *test_name = __func__;
+	struct rnode *p = stale_sibling_tree();
+	if (NULL == p->last_child->next_sibling) {
+		printf ("%s: test tree should have a stale next_sibling\n",
+				test_name);
+		return 1;
+	}
+
+	struct rnode *clones[2];
+	clones[0] = clone_rnode(p);
+	clones[1] = clone_rnode_cond(p, always_true, NULL);
+	int i;
+	for (i = 0; i < 2; i++) {
+		struct rnode *clone = clones[i];
+		if (NULL == clone) {
+			printf ("%s: clone should not be NULL\n", test_name);
+			return 1;
+		}
+		if (2 != clone->child_count ||
+		    0 != strcmp("a", clone->first_child->label) ||
+		    0 != strcmp("b", clone->last_child->label)) {
+			printf ("%s: expected children 'a' and 'b' (%s)\n",
+				test_name, 0 == i ? "clone_rnode()" :
+				"clone_rnode_cond()");
+			return 1;
+		}
+	}
+
+	destroy_all_rnodes(NULL);
+	printf("%s ok.\n", test_name);
+	return 0;
+}
+
+/* Drops all nodes labelled 'l' */
+
+static bool not_l(struct rnode *node, void *param)
+{
+	param = param;	/* suppresses warning about unused param */
+	return 0 != strcmp("l", node->label);
+}
+
+/* Removing the leaves of a ladder leaves a chain of single-child nodes, all
+ * of which should be spliced out, leaving just the 'end' leaf - with the sum
+ * of all lengths along the way. */
+
+int test_clone_rnode_cond_deep()
+{
+	const char *test_name = __func__;
+	int depth = 500000;
+	struct rnode *root = ladder(depth);
+	struct rnode *clone = clone_rnode_cond(root, not_l, NULL);
+	if (NULL == clone) {
+		printf ("%s: clone should not be NULL\n", test_name);
+		return 1;
+	}
+	if (0 != strcmp("end", clone->label)) {
+		printf ("%s: expected label 'end', got '%s'\n", test_name,
+				clone->label);
+		return 1;
+	}
+	if (! is_root(clone)) {
+		printf ("%s: clone should be a root\n", test_name);
+		return 1;
+	}
+	if (0 != strcmp("500001", clone->edge_length_as_string)) {
+		printf ("%s: expected length '500001', got '%s'\n",
+			test_name, clone->edge_length_as_string);
+		return 1;
+	}
+
+	destroy_all_rnodes(NULL);
+	printf("%s ok.\n", test_name);
+	return 0;
+}
+
 int main()
 {
 	int failures = 0;
@@ -807,6 +1038,7 @@ int main()
 	failures += test_create_rnode();
 	failures += test_static_rnode_vars();
 	failures += test_static_rnode_vars_2();
+	failures += test_recycle_all_rnodes();
 	failures += test_create_rnode_nulllabel();
 	failures += test_create_rnode_emptylabel();
 	failures += test_create_rnode_nulllength();
@@ -820,6 +1052,9 @@ int main()
 	failures += test_children_array();
 	failures += test_clone_rnode();
 	failures += test_clone_rnode_wkids();
+	failures += test_clone_rnode_deep();
+	failures += test_clone_rnode_cond_deep();
+	failures += test_clone_rnode_stale_sibling();
 	if (0 == failures) {
 		printf("All tests ok.\n");
 	} else {
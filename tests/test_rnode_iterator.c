@@ -628,6 +628,165 @@ int test_iterator_sibling()
 	return 0;
 }
 
+/* Traverses the tree with a stack iterator, and returns the concatenation of
+ * the visited nodes' labels. */
+
+static char *stack_iterator_labels(struct rnode *root,
+		enum rnode_traversal order)
+{
+	static char labels[100];
+	struct rnode_stack_iterator *it =
+		create_rnode_stack_iterator(root, order);
+	struct rnode *current;
+	labels[0] = '\0';
+	while (NULL != (current = rnode_stack_iterator_next(it)))
+		strcat(labels, current->label);
+	destroy_rnode_stack_iterator(it);
+	return labels;
+}
+
+int test_stack_iterator_orders()
+{
+	const char *test_name = __func__;
+
+	/* ((A:1,B:1.0)f:2.0,(C:1,(D:1,E:1)g:2)h:3)i; */
+	struct rooted_tree tree = tree_3();
+	char *exp, *obt;
+
+	exp = "ifABhCgDE";
+	obt = stack_iterator_labels(tree.root, RNODE_PREORDER);
+	if (0 != strcmp(exp, obt)) {
+		printf("%s: expected pre-order '%s', got '%s'.\n", test_name,
+				exp, obt);
+		return 1;
+	}
+	exp = "ABfCDEghi";
+	obt = stack_iterator_labels(tree.root, RNODE_POSTORDER);
+	if (0 != strcmp(exp, obt)) {
+		printf("%s: expected post-order '%s', got '%s'.\n", test_name,
+				exp, obt);
+		return 1;
+	}
+	exp = "ifAfBfihChgDgEghi";
+	obt = stack_iterator_labels(tree.root, RNODE_EULER_TOUR);
+	if (0 != strcmp(exp, obt)) {
+		printf("%s: expected Euler tour '%s', got '%s'.\n", test_name,
+				exp, obt);
+		return 1;
+	}
+	/* subtree */
+	struct hash *nodemap = create_label2node_map(tree.nodes_in_order);
+	struct rnode *node_h = hash_get(nodemap, "h");
+	exp = "hChgDgEgh";
+	obt = stack_iterator_labels(node_h, RNODE_EULER_TOUR);
+	if (0 != strcmp(exp, obt)) {
+		printf("%s: expected Euler tour '%s', got '%s'.\n", test_name,
+				exp, obt);
+		return 1;
+	}
+	/* leaf */
+	struct rnode *node_D = hash_get(nodemap, "D");
+	int order;
+	for (order = RNODE_PREORDER; order <= RNODE_EULER_TOUR; order++) {
+		obt = stack_iterator_labels(node_D, order);
+		if (0 != strcmp("D", obt)) {
+			printf("%s: expected 'D', got '%s'.\n", test_name,
+					obt);
+			return 1;
+		}
+	}
+	destroy_hash(nodemap);
+
+	printf("%s ok.\n", test_name);
+	return 0;
+}
+
+int test_stack_iterator_visits()
+{
+	const char *test_name = __func__;
+
+	/* ((A:1,B:1.0)f:2.0,(C:1,(D:1,E:1)g:2)h:3)i; */
+	struct rooted_tree tree = tree_3();
+	struct rnode_stack_iterator *it =
+		create_rnode_stack_iterator(tree.root, RNODE_EULER_TOUR);
+	/* first visit?, more children?, depth */
+	char *exp_labels = "ifAfBfihChgDgEghi";
+	char *exp_first  = "yyynynnyynyynynnn";
+	char *exp_more   = "yynynnyynyynynnnn";
+	int exp_depth[] = {0,1,2,1,2,1,0,1,2,1,2,3,2,3,2,1,0};
+	struct rnode *current;
+	int i;
+	for (i = 0; NULL != (current = rnode_stack_iterator_next(it)); i++) {
+		if (exp_labels[i] != current->label[0]) {
+			printf("%s: expected node %c, got %s.\n", test_name,
+					exp_labels[i], current->label);
+			return 1;
+		}
+		bool first = rnode_stack_iterator_first_visit(it);
+		if ((exp_first[i] == 'y') != first) {
+			printf("%s: wrong first visit flag at step %d (%s).\n",
+					test_name, i, current->label);
+			return 1;
+		}
+		bool more = rnode_stack_iterator_more_children(it);
+		if ((exp_more[i] == 'y') != more) {
+			printf("%s: wrong 'more children' at step %d (%s).\n",
+					test_name, i, current->label);
+			return 1;
+		}
+		if (exp_depth[i] != rnode_stack_iterator_depth(it)) {
+			printf("%s: expected depth %d at step %d, got %d.\n",
+					test_name, exp_depth[i], i,
+					rnode_stack_iterator_depth(it));
+			return 1;
+		}
+	}
+	if (17 != i) {
+		printf("%s: expected 17 visits, got %d.\n", test_name, i);
+		return 1;
+	}
+	destroy_rnode_stack_iterator(it);
+
+	printf("%s ok.\n", test_name);
+	return 0;
+}
+
+/* Several stack iterators can traverse the same tree at the same time. */
+
+int test_stack_iterator_concurrent()
+{
+	const char *test_name = __func__;
+
+	/* ((A:1,B:1.0)f:2.0,(C:1,(D:1,E:1)g:2)h:3)i; */
+	struct rooted_tree tree = tree_3();
+	struct rnode_stack_iterator *pre =
+		create_rnode_stack_iterator(tree.root, RNODE_PREORDER);
+	struct rnode_stack_iterator *post =
+		create_rnode_stack_iterator(tree.root, RNODE_POSTORDER);
+	char pre_labels[20] = "", post_labels[20] = "";
+	struct rnode *n1, *n2;
+	do {
+		n1 = rnode_stack_iterator_next(pre);
+		if (NULL != n1) strcat(pre_labels, n1->label);
+		n2 = rnode_stack_iterator_next(post);
+		if (NULL != n2) strcat(post_labels, n2->label);
+	} while (NULL != n1 || NULL != n2);
+	destroy_rnode_stack_iterator(pre);
+	destroy_rnode_stack_iterator(post);
+
+	if (0 != strcmp("ifABhCgDE", pre_labels)) {
+		printf("%s: wrong pre-order '%s'.\n", test_name, pre_labels);
+		return 1;
+	}
+	if (0 != strcmp("ABfCDEghi", post_labels)) {
+		printf("%s: wrong post-order '%s'.\n", test_name, post_labels);
+		return 1;
+	}
+
+	printf("%s ok.\n", test_name);
+	return 0;
+}
+
 int main()
 {
 	int failures = 0;
@@ -637,6 +796,9 @@ int main()
 	failures += test_iterator_leaf();
 	failures += test_iterator_repeat();
 	failures += test_iterator_sibling();
+	failures += test_stack_iterator_orders();
+	failures += test_stack_iterator_visits();
+	failures += test_stack_iterator_concurrent();
 	if (0 == failures) {
 		printf("All tests ok.\n");
 	} else {
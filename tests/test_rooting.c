@@ -0,0 +1,143 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "rnode.h"
+#include "list.h"
+#include "parser.h"
+#include "tree.h"
+#include "tree_stats.h"
+#include "to_newick.h"
+#include "rooting.h"
+
+void newick_scanner_set_string_input(char *);
+void newick_scanner_clear_string_input();
+
+static struct rooted_tree *parse(char *newick)
+{
+	newick_scanner_set_string_input(newick);
+	struct rooted_tree *tree = parse_tree();
+	newick_scanner_clear_string_input();
+	return tree;
+}
+
+/* Variance of the root-to-leaf distances */
+
+static double leaf_depth_variance(struct rooted_tree *tree)
+{
+	struct tree_stats *stats = get_tree_stats(tree);
+	double sum = 0, sq = 0;
+	int n = 0, i;
+	for (i = 0; i < stats->nb_nodes; i++) {
+		if (! is_leaf(stats->nodes[i])) continue;
+		sum += stats->depth[i];
+		sq += stats->depth[i] * stats->depth[i];
+		n++;
+	}
+	return sq / n - (sum / n) * (sum / n);
+}
+
+int test_midpoint()
+{
+	const char *test_name = __func__;
+	struct rooted_tree *tree = parse("((A:1,B:2):1,(C:3,D:10):1);");
+	struct root_position pos;
+
+	if (ROOT_POS_OK != midpoint_root_position(tree, &pos)) {
+		printf("%s: could not find midpoint\n", test_name);
+		return 1;
+	}
+	if (NULL == pos.node || strcmp("D", pos.node->label) != 0 ||
+			7 != pos.length_above) {
+		printf("%s: expected midpoint 7 above D\n", test_name);
+		return 1;
+	}
+	if (! reroot_at_position(tree, &pos, false)) {
+		printf("%s: could not reroot\n", test_name);
+		return 1;
+	}
+	char *exp = "(D:7,(C:3,(A:1,B:2):2):3);";
+	char *obt = to_newick(tree->root);
+	if (strcmp(exp, obt) != 0) {
+		printf("%s: expected %s, got %s\n", test_name, exp, obt);
+		return 1;
+	}
+
+	/* Already at the midpoint */
+	tree = parse("((A:1,B:1):2,(C:2,D:2):1);");
+	midpoint_root_position(tree, &pos);
+	if (NULL != pos.node) {
+		printf("%s: expected the root as midpoint\n", test_name);
+		return 1;
+	}
+
+	tree = parse("((A,B):1,C:2);");
+	if (ROOT_POS_NOT_PHYLOGRAM != midpoint_root_position(tree, &pos)) {
+		printf("%s: expected a 'not phylogram' error\n", test_name);
+		return 1;
+	}
+
+	printf("%s ok.\n", test_name);
+	return 0;
+}
+
+/* Checks the minimum variance root against points sampled along every edge
+ * (rerooting a fresh copy of the tree for each). */
+
+int test_min_var()
+{
+	const char *test_name = __func__;
+	char *newick = "(A:1,B:4,(C:3,(D:10,E:0.5):2):1);";
+	struct rooted_tree *tree = parse(newick);
+	struct root_position pos;
+
+	if (ROOT_POS_OK != min_var_root_position(tree, &pos)) {
+		printf("%s: could not find position\n", test_name);
+		return 1;
+	}
+	reroot_at_position(tree, &pos, false);
+	double best = leaf_depth_variance(tree);
+
+	int nb_nodes = parse(newick)->nodes_in_order->count;
+	int k, s;
+	for (k = 0; k < nb_nodes - 1; k++) {
+		for (s = 0; s <= 10; s++) {
+			tree = parse(newick);
+			struct list_elem *el = tree->nodes_in_order->head;
+			int j;
+			for (j = 0; j < k; j++) el = el->next;
+			struct root_position sample;
+			sample.node = el->data;
+			sample.length_above = s / 10.0 *
+				atof(sample.node->edge_length_as_string);
+			reroot_at_position(tree, &sample, false);
+			double var = leaf_depth_variance(tree);
+			if (var < best - 1e-3) {
+				printf("%s: variance %g at %g above %s is "
+					"lower than %g\n", test_name, var,
+					sample.length_above,
+					sample.node->label, best);
+				return 1;
+			}
+		}
+	}
+
+	printf("%s ok.\n", test_name);
+	return 0;
+}
+
+int main()
+{
+	int failures = 0;
+	printf("Starting rooting test...\n");
+	failures += test_midpoint();
+	failures += test_min_var();
+	if (0 == failures) {
+		printf("All tests ok.\n");
+	} else {
+		printf("%d test(s) FAILED.\n", failures);
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,140 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "rnode.h"
+#include "list.h"
+#include "parser.h"
+#include "tree.h"
+#include "topology_hash.h"
+
+void newick_scanner_set_string_input(char *);
+void newick_scanner_clear_string_input();
+
+static struct rooted_tree *parse(char *newick)
+{
+	newick_scanner_set_string_input(newick);
+	struct rooted_tree *tree = parse_tree();
+	newick_scanner_clear_string_input();
+	return tree;
+}
+
+/* Returns the restricted hash of 'newick' on the leaf set of 'pattern' */
+
+static uint64_t restricted_hash(char *pattern, char *newick)
+{
+	struct rooted_tree *ptree = parse(pattern);
+	struct llist *labels = get_leaf_labels(ptree);
+	struct topo_leaf_set *leaves = create_topo_leaf_set(labels);
+	struct rooted_tree *tree = parse(newick);
+	uint64_t hash;
+	restricted_topology_hash(tree, leaves, NULL, &hash);
+	destroy_topo_leaf_set(leaves);
+	return hash;
+}
+
+int test_isomorphic()
+{
+	const char *test_name = __func__;
+	char *pattern = "((A,B),C);";
+	uint64_t exp = restricted_hash(pattern, pattern);
+
+	/* Order, lengths, inner labels, extra leaves and knees don't count */
+	char *same[] = {
+		"(C,(B,A));",
+		"((B:1,A:2)x:3,C:4)y;",
+		"((C,(X,(B,A)1:2)x),(Y,Z));",
+		"(((((A,B)))),((C)));",
+		NULL
+	};
+	char **t;
+	for (t = same; NULL != *t; t++) {
+		if (restricted_hash(pattern, *t) != exp) {
+			printf("%s: '%s' should hash like '%s'\n", test_name,
+					*t, pattern);
+			return 1;
+		}
+	}
+
+	char *different[] = {
+		"((A,C),B);",
+		"(A,B,C);",
+		"((A,B),D);",
+		"(A,B);",
+		"(((A,B),C),C);",
+		NULL
+	};
+	for (t = different; NULL != *t; t++) {
+		if (restricted_hash(pattern, *t) == exp) {
+			printf("%s: '%s' should not hash like '%s'\n",
+					test_name, *t, pattern);
+			return 1;
+		}
+	}
+
+	if (0 != restricted_hash(pattern, "(X,(Y,Z));")) {
+		printf("%s: expected hash 0 for an empty restriction\n",
+				test_name);
+		return 1;
+	}
+
+	printf("%s ok.\n", test_name);
+	return 0;
+}
+
+int test_pattern_match()
+{
+	const char *test_name = __func__;
+	struct rooted_tree *ptree = parse("(Vulpes,(Tamias,Homo));");
+	struct llist *labels = get_leaf_labels(ptree);
+	struct topo_leaf_set *leaves = create_topo_leaf_set(labels);
+	struct topo_pattern *pattern = create_topo_pattern(ptree, leaves);
+
+	if (2 != pattern->nb_clades) {
+		printf("%s: expected 2 clades in pattern, got %d\n",
+				test_name, pattern->nb_clades);
+		return 1;
+	}
+
+	struct rooted_tree *tree = parse(
+		"((Homo:1,(Tamias:2,Sciurus:1):1):1,(Vulpes:1,Canis:2):2);");
+	if (! topo_pattern_match(pattern, leaves, tree)) {
+		printf("%s: tree should match\n", test_name);
+		return 1;
+	}
+
+	/* (Homo,Vulpes) is not a clade of the pattern: the tree is rejected
+	 * before its root is reached. */
+	tree = parse("((Homo,Vulpes),(Tamias,Sciurus));");
+	uint64_t hash;
+	if (TOPO_HASH_REJECTED !=
+		restricted_topology_hash(tree, leaves, pattern, &hash)) {
+		printf("%s: tree should be rejected early\n", test_name);
+		return 1;
+	}
+	if (topo_pattern_match(pattern, leaves, tree)) {
+		printf("%s: tree should not match\n", test_name);
+		return 1;
+	}
+
+	destroy_topo_pattern(pattern);
+	destroy_topo_leaf_set(leaves);
+	printf("%s ok.\n", test_name);
+	return 0;
+}
+
+int main()
+{
+	int failures = 0;
+	printf("Starting topology hash test...\n");
+	failures += test_isomorphic();
+	failures += test_pattern_match();
+	if (0 == failures) {
+		printf("All tests ok.\n");
+	} else {
+		printf("%d test(s) FAILED.\n", failures);
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,236 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "rnode.h"
+#include "link.h"
+#include "list.h"
+#include "tree_stubs.h"
+#include "tree.h"
+#include "tree_stats.h"
+#include "nodemap.h"
+#include "hash.h"
+#include "parser.h"
+
+void newick_scanner_set_string_input(char *);
+void newick_scanner_clear_string_input();
+
+int test_values()
+{
+	const char *test_name = __func__;
+	/* ((A:1,B:1.0)f:2.0,(C:1,(D:1,E:1)g:2)h:3)i; */
+	struct rooted_tree tree = tree_3();
+	struct hash *map = create_label2node_map(tree.nodes_in_order);
+	struct tree_stats *stats = get_tree_stats(&tree);
+	if (NULL == stats) { printf("%s: stats are NULL\n", test_name);
+		return 1; }
+
+	if (9 != stats->nb_nodes) {
+		printf("%s: expected 9 nodes, got %d\n", test_name,
+				stats->nb_nodes);
+		return 1;
+	}
+	/* post-order: A B f C D E g h i */
+	const char *exp_order[] = {"A", "B", "f", "C", "D", "E", "g", "h", "i"};
+	int i;
+	for (i = 0; i < 9; i++) {
+		if (strcmp(exp_order[i], stats->nodes[i]->label) != 0) {
+			printf("%s: expected node '%s' at index %d, got '%s'\n",
+				test_name, exp_order[i], i,
+				stats->nodes[i]->label);
+			return 1;
+		}
+		if (i != stats->nodes[i]->index) {
+			printf("%s: node '%s' has index %d, expected %d\n",
+				test_name, stats->nodes[i]->label,
+				stats->nodes[i]->index, i);
+			return 1;
+		}
+	}
+
+	int h = tree_stats_index(stats, hash_get(map, "h"));
+	int d = tree_stats_index(stats, hash_get(map, "D"));
+	int r = tree_stats_index(stats, tree.root);
+	if (5 != stats->nb_leaves[r] || 3 != stats->nb_leaves[h] ||
+			1 != stats->nb_leaves[d]) {
+		printf("%s: wrong leaf counts (%d, %d, %d)\n", test_name,
+			stats->nb_leaves[r], stats->nb_leaves[h],
+			stats->nb_leaves[d]);
+		return 1;
+	}
+	if (8 != stats->nb_descendants[r] || 4 != stats->nb_descendants[h] ||
+			0 != stats->nb_descendants[d]) {
+		printf("%s: wrong descendant counts (%d, %d, %d)\n", test_name,
+			stats->nb_descendants[r], stats->nb_descendants[h],
+			stats->nb_descendants[d]);
+		return 1;
+	}
+	if (0 != stats->nb_ancestors[r] || 3 != stats->nb_ancestors[d]) {
+		printf("%s: wrong ancestor counts (%d, %d)\n", test_name,
+			stats->nb_ancestors[r], stats->nb_ancestors[d]);
+		return 1;
+	}
+	if (0 != stats->depth[r] || 3 != stats->depth[h] ||
+			6 != stats->depth[d] || ! stats->depth_defined[d]) {
+		printf("%s: wrong depths (%g, %g, %g)\n", test_name,
+			stats->depth[r], stats->depth[h], stats->depth[d]);
+		return 1;
+	}
+	if (6 != stats->height[r] || 3 != stats->height[h] ||
+			0 != stats->height[d]) {
+		printf("%s: wrong heights (%g, %g, %g)\n", test_name,
+			stats->height[r], stats->height[h], stats->height[d]);
+		return 1;
+	}
+	if (5 != leaf_count(&tree)) {
+		printf("%s: expected 5 leaves, got %d\n", test_name,
+				leaf_count(&tree));
+		return 1;
+	}
+
+	destroy_tree_stats(tree.stats);
+	printf("%s ok.\n", test_name);
+	return 0;
+}
+
+int test_cladogram()
+{
+	const char *test_name = __func__;
+	/* ((A,B:1),C); */
+	struct rooted_tree tree = tree_12();
+	struct hash *map = create_label2node_map(tree.nodes_in_order);
+	struct tree_stats *stats = get_tree_stats(&tree);
+
+	int a = tree_stats_index(stats, hash_get(map, "A"));
+	int b = tree_stats_index(stats, hash_get(map, "B"));
+	int r = tree_stats_index(stats, tree.root);
+
+	if (! stats->depth_defined[r]) {
+		printf("%s: root depth should be defined\n", test_name);
+		return 1;
+	}
+	if (stats->depth_defined[a] || stats->depth_defined[b]) {
+		printf("%s: depths of A and B should be undefined\n",
+				test_name);
+		return 1;
+	}
+	if (1 != stats->height[r]) {
+		printf("%s: expected root height 1, got %g\n", test_name,
+				stats->height[r]);
+		return 1;
+	}
+
+	destroy_tree_stats(tree.stats);
+	printf("%s ok.\n", test_name);
+	return 0;
+}
+
+/* A length that is not a number leaves the depth undefined, as a missing one
+ * does */
+
+int test_non_numeric_length()
+{
+	const char *test_name = __func__;
+	newick_scanner_set_string_input("((A:1,B:x)f:2,C:2);");
+	struct rooted_tree *tree = parse_tree();
+	newick_scanner_clear_string_input();
+	struct hash *map = create_label2node_map(tree->nodes_in_order);
+	struct tree_stats *stats = get_tree_stats(tree);
+
+	int a = tree_stats_index(stats, hash_get(map, "A"));
+	int b = tree_stats_index(stats, hash_get(map, "B"));
+	if (! stats->depth_defined[a] || 3 != stats->depth[a]) {
+		printf("%s: depth of A should be 3\n", test_name);
+		return 1;
+	}
+	if (stats->depth_defined[b]) {
+		printf("%s: depth of B should be undefined\n", test_name);
+		return 1;
+	}
+
+	destroy_tree_stats(tree->stats);
+	printf("%s ok.\n", test_name);
+	return 0;
+}
+
+int test_invalidation()
+{
+	const char *test_name = __func__;
+	/* ((A:1,B:1.0)f:2.0,(C:1,(D:1,E:1)g:2)h:3)i; */
+	struct rooted_tree tree = tree_3();
+	struct hash *map = create_label2node_map(tree.nodes_in_order);
+	struct rnode *node_g = hash_get(map, "g");
+	struct rnode *node_h = hash_get(map, "h");
+	struct rnode *node_d = hash_get(map, "D");
+
+	struct tree_stats *stats = get_tree_stats(&tree);
+	if (4 != stats->nb_descendants[tree_stats_index(stats, node_h)]) {
+		printf("%s: expected 4 descendants for h\n", test_name);
+		return 1;
+	}
+
+	/* Without changes, the stats are reused */
+	unsigned long count = stats->link_change_count;
+	stats = get_tree_stats(&tree);
+	if (count != stats->link_change_count) {
+		printf("%s: stats were recomputed without changes\n",
+				test_name);
+		return 1;
+	}
+
+	/* Splicing out g: D and E become children of h, and the stats must
+	 * reflect this. */
+	splice_out_rnode(node_g);
+	stats = get_tree_stats(&tree);
+	if (-1 != tree_stats_index(stats, node_g)) {
+		printf("%s: g should no longer be in the stats\n", test_name);
+		return 1;
+	}
+	int h = tree_stats_index(stats, node_h);
+	int d = tree_stats_index(stats, node_d);
+	if (3 != stats->nb_descendants[h] || 2 != stats->nb_ancestors[d]) {
+		printf("%s: expected 3 descendants for h and 2 ancestors "
+			"for D, got %d and %d\n", test_name,
+			stats->nb_descendants[h], stats->nb_ancestors[d]);
+		return 1;
+	}
+	/* splice_out_rnode() keeps depths */
+	if (6 != stats->depth[d]) {
+		printf("%s: expected depth 6 for D, got %g\n", test_name,
+				stats->depth[d]);
+		return 1;
+	}
+
+	/* Changes made outside link.c need explicit invalidation */
+	free(node_d->edge_length_as_string);
+	node_d->edge_length_as_string = strdup("10");
+	invalidate_tree_stats(&tree);
+	stats = get_tree_stats(&tree);
+	if (13 != stats->depth[tree_stats_index(stats, node_d)]) {
+		printf("%s: expected depth 13 for D, got %g\n", test_name,
+			stats->depth[tree_stats_index(stats, node_d)]);
+		return 1;
+	}
+
+	destroy_tree_stats(tree.stats);
+	printf("%s ok.\n", test_name);
+	return 0;
+}
+
+int main()
+{
+	int failures = 0;
+	printf("Starting tree stats test...\n");
+	failures += test_values();
+	failures += test_cladogram();
+	failures += test_non_numeric_length();
+	failures += test_invalidation();
+	if (0 == failures) {
+		printf("All tests ok.\n");
+	} else {
+		printf("%d test(s) FAILED.\n", failures);
+		return 1;
+	}
+
+	return 0;
+}
@@ -33,6 +33,8 @@ struct rooted_tree tree_1()
 	result.root = node_e;
 	result.nodes_in_order = nodes_in_order;
 	result.type = TREE_TYPE_UNKNOWN;
+	result.stats = NULL;
+	result.attrs = NULL;
 
 	return result;
 }
@@ -78,6 +80,8 @@ struct rooted_tree tree_2()
 	result.root = node_i;
 	result.nodes_in_order = nodes_in_order;
 	result.type = TREE_TYPE_UNKNOWN;
+	result.stats = NULL;
+	result.attrs = NULL;
 
 	return result;
 }
@@ -123,6 +127,8 @@ struct rooted_tree tree_3()
 	result.root = node_i;
 	result.nodes_in_order = nodes_in_order;
 	result.type = TREE_TYPE_UNKNOWN;
+	result.stats = NULL;
+	result.attrs = NULL;
 
 	return result;
 }
@@ -170,6 +176,8 @@ struct rooted_tree tree_4()
 	result.root = node_i;
 	result.nodes_in_order = nodes_in_order;
 	result.type = TREE_TYPE_UNKNOWN;
+	result.stats = NULL;
+	result.attrs = NULL;
 
 	return result;
 }
@@ -212,6 +220,8 @@ struct rooted_tree tree_5()
 	result.root = node_h;
 	result.nodes_in_order = nodes_in_order;
 	result.type = TREE_TYPE_UNKNOWN;
+	result.stats = NULL;
+	result.attrs = NULL;
 
 	return result;
 }
@@ -249,6 +259,8 @@ struct rooted_tree tree_6()
 	result.root = node_f;
 	result.nodes_in_order = nodes_in_order;
 	result.type = TREE_TYPE_UNKNOWN;
+	result.stats = NULL;
+	result.attrs = NULL;
 
 	return result;
 }
@@ -295,6 +307,8 @@ struct rooted_tree tree_7()
 	result.root = node_i;
 	result.nodes_in_order = nodes_in_order;
 	result.type = TREE_TYPE_UNKNOWN;
+	result.stats = NULL;
+	result.attrs = NULL;
 
 	return result;
 }
@@ -336,6 +350,8 @@ struct rooted_tree tree_8()
 	result.root = root;
 	result.nodes_in_order = nodes_in_order;
 	result.type = TREE_TYPE_UNKNOWN;
+	result.stats = NULL;
+	result.attrs = NULL;
 
 	return result;
 }
@@ -387,6 +403,8 @@ struct rooted_tree tree_9()
 	tree.root = nj;
 	tree.nodes_in_order = nodes_in_order;
 	tree.type = TREE_TYPE_UNKNOWN;
+	tree.stats = NULL;
+	tree.attrs = NULL;
 
 	return tree;
 }
@@ -420,6 +438,8 @@ struct rooted_tree tree_10()
 	tree.root = hominoidea;
 	tree.nodes_in_order = nodes_in_order;
 	tree.type = TREE_TYPE_UNKNOWN;
+	tree.stats = NULL;
+	tree.attrs = NULL;
 
 	return tree;
 }
@@ -456,6 +476,8 @@ struct rooted_tree tree_11()
 	tree.root = hominoidea;
 	tree.nodes_in_order = nodes_in_order;
 	tree.type = TREE_TYPE_UNKNOWN;
+	tree.stats = NULL;
+	tree.attrs = NULL;
 
 	return tree;
 }
@@ -489,6 +511,8 @@ struct rooted_tree tree_12()
 	result.root = node_e;
 	result.nodes_in_order = nodes_in_order;
 	result.type = TREE_TYPE_UNKNOWN;
+	result.stats = NULL;
+	result.attrs = NULL;
 
 	return result;
 }
@@ -535,6 +559,8 @@ struct rooted_tree tree_13()
 	result.root = node_i;
 	result.nodes_in_order = nodes_in_order;
 	result.type = TREE_TYPE_UNKNOWN;
+	result.stats = NULL;
+	result.attrs = NULL;
 
 	return result;
 }
@@ -586,6 +612,8 @@ struct rooted_tree tree_14()
 	result.root = Vertebrata;
 	result.nodes_in_order = nodes_in_order;
 	result.type = TREE_TYPE_CLADOGRAM; 	/* should make no difference */
+	result.stats = NULL;
+	result.attrs = NULL;
 
 	return result;
 }
@@ -636,6 +664,8 @@ struct rooted_tree tree_15()
 	result.root = Vertebrata;
 	result.nodes_in_order = nodes_in_order;
 	result.type = TREE_TYPE_CLADOGRAM; 	/* should make no difference */
+	result.stats = NULL;
+	result.attrs = NULL;
 
 	return result;
 }
@@ -668,6 +698,8 @@ struct rooted_tree tree_16()
 	result.root = root;
 	result.nodes_in_order = nodes_in_order;
 	result.type = TREE_TYPE_CLADOGRAM; 	/* should make no difference */
+	result.stats = NULL;
+	result.attrs = NULL;
 
 	return result;
 }
@@ -738,6 +770,8 @@ struct rooted_tree tree_17()
 	result.root = node_p;
 	result.nodes_in_order = nodes_in_order;
 	result.type = TREE_TYPE_CLADOGRAM;
+	result.stats = NULL;
+	result.attrs = NULL;
 
 	return result;
 }